@@ -0,0 +1,783 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Benchmarks of every check, the SRS index, the prefilter and the walker.
+//!
+//! Run with `cargo bench --bench checks [-- options]`:
+//!
+//!   --sizes <list>     corpus sizes in files (default: 1000,10000,100000)
+//!   --filter <text>    only run benchmarks whose name contains <text>
+//!   --save <file>      write the results (name, median ns, bytes) as tab-separated lines
+//!   --baseline <file>  show the change of each median against a file written by --save
+//!
+//! The corpora are clean synthetic repositories written once under the temp
+//! directory by the synth_repo generator (see support/corpus.rs). Check benchmarks
+//! run check_file on every file the walker would give the check, then finalize();
+//! files are read and scanned by the prefilter beforehand. Walk benchmarks run the whole walker, reads included.
+//! Cold read benchmarks (Linux) run it after dropping the page cache.
+//! The adversarial benchmarks run every check on single pathological files.
+//! Memory benchmarks run once and report the peak live heap of the routine, counted
+//! by the global allocator, the growth of the resident set (Linux), and the heap
+//! still held by the result.
+
+#![allow(dead_code)]
+
+#[path = "../src/c_lexer.rs"]
+mod c_lexer;
+#[path = "../src/cache.rs"]
+mod cache;
+#[path = "../src/changed_files.rs"]
+mod changed_files;
+#[path = "../src/checks/mod.rs"]
+mod checks;
+#[path = "../src/codec.rs"]
+mod codec;
+#[path = "../src/config.rs"]
+mod config;
+#[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64")))]
+#[path = "../src/dir_reader.rs"]
+mod dir_reader;
+#[path = "../src/exclusions.rs"]
+mod exclusions;
+#[path = "../src/file_walker.rs"]
+mod file_walker;
+#[path = "../src/fixes.rs"]
+mod fixes;
+#[path = "../src/git_objects.rs"]
+mod git_objects;
+#[path = "../src/hash.rs"]
+mod hash;
+#[path = "../src/inflate.rs"]
+mod inflate;
+#[path = "../src/line_index.rs"]
+mod line_index;
+#[path = "../src/memory.rs"]
+mod memory;
+#[path = "../src/prefilter.rs"]
+mod prefilter;
+#[path = "../src/scan.rs"]
+mod scan;
+#[path = "../src/srs_index.rs"]
+mod srs_index;
+#[path = "../src/timings.rs"]
+mod timings;
+#[cfg(target_os = "linux")]
+#[path = "../src/uring.rs"]
+mod uring;
+#[path = "../src/work_queue.rs"]
+mod work_queue;
+
+#[path = "../src/bin/synth_repo/generator.rs"]
+mod generator;
+#[path = "support/corpus.rs"]
+mod corpus;
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::cell::OnceCell;
+use std::collections::HashMap;
+use std::fs;
+use std::hint::black_box;
+use std::path::Path;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::{Duration, Instant};
+
+use cache::ResultCache;
+use checks::Check;
+use config::*;
+use exclusions::Exclusions;
+use file_walker::{classify_file_type, is_in_devdoc_directory};
+use fixes::PendingFixes;
+use prefilter::Prefilter;
+use srs_index::{SrsIndex, SrsIndexBuilder};
+use timings::Profiler;
+
+const MIN_SAMPLES: usize = 5;
+const MAX_SAMPLES: usize = 100;
+const MIN_TIME: Duration = Duration::from_secs(1);
+
+/// The system allocator, counting live heap bytes and their high-water mark
+struct CountingAllocator;
+
+static LIVE_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn count_alloc(size: usize) {
+    let live = LIVE_BYTES.fetch_add(size, Ordering::Relaxed) + size;
+    PEAK_BYTES.fetch_max(live, Ordering::Relaxed);
+}
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = System.alloc(layout);
+        if !ptr.is_null() {
+            count_alloc(layout.size());
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout);
+        LIVE_BYTES.fetch_sub(layout.size(), Ordering::Relaxed);
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new_ptr = System.realloc(ptr, layout, new_size);
+        if !new_ptr.is_null() {
+            LIVE_BYTES.fetch_sub(layout.size(), Ordering::Relaxed);
+            count_alloc(new_size);
+        }
+        new_ptr
+    }
+}
+
+#[global_allocator]
+static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+/// Sends stdout to /dev/null while alive: the walker prints every finding
+struct Quiet {
+    #[cfg(unix)]
+    saved: i32,
+}
+
+#[cfg(unix)]
+extern "C" {
+    fn dup(fd: i32) -> i32;
+    fn dup2(oldfd: i32, newfd: i32) -> i32;
+    fn close(fd: i32) -> i32;
+}
+
+impl Quiet {
+    #[cfg(unix)]
+    fn new() -> Self {
+        use std::io::Write;
+        use std::os::unix::io::AsRawFd;
+        let _ = std::io::stdout().flush();
+        let null = fs::OpenOptions::new().write(true).open("/dev/null").expect("open /dev/null");
+        let saved = unsafe { dup(1) };
+        unsafe { dup2(null.as_raw_fd(), 1) };
+        Self { saved }
+    }
+
+    #[cfg(not(unix))]
+    fn new() -> Self {
+        Self {}
+    }
+}
+
+impl Drop for Quiet {
+    fn drop(&mut self) {
+        #[cfg(unix)]
+        {
+            use std::io::Write;
+            let _ = std::io::stdout().flush();
+            unsafe {
+                dup2(self.saved, 1);
+                close(self.saved);
+            }
+        }
+    }
+}
+
+struct Options {
+    sizes: Vec<usize>,
+    filter: Option<String>,
+    save: Option<String>,
+    baseline: Option<String>,
+}
+
+fn parse_options() -> Options {
+    let mut options = Options {
+        sizes: vec![1000, 10000, 100000],
+        filter: None,
+        save: None,
+        baseline: None,
+    };
+    let args: Vec<String> = std::env::args().skip(1).collect();
+    let mut i = 0;
+    while i < args.len() {
+        let value = args.get(i + 1).cloned();
+        match args[i].as_str() {
+            "--sizes" => {
+                options.sizes = value
+                    .unwrap_or_default()
+                    .split(',')
+                    .filter_map(|size| size.trim().parse().ok())
+                    .collect();
+                i += 1;
+            }
+            "--filter" => {
+                options.filter = value;
+                i += 1;
+            }
+            "--save" => {
+                options.save = value;
+                i += 1;
+            }
+            "--baseline" => {
+                options.baseline = value;
+                i += 1;
+            }
+            // Passed by `cargo bench`
+            "--bench" => {}
+            other if !other.starts_with('-') => options.filter = Some(other.to_string()),
+            _ => {}
+        }
+        i += 1;
+    }
+    options
+}
+
+struct Bench {
+    filter: Option<String>,
+    baseline: HashMap<String, f64>,
+    /// (name, median ns or peak heap bytes, bytes processed per iteration)
+    results: Vec<(String, f64, u64)>,
+}
+
+impl Bench {
+    fn wants(&self, name: &str) -> bool {
+        self.filter.as_ref().is_none_or(|filter| name.contains(filter.as_str()))
+    }
+
+    /// Time `routine` until MIN_TIME has passed (at least MIN_SAMPLES runs) and
+    /// report the median
+    fn run(&mut self, name: &str, bytes: u64, routine: impl FnMut()) {
+        self.run_prepared(name, bytes, || {}, routine);
+    }
+
+    /// As run, calling `prepare` untimed before every run of `routine`
+    fn run_prepared(&mut self, name: &str, bytes: u64, mut prepare: impl FnMut(), mut routine: impl FnMut()) {
+        if !self.wants(name) {
+            return;
+        }
+        let mut samples: Vec<Duration> = Vec::new();
+        {
+            let _quiet = Quiet::new();
+            prepare();
+            routine();
+            let started = Instant::now();
+            while samples.len() < MIN_SAMPLES || (started.elapsed() < MIN_TIME && samples.len() < MAX_SAMPLES) {
+                prepare();
+                let sample = Instant::now();
+                routine();
+                samples.push(sample.elapsed());
+            }
+        }
+        samples.sort();
+        let median = samples[samples.len() / 2].as_secs_f64() * 1e9;
+        let fastest = samples[0].as_secs_f64() * 1e9;
+
+        let throughput = if bytes > 0 {
+            format!("{:>10.1}", bytes as f64 / median * 1e3)
+        } else {
+            format!("{:>10}", "-")
+        };
+        let change = match self.baseline.get(name) {
+            Some(before) => format!("{:>+8.1}%", (median - before) / before * 100.0),
+            None => String::new(),
+        };
+        println!(
+            "{:<44} {:>12.3} {:>12.3} {} {}",
+            name,
+            median / 1e6,
+            fastest / 1e6,
+            throughput,
+            change
+        );
+        self.results.push((name.to_string(), median, bytes));
+    }
+
+    /// Run `routine` once and report the most heap it had live at any time, the
+    /// growth of the resident set, and how much heap the value it returns still holds.
+    /// The heap figures count capacity, touched or not; RSS counts touched pages only.
+    fn memory<T>(&mut self, name: &str, routine: impl FnOnce() -> T) {
+        if !self.wants(name) {
+            return;
+        }
+        let (peak, rss, retained) = {
+            let _quiet = Quiet::new();
+            let rss_before = reset_peak_rss();
+            let before = LIVE_BYTES.load(Ordering::Relaxed);
+            PEAK_BYTES.store(before, Ordering::Relaxed);
+            let value = routine();
+            let peak = PEAK_BYTES.load(Ordering::Relaxed) - before;
+            let retained = LIVE_BYTES.load(Ordering::Relaxed).saturating_sub(before);
+            let rss = match (rss_before, peak_rss()) {
+                (Some(before), Some(after)) => Some(after.saturating_sub(before) as f64),
+                _ => None,
+            };
+            drop(value);
+            (peak as f64, rss, retained as f64)
+        };
+
+        // Saved and compared: the RSS growth where it can be measured, else the heap peak
+        let key = rss.unwrap_or(peak);
+        let change = match self.baseline.get(name) {
+            Some(before) => format!("{:>+8.1}%", (key - before) / before * 100.0),
+            None => String::new(),
+        };
+        let rss = match rss {
+            Some(rss) => format!("{:>12.3}", rss / 1e6),
+            None => format!("{:>12}", "-"),
+        };
+        println!(
+            "{:<44} {:>12.3} {} {:>12.3} {}",
+            name,
+            peak / 1e6,
+            rss,
+            retained / 1e6,
+            change
+        );
+        self.results.push((name.to_string(), key, 0));
+    }
+}
+
+#[cfg(all(target_os = "linux", target_env = "gnu"))]
+extern "C" {
+    fn malloc_trim(pad: usize) -> i32;
+}
+
+/// Return freed heap to the system and restart the kernel's peak RSS counter.
+/// Returns the current RSS in bytes.
+#[cfg(target_os = "linux")]
+fn reset_peak_rss() -> Option<usize> {
+    #[cfg(target_env = "gnu")]
+    unsafe {
+        malloc_trim(0);
+    }
+    fs::write("/proc/self/clear_refs", "5").ok()?;
+    proc_status_kb("VmRSS:").map(|kb| kb * 1024)
+}
+
+#[cfg(target_os = "linux")]
+fn peak_rss() -> Option<usize> {
+    proc_status_kb("VmHWM:").map(|kb| kb * 1024)
+}
+
+#[cfg(target_os = "linux")]
+fn proc_status_kb(field: &str) -> Option<usize> {
+    let status = fs::read_to_string("/proc/self/status").ok()?;
+    let line = status.lines().find(|line| line.starts_with(field))?;
+    line[field.len()..].trim().trim_end_matches("kB").trim().parse().ok()
+}
+
+#[cfg(not(target_os = "linux"))]
+fn reset_peak_rss() -> Option<usize> {
+    None
+}
+
+#[cfg(not(target_os = "linux"))]
+fn peak_rss() -> Option<usize> {
+    None
+}
+
+/// Type flags the walker would give a file (see file_walker::select_file)
+fn type_flags(relative_path: &str) -> u32 {
+    let filename = relative_path.rsplit(['/', '\\']).next().unwrap_or(relative_path);
+    let mut flags = classify_file_type(filename);
+    if flags == 0 {
+        return 0;
+    }
+    if is_in_devdoc_directory(relative_path) {
+        flags |= FILE_FLAG_IN_DEVDOC;
+    }
+    if filename.contains("_ut.") {
+        flags |= FILE_FLAG_IS_UT;
+    }
+    flags
+}
+
+fn file_info(root: &str, relative_path: &str, content: Vec<u8>, prefilter: &Prefilter, ordinal: usize) -> FileInfo {
+    FileInfo {
+        path: format!("{}/{}", root, relative_path),
+        relative_path: relative_path.to_string(),
+        type_flags: type_flags(relative_path),
+        matches: prefilter.scan(&content),
+        content: content.into(),
+        ordinal,
+        line_table: OnceCell::new(),
+        tokens: OnceCell::new(),
+    }
+}
+
+fn load_repository(root: &Path, prefilter: &Prefilter) -> Vec<FileInfo> {
+    fn visit(dir: &Path, root: &Path, found: &mut Vec<String>) {
+        let mut entries: Vec<_> = fs::read_dir(dir).expect("read corpus").flatten().collect();
+        entries.sort_by_key(|entry| entry.file_name());
+        for entry in entries {
+            let path = entry.path();
+            if entry.file_name().to_string_lossy().starts_with('.') {
+                continue;
+            }
+            if path.is_dir() {
+                visit(&path, root, found);
+            } else {
+                let relative = path.strip_prefix(root).unwrap().to_string_lossy().replace('\\', "/");
+                if type_flags(&relative) != 0 {
+                    found.push(relative);
+                }
+            }
+        }
+    }
+    let mut paths = Vec::new();
+    visit(root, root, &mut paths);
+
+    let root_str = root.to_string_lossy().to_string();
+    paths
+        .iter()
+        .enumerate()
+        .map(|(ordinal, relative)| {
+            let content = fs::read(root.join(relative)).expect("read corpus file");
+            file_info(&root_str, relative, content, prefilter, ordinal)
+        })
+        .collect()
+}
+
+fn config(root: &str, jobs: usize) -> ValidatorConfig {
+    ValidatorConfig {
+        repo_root: root.to_string(),
+        exclusions: Exclusions::new(vec!["deps".to_string(), "cmake".to_string()], false),
+        fix_mode: false,
+        submodule_sha: Some(generator::SUBMODULE_SHA.to_string()),
+        jobs,
+        cache_path: None,
+        changed_paths: None,
+        srs_index_out: None,
+        timings: false,
+        trace_out: None,
+        workspace: false,
+        staged: None,
+        batched_reads: false,
+        max_memory: None,
+        map_files: true,
+    }
+}
+
+fn prefilter_for(checks: &[Box<dyn Check>]) -> Prefilter {
+    Prefilter::new(checks.iter().flat_map(|check| check.needles().iter().copied()).collect())
+}
+
+/// The files the walker would pass to check_file (see file_walker::CheckFilter)
+fn wanted<'a>(check: &dyn Check, files: &'a mut [FileInfo]) -> Vec<&'a mut FileInfo> {
+    files
+        .iter_mut()
+        .filter(|file| {
+            let finds_needles = check.needles().is_empty()
+                || check.needles().iter().any(|&needle| !file.matches.offsets(needle).is_empty());
+            check.file_types() & file.type_flags != 0
+                && (!check.requires_devdoc() || file.type_flags & FILE_FLAG_IN_DEVDOC != 0)
+                && finds_needles
+        })
+        .collect()
+}
+
+/// check_file on every wanted file on a fresh shard, as one worker would.
+/// Line tables are dropped first so that every run builds its own.
+fn run_check_files(check: &mut Box<dyn Check>, files: &mut [&mut FileInfo], config: &ValidatorConfig) {
+    let mut shard = check.fork();
+    for file in files.iter_mut() {
+        file.line_table = OnceCell::new();
+        let mut report = FileReport::default();
+        shard.check_file(file, config, &mut report);
+        black_box(&report);
+    }
+    check.merge(shard);
+}
+
+fn build_index(files: &mut [FileInfo], config: &ValidatorConfig) -> SrsIndex {
+    let mut builder: Box<dyn Check> = Box::new(SrsIndexBuilder::new());
+    let mut wanted_files = wanted(builder.as_ref(), files);
+    run_check_files(&mut builder, &mut wanted_files, config);
+    checks::downcast_shard::<SrsIndexBuilder>(builder).build()
+}
+
+fn total_bytes(files: &[&mut FileInfo]) -> u64 {
+    files.iter().map(|file| file.content.len() as u64).sum()
+}
+
+/// A whole walk, printing the report as the binary does
+fn walk(config: &ValidatorConfig, checks: &mut Vec<Box<dyn Check>>, cache: Option<ResultCache>) -> file_walker::Walk {
+    let mut profiler = Profiler::new(config);
+    file_walker::walk_repository(config, checks, &mut PendingFixes::new(), cache, &mut profiler, &mut std::io::stdout(), &mut |_, _| {})
+        .expect("report written")
+}
+
+fn bench_repository(bench: &mut Bench, files: usize) {
+    let root = corpus::repository(files).expect("generate corpus");
+    let root_str = root.to_string_lossy().to_string();
+    let config = config(&root_str, 1);
+    let prefilter = prefilter_for(&checks::all_checks());
+    let mut loaded = load_repository(&root, &prefilter);
+    let corpus_bytes: u64 = loaded.iter().map(|file| file.content.len() as u64).sum();
+
+    bench.run(&format!("prefilter/{}", files), corpus_bytes, || {
+        for file in &loaded {
+            black_box(prefilter.scan(&file.content));
+        }
+    });
+
+    // The index every check's finalize() reads
+    let srs_index = build_index(&mut loaded, &config);
+    {
+        let builder = SrsIndexBuilder::new();
+        let bytes = total_bytes(&wanted(&builder, &mut loaded));
+        bench.run(&format!("srs_index/{}", files), bytes, || {
+            black_box(build_index(&mut loaded, &config));
+        });
+    }
+
+    for mut check in checks::all_checks() {
+        let name = format!("check/{}/{}", check.name(), files);
+        if !bench.wants(&name) {
+            continue;
+        }
+        let mut wanted_files = wanted(check.as_ref(), &mut loaded);
+        let bytes = total_bytes(&wanted_files);
+        bench.run(&name, bytes, || {
+            let mut out = CheckOutput::default();
+            check.init(&config, &mut out);
+            run_check_files(&mut check, &mut wanted_files, &config);
+            black_box(check.finalize(&config, &srs_index, &mut PendingFixes::new(), &mut out));
+        });
+    }
+    drop(loaded);
+
+    let jobs = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+    let mut job_counts = vec![1];
+    if jobs > 1 {
+        job_counts.push(jobs);
+    }
+    for jobs in job_counts {
+        let config = self::config(&root_str, jobs);
+        let mut all = checks::all_checks();
+        for check in all.iter_mut() {
+            check.init(&config, &mut CheckOutput::default());
+        }
+
+        // Directory enumeration alone, with directories read ahead on `jobs` threads
+        bench.run(&format!("enumerate/j{}/{}", jobs, files), 0, || {
+            let mut found = 0usize;
+            file_walker::walk_directory(&config, &mut |_, _| found += 1);
+            black_box(found);
+        });
+
+        bench.run(&format!("walk/j{}/{}", jobs, files), corpus_bytes, || {
+            let walk = walk(&config, &mut all, None);
+            black_box(walk.srs_index);
+        });
+
+        // Every file unchanged: results are replayed from the in-memory cache
+        let mut cache = Some(ResultCache::empty());
+        bench.run(&format!("walk_cached/j{}/{}", jobs, files), corpus_bytes, || {
+            let walk = walk(&config, &mut all, cache.take());
+            cache = walk.cache;
+        });
+    }
+}
+
+/// Whole walks on a cold page cache, reading files in io_uring batches and one at
+/// a time. The cache is dropped before every sample: through drop_caches when
+/// running as root, otherwise with POSIX_FADV_DONTNEED on every file of the corpus
+/// (which keeps directories and inodes cached).
+#[cfg(target_os = "linux")]
+fn bench_cold_read(bench: &mut Bench, files: usize) {
+    fn visit(dir: &Path, found: &mut Vec<std::path::PathBuf>) {
+        for entry in fs::read_dir(dir).expect("read corpus directory").flatten() {
+            let path = entry.path();
+            if path.is_dir() {
+                visit(&path, found);
+            } else {
+                found.push(path);
+            }
+        }
+    }
+
+    let root = corpus::repository(files).expect("generate corpus");
+    let root_str = root.to_string_lossy().to_string();
+    let mut paths = Vec::new();
+    visit(&root, &mut paths);
+    let corpus_bytes: u64 = paths.iter().filter_map(|path| fs::metadata(path).ok()).map(|meta| meta.len()).sum();
+
+    // Only a walk with workers reads ahead
+    let jobs = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1).max(2);
+    for (mode, batched_reads) in [("blocking", false), ("io_uring", true)] {
+        let mut config = self::config(&root_str, jobs);
+        config.batched_reads = batched_reads;
+        let mut all = checks::all_checks();
+        for check in all.iter_mut() {
+            check.init(&config, &mut CheckOutput::default());
+        }
+        bench.run_prepared(
+            &format!("cold_read/{}/{}", mode, files),
+            corpus_bytes,
+            || evict_page_cache(&paths),
+            || {
+                let walk = walk(&config, &mut all, None);
+                black_box(walk.srs_index);
+            },
+        );
+    }
+}
+
+#[cfg(target_os = "linux")]
+extern "C" {
+    fn sync();
+    fn posix_fadvise(fd: i32, offset: i64, len: i64, advice: i32) -> i32;
+}
+
+#[cfg(target_os = "linux")]
+fn evict_page_cache(paths: &[std::path::PathBuf]) {
+    use std::os::unix::io::AsRawFd;
+    const POSIX_FADV_DONTNEED: i32 = 4;
+    unsafe { sync() };
+    if fs::write("/proc/sys/vm/drop_caches", b"3").is_ok() {
+        return;
+    }
+    for path in paths {
+        if let Ok(file) = fs::File::open(path) {
+            unsafe { posix_fadvise(file.as_raw_fd(), 0, 0, POSIX_FADV_DONTNEED) };
+        }
+    }
+}
+
+/// Peak and retained heap of collecting the SRS index, building it, and a whole walk
+fn bench_memory(bench: &mut Bench, files: usize) {
+    let root = corpus::repository(files).expect("generate corpus");
+    let root_str = root.to_string_lossy().to_string();
+    let config = config(&root_str, 1);
+    let prefilter = prefilter_for(&checks::all_checks());
+    let mut loaded = load_repository(&root, &prefilter);
+
+    // Line tables are cached in the files; drop the ones a routine built so that
+    // they do not count as retained
+    fn drop_line_tables(files: &mut [FileInfo]) {
+        for file in files.iter_mut() {
+            file.line_table = OnceCell::new();
+        }
+    }
+
+    bench.memory(&format!("memory/srs_collect/{}", files), || {
+        let mut builder: Box<dyn Check> = Box::new(SrsIndexBuilder::new());
+        let mut wanted_files = wanted(builder.as_ref(), &mut loaded);
+        run_check_files(&mut builder, &mut wanted_files, &config);
+        drop(wanted_files);
+        drop_line_tables(&mut loaded);
+        builder
+    });
+    bench.memory(&format!("memory/srs_index/{}", files), || {
+        let srs_index = build_index(&mut loaded, &config);
+        drop_line_tables(&mut loaded);
+        srs_index
+    });
+    drop(loaded);
+
+    let mut all = checks::all_checks();
+    for check in all.iter_mut() {
+        check.init(&config, &mut CheckOutput::default());
+    }
+    bench.memory(&format!("memory/walk/j1/{}", files), || {
+        walk(&config, &mut all, None).srs_index
+    });
+
+    // Workers reading ahead, without and with a budget for file contents
+    let jobs = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1).max(2);
+    for (mode, max_memory) in [("unbounded", None), ("max_memory_4M", Some(4 << 20))] {
+        let mut config = self::config(&root_str, jobs);
+        config.max_memory = max_memory;
+        bench.memory(&format!("memory/walk/j{}/{}/{}", jobs, mode, files), || {
+            walk(&config, &mut all, None).srs_index
+        });
+    }
+}
+
+/// Run every check on one pathological file (plus the SRS index)
+fn bench_adversarial(bench: &mut Bench, name: &str, inputs: &[(&str, String)]) {
+    let root = "adversarial";
+    let config = config(root, 1);
+    let prefilter = prefilter_for(&checks::all_checks());
+    let mut files: Vec<FileInfo> = inputs
+        .iter()
+        .enumerate()
+        .map(|(ordinal, (path, content))| file_info(root, path, content.clone().into_bytes(), &prefilter, ordinal))
+        .collect();
+
+    let mut all: Vec<Box<dyn Check>> = checks::all_checks();
+    all.push(Box::new(SrsIndexBuilder::new()));
+    for mut check in all {
+        let mut wanted_files = wanted(check.as_ref(), &mut files);
+        if wanted_files.is_empty() {
+            continue;
+        }
+        let bytes = total_bytes(&wanted_files);
+        bench.run(&format!("adversarial/{}/{}", name, check.name()), bytes, || {
+            run_check_files(&mut check, &mut wanted_files, &config);
+        });
+    }
+}
+
+fn main() {
+    let options = parse_options();
+    let baseline = match &options.baseline {
+        Some(path) => fs::read_to_string(path)
+            .expect("read baseline")
+            .lines()
+            .filter_map(|line| {
+                let mut fields = line.split('\t');
+                Some((fields.next()?.to_string(), fields.next()?.parse().ok()?))
+            })
+            .collect(),
+        None => HashMap::new(),
+    };
+    let mut bench = Bench {
+        filter: options.filter.clone(),
+        baseline,
+        results: Vec::new(),
+    };
+
+    println!(
+        "{:<44} {:>12} {:>12} {:>10} {}",
+        "benchmark",
+        "median ms",
+        "min ms",
+        "MB/s",
+        if options.baseline.is_some() { "  change" } else { "" }
+    );
+
+    let (requirements, source) = corpus::many_tags(5000);
+    bench_adversarial(
+        &mut bench,
+        "long_lines",
+        &[("long_lines.c", corpus::long_lines(4 << 20)), ("devdoc/long_lines_requirements.md", corpus::long_lines(4 << 20))],
+    );
+    bench_adversarial(
+        &mut bench,
+        "many_tags",
+        &[("devdoc/big_module_requirements.md", requirements), ("big_module.c", source)],
+    );
+    bench_adversarial(&mut bench, "deep_nesting", &[("deep_ut.c", corpus::deep_nesting(100, 1000))]);
+    bench_adversarial(&mut bench, "many_lines", &[("many_lines.c", corpus::many_lines(32 << 20))]);
+
+    for &files in &options.sizes {
+        bench_repository(&mut bench, files);
+    }
+    #[cfg(target_os = "linux")]
+    for &files in &options.sizes {
+        bench_cold_read(&mut bench, files);
+    }
+
+    println!();
+    println!("{:<44} {:>12} {:>12} {:>12}", "benchmark", "peak heap MB", "peak RSS MB", "retained MB");
+    for &files in &options.sizes {
+        bench_memory(&mut bench, files);
+    }
+
+    if let Some(path) = &options.save {
+        let lines: String = bench
+            .results
+            .iter()
+            .map(|(name, median, bytes)| format!("{}\t{:.0}\t{}\n", name, median, bytes))
+            .collect();
+        fs::write(path, lines).expect("write results");
+        println!("Results written to {}", path);
+    }
+}
@@ -0,0 +1,175 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Microbenchmark for the byte-scanning kernels in src/scan.rs.
+//!
+//! Run with `cargo bench --bench scan_kernels`. Every kernel scans the same synthetic
+//! C source with the scalar loop it replaced and with each implementation this CPU
+//! supports. Results are checked against the scalar loop before anything is timed.
+
+#[allow(dead_code)]
+#[path = "../src/scan.rs"]
+mod scan;
+
+use scan::Kernels;
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+const DATA_SIZE: usize = 8 << 20;
+const MIN_RUN_TIME: Duration = Duration::from_millis(200);
+const RUNS: usize = 5;
+
+/// Deterministic C-like text: CRLF lines, block and line comments, a few tabs and backticks
+fn synthetic_source(size: usize) -> Vec<u8> {
+    const LINES: &[&[u8]] = &[
+        b"    /* Codes_SRS_MODULE_01_001: [ module_create shall allocate a handle. ]*/",
+        b"    MODULE_HANDLE result = malloc(sizeof(MODULE));",
+        b"    if (result == NULL)",
+        b"    {",
+        b"        LogError(\"malloc failed, size=%zu\", sizeof(MODULE));",
+        b"    }",
+        b"    // arrange",
+        b"    STRICT_EXPECTED_CALL(gballoc_hl_malloc(IGNORED_ARG));",
+        b"",
+        b"TEST_FUNCTION(module_create_succeeds)",
+        b"    return result;",
+        b"}",
+    ];
+
+    let mut data = Vec::with_capacity(size + 128);
+    let mut seed = 0x2545_f491_4f6c_dd1du64;
+    while data.len() < size {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        data.extend_from_slice(LINES[(seed % LINES.len() as u64) as usize]);
+        match seed % 97 {
+            0 => data.push(b'\t'),
+            1 => data.extend_from_slice(b" `x`"),
+            2 => data.push(b'@'),
+            _ => {}
+        }
+        data.extend_from_slice(b"\r\n");
+    }
+    data.truncate(size);
+    data
+}
+
+/// Sum of the offsets of every match found by repeatedly calling `find`
+fn forward_matches(haystack: &[u8], find: impl Fn(&[u8]) -> Option<usize>) -> usize {
+    let mut sum = 0usize;
+    let mut start = 0usize;
+    while let Some(i) = find(&haystack[start..]) {
+        sum = sum.wrapping_add(start + i);
+        start += i + 1;
+    }
+    sum
+}
+
+fn backward_matches(haystack: &[u8], find: impl Fn(&[u8]) -> Option<usize>) -> usize {
+    let mut sum = 0usize;
+    let mut end = haystack.len();
+    while let Some(i) = find(&haystack[..end]) {
+        sum = sum.wrapping_add(i);
+        end = i;
+    }
+    sum
+}
+
+struct Workload {
+    name: &'static str,
+    scalar: fn(&[u8]) -> usize,
+    kernel: fn(&Kernels, &[u8]) -> usize,
+}
+
+const WORKLOADS: &[Workload] = &[
+    Workload {
+        name: "memchr (tab, rare)",
+        scalar: |h| forward_matches(h, |s| s.iter().position(|&b| b == b'\t')),
+        kernel: |k, h| forward_matches(h, |s| (k.memchr)(b'\t', s)),
+    },
+    Workload {
+        name: "memchr (newline, dense)",
+        scalar: |h| forward_matches(h, |s| s.iter().position(|&b| b == b'\n')),
+        kernel: |k, h| forward_matches(h, |s| (k.memchr)(b'\n', s)),
+    },
+    Workload {
+        name: "memchr2 (tab, backtick)",
+        scalar: |h| forward_matches(h, |s| s.iter().position(|&b| b == b'\t' || b == b'`')),
+        kernel: |k, h| forward_matches(h, |s| (k.memchr2)(b'\t', b'`', s)),
+    },
+    Workload {
+        name: "memchr3 (tab, backtick, @)",
+        scalar: |h| {
+            forward_matches(h, |s| s.iter().position(|&b| b == b'\t' || b == b'`' || b == b'@'))
+        },
+        kernel: |k, h| forward_matches(h, |s| (k.memchr3)(b'\t', b'`', b'@', s)),
+    },
+    Workload {
+        name: "memrchr (tab)",
+        scalar: |h| backward_matches(h, |s| s.iter().rposition(|&b| b == b'\t')),
+        kernel: |k, h| backward_matches(h, |s| (k.memrchr)(b'\t', s)),
+    },
+    Workload {
+        name: "count newlines",
+        scalar: |h| h.iter().filter(|&&b| b == b'\n').count(),
+        kernel: |k, h| (k.count)(b'\n', h),
+    },
+    Workload {
+        name: "find_pair (\"/*\")",
+        scalar: |h| {
+            forward_matches(h, |s| s.windows(2).position(|w| w[0] == b'/' && w[1] == b'*'))
+        },
+        kernel: |k, h| forward_matches(h, |s| (k.find_pair)(b'/', b'*', s)),
+    },
+];
+
+/// Best throughput over several runs, in MB/s
+fn measure(data: &[u8], run: impl Fn(&[u8]) -> usize) -> f64 {
+    let mut best = f64::MAX;
+    for _ in 0..RUNS {
+        let start = Instant::now();
+        let mut iterations = 0u32;
+        while start.elapsed() < MIN_RUN_TIME {
+            black_box(run(black_box(data)));
+            iterations += 1;
+        }
+        best = best.min(start.elapsed().as_secs_f64() / iterations as f64);
+    }
+    data.len() as f64 / best / 1e6
+}
+
+fn main() {
+    let data = synthetic_source(DATA_SIZE);
+    let kernels = scan::available_kernels();
+
+    println!("Scanning {} MiB of synthetic C source", DATA_SIZE >> 20);
+    println!("Selected implementation: {}", scan::kernels().name);
+    println!();
+    println!("{:<28} {:<12} {:>10} {:>9}", "kernel", "impl", "MB/s", "speedup");
+
+    for workload in WORKLOADS {
+        let expected = (workload.scalar)(&data);
+        for k in &kernels {
+            let actual = (workload.kernel)(k, &data);
+            assert_eq!(
+                actual, expected,
+                "{} ({}) disagrees with the scalar loop",
+                workload.name, k.name
+            );
+        }
+
+        let baseline = measure(&data, workload.scalar);
+        println!("{:<28} {:<12} {:>10.0} {:>8.2}x", workload.name, "scalar", baseline, 1.0);
+        for k in &kernels {
+            let throughput = measure(&data, |h| (workload.kernel)(k, h));
+            println!(
+                "{:<28} {:<12} {:>10.0} {:>8.2}x",
+                "",
+                k.name,
+                throughput,
+                throughput / baseline
+            );
+        }
+    }
+}
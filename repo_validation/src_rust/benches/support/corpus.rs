@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Synthetic inputs for the check benchmarks: clean repositories of a given size and
+//! single adversarial files. Everything is derived from a fixed seed, so every run
+//! (and every commit) measures the same bytes.
+
+use std::fs;
+use std::io;
+use std::path::PathBuf;
+
+use crate::generator::{self, Params, Rng};
+
+/// Bump when the generated tree changes, so stale corpora are regenerated
+const CORPUS_VERSION: u32 = 2;
+
+/// A clean repository of about `files` files under the temp directory, written by
+/// the synth_repo generator on first use and reused by later runs
+pub fn repository(files: usize) -> io::Result<PathBuf> {
+    let root = std::env::temp_dir().join(format!("repo_validator_bench_{}", files));
+    let marker = root.join(format!(".corpus_v{}", CORPUS_VERSION));
+    if marker.exists() {
+        return Ok(root);
+    }
+    if root.exists() {
+        fs::remove_dir_all(&root)?;
+    }
+
+    let params = Params {
+        seed: files as u64,
+        files,
+        ..Params::default()
+    };
+    generator::generate(&root, &params)?;
+    fs::write(marker, b"")?;
+    Ok(root)
+}
+
+/// A file made of a few lines, each about `line_len` bytes long. Every line ends in
+/// a tab, a backtick and an SRS tag, so that the checks looking for those reach it.
+pub fn long_lines(line_len: usize) -> String {
+    let filler = "abcdefghijklmnopqrstuvwxyz ".repeat(line_len / 27 + 1);
+    (1..=4)
+        .map(|line| {
+            format!(
+                "int x{0} = 0; /* {1} `x`\t*/ /*Codes_SRS_LONG_LINES_01_{0:03}: [ long_lines shall scan. ]*/\r\n",
+                line,
+                &filler[..line_len]
+            )
+        })
+        .collect()
+}
+
+/// A source file of about `bytes` bytes of short lines. Every 64th line holds an SRS
+/// tag, so that the checks reporting tag lines look up lines all through the file.
+pub fn many_lines(bytes: usize) -> String {
+    let mut content = String::with_capacity(bytes + 128);
+    let mut line = 0;
+    while content.len() < bytes {
+        line += 1;
+        if line % 64 == 0 {
+            content.push_str(&format!("    /*Codes_SRS_MANY_LINES_01_{:06}: [ many_lines shall scan. ]*/\r\n", line));
+        } else {
+            content.push_str(&format!("    int x{} = {};\r\n", line, line % 7));
+        }
+    }
+    content
+}
+
+/// A requirements document and a source file referencing the same `tags` SRS tags
+pub fn many_tags(tags: usize) -> (String, String) {
+    let mut rng = Rng::new(0x7a95);
+    let mut requirements = String::from("# big_module requirements\r\n\r\n");
+    let mut source = String::from("#include \"big_module.h\"\r\n\r\nint big_module(void)\r\n{\r\n");
+    for tag in 1..=tags {
+        let text = generator::requirement_text(&mut rng, "big_module");
+        requirements.push_str(&format!("**SRS_BIG_MODULE_01_{:05}: [** {} **]**\r\n\r\n", tag, text));
+        source.push_str(&format!("    /*Codes_SRS_BIG_MODULE_01_{:05}: [ {} ]*/\r\n", tag, text));
+    }
+    source.push_str("    return 0;\r\n}\r\n");
+    (requirements, source)
+}
+
+/// A unit test file whose test bodies nest braces `depth` levels deep
+pub fn deep_nesting(tests: usize, depth: usize) -> String {
+    let mut content = String::from("#include \"testrunnerswitcher.h\"\r\n\r\nBEGIN_TEST_SUITE(deep_ut)\r\n\r\n");
+    for test in 0..tests {
+        content.push_str(&format!("TEST_FUNCTION(deep_{})\r\n{{\r\n    // arrange\r\n    int x = 0;\r\n\r\n    // act\r\n", test));
+        for _ in 0..depth {
+            content.push_str("    if (x == 0) { x++;\r\n");
+        }
+        for _ in 0..depth {
+            content.push_str("    }\r\n");
+        }
+        content.push_str("\r\n    // assert\r\n    ASSERT_ARE_EQUAL(int, 1, x);\r\n}\r\n\r\n");
+    }
+    content.push_str("END_TEST_SUITE(deep_ut)\r\n");
+    content
+}
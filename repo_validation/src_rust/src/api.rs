@@ -0,0 +1,245 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Library API: run the checks on files the caller already holds.
+//!
+//! Git hooks, the srs_extension and editors pass (relative path, content) pairs,
+//! such as staged blobs or unsaved buffers, to Validator::validate_files and get
+//! the findings back as data instead of a printed report. Nothing is read from
+//! the repository except what c_build_tools_ref needs (.gitmodules and the
+//! submodule commit), and nothing is written: fix mode is not available here.
+//!
+//! Cross-file checks only see the files given. Validating one requirement
+//! document on its own, for example, cannot find a duplicate of one of its tags
+//! in another document.
+
+use std::fmt;
+
+use crate::checks::{self, Check};
+use crate::config::{self, CheckOutput, ValidatorConfig};
+use crate::exclusions::{Exclusions, DEFAULT_EXCLUDED_FOLDERS};
+use crate::file_walker;
+use crate::fixes::PendingFixes;
+use crate::timings::Profiler;
+
+pub use crate::config::Severity;
+
+/// One problem reported by a check
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct Finding {
+    /// Name of the check that reported it
+    pub check: String,
+    /// The file it is about, relative to the repository root. For a finding that
+    /// needs every file's results, such as a duplicate SRS tag, the file where it
+    /// shows (the duplicate); None when no file is to blame, for example when the
+    /// submodule commit cannot be read.
+    pub path: Option<String>,
+    /// 1-based line in that file, when the check knows it
+    pub line: Option<usize>,
+    pub severity: Severity,
+    /// What is wrong, as the binary prints it after [ERROR] or [WARN]
+    pub message: String,
+    /// Lines the binary prints under the message (the first occurrence of a
+    /// duplicate tag, the texts that disagree)
+    pub details: Vec<String>,
+}
+
+impl Finding {
+    pub(crate) fn new(check: &str, finding: config::Finding) -> Self {
+        Self {
+            check: check.to_string(),
+            path: finding.path,
+            line: finding.line,
+            severity: finding.severity,
+            message: finding.message,
+            details: finding.details,
+        }
+    }
+}
+
+/// The finding as the binary prints it, without indentation
+impl fmt::Display for Finding {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        let finding = config::Finding {
+            severity: self.severity,
+            path: self.path.clone(),
+            line: self.line,
+            message: self.message.clone(),
+            details: self.details.clone(),
+        };
+        f.write_str(&finding.render(0))
+    }
+}
+
+/// Verdict of one check
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct CheckSummary {
+    pub name: String,
+    /// 0 when the check passed
+    pub violations: i32,
+}
+
+/// Result of Validator::validate_files
+#[derive(Debug, Clone, Default)]
+pub struct Validation {
+    /// In report order: findings of the checks' set-up (c_build_tools_ref reading
+    /// the submodule commit), per-file findings in input order, then the findings
+    /// that needed every file, in check order
+    pub findings: Vec<Finding>,
+    /// Every active check, in check order
+    pub checks: Vec<CheckSummary>,
+    /// Files that at least one active check looked at
+    pub files_checked: usize,
+}
+
+impl Validation {
+    pub fn passed(&self) -> bool {
+        self.checks.iter().all(|check| check.violations == 0)
+    }
+}
+
+/// The checks to run and the options they run with. A validator can be reused:
+/// every call to validate_files starts from a clean state.
+pub struct Validator {
+    config: ValidatorConfig,
+    checks: Vec<Box<dyn Check>>,
+}
+
+impl Default for Validator {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Validator {
+    /// A validator running every check. Files under the default excluded folders
+    /// (deps, cmake) are skipped, and the repository root is the current directory.
+    pub fn new() -> Self {
+        let folders = DEFAULT_EXCLUDED_FOLDERS.iter().map(|folder| folder.to_string()).collect();
+        Self {
+            config: ValidatorConfig {
+                repo_root: ".".to_string(),
+                exclusions: Exclusions::new(folders, false),
+                fix_mode: false,
+                submodule_sha: None,
+                jobs: 1,
+                cache_path: None,
+                changed_paths: None,
+                srs_index_out: None,
+                timings: false,
+                trace_out: None,
+                workspace: false,
+                staged: None,
+                batched_reads: false,
+                max_memory: None,
+                map_files: false,
+            },
+            checks: checks::all_checks(),
+        }
+    }
+
+    /// (name, description) of every check, in the order they run
+    pub fn available_checks() -> Vec<(String, String)> {
+        checks::all_checks()
+            .iter()
+            .map(|check| (check.name().to_string(), check.description().to_string()))
+            .collect()
+    }
+
+    /// Run only the named checks. Fails on a name no check has.
+    pub fn with_checks<S: AsRef<str>>(mut self, names: &[S]) -> Result<Self, String> {
+        if let Some(unknown) = names
+            .iter()
+            .map(|name| name.as_ref())
+            .find(|name| !checks::all_checks().iter().any(|check| check.name() == *name))
+        {
+            return Err(format!("no check named '{}'", unknown));
+        }
+        self.checks = checks::all_checks()
+            .into_iter()
+            .filter(|check| names.iter().any(|name| name.as_ref() == check.name()))
+            .collect();
+        Ok(self)
+    }
+
+    /// The repository the files belong to (default: the current directory).
+    /// Only c_build_tools_ref reads from it.
+    pub fn repo_root(mut self, repo_root: &str) -> Self {
+        self.config.repo_root = repo_root.trim_end_matches(['/', '\\']).to_string();
+        self
+    }
+
+    /// Folders to skip in addition to the default ones, as with --exclude-folders
+    pub fn exclude_folders<S: AsRef<str>>(mut self, folders: &[S]) -> Self {
+        let mut all: Vec<String> = self.config.exclusions.folders().to_vec();
+        for folder in folders {
+            let folder = folder.as_ref().trim();
+            if !folder.is_empty() && !all.iter().any(|f| f == folder) {
+                all.push(folder.to_string());
+            }
+        }
+        self.config.exclusions = Exclusions::new(all, false);
+        self
+    }
+
+    /// The commit c_build_tools_ref expects pipelines to reference, as with --submodule-sha
+    pub fn submodule_sha(mut self, sha: &str) -> Self {
+        self.config.submodule_sha = Some(sha.trim().to_string()).filter(|sha| !sha.is_empty());
+        self
+    }
+
+    /// Run the checks on (path relative to the repository root, content) pairs
+    pub fn validate_files<I, P, B>(&mut self, files: I) -> Validation
+    where
+        I: IntoIterator<Item = (P, B)>,
+        P: Into<String>,
+        B: Into<Vec<u8>>,
+    {
+        let config = &self.config;
+        let mut profiler = Profiler::new(config);
+        let mut validation = Validation::default();
+
+        for check in self.checks.iter_mut() {
+            let mut out = CheckOutput::default();
+            check.init(config, &mut out);
+            push_findings(&mut validation.findings, check.name(), out.findings);
+        }
+
+        let names: Vec<String> = self.checks.iter().map(|check| check.name().to_string()).collect();
+        let mut files = files.into_iter().map(|(path, content)| (path.into(), content.into()));
+        let findings = &mut validation.findings;
+        let files_checked = &mut validation.files_checked;
+        let srs_index = file_walker::check_buffers(config, &mut self.checks, &mut files, &mut profiler, &mut |_, reports| {
+            *files_checked += 1;
+            for (index, reported) in reports {
+                push_findings(findings, &names[index], reported);
+            }
+        });
+
+        let mut fixes = PendingFixes::new();
+        for check in self.checks.iter_mut() {
+            let mut out = CheckOutput::default();
+            let violations = check.finalize(config, &srs_index, &mut fixes, &mut out);
+            push_findings(&mut validation.findings, check.name(), out.findings);
+            validation.checks.push(CheckSummary {
+                name: check.name().to_string(),
+                violations: violations.max(0),
+            });
+        }
+        validation
+    }
+}
+
+/// Run every check on (path relative to the current directory, content) pairs
+pub fn validate_files<I, P, B>(files: I) -> Validation
+where
+    I: IntoIterator<Item = (P, B)>,
+    P: Into<String>,
+    B: Into<Vec<u8>>,
+{
+    Validator::new().validate_files(files)
+}
+
+fn push_findings(findings: &mut Vec<Finding>, check: &str, reported: Vec<config::Finding>) {
+    findings.extend(reported.into_iter().map(|finding| Finding::new(check, finding)));
+}
@@ -0,0 +1,414 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Deterministic synthetic repositories for scale testing the validator.
+//!
+//! A repository is a set of modules, each made of a requirements document with SRS
+//! tags, a source file implementing them (Codes_SRS_ comments), a header and a unit
+//! test file (Tests_SRS_ comments, AAA comments, include-based ENABLE_MOCKS). Modules
+//! are grouped in directories of MODULES_PER_GROUP. The tree also holds pipeline YAML
+//! files referencing c_build_tools, a .gitmodules file, and optional submodules
+//! under deps/ that nest their own deps/.
+//!
+//! Content is drawn from one random stream and violations from another, so a given
+//! seed yields the same clean tree whatever the violation rates are.
+
+use std::fs;
+use std::io;
+use std::path::Path;
+
+/// Files generated per module: requirements, source, header, unit test
+pub const FILES_PER_MODULE: usize = 4;
+const MODULES_PER_GROUP: usize = 50;
+
+/// Commit of the c-build-tools submodule that the pipeline files reference
+pub const SUBMODULE_SHA: &str = "0123456789abcdef0123456789abcdef01234567";
+const WRONG_SHA: &str = "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef";
+
+/// xorshift64: deterministic and dependency free
+pub struct Rng(u64);
+
+impl Rng {
+    pub fn new(seed: u64) -> Self {
+        // xorshift never leaves 0
+        Self(seed ^ 0x9e37_79b9_7f4a_7c15 | 1)
+    }
+
+    pub fn next(&mut self) -> u64 {
+        self.0 ^= self.0 << 13;
+        self.0 ^= self.0 >> 7;
+        self.0 ^= self.0 << 17;
+        self.0
+    }
+
+    /// Uniform in [low, high]
+    pub fn range(&mut self, low: usize, high: usize) -> usize {
+        low + (self.next() % (high - low + 1) as u64) as usize
+    }
+
+    pub fn pick<'a>(&mut self, items: &[&'a str]) -> &'a str {
+        items[(self.next() % items.len() as u64) as usize]
+    }
+
+    /// True with probability `rate`
+    pub fn chance(&mut self, rate: f64) -> bool {
+        let unit = (self.next() >> 11) as f64 / (1u64 << 53) as f64;
+        rate > 0.0 && unit < rate
+    }
+}
+
+/// Violations that can be injected, one per check
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub enum Violation {
+    Tabs,
+    LfEnding,
+    RequirementsNaming,
+    DuplicateTag,
+    EnableMocks,
+    VldInclude,
+    SrsBackticks,
+    MissingSpecTag,
+    MissingAaa,
+    SrsMismatch,
+    SrsFormat,
+    CbtRef,
+}
+
+impl Violation {
+    pub const ALL: [Violation; 12] = [
+        Violation::Tabs,
+        Violation::LfEnding,
+        Violation::RequirementsNaming,
+        Violation::DuplicateTag,
+        Violation::EnableMocks,
+        Violation::VldInclude,
+        Violation::SrsBackticks,
+        Violation::MissingSpecTag,
+        Violation::MissingAaa,
+        Violation::SrsMismatch,
+        Violation::SrsFormat,
+        Violation::CbtRef,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Violation::Tabs => "tabs",
+            Violation::LfEnding => "lf_ending",
+            Violation::RequirementsNaming => "requirements_naming",
+            Violation::DuplicateTag => "duplicate_tag",
+            Violation::EnableMocks => "enable_mocks",
+            Violation::VldInclude => "vld_include",
+            Violation::SrsBackticks => "srs_backticks",
+            Violation::MissingSpecTag => "missing_spec_tag",
+            Violation::MissingAaa => "missing_aaa",
+            Violation::SrsMismatch => "srs_mismatch",
+            Violation::SrsFormat => "srs_format",
+            Violation::CbtRef => "cbt_ref",
+        }
+    }
+
+    /// The check that reports the violation
+    pub fn check(self) -> &'static str {
+        match self {
+            Violation::Tabs => "no_tabs",
+            Violation::LfEnding => "file_endings",
+            Violation::RequirementsNaming => "requirements_naming",
+            Violation::DuplicateTag => "srs_uniqueness",
+            Violation::EnableMocks => "enable_mocks",
+            Violation::VldInclude => "no_vld_include",
+            Violation::SrsBackticks => "no_backticks_in_srs",
+            Violation::MissingSpecTag => "test_spec_tags",
+            Violation::MissingAaa => "aaa_comments",
+            Violation::SrsMismatch => "srs_consistency",
+            Violation::SrsFormat => "srs_format",
+            Violation::CbtRef => "c_build_tools_ref",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Violation> {
+        Violation::ALL.iter().copied().find(|v| v.name() == name)
+    }
+
+    fn index(self) -> usize {
+        Violation::ALL.iter().position(|v| *v == self).unwrap()
+    }
+}
+
+pub struct Params {
+    pub seed: u64,
+    /// Files in the main tree, excluding pipelines and deps/ (rounded up to whole modules)
+    pub files: usize,
+    /// Requirements per module are drawn from this range
+    pub min_requirements: usize,
+    pub max_requirements: usize,
+    /// Submodules under deps/, each nesting `dep_depth - 1` levels of its own deps/
+    pub deps: usize,
+    pub dep_files: usize,
+    pub dep_depth: usize,
+    pub pipelines: usize,
+    /// Probability of each violation (by Violation::index) per module, or per
+    /// pipeline file for CbtRef
+    pub rates: [f64; Violation::ALL.len()],
+}
+
+impl Default for Params {
+    fn default() -> Self {
+        Self {
+            seed: 1,
+            files: 1000,
+            min_requirements: 4,
+            max_requirements: 16,
+            deps: 0,
+            dep_files: 40,
+            dep_depth: 1,
+            pipelines: 1,
+            rates: [0.0; Violation::ALL.len()],
+        }
+    }
+}
+
+impl Params {
+    pub fn set_rate(&mut self, violation: Violation, rate: f64) {
+        self.rates[violation.index()] = rate;
+    }
+
+    fn rate(&self, violation: Violation) -> f64 {
+        self.rates[violation.index()]
+    }
+}
+
+#[derive(Default)]
+pub struct Summary {
+    pub files: usize,
+    pub bytes: u64,
+    /// Violations injected into the main tree (by Violation::index); deps/ is
+    /// excluded from validation and always clean
+    pub injected: [usize; Violation::ALL.len()],
+}
+
+impl Summary {
+    pub fn injected(&self, violation: Violation) -> usize {
+        self.injected[violation.index()]
+    }
+}
+
+const SUBJECTS: &[&str] = &["the handle", "the buffer", "the context", "the callback", "the lock", "the queue"];
+const VERBS: &[&str] = &["allocate", "release", "validate", "initialize", "return", "log an error for"];
+const CONDITIONS: &[&str] = &["If malloc fails,", "On success,", "If the argument is NULL,", "Otherwise,", ""];
+
+/// Text of a requirement on `function`
+pub fn requirement_text(rng: &mut Rng, function: &str) -> String {
+    let condition = rng.pick(CONDITIONS);
+    let text = format!("{} shall {} {} and return.", function, rng.pick(VERBS), rng.pick(SUBJECTS));
+    if condition.is_empty() {
+        text
+    } else {
+        format!("{} {}", condition, text)
+    }
+}
+
+struct Generator<'a> {
+    params: &'a Params,
+    content: Rng,
+    violations: Rng,
+    summary: Summary,
+    /// Tag and text of the first requirement of the previous module (DuplicateTag)
+    previous_requirement: Option<(String, String)>,
+}
+
+impl Generator<'_> {
+    fn write(&mut self, root: &Path, relative_path: &str, content: &str) -> io::Result<()> {
+        let path = root.join(relative_path);
+        if let Some(parent) = path.parent() {
+            fs::create_dir_all(parent)?;
+        }
+        fs::write(path, content)?;
+        self.summary.files += 1;
+        self.summary.bytes += content.len() as u64;
+        Ok(())
+    }
+
+    /// Decide whether to inject `violation` here (never outside the main tree)
+    fn inject(&mut self, violation: Violation, main_tree: bool) -> bool {
+        let rate = self.params.rate(violation);
+        if !self.violations.chance(rate) || !main_tree {
+            return false;
+        }
+        self.summary.injected[violation.index()] += 1;
+        true
+    }
+
+    fn module(&mut self, root: &Path, module: usize, main_tree: bool) -> io::Result<()> {
+        let name = format!("mod{:05}", module);
+        let upper = name.to_uppercase();
+        let requirement_count = self.content.range(self.params.min_requirements, self.params.max_requirements);
+
+        let mut requirements = format!("# {} requirements\r\n\r\n## Exposed API\r\n\r\n", name);
+        let mut source = format!(
+            "// Copyright (c) Microsoft. All rights reserved.\r\n\r\n#include <stdlib.h>\r\n#include \"{}.h\"\r\n\r\n",
+            name
+        );
+        let mut header = format!(
+            "// Copyright (c) Microsoft. All rights reserved.\r\n\r\n#ifndef {0}_H\r\n#define {0}_H\r\n\r\n",
+            upper
+        );
+        let (enable_mocks, disable_mocks) = if self.inject(Violation::EnableMocks, main_tree) {
+            ("#define ENABLE_MOCKS", "#undef ENABLE_MOCKS")
+        } else {
+            (
+                "#include \"umock_c/umock_c_ENABLE_MOCKS.h\" // ============================== ENABLE_MOCKS",
+                "#include \"umock_c/umock_c_DISABLE_MOCKS.h\" // ============================== DISABLE_MOCKS",
+            )
+        };
+        let mut test = format!(
+            "// Copyright (c) Microsoft. All rights reserved.\r\n\r\n#include \"testrunnerswitcher.h\"\r\n\r\n{0}\r\n#include \"{1}.h\"\r\n{2}\r\n\r\nBEGIN_TEST_SUITE({1}_ut)\r\n\r\n",
+            enable_mocks, name, disable_mocks
+        );
+        if self.inject(Violation::VldInclude, main_tree) {
+            source.push_str("#include \"vld.h\"\r\n\r\n");
+        }
+
+        // Per-requirement violations land on one requirement of the module
+        let target = |generator: &mut Self, violation: Violation| {
+            if generator.inject(violation, main_tree) {
+                Some(generator.violations.range(1, requirement_count))
+            } else {
+                None
+            }
+        };
+        let tab_at = target(self, Violation::Tabs);
+        let backticks_at = target(self, Violation::SrsBackticks);
+        let untagged_at = target(self, Violation::MissingSpecTag);
+        let no_act_at = target(self, Violation::MissingAaa);
+        let mismatch_at = target(self, Violation::SrsMismatch);
+        let format_at = target(self, Violation::SrsFormat);
+
+        let mut first_requirement = None;
+        for requirement in 1..=requirement_count {
+            let function = format!("{}_function_{}", name, requirement);
+            let tag = format!("SRS_{}_01_{:03}", upper, requirement);
+            let text = requirement_text(&mut self.content, &function);
+            if requirement == 1 {
+                first_requirement = Some((tag.clone(), text.clone()));
+            }
+
+            let closing = if format_at == Some(requirement) { "]*/" } else { "**]**" };
+            requirements.push_str(&format!(
+                "```c\r\nint {}(int value);\r\n```\r\n\r\n**{}: [** {} {}\r\n\r\n",
+                function, tag, text, closing
+            ));
+            header.push_str(&format!("MOCKABLE_FUNCTION(, int, {}, int, value);\r\n", function));
+
+            let code_text = if mismatch_at == Some(requirement) {
+                text.replacen("shall", "should", 1)
+            } else if backticks_at == Some(requirement) {
+                text.replacen(&function, &format!("`{}`", function), 1)
+            } else {
+                text.clone()
+            };
+            let indent = if tab_at == Some(requirement) { "\t" } else { "    " };
+            source.push_str(&format!(
+                "int {0}(int value)\r\n{{\r\n    int result;\r\n{1}/*Codes_{2}: [ {3} ]*/\r\n    if (value < 0)\r\n    {{\r\n        result = -1;\r\n    }}\r\n    else\r\n    {{\r\n        result = value * {4};\r\n    }}\r\n    return result;\r\n}}\r\n\r\n",
+                function, indent, tag, code_text, requirement
+            ));
+
+            if untagged_at != Some(requirement) {
+                test.push_str(&format!("/*Tests_{}: [ {} ]*/\r\n", tag, text));
+            }
+            let act = if no_act_at == Some(requirement) { "" } else { "    // act\r\n" };
+            test.push_str(&format!(
+                "TEST_FUNCTION({0}_succeeds)\r\n{{\r\n    // arrange\r\n    int value = {1};\r\n\r\n{2}    int result = {0}(value);\r\n\r\n    // assert\r\n    ASSERT_ARE_EQUAL(int, {3}, result);\r\n}}\r\n\r\n",
+                function,
+                requirement,
+                act,
+                requirement * requirement
+            ));
+        }
+
+        // A tag already defined by the previous module, with the same text
+        if self.previous_requirement.is_some() && self.inject(Violation::DuplicateTag, main_tree) {
+            let (tag, text) = self.previous_requirement.as_ref().unwrap();
+            requirements.push_str(&format!("**{}: [** {} **]**\r\n\r\n", tag, text));
+        }
+        self.previous_requirement = first_requirement;
+
+        header.push_str(&format!("\r\n#endif // {}_H\r\n", upper));
+        if self.inject(Violation::LfEnding, main_tree) {
+            header.truncate(header.len() - 2);
+            header.push('\n');
+        }
+        test.push_str(&format!("END_TEST_SUITE({}_ut)\r\n", name));
+
+        let requirements_name = if self.inject(Violation::RequirementsNaming, main_tree) {
+            format!("devdoc/{}.md", name)
+        } else {
+            format!("devdoc/{}_requirements.md", name)
+        };
+        let group = format!("group_{:03}/{}", module / MODULES_PER_GROUP, name);
+        self.write(root, &format!("{}/{}", group, requirements_name), &requirements)?;
+        self.write(root, &format!("{}/src/{}.c", group, name), &source)?;
+        self.write(root, &format!("{}/inc/{}.h", group, name), &header)?;
+        self.write(root, &format!("{0}/tests/{1}_ut/{1}_ut.c", group, name), &test)
+    }
+
+    /// Modules for `files` files starting at module number `first`
+    fn modules(&mut self, root: &Path, first: usize, files: usize, main_tree: bool) -> io::Result<usize> {
+        let count = files.div_ceil(FILES_PER_MODULE);
+        for module in first..first + count {
+            self.module(root, module, main_tree)?;
+        }
+        Ok(first + count)
+    }
+
+    /// A submodule with its own deps/ down to `depth` levels
+    fn dependency(&mut self, root: &Path, name: &str, depth: usize, first: usize) -> io::Result<usize> {
+        let mut next = self.modules(root, first, self.params.dep_files, false)?;
+        self.write(root, ".git", &format!("gitdir: ../.git/modules/{}\n", name))?;
+        if depth > 1 {
+            let nested = format!("{}_nested", name);
+            next = self.dependency(&root.join("deps").join(&nested), &nested, depth - 1, next)?;
+        }
+        Ok(next)
+    }
+
+    fn pipelines(&mut self, root: &Path) -> io::Result<()> {
+        for pipeline in 0..self.params.pipelines {
+            let sha = if self.inject(Violation::CbtRef, true) { WRONG_SHA } else { SUBMODULE_SHA };
+            let content = format!(
+                "name: $(BuildID)_$(BuildDefinitionName)_{0}\n\nresources:\n  repositories:\n  - repository: self\n    clean: true\n  - repository: c_build_tools\n    type: github\n    name: azure/c-build-tools\n    endpoint: github.com_azure\n    ref: {1}\n\njobs:\n- template: /pipeline_templates/build_all_flavors.yml@c_build_tools\n",
+                pipeline, sha
+            );
+            self.write(root, &format!("build/pipeline_{:03}.yml", pipeline), &content)?;
+        }
+        Ok(())
+    }
+}
+
+/// Write a repository described by `params` under `root`
+pub fn generate(root: &Path, params: &Params) -> io::Result<Summary> {
+    let mut generator = Generator {
+        params,
+        content: Rng::new(params.seed),
+        violations: Rng::new(params.seed.wrapping_add(0x51ed_270b)),
+        summary: Summary::default(),
+        previous_requirement: None,
+    };
+
+    let mut next = generator.modules(root, 0, params.files, true)?;
+    generator.pipelines(root)?;
+
+    let mut gitmodules = String::from(
+        "[submodule \"deps/c-build-tools\"]\n\tpath = deps/c-build-tools\n\turl = https://github.com/Azure/c-build-tools.git\n",
+    );
+    for dep in 0..params.deps {
+        let name = format!("dep{:03}", dep);
+        gitmodules.push_str(&format!(
+            "[submodule \"deps/{0}\"]\n\tpath = deps/{0}\n\turl = https://example.com/{0}.git\n",
+            name
+        ));
+        next = generator.dependency(&root.join("deps").join(&name), &name, params.dep_depth.max(1), next)?;
+    }
+    generator.write(root, ".gitmodules", &gitmodules)?;
+
+    Ok(generator.summary)
+}
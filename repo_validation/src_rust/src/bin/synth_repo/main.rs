@@ -0,0 +1,183 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! synth_repo: writes a deterministic synthetic repository for scale testing
+//! repo_validator_rs and the traceability tool (see generator.rs).
+
+mod generator;
+
+use generator::{Params, Violation, SUBMODULE_SHA};
+use std::fs;
+use std::path::Path;
+use std::process;
+
+fn print_usage(program_name: &str) {
+    println!("Usage: {} --out <dir> [options]\n", program_name);
+    println!("Options:");
+    println!("  --out <dir>                Directory to create (required)");
+    println!("  --force                    Replace <dir> if it already exists");
+    println!("  --seed <n>                 Seed of the generated content (default: 1)");
+    println!("  --files <n>                Source and requirement files in the main tree (default: 1000)");
+    println!("  --requirements <min>-<max> SRS requirements per module (default: 4-16)");
+    println!("  --deps <n>                 Submodules under deps/ (default: 0)");
+    println!("  --dep-files <n>            Files per submodule (default: 40)");
+    println!("  --dep-depth <n>            Nesting depth of deps/ inside each submodule (default: 1)");
+    println!("  --pipelines <n>            Pipeline .yml files referencing c_build_tools (default: 1)");
+    println!("  --violations <list>        Comma-separated <kind>=<rate> pairs; `all=<rate>` sets every kind.");
+    println!("                             The rate is the probability per module (per pipeline for cbt_ref).");
+    println!("  --help                     Show this help message");
+    println!("\nViolation kinds:");
+    for violation in Violation::ALL {
+        println!("  {:<25} reported by {}", violation.name(), violation.check());
+    }
+}
+
+fn parse_number(option: &str, value: &str) -> usize {
+    match value.trim().parse::<usize>() {
+        Ok(n) => n,
+        Err(_) => {
+            eprintln!("Error: {} expects a number, got '{}'", option, value);
+            process::exit(1);
+        }
+    }
+}
+
+fn parse_violations(params: &mut Params, list: &str) {
+    for pair in list.split(',').map(str::trim).filter(|p| !p.is_empty()) {
+        let (kind, rate) = match pair.split_once('=') {
+            Some((kind, rate)) => (kind.trim(), rate.trim()),
+            None => {
+                eprintln!("Error: --violations expects <kind>=<rate>, got '{}'", pair);
+                process::exit(1);
+            }
+        };
+        let rate = match rate.parse::<f64>() {
+            Ok(r) if (0.0..=1.0).contains(&r) => r,
+            _ => {
+                eprintln!("Error: violation rate must be between 0 and 1, got '{}'", rate);
+                process::exit(1);
+            }
+        };
+        if kind == "all" {
+            for violation in Violation::ALL {
+                params.set_rate(violation, rate);
+            }
+        } else {
+            match Violation::from_name(kind) {
+                Some(violation) => params.set_rate(violation, rate),
+                None => {
+                    eprintln!("Error: unknown violation kind '{}' (see --help)", kind);
+                    process::exit(1);
+                }
+            }
+        }
+    }
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let program_name = &args[0];
+
+    let mut params = Params::default();
+    let mut out: Option<String> = None;
+    let mut force = false;
+
+    let mut i = 1;
+    while i < args.len() {
+        let option = args[i].as_str();
+        let takes_value = !matches!(option, "--force" | "--help" | "-h");
+        let value = if takes_value {
+            i += 1;
+            match args.get(i) {
+                Some(v) => v.as_str(),
+                None => {
+                    eprintln!("Error: {} expects a value", option);
+                    process::exit(1);
+                }
+            }
+        } else {
+            ""
+        };
+        match option {
+            "--out" => out = Some(value.to_string()),
+            "--force" => force = true,
+            "--seed" => params.seed = parse_number(option, value) as u64,
+            "--files" => params.files = parse_number(option, value),
+            "--requirements" => {
+                let (low, high) = value.split_once('-').unwrap_or((value, value));
+                params.min_requirements = parse_number(option, low).max(1);
+                params.max_requirements = parse_number(option, high).max(params.min_requirements);
+            }
+            "--deps" => params.deps = parse_number(option, value),
+            "--dep-files" => params.dep_files = parse_number(option, value),
+            "--dep-depth" => params.dep_depth = parse_number(option, value),
+            "--pipelines" => params.pipelines = parse_number(option, value),
+            "--violations" => parse_violations(&mut params, value),
+            "--help" | "-h" => {
+                print_usage(program_name);
+                process::exit(0);
+            }
+            _ => {
+                eprintln!("Error: unknown option '{}'\n", option);
+                print_usage(program_name);
+                process::exit(1);
+            }
+        }
+        i += 1;
+    }
+
+    let out = match out {
+        Some(o) => o,
+        None => {
+            eprintln!("Error: --out is required\n");
+            print_usage(program_name);
+            process::exit(1);
+        }
+    };
+    let root = Path::new(&out);
+    if root.exists() {
+        let empty = fs::read_dir(root).map(|mut entries| entries.next().is_none()).unwrap_or(false);
+        if !empty && !force {
+            eprintln!("Error: {} already exists (use --force to replace it)", out);
+            process::exit(1);
+        }
+        if let Err(e) = fs::remove_dir_all(root) {
+            eprintln!("Error: could not remove {}: {}", out, e);
+            process::exit(1);
+        }
+    }
+
+    let summary = match generator::generate(root, &params) {
+        Ok(s) => s,
+        Err(e) => {
+            eprintln!("Error: could not write {}: {}", out, e);
+            process::exit(1);
+        }
+    };
+
+    println!(
+        "Generated {} file(s), {:.1} MB in {}",
+        summary.files,
+        summary.bytes as f64 / (1024.0 * 1024.0),
+        out
+    );
+    let injected: Vec<Violation> = Violation::ALL
+        .into_iter()
+        .filter(|&violation| summary.injected(violation) > 0)
+        .collect();
+    if !injected.is_empty() {
+        println!("Injected violations:");
+        for violation in injected {
+            println!(
+                "  {:<25} {:>8}  ({})",
+                violation.name(),
+                summary.injected(violation),
+                violation.check()
+            );
+        }
+    }
+    println!(
+        "Validate with: repo_validator_rs --repo-root {} --submodule-sha {}",
+        out, SUBMODULE_SHA
+    );
+}
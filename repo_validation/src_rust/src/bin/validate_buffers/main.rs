@@ -0,0 +1,118 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! validate_buffers: runs the library API (repo_validator_rs::Validator) on
+//! contents given under a path of the caller's choosing, the way a git hook
+//! passes staged blobs, and prints what validate_files returns one item per
+//! line. The validate_api tests drive it.
+
+use repo_validator_rs::{Severity, Validator};
+use std::fs;
+use std::process;
+
+fn print_usage(program_name: &str) {
+    println!("Usage: {} [options] <path>=<content file>...\n", program_name);
+    println!("Checks the content of each <content file> as if it were the file at <path>,");
+    println!("relative to the repository root. Nothing under the repository root is read");
+    println!("except what c_build_tools_ref needs.\n");
+    println!("Options:");
+    println!("  --check <name>             Run only this check (repeatable; default: every check)");
+    println!("  --repo-root <dir>          Repository the paths belong to (default: current directory)");
+    println!("  --submodule-sha <sha>      Commit c_build_tools_ref expects, as with repo_validator_rs");
+    println!("  --help                     Show this help message");
+    println!("\nOutput:");
+    println!("  finding <check> <path>[:<line>] <ERROR|WARN> <message>");
+    println!("  check <name> <violations>");
+    println!("  files_checked <n>");
+    println!("\nExits with 0 when every check passed, 1 when one failed, 2 on a usage error.");
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let program_name = &args[0];
+
+    let mut check_names: Vec<String> = Vec::new();
+    let mut repo_root: Option<String> = None;
+    let mut submodule_sha: Option<String> = None;
+    let mut files: Vec<(String, Vec<u8>)> = Vec::new();
+
+    let mut i = 1;
+    while i < args.len() {
+        let option = args[i].as_str();
+        match option {
+            "--check" | "--repo-root" | "--submodule-sha" => {
+                i += 1;
+                let value = match args.get(i) {
+                    Some(v) => v.clone(),
+                    None => {
+                        eprintln!("Error: {} expects a value", option);
+                        process::exit(2);
+                    }
+                };
+                match option {
+                    "--check" => check_names.push(value),
+                    "--repo-root" => repo_root = Some(value),
+                    _ => submodule_sha = Some(value),
+                }
+            }
+            "--help" | "-h" => {
+                print_usage(program_name);
+                process::exit(0);
+            }
+            _ => {
+                let (path, content_file) = match option.split_once('=') {
+                    Some(pair) => pair,
+                    None => {
+                        eprintln!("Error: expected <path>=<content file>, got '{}'", option);
+                        process::exit(2);
+                    }
+                };
+                match fs::read(content_file) {
+                    Ok(content) => files.push((path.to_string(), content)),
+                    Err(e) => {
+                        eprintln!("Error: could not read {}: {}", content_file, e);
+                        process::exit(2);
+                    }
+                }
+            }
+        }
+        i += 1;
+    }
+
+    let mut validator = Validator::new();
+    if !check_names.is_empty() {
+        validator = match validator.with_checks(&check_names) {
+            Ok(validator) => validator,
+            Err(e) => {
+                eprintln!("Error: {}", e);
+                process::exit(2);
+            }
+        };
+    }
+    if let Some(repo_root) = &repo_root {
+        validator = validator.repo_root(repo_root);
+    }
+    if let Some(sha) = &submodule_sha {
+        validator = validator.submodule_sha(sha);
+    }
+
+    let validation = validator.validate_files(files);
+    for finding in &validation.findings {
+        let location = match (&finding.path, finding.line) {
+            (Some(path), Some(line)) => format!("{}:{}", path, line),
+            (Some(path), None) => path.clone(),
+            (None, _) => "-".to_string(),
+        };
+        let severity = match finding.severity {
+            Severity::Error => "ERROR",
+            Severity::Warning => "WARN",
+        };
+        println!("finding {} {} {} {}", finding.check, location, severity, finding.message);
+    }
+    for check in &validation.checks {
+        println!("check {} {}", check.name, check.violations);
+    }
+    println!("files_checked {}", validation.files_checked);
+
+    process::exit(if validation.passed() { 0 } else { 1 });
+}
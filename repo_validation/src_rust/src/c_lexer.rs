@@ -0,0 +1,616 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Comment- and string-aware tokenizer for C and C# sources.
+//!
+//! A file is tokenized once, on first use (FileInfo::tokens), and the checks that
+//! need to tell code from comments and literals - test bodies, helper functions,
+//! the comment block above a test - read the tokens instead of rescanning the
+//! bytes. Tokens are byte ranges into the file content; nothing is copied.
+//!
+//! The lexer knows just enough to keep comments, literals and preprocessor lines
+//! apart from code. It does not expand macros or evaluate #if, and every other
+//! punctuation byte is a token of its own. String and character literals end at
+//! the end of their line at the latest (C# verbatim strings excepted), so a stray
+//! quote cannot swallow the rest of the file.
+
+use std::ops::Range;
+
+use crate::scan;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Language {
+    C,
+    CSharp,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TokenKind {
+    /// `//` up to the end of the line (not included)
+    LineComment,
+    /// `/* */`, or up to the end of the content when it is not closed
+    BlockComment,
+    /// String literal with its quotes (and the @/$ prefixes of C#)
+    String,
+    /// Character literal with its quotes
+    Char,
+    /// Preprocessor directive, from '#' to the end of its logical line. A comment
+    /// on the line is a token of its own; the directive resumes after it.
+    Preprocessor,
+    Identifier,
+    Number,
+    /// Any other single byte: braces, parentheses, operators
+    Punct,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Token {
+    pub kind: TokenKind,
+    pub start: usize,
+    pub end: usize,
+}
+
+impl Token {
+    pub fn is_comment(&self) -> bool {
+        self.kind == TokenKind::LineComment || self.kind == TokenKind::BlockComment
+    }
+
+    /// True for the punctuation token `byte`
+    pub fn is_punct(&self, content: &[u8], byte: u8) -> bool {
+        self.kind == TokenKind::Punct && content[self.start] == byte
+    }
+
+    pub fn text<'a>(&self, content: &'a [u8]) -> &'a [u8] {
+        &content[self.start..self.end]
+    }
+}
+
+/// Test macros of the C test frameworks
+pub const TEST_MACROS: &[&str] = &[
+    "TEST_FUNCTION",
+    "TEST_METHOD",
+    "CTEST_FUNCTION",
+    "PARAMETERIZED_TEST_FUNCTION",
+];
+
+/// Keywords that look like a function name when followed by parentheses
+const KEYWORDS: &[&[u8]] = &[
+    b"if", b"else", b"while", b"do", b"for", b"foreach", b"switch", b"case", b"default", b"return", b"sizeof",
+    b"typeof", b"nameof", b"catch", b"using", b"lock", b"fixed", b"when", b"checked", b"unchecked", b"new",
+    b"await", b"throw", b"yield", b"goto", b"in", b"is", b"as",
+];
+
+/// One test found by SourceTokens::new: a test macro in C, a method carrying a
+/// [TestMethod] or [DataTestMethod] attribute in C#
+pub struct TestFunction {
+    /// The macro ("TEST_FUNCTION", ...) or the attribute ("[TestMethod]", "[DataTestMethod]")
+    pub kind: &'static str,
+    /// Byte range of the name (the first macro argument, the method name); empty
+    /// when a C# signature has no name we recognize
+    pub name: Range<usize>,
+    /// Tokens of the declaration: the macro through its closing parenthesis, or the
+    /// attribute through the end of the method signature
+    pub declaration: Range<usize>,
+    /// Tokens of the body's braces; None for a declaration without a body
+    /// (an abstract or expression-bodied method, a macro not followed by '{')
+    pub body: Option<(usize, usize)>,
+    /// The comment tokens right before the declaration, with nothing but
+    /// whitespace between them
+    pub comments: Range<usize>,
+}
+
+impl TestFunction {
+    pub fn name_text<'a>(&self, content: &'a [u8]) -> &'a str {
+        if self.name.is_empty() {
+            return "<unknown>";
+        }
+        // Names are identifiers, which are ASCII
+        std::str::from_utf8(&content[self.name.clone()]).unwrap_or("<unknown>")
+    }
+}
+
+/// A function (C) or method (C#) definition: a name, its parameter list and a body
+pub struct FunctionDefinition {
+    pub name: Range<usize>,
+    /// Token of the body's '{'
+    pub body: usize,
+}
+
+const NO_PARTNER: usize = usize::MAX;
+
+pub struct SourceTokens {
+    tokens: Vec<Token>,
+    /// Index of the matching bracket of every ( ) [ ] { } token, NO_PARTNER otherwise
+    partners: Vec<usize>,
+    tests: Vec<TestFunction>,
+}
+
+impl SourceTokens {
+    pub fn new(content: &[u8], language: Language) -> Self {
+        let tokens = tokenize(content, language);
+        let partners = match_brackets(content, &tokens);
+        let mut source = Self {
+            tokens,
+            partners,
+            tests: Vec::new(),
+        };
+        source.tests = match language {
+            Language::C => source.find_test_macros(content),
+            Language::CSharp => source.find_test_methods(content),
+        };
+        source
+    }
+
+    pub fn tokens(&self) -> &[Token] {
+        &self.tokens
+    }
+
+    /// Matching bracket of the bracket token `index`, None if it has none
+    pub fn partner(&self, index: usize) -> Option<usize> {
+        Some(self.partners[index]).filter(|&partner| partner != NO_PARTNER)
+    }
+
+    /// The tests of the file, in file order
+    pub fn test_functions(&self) -> &[TestFunction] {
+        &self.tests
+    }
+
+    /// Index of the first token starting at or after byte `offset`
+    pub fn first_at(&self, offset: usize) -> usize {
+        self.tokens.partition_point(|token| token.start < offset)
+    }
+
+    /// The first token after `index` that is not a comment
+    pub fn next_code(&self, index: usize) -> Option<usize> {
+        (index + 1..self.tokens.len()).find(|&i| !self.tokens[i].is_comment())
+    }
+
+    /// The comment tokens among tokens `range`
+    pub fn comments(&self, range: Range<usize>) -> impl Iterator<Item = &Token> {
+        self.tokens[range].iter().filter(|token| token.is_comment())
+    }
+
+    /// Identifiers among tokens `range` that are followed by '(' (calls, mostly)
+    pub fn calls<'a>(&'a self, content: &'a [u8], range: Range<usize>) -> impl Iterator<Item = &'a [u8]> {
+        let end = range.end;
+        range.filter_map(move |i| {
+            let token = &self.tokens[i];
+            let is_call = token.kind == TokenKind::Identifier && i + 1 < end && self.tokens[i + 1].is_punct(content, b'(');
+            if is_call {
+                Some(token.text(content))
+            } else {
+                None
+            }
+        })
+    }
+
+    /// Function and method definitions: a name preceded by a type or modifier and
+    /// followed by a parameter list and a body. Anything between the parameter list
+    /// and the body must look like a C# constructor initializer or where clause.
+    pub fn function_definitions(&self, content: &[u8]) -> Vec<FunctionDefinition> {
+        let tokens = &self.tokens;
+        let mut definitions = Vec::new();
+        for i in 1..tokens.len() {
+            let name = &tokens[i - 1];
+            if !tokens[i].is_punct(content, b'(') || name.kind != TokenKind::Identifier {
+                continue;
+            }
+            if KEYWORDS.contains(&name.text(content)) || i < 2 || !self.precedes_name(content, i - 2) {
+                continue;
+            }
+            let close = match self.partner(i) {
+                Some(close) => close,
+                None => continue,
+            };
+            if let Some(body) = self.body_after_signature(content, close) {
+                definitions.push(FunctionDefinition {
+                    name: name.start..name.end,
+                    body,
+                });
+            }
+        }
+        definitions
+    }
+
+    /// True if token `index`, right before a name, can end a return type or a modifier list
+    fn precedes_name(&self, content: &[u8], index: usize) -> bool {
+        let token = &self.tokens[index];
+        match token.kind {
+            TokenKind::Identifier => !KEYWORDS.contains(&token.text(content)),
+            TokenKind::Punct => matches!(content[token.start], b'*' | b'>' | b']' | b')' | b'?' | b'&'),
+            _ => false,
+        }
+    }
+
+    /// The '{' ending the signature whose parameter list closes at token `close`
+    fn body_after_signature(&self, content: &[u8], close: usize) -> Option<usize> {
+        let mut i = self.next_code(close)?;
+        loop {
+            let token = &self.tokens[i];
+            if token.is_punct(content, b'{') {
+                return Some(i);
+            }
+            let allowed = token.kind == TokenKind::Identifier
+                || (token.kind == TokenKind::Punct && matches!(content[token.start], b':' | b'<' | b'>' | b',' | b'.' | b'?'));
+            if token.is_punct(content, b'(') {
+                i = self.partner(i)?;
+            } else if !allowed {
+                return None;
+            }
+            i = self.next_code(i)?;
+        }
+    }
+
+    /// The comment tokens right before token `index`
+    fn comments_before(&self, index: usize) -> Range<usize> {
+        let mut first = index;
+        while first > 0 && self.tokens[first - 1].is_comment() {
+            first -= 1;
+        }
+        first..index
+    }
+
+    /// True if token `index` is the first thing on its line
+    fn starts_line(&self, content: &[u8], index: usize) -> bool {
+        let start = self.tokens[index].start;
+        let line_start = scan::memrchr(b'\n', &content[..start]).map_or(0, |i| i + 1);
+        content[line_start..start].iter().all(|&b| b == b' ' || b == b'\t')
+    }
+
+    /// C: a test macro at the start of a line, `MACRO(name ...)`, and the body that follows it
+    fn find_test_macros(&self, content: &[u8]) -> Vec<TestFunction> {
+        let tokens = &self.tokens;
+        let mut tests = Vec::new();
+        for (i, token) in tokens.iter().enumerate() {
+            if token.kind != TokenKind::Identifier {
+                continue;
+            }
+            let kind = match TEST_MACROS.iter().find(|name| name.as_bytes() == token.text(content)) {
+                Some(kind) => *kind,
+                None => continue,
+            };
+            if !self.starts_line(content, i) {
+                continue;
+            }
+            let open = match self.next_code(i) {
+                Some(open) if tokens[open].is_punct(content, b'(') => open,
+                _ => continue,
+            };
+            let name = match self.next_code(open) {
+                Some(name) if tokens[name].kind == TokenKind::Identifier => &tokens[name],
+                _ => continue,
+            };
+            let close = match self.partner(open) {
+                Some(close) => close,
+                None => continue,
+            };
+            // The body is the next block, possibly after more macros
+            // (PARAMETERIZED_TEST_FUNCTION_BEGIN(name)); a ';' or '}' first means there is none
+            let body = (close + 1..tokens.len())
+                .find(|&t| tokens[t].is_punct(content, b'{') || tokens[t].is_punct(content, b';') || tokens[t].is_punct(content, b'}'))
+                .filter(|&brace| tokens[brace].is_punct(content, b'{'))
+                .and_then(|brace| self.partner(brace).map(|end| (brace, end)));
+            tests.push(TestFunction {
+                kind,
+                name: name.start..name.end,
+                declaration: i..close + 1,
+                body,
+                comments: self.comments_before(i),
+            });
+        }
+        tests
+    }
+
+    /// C#: `[TestMethod]` or `[DataTestMethod]` (optionally with the Attribute
+    /// suffix, arguments or further attributes in the same brackets) at the start
+    /// of a line, then any other attributes and comments, then the method
+    fn find_test_methods(&self, content: &[u8]) -> Vec<TestFunction> {
+        let tokens = &self.tokens;
+        let mut tests = Vec::new();
+        for (i, token) in tokens.iter().enumerate() {
+            if !token.is_punct(content, b'[') || i + 2 >= tokens.len() {
+                continue;
+            }
+            let kind = match csharp_test_attribute(tokens[i + 1].text(content)) {
+                Some(kind) if tokens[i + 1].kind == TokenKind::Identifier => kind,
+                _ => continue,
+            };
+            let after = &tokens[i + 2];
+            if !(after.is_punct(content, b']') || after.is_punct(content, b'(') || after.is_punct(content, b','))
+                || !self.starts_line(content, i)
+            {
+                continue;
+            }
+
+            // Skip this and the following attribute lists, and comments
+            let mut signature = i;
+            loop {
+                signature = match self.partner(signature).and_then(|end| self.next_code(end)) {
+                    Some(next) => next,
+                    None => break,
+                };
+                if !tokens[signature].is_punct(content, b'[') {
+                    break;
+                }
+            }
+            if signature == i || tokens[signature].is_punct(content, b'[') {
+                continue;
+            }
+
+            let (end, body) = self.method_body(content, signature);
+            let name = (signature..end)
+                .find(|&t| tokens[t].is_punct(content, b'('))
+                .filter(|&paren| paren > signature && tokens[paren - 1].kind == TokenKind::Identifier)
+                .map_or(0..0, |paren| tokens[paren - 1].start..tokens[paren - 1].end);
+            tests.push(TestFunction {
+                kind,
+                name,
+                declaration: i..end,
+                body,
+                comments: self.comments_before(i),
+            });
+        }
+        tests
+    }
+
+    /// End of the signature starting at token `signature` (exclusive: its '{', or
+    /// past the ';' of a body-less or expression-bodied method) and the body's braces
+    fn method_body(&self, content: &[u8], signature: usize) -> (usize, Option<(usize, usize)>) {
+        let tokens = &self.tokens;
+        let mut i = signature;
+        while i < tokens.len() {
+            let token = &tokens[i];
+            if token.is_punct(content, b'{') {
+                return (i, self.partner(i).map(|end| (i, end)));
+            }
+            if token.is_punct(content, b';') {
+                return (i + 1, None);
+            }
+            let arrow = token.is_punct(content, b'=')
+                && i + 1 < tokens.len()
+                && tokens[i + 1].is_punct(content, b'>')
+                && tokens[i + 1].start == token.end;
+            if arrow {
+                // Expression body: up to the ';' outside any brackets
+                let mut j = i + 2;
+                while j < tokens.len() && !tokens[j].is_punct(content, b';') {
+                    j = match self.partner(j) {
+                        Some(end) if end > j => end + 1,
+                        _ => j + 1,
+                    };
+                }
+                return ((j + 1).min(tokens.len()), None);
+            }
+            i += 1;
+        }
+        (tokens.len(), None)
+    }
+}
+
+fn csharp_test_attribute(name: &[u8]) -> Option<&'static str> {
+    let name = match name.len().checked_sub(b"Attribute".len()) {
+        Some(stem) if name[stem..].eq_ignore_ascii_case(b"Attribute") => &name[..stem],
+        _ => name,
+    };
+    if name.eq_ignore_ascii_case(b"TestMethod") {
+        Some("[TestMethod]")
+    } else if name.eq_ignore_ascii_case(b"DataTestMethod") {
+        Some("[DataTestMethod]")
+    } else {
+        None
+    }
+}
+
+fn is_ident_start(b: u8) -> bool {
+    b.is_ascii_alphabetic() || b == b'_'
+}
+
+fn is_ident_char(b: u8) -> bool {
+    b.is_ascii_alphanumeric() || b == b'_'
+}
+
+/// Offset of the '\n' ending the line that contains `pos` (the content length if none)
+fn line_end_from(content: &[u8], pos: usize) -> usize {
+    scan::memchr(b'\n', &content[pos..]).map_or(content.len(), |i| pos + i)
+}
+
+/// End of the quoted literal whose opening quote is at `start`: past the closing
+/// quote, or at the end of the line if it is not closed there
+fn quoted_end(content: &[u8], start: usize, quote: u8) -> usize {
+    let len = content.len();
+    let mut pos = start + 1;
+    while pos < len {
+        match scan::memchr3(quote, b'\\', b'\n', &content[pos..]) {
+            Some(i) => pos += i,
+            None => return len,
+        }
+        match content[pos] {
+            b'\\' => pos += 2,
+            b'\n' => return pos,
+            _ => return pos + 1,
+        }
+    }
+    len
+}
+
+/// End of a C# verbatim string whose opening quote is at `start`: "" is an escaped quote
+fn verbatim_end(content: &[u8], start: usize) -> usize {
+    let len = content.len();
+    let mut pos = start + 1;
+    loop {
+        match scan::memchr(b'"', &content[pos..]) {
+            Some(i) => pos += i + 1,
+            None => return len,
+        }
+        if pos < len && content[pos] == b'"' {
+            pos += 1;
+        } else {
+            return pos;
+        }
+    }
+}
+
+/// Length of a line splice (backslash, optional '\r', newline) at `pos`, 0 if none
+fn splice_len(content: &[u8], pos: usize) -> usize {
+    match content.get(pos..(pos + 3).min(content.len())) {
+        Some([b'\\', b'\n', ..]) => 2,
+        Some([b'\\', b'\r', b'\n']) => 3,
+        _ => 0,
+    }
+}
+
+/// End of the preprocessor directive text starting at `start`: the end of its
+/// logical line, or the start of a comment on it
+fn directive_end(content: &[u8], start: usize) -> usize {
+    let len = content.len();
+    let mut pos = start;
+    while pos < len {
+        match content[pos] {
+            b'\n' => break,
+            b'\\' if splice_len(content, pos) > 0 => pos += splice_len(content, pos),
+            b'/' if pos + 1 < len && (content[pos + 1] == b'/' || content[pos + 1] == b'*') => break,
+            b'"' | b'\'' => pos = quoted_end(content, pos, content[pos]),
+            _ => pos += 1,
+        }
+    }
+    // Trailing blanks and '\r' are not part of the directive
+    while pos > start && matches!(content[pos - 1], b' ' | b'\t' | b'\r') {
+        pos -= 1;
+    }
+    pos
+}
+
+fn tokenize(content: &[u8], language: Language) -> Vec<Token> {
+    let len = content.len();
+    let mut tokens = Vec::with_capacity(len / 4);
+    let mut pos = 0usize;
+    // Only blanks since the last newline
+    let mut at_line_start = true;
+    // Inside a preprocessor directive's logical line
+    let mut in_directive = false;
+
+    while pos < len {
+        let b = content[pos];
+        let start = pos;
+        let kind = match b {
+            b'\n' => {
+                pos += 1;
+                at_line_start = true;
+                in_directive = false;
+                continue;
+            }
+            b' ' | b'\t' | b'\r' | b'\x0b' | b'\x0c' => {
+                pos += 1;
+                continue;
+            }
+            b'\\' if splice_len(content, pos) > 0 => {
+                pos += splice_len(content, pos);
+                continue;
+            }
+            b'/' if pos + 1 < len && content[pos + 1] == b'/' => {
+                pos = line_end_from(content, pos);
+                if pos > start && content[pos - 1] == b'\r' {
+                    pos -= 1;
+                }
+                TokenKind::LineComment
+            }
+            b'/' if pos + 1 < len && content[pos + 1] == b'*' => {
+                pos = match scan::find_pair(b'*', b'/', &content[pos + 2..]) {
+                    Some(i) => pos + 2 + i + 2,
+                    None => len,
+                };
+                TokenKind::BlockComment
+            }
+            _ if in_directive || (b == b'#' && at_line_start) => {
+                in_directive = true;
+                pos = directive_end(content, pos);
+                if pos == start {
+                    // Only blanks before a comment or the end of the line
+                    pos += 1;
+                    continue;
+                }
+                TokenKind::Preprocessor
+            }
+            b'"' => {
+                pos = quoted_end(content, pos, b'"');
+                TokenKind::String
+            }
+            b'\'' => {
+                pos = quoted_end(content, pos, b'\'');
+                TokenKind::Char
+            }
+            b'@' | b'$' if language == Language::CSharp && csharp_string_prefix(content, pos) > 0 => {
+                let quote = pos + csharp_string_prefix(content, pos);
+                pos = if content[pos..quote].contains(&b'@') {
+                    verbatim_end(content, quote)
+                } else {
+                    quoted_end(content, quote, b'"')
+                };
+                TokenKind::String
+            }
+            _ if is_ident_start(b) => {
+                pos += 1;
+                while pos < len && is_ident_char(content[pos]) {
+                    pos += 1;
+                }
+                TokenKind::Identifier
+            }
+            _ if b.is_ascii_digit() => {
+                pos += 1;
+                while pos < len && (is_ident_char(content[pos]) || content[pos] == b'.') {
+                    pos += 1;
+                }
+                TokenKind::Number
+            }
+            _ => {
+                pos += 1;
+                TokenKind::Punct
+            }
+        };
+        at_line_start = false;
+        tokens.push(Token {
+            kind,
+            start,
+            end: pos,
+        });
+    }
+
+    tokens
+}
+
+/// Length of the @, $, @$ or $@ prefix of a C# string literal at `pos`, 0 if none
+fn csharp_string_prefix(content: &[u8], pos: usize) -> usize {
+    match content.get(pos..(pos + 3).min(content.len())) {
+        Some([b'@' | b'$', b'"', ..]) => 1,
+        Some([b'@', b'$', b'"']) | Some([b'$', b'@', b'"']) => 2,
+        _ => 0,
+    }
+}
+
+/// Pair every opening bracket with its closing bracket; each kind is matched on
+/// its own, so an unbalanced parenthesis does not unbalance the braces
+fn match_brackets(content: &[u8], tokens: &[Token]) -> Vec<usize> {
+    let mut partners = vec![NO_PARTNER; tokens.len()];
+    let mut open: [Vec<usize>; 3] = [Vec::new(), Vec::new(), Vec::new()];
+    for (i, token) in tokens.iter().enumerate() {
+        if token.kind != TokenKind::Punct {
+            continue;
+        }
+        let (kind, opening) = match content[token.start] {
+            b'(' => (0, true),
+            b')' => (0, false),
+            b'[' => (1, true),
+            b']' => (1, false),
+            b'{' => (2, true),
+            b'}' => (2, false),
+            _ => continue,
+        };
+        if opening {
+            open[kind].push(i);
+        } else if let Some(start) = open[kind].pop() {
+            partners[start] = i;
+            partners[i] = start;
+        }
+    }
+    partners
+}
@@ -0,0 +1,460 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Persistent per-file result cache (--cache <path>).
+//!
+//! For every file the cache stores its size, modification time and content hash,
+//! plus one record per check: the messages the check printed for the file, the
+//! findings among them (for callers that use findings as data, such as --watch)
+//! and the check's shard state after seeing only that file (see Check::save_shard).
+//! When a file is unchanged, the walker replays the records instead of running
+//! check_file, and cross-file checks rebuild their state from the saved shards.
+//!
+//! The cache file names every check and version once, in its header; records
+//! refer to them by number. Loading the file only indexes it: the records of a
+//! file stay the bytes read from disk, decoded when they are replayed, and an
+//! unchanged file hands them on to the next cache without a copy. A walk that
+//! found every file as the cache held it does not rewrite the file.
+//!
+//! A --workspace run shares one in-memory cache between its repositories (see
+//! ResultCache::absorb). It can hold several contents of the same relative path,
+//! and is only ever matched by content size and hash.
+
+use std::collections::HashMap;
+use std::fs;
+use std::io;
+use std::sync::Arc;
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::codec::{Decoder, Encoder};
+use crate::config::{Finding, Severity};
+
+const MAGIC: &[u8; 8] = b"RVCACHE\0";
+
+/// Bump when the layout of the cache file changes
+const CACHE_FORMAT_VERSION: u32 = 4;
+
+/// A file modified this close to the moment the cache was written may have been
+/// modified again within the same timestamp tick, so its size and mtime alone
+/// cannot prove it is unchanged. Such files are verified by content hash.
+const RACY_WINDOW_NS: u64 = 2_000_000_000;
+
+/// A range of a buffer shared between entries: the cache file as loaded, or the
+/// records encoded for one file by a walk. Cloning it copies no bytes.
+#[derive(Clone)]
+struct SharedBytes {
+    buffer: Arc<Vec<u8>>,
+    start: usize,
+    end: usize,
+}
+
+impl SharedBytes {
+    fn new(buffer: Vec<u8>) -> Self {
+        let end = buffer.len();
+        Self {
+            buffer: Arc::new(buffer),
+            start: 0,
+            end,
+        }
+    }
+
+    fn as_slice(&self) -> &[u8] {
+        &self.buffer[self.start..self.end]
+    }
+}
+
+/// The results of one check for one file, borrowed from its CachedFile. Each is
+/// encoded as the check's number, its messages, its findings and its shard.
+#[derive(Clone, Copy)]
+pub struct CheckRecord<'a> {
+    /// Number of the check in the cache's table (see ResultCache::check_id)
+    pub check: u32,
+    message_count: u32,
+    messages: &'a [u8],
+    findings: &'a [u8],
+    /// Shard state saved by Check::save_shard
+    pub shard: &'a [u8],
+    /// The whole record as encoded
+    raw: &'a [u8],
+}
+
+impl CheckRecord<'_> {
+    /// The messages the check printed for the file (None if they are malformed)
+    pub fn messages(&self) -> Option<Vec<String>> {
+        let mut input = Decoder::new(self.messages);
+        (0..self.message_count).map(|_| input.string()).collect()
+    }
+
+    /// The findings among the messages (None if they are malformed)
+    pub fn findings(&self) -> Option<Vec<Finding>> {
+        if self.findings.is_empty() {
+            return Some(Vec::new());
+        }
+        let mut input = Decoder::new(self.findings);
+        let count = input.u32()?;
+        (0..count).map(|_| decode_finding(&mut input)).collect()
+    }
+}
+
+fn encode_finding(out: &mut Encoder, finding: &Finding) {
+    out.bool(finding.severity == Severity::Error);
+    out.bool(finding.path.is_some());
+    out.str(finding.path.as_deref().unwrap_or(""));
+    out.bool(finding.line.is_some());
+    out.usize(finding.line.unwrap_or(0));
+    out.str(&finding.message);
+    out.u32(finding.details.len() as u32);
+    for detail in &finding.details {
+        out.str(detail);
+    }
+}
+
+fn decode_finding(input: &mut Decoder) -> Option<Finding> {
+    let severity = if input.bool()? { Severity::Error } else { Severity::Warning };
+    let has_path = input.bool()?;
+    let path = input.string()?;
+    let has_line = input.bool()?;
+    let line = input.usize()?;
+    let message = input.string()?;
+    let detail_count = input.u32()?;
+    let details = (0..detail_count).map(|_| input.string()).collect::<Option<Vec<String>>>()?;
+    Some(Finding {
+        severity,
+        path: has_path.then_some(path),
+        line: has_line.then_some(line),
+        message,
+        details,
+    })
+}
+
+/// Iterator over the records of a CachedFile, ending early at malformed bytes
+pub struct CheckRecords<'a> {
+    input: Decoder<'a>,
+    data: &'a [u8],
+}
+
+impl<'a> Iterator for CheckRecords<'a> {
+    type Item = CheckRecord<'a>;
+
+    fn next(&mut self) -> Option<CheckRecord<'a>> {
+        if self.input.is_at_end() {
+            return None;
+        }
+        let start = self.input.position();
+        let check = self.input.u32()?;
+        let message_count = self.input.u32()?;
+        let messages_start = self.input.position();
+        for _ in 0..message_count {
+            self.input.bytes()?;
+        }
+        let messages = &self.data[messages_start..self.input.position()];
+        let findings = self.input.bytes()?;
+        let shard = self.input.bytes()?;
+        Some(CheckRecord {
+            check,
+            message_count,
+            messages,
+            findings,
+            shard,
+            raw: &self.data[start..self.input.position()],
+        })
+    }
+}
+
+pub struct CachedFile {
+    pub size: u64,
+    pub mtime_ns: u64,
+    pub hash: u64,
+    records: SharedBytes,
+}
+
+impl CachedFile {
+    /// True when the entry was made for content of this size and hash
+    pub fn same_content(&self, size: u64, hash: u64) -> bool {
+        self.size == size && self.hash == hash
+    }
+
+    pub fn records(&self) -> CheckRecords<'_> {
+        let data = self.records.as_slice();
+        CheckRecords {
+            input: Decoder::new(data),
+            data,
+        }
+    }
+
+    pub fn record(&self, check: u32) -> Option<CheckRecord<'_>> {
+        self.records().find(|record| record.check == check)
+    }
+
+    /// The same results, for the same content found with modification time `mtime_ns`
+    pub fn restamped(&self, mtime_ns: u64) -> Self {
+        Self {
+            mtime_ns,
+            records: self.records.clone(),
+            ..*self
+        }
+    }
+}
+
+/// Encodes the records of a new CachedFile
+pub struct RecordsBuilder {
+    out: Encoder,
+}
+
+impl RecordsBuilder {
+    pub fn new() -> Self {
+        Self { out: Encoder::new() }
+    }
+
+    pub fn add(&mut self, check: u32, messages: &[String], findings: &[Finding], shard: &[u8]) {
+        self.out.u32(check);
+        self.out.u32(messages.len() as u32);
+        for message in messages {
+            self.out.str(message);
+        }
+        // Most records have no findings: those store an empty block
+        let mut encoded = Encoder::new();
+        if !findings.is_empty() {
+            encoded.u32(findings.len() as u32);
+            for finding in findings {
+                encode_finding(&mut encoded, finding);
+            }
+        }
+        self.out.bytes(&encoded.into_bytes());
+        self.out.bytes(shard);
+    }
+
+    /// Add a record of another entry as it is
+    pub fn add_record(&mut self, record: &CheckRecord) {
+        self.out.raw(record.raw);
+    }
+
+    pub fn finish(self, size: u64, mtime_ns: u64, hash: u64) -> CachedFile {
+        CachedFile {
+            size,
+            mtime_ns,
+            hash,
+            records: SharedBytes::new(self.out.into_bytes()),
+        }
+    }
+}
+
+pub struct ResultCache {
+    /// Name and version of the check behind each record number
+    checks: Vec<(String, u32)>,
+    files: HashMap<String, CachedFile>,
+    /// Other contents seen at the same relative paths (workspace caches only)
+    variants: HashMap<String, Vec<CachedFile>>,
+    written_at_ns: u64,
+}
+
+/// Size and modification time (nanoseconds since the epoch) of a file
+pub fn file_stamp(meta: &fs::Metadata) -> (u64, u64) {
+    let mtime_ns = meta
+        .modified()
+        .ok()
+        .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+        .map(|d| d.as_nanos() as u64)
+        .unwrap_or(0);
+    (meta.len(), mtime_ns)
+}
+
+fn now_ns() -> u64 {
+    SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .map(|d| d.as_nanos() as u64)
+        .unwrap_or(0)
+}
+
+impl ResultCache {
+    /// An empty cache. Nothing in it is ever trusted by size and mtime alone.
+    pub fn empty() -> Self {
+        Self {
+            checks: Vec::new(),
+            files: HashMap::new(),
+            variants: HashMap::new(),
+            written_at_ns: 0,
+        }
+    }
+
+    /// Load a cache written for the given repository root.
+    /// A missing, corrupt, outdated or foreign cache file yields an empty cache.
+    pub fn load(path: &str, repo_root: &str) -> Self {
+        match fs::read(path) {
+            Ok(data) => Self::decode(Arc::new(data), repo_root).unwrap_or_else(Self::empty),
+            Err(_) => Self::empty(),
+        }
+    }
+
+    /// Index the entries of a cache file; their records are left encoded in `data`
+    fn decode(data: Arc<Vec<u8>>, repo_root: &str) -> Option<Self> {
+        let mut input = Decoder::new(&data);
+        if input.bytes()? != MAGIC {
+            return None;
+        }
+        if input.u32()? != CACHE_FORMAT_VERSION {
+            return None;
+        }
+        if input.bytes()? != repo_root.as_bytes() {
+            return None;
+        }
+        let written_at_ns = input.u64()?;
+
+        let check_count = input.u32()? as usize;
+        let mut checks = Vec::with_capacity(check_count);
+        for _ in 0..check_count {
+            checks.push((input.string()?, input.u32()?));
+        }
+
+        let file_count = input.u32()? as usize;
+        let mut files = HashMap::with_capacity(file_count);
+        for _ in 0..file_count {
+            let relative_path = input.string()?;
+            let size = input.u64()?;
+            let mtime_ns = input.u64()?;
+            let hash = input.u64()?;
+            let records_len = input.bytes()?.len();
+            let end = input.position();
+            let records = SharedBytes {
+                buffer: Arc::clone(&data),
+                start: end - records_len,
+                end,
+            };
+            files.insert(
+                relative_path,
+                CachedFile {
+                    size,
+                    mtime_ns,
+                    hash,
+                    records,
+                },
+            );
+        }
+
+        if !input.is_at_end() {
+            return None;
+        }
+        Some(Self {
+            checks,
+            files,
+            variants: HashMap::new(),
+            written_at_ns,
+        })
+    }
+
+    /// Number under which records of the check `name` at `version` are stored,
+    /// added to the table if it is new. Every check of a walk gets its number
+    /// before the walk starts.
+    pub fn check_id(&mut self, name: &str, version: u32) -> u32 {
+        match self.checks.iter().position(|(n, v)| n == name && *v == version) {
+            Some(id) => id as u32,
+            None => {
+                self.checks.push((name.to_string(), version));
+                (self.checks.len() - 1) as u32
+            }
+        }
+    }
+
+    /// Name of the check behind a record number (None for a number the table does not have)
+    pub fn check_name(&self, id: u32) -> Option<&str> {
+        self.checks.get(id as usize).map(|(name, _)| name.as_str())
+    }
+
+    pub fn len(&self) -> usize {
+        self.files.len()
+    }
+
+    pub fn get(&self, relative_path: &str) -> Option<&CachedFile> {
+        self.files.get(relative_path)
+    }
+
+    /// The entry for a path whose content has the given size and hash
+    pub fn find(&self, relative_path: &str, size: u64, hash: u64) -> Option<&CachedFile> {
+        match self.files.get(relative_path) {
+            Some(entry) if entry.same_content(size, hash) => Some(entry),
+            Some(_) => self.variants.get(relative_path)?.iter().find(|entry| entry.same_content(size, hash)),
+            None => None,
+        }
+    }
+
+    /// True when size and mtime match and the entry is old enough that
+    /// the timestamps can be trusted without hashing the content. An mtime of 0
+    /// is unknown (staged content, or an entry whose stamp was cleared).
+    pub fn stat_matches(&self, entry: &CachedFile, size: u64, mtime_ns: u64) -> bool {
+        entry.size == size
+            && entry.mtime_ns == mtime_ns
+            && mtime_ns != 0
+            && mtime_ns.saturating_add(RACY_WINDOW_NS) <= self.written_at_ns
+    }
+
+    /// Replace the entries with the results of a walk, as of now. An incremental
+    /// walk skips most unchanged files: with `keep_unvisited`, the entries of the
+    /// paths it did not visit are kept. A kept entry that was too recent to be
+    /// trusted by its stamp under the old write time loses its mtime, so that the
+    /// new write time does not make it trusted: its file may have changed within
+    /// the same timestamp tick since.
+    pub fn update(&mut self, entries: Vec<(String, CachedFile)>, keep_unvisited: bool) {
+        if keep_unvisited {
+            for entry in self.files.values_mut() {
+                if entry.mtime_ns.saturating_add(RACY_WINDOW_NS) > self.written_at_ns {
+                    entry.mtime_ns = 0;
+                }
+            }
+        } else {
+            self.files.clear();
+        }
+        self.files.extend(entries);
+        self.written_at_ns = now_ns();
+    }
+
+    /// Add the results of a walk over another repository. An entry for a path
+    /// that already holds different content is kept as a variant, so repositories
+    /// pinning different commits of the same submodule all find theirs. The
+    /// timestamps of another repository prove nothing, so `self` keeps its
+    /// write time: a cache made with empty() is matched by content hash only.
+    pub fn absorb(&mut self, entries: Vec<(String, CachedFile)>) {
+        for (relative_path, entry) in entries {
+            let (size, hash) = (entry.size, entry.hash);
+            match self.files.insert(relative_path.clone(), entry) {
+                Some(previous) if !previous.same_content(size, hash) => {
+                    let variants = self.variants.entry(relative_path).or_default();
+                    variants.retain(|variant| !variant.same_content(size, hash));
+                    variants.push(previous);
+                }
+                _ => {}
+            }
+        }
+    }
+
+    /// Write the cache to `path` (atomically: the file is written next to the
+    /// destination and renamed over it). Entries are stored in path order;
+    /// variants are not saved.
+    pub fn save(&self, path: &str, repo_root: &str) -> io::Result<()> {
+        let mut paths: Vec<&String> = self.files.keys().collect();
+        paths.sort();
+
+        let mut out = Encoder::new();
+        out.bytes(MAGIC);
+        out.u32(CACHE_FORMAT_VERSION);
+        out.str(repo_root);
+        out.u64(self.written_at_ns);
+        out.u32(self.checks.len() as u32);
+        for (name, version) in &self.checks {
+            out.str(name);
+            out.u32(*version);
+        }
+        out.u32(paths.len() as u32);
+        for relative_path in paths {
+            let file = &self.files[relative_path];
+            out.str(relative_path);
+            out.u64(file.size);
+            out.u64(file.mtime_ns);
+            out.u64(file.hash);
+            out.bytes(file.records.as_slice());
+        }
+
+        let temp_path = format!("{}.tmp", path);
+        fs::write(&temp_path, out.into_bytes())?;
+        fs::rename(&temp_path, path)
+    }
+}
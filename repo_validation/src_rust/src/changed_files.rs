@@ -0,0 +1,237 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Changed-file selection for incremental runs (--changed-since, --paths-from,
+//! --staged). All paths are relative to the repository root and normalized with
+//! normalize_relative_path() so they compare equal to walker paths on any platform.
+
+use std::collections::{HashMap, HashSet};
+use std::fs;
+use std::io::{BufRead, BufReader, Write};
+use std::process::{Command, Stdio};
+use std::thread;
+
+/// Normalize a repository-relative path: forward slashes, no leading "./"
+pub fn normalize_relative_path(path: &str) -> String {
+    let path = path.replace('\\', "/");
+    let mut rest = path.as_str();
+    while let Some(stripped) = rest.strip_prefix("./") {
+        rest = stripped;
+    }
+    rest.to_string()
+}
+
+fn run_git(repo_root: &str, args: &[&str]) -> Result<Vec<u8>, String> {
+    let output = Command::new("git")
+        .arg("-C")
+        .arg(repo_root)
+        .args(args)
+        .output()
+        .map_err(|e| format!("Failed to run git: {}", e))?;
+
+    if !output.status.success() {
+        let stderr = String::from_utf8_lossy(&output.stderr);
+        return Err(format!("git {} failed: {}", args[0], stderr.trim()));
+    }
+    Ok(output.stdout)
+}
+
+fn add_nul_separated(paths: &mut HashSet<String>, output: &[u8]) {
+    for entry in output.split(|&b| b == 0) {
+        if !entry.is_empty() {
+            paths.insert(normalize_relative_path(&String::from_utf8_lossy(entry)));
+        }
+    }
+}
+
+/// Files changed since the merge base of `git_ref` and HEAD: committed, staged and
+/// unstaged changes, plus untracked files that are not ignored.
+pub fn changed_since(repo_root: &str, git_ref: &str) -> Result<HashSet<String>, String> {
+    let merge_base = run_git(repo_root, &["merge-base", git_ref, "HEAD"])?;
+    let merge_base = String::from_utf8_lossy(&merge_base).trim().to_string();
+
+    let mut paths = HashSet::new();
+    let diff = run_git(
+        repo_root,
+        &["diff", "--name-only", "-z", "--no-renames", "--relative", &merge_base],
+    )?;
+    add_nul_separated(&mut paths, &diff);
+
+    let untracked = run_git(repo_root, &["ls-files", "--others", "--exclude-standard", "-z"])?;
+    add_nul_separated(&mut paths, &untracked);
+
+    Ok(paths)
+}
+
+/// Read a list of paths, one per line. Paths are relative to the repository root;
+/// absolute paths inside the repository are accepted too. Blank lines are ignored.
+pub fn paths_from_file(repo_root: &str, list_path: &str) -> Result<HashSet<String>, String> {
+    let content = fs::read_to_string(list_path)
+        .map_err(|e| format!("Failed to read {}: {}", list_path, e))?;
+
+    let root = normalize_relative_path(repo_root);
+    let mut paths = HashSet::new();
+    for line in content.lines() {
+        let line = line.trim();
+        if line.is_empty() {
+            continue;
+        }
+        let path = normalize_relative_path(line);
+        let relative = match path.strip_prefix(&root) {
+            Some(rest) if rest.starts_with('/') => rest.trim_start_matches('/').to_string(),
+            _ => path,
+        };
+        paths.insert(relative);
+    }
+    Ok(paths)
+}
+
+/// The staged version of the files a commit would change (--staged)
+#[derive(Default)]
+pub struct StagedFiles {
+    /// Content in the index of each added or modified file
+    blobs: HashMap<String, Vec<u8>>,
+    /// Files whose deletion is staged
+    deleted: HashSet<String>,
+}
+
+impl StagedFiles {
+    /// The staged content of a file, None when the file is not staged
+    pub fn content(&self, relative_path: &str) -> Option<&[u8]> {
+        if self.blobs.is_empty() {
+            return None;
+        }
+        self.blobs.get(&normalize_relative_path(relative_path)).map(Vec::as_slice)
+    }
+
+    pub fn is_deleted(&self, relative_path: &str) -> bool {
+        !self.deleted.is_empty() && self.deleted.contains(&normalize_relative_path(relative_path))
+    }
+
+    /// True when the content of the file is staged (added or modified)
+    pub fn is_staged(&self, relative_path: &str) -> bool {
+        !self.blobs.is_empty() && self.blobs.contains_key(&normalize_relative_path(relative_path))
+    }
+
+    /// The added and modified paths, sorted: whether or not they are still in the
+    /// working tree, they are part of the commit
+    pub fn staged_paths(&self) -> Vec<&str> {
+        let mut paths: Vec<&str> = self.blobs.keys().map(String::as_str).collect();
+        paths.sort_unstable();
+        paths
+    }
+
+    /// Every staged path, deletions included
+    pub fn paths(&self) -> HashSet<String> {
+        self.blobs.keys().chain(&self.deleted).cloned().collect()
+    }
+}
+
+/// Read the files staged for the next commit. The staged paths come from git diff;
+/// their content is streamed from the index through one git cat-file --batch
+/// process. Gitlinks and symbolic links are left out, as the walker skips them.
+pub fn staged_files(repo_root: &str) -> Result<StagedFiles, String> {
+    // Outside a repository git diff would compare files instead
+    run_git(repo_root, &["rev-parse", "--git-dir"]).map_err(|_| format!("{} is not in a git repository", repo_root))?;
+
+    // Before the first commit everything in the index is staged
+    let base = match run_git(repo_root, &["rev-parse", "--verify", "-q", "HEAD"]) {
+        Ok(_) => "HEAD",
+        Err(_) => EMPTY_TREE,
+    };
+    let diff = run_git(
+        repo_root,
+        &["diff", "--cached", "--raw", "-z", "--no-abbrev", "--no-renames", "--relative", base],
+    )?;
+
+    // -z --raw: ":<old mode> <new mode> <old id> <new id> <status>\0<path>\0"
+    let mut staged = StagedFiles::default();
+    let mut wanted: Vec<(String, String)> = Vec::new();
+    let mut fields = diff.split(|&b| b == 0);
+    while let Some(header) = fields.next() {
+        if header.is_empty() {
+            continue;
+        }
+        let path = fields.next().ok_or("git diff --raw ended after a header")?;
+        let path = normalize_relative_path(&String::from_utf8_lossy(path));
+        let header = String::from_utf8_lossy(header);
+        let parts: Vec<&str> = header.trim_start_matches(':').split(' ').collect();
+        if parts.len() != 5 {
+            return Err(format!("unexpected git diff --raw line: {}", header));
+        }
+        let (new_mode, new_id, status) = (parts[1], parts[3], parts[4]);
+        if status.starts_with('D') {
+            staged.deleted.insert(path);
+        } else if new_mode.starts_with("100") {
+            wanted.push((path, new_id.to_string()));
+        }
+    }
+
+    let ids: Vec<&str> = wanted.iter().map(|(_, id)| id.as_str()).collect();
+    for ((path, _), content) in wanted.iter().zip(read_blobs(repo_root, &ids)?) {
+        staged.blobs.insert(path.clone(), content);
+    }
+    Ok(staged)
+}
+
+/// Id of the tree with no entries, which git knows without storing it
+const EMPTY_TREE: &str = "4b825dc642cb6eb9a060e54bf8d69288fbee4904";
+
+/// Contents of the given blobs, in order, from a single git cat-file --batch
+fn read_blobs(repo_root: &str, ids: &[&str]) -> Result<Vec<Vec<u8>>, String> {
+    if ids.is_empty() {
+        return Ok(Vec::new());
+    }
+    let mut child = Command::new("git")
+        .arg("-C")
+        .arg(repo_root)
+        .args(["cat-file", "--batch"])
+        .stdin(Stdio::piped())
+        .stdout(Stdio::piped())
+        .stderr(Stdio::null())
+        .spawn()
+        .map_err(|e| format!("Failed to run git: {}", e))?;
+
+    // Requests are written from another thread so that neither pipe can fill up
+    // while the other side waits
+    let mut stdin = child.stdin.take().expect("stdin is piped");
+    let requests: String = ids.iter().map(|id| format!("{}\n", id)).collect();
+    let writer = thread::spawn(move || stdin.write_all(requests.as_bytes()));
+
+    let mut stdout = BufReader::new(child.stdout.take().expect("stdout is piped"));
+    let mut blobs = Vec::with_capacity(ids.len());
+    let mut result = Ok(());
+    for id in ids {
+        match read_batch_entry(&mut stdout, id) {
+            Ok(content) => blobs.push(content),
+            Err(e) => {
+                result = Err(e);
+                break;
+            }
+        }
+    }
+    drop(stdout);
+    let _ = writer.join();
+    let _ = child.wait();
+    result.map(|()| blobs)
+}
+
+/// One "<id> <type> <size>\n<content>\n" answer of git cat-file --batch
+fn read_batch_entry(stdout: &mut impl BufRead, id: &str) -> Result<Vec<u8>, String> {
+    let mut header = String::new();
+    stdout
+        .read_line(&mut header)
+        .map_err(|e| format!("git cat-file: {}", e))?;
+    let parts: Vec<&str> = header.trim_end().split(' ').collect();
+    let size = match parts.as_slice() {
+        [_, "blob", size] => size.parse::<usize>().ok(),
+        _ => None,
+    };
+    let size = size.ok_or_else(|| format!("git cat-file could not read blob {}: {}", id, header.trim_end()))?;
+    let mut content = vec![0u8; size + 1];
+    stdout
+        .read_exact(&mut content)
+        .map_err(|e| format!("git cat-file: {}", e))?;
+    content.truncate(size);
+    Ok(content)
+}
@@ -1,9 +1,17 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::c_lexer::{SourceTokens, TestFunction, TokenKind};
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::scan;
+use crate::srs_index::SrsIndex;
 use std::collections::HashMap;
+use std::ops::Range;
 
 pub struct AaaComments {
     violations: i32,
@@ -21,48 +29,20 @@ impl AaaComments {
     }
 }
 
-struct LineIndex {
-    starts: Vec<usize>,
-}
-
-fn build_line_index(content: &[u8]) -> LineIndex {
-    let mut starts = Vec::new();
-    starts.push(0);
-    for i in 0..content.len() {
-        if content[i] == b'\n' && i < content.len() {
-            starts.push(i + 1);
-        }
-    }
-    LineIndex { starts }
-}
-
-fn line_number_at(index: &LineIndex, pos: usize) -> usize {
-    match index.starts.binary_search(&pos) {
-        Ok(i) => i + 1,
-        Err(i) => i,
-    }
-}
-
-/// Test macro types we recognize
-const MACROS: &[&str] = &[
-    "TEST_FUNCTION",
-    "TEST_METHOD",
-    "CTEST_FUNCTION",
-    "PARAMETERIZED_TEST_FUNCTION",
+/// Every test macro contains one of the first two needles; C# test attributes
+/// ([TestMethod], [DataTestMethod]) are matched case-insensitively
+const NEEDLES: &[Needle] = &[
+    Needle::exact(b"TEST_FUNCTION"),
+    Needle::exact(b"TEST_METHOD"),
+    Needle::ignore_case(b"testmethod"),
 ];
 
-/// Keywords/macros to exclude from helper function detection
+/// Macros that look like helper function definitions
 const EXCLUDED_NAMES: &[&str] = &[
     "TEST_FUNCTION",
     "TEST_METHOD",
     "CTEST_FUNCTION",
     "PARAMETERIZED_TEST_FUNCTION",
-    "if",
-    "while",
-    "for",
-    "switch",
-    "else",
-    "do",
     "TEST_DEFINE_ENUM_TYPE",
     "TEST_SUITE_INITIALIZE",
     "TEST_SUITE_CLEANUP",
@@ -70,645 +50,42 @@ const EXCLUDED_NAMES: &[&str] = &[
     "TEST_FUNCTION_CLEANUP",
 ];
 
-struct TestFuncMatch {
-    macro_name: String,
-    test_name: String,
-    match_pos: usize,
-    match_end: usize,
-    body_start: Option<usize>,
-    has_no_aaa: bool,
-}
-
-/// Find all test macro invocations in content.
-/// Matches: optional leading whitespace, MACRO_NAME(identifier)
-fn find_test_functions(content: &[u8]) -> Vec<TestFuncMatch> {
-    let len = content.len();
-    let mut results = Vec::new();
-    let mut pos = 0usize;
-
-    while pos < len {
-        // Save position at start of potential match (before whitespace skip)
-        let match_start = pos;
-
-        // Skip leading whitespace
-        while pos < len && (content[pos] == b' ' || content[pos] == b'\t') {
-            pos += 1;
-        }
-
-        if pos >= len {
-            break;
-        }
-
-        // Try to match each macro
-        let mut matched = false;
-        for macro_name in MACROS {
-            let macro_bytes = macro_name.as_bytes();
-            let mlen = macro_bytes.len();
-            if pos + mlen <= len && &content[pos..pos + mlen] == macro_bytes {
-                // After macro name, skip optional whitespace then expect '('
-                let mut p = pos + mlen;
-                while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                    p += 1;
-                }
-                if p < len && content[p] == b'(' {
-                    p += 1;
-                    // Skip whitespace
-                    while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                        p += 1;
-                    }
-                    // Extract identifier
-                    let name_start = p;
-                    while p < len && is_ident_char(content[p]) {
-                        p += 1;
-                    }
-                    if p > name_start {
-                        let test_name =
-                            String::from_utf8_lossy(&content[name_start..p]).to_string();
-                        // Skip to closing paren (handle nested parens for PARAMETERIZED)
-                        let mut paren_depth = 1;
-                        while p < len && paren_depth > 0 {
-                            if content[p] == b'(' {
-                                paren_depth += 1;
-                            } else if content[p] == b')' {
-                                paren_depth -= 1;
-                            }
-                            if paren_depth > 0 {
-                                p += 1;
-                            }
-                        }
-                        if p < len {
-                            p += 1; // skip ')'
-                        }
-                        results.push(TestFuncMatch {
-                            macro_name: macro_name.to_string(),
-                            test_name,
-                            match_pos: match_start,
-                            match_end: p,
-                            body_start: Some(match_start),
-                            has_no_aaa: false,
-                        });
-                        matched = true;
-                        // Skip to end of line
-                        while p < len && content[p] != b'\n' {
-                            p += 1;
-                        }
-                        if p < len {
-                            p += 1;
-                        }
-                        pos = p;
-                        break;
-                    }
-                }
-            }
-        }
-
-        if !matched {
-            // Skip to next line
-            while pos < len && content[pos] != b'\n' {
-                pos += 1;
-            }
-            if pos < len {
-                pos += 1;
-            }
-        }
-    }
-
-    results
-}
-
 fn is_ident_char(b: u8) -> bool {
     b.is_ascii_alphanumeric() || b == b'_'
 }
 
-fn line_bounds_at(content: &[u8], pos: usize) -> (usize, usize, usize) {
-    let len = content.len();
-    let pos = pos.min(len);
-
-    let line_start = content[..pos]
-        .iter()
-        .rposition(|b| *b == b'\n')
-        .map_or(0, |i| i + 1);
-    let line_end = content[pos..]
-        .iter()
-        .position(|b| *b == b'\n')
-        .map_or(len, |i| pos + i);
-
-    let next_line = if line_end < len {
-        line_end + 1
-    } else {
-        line_end
-    };
-    (line_start, line_end, next_line)
-}
-
-fn matches_csharp_attribute(line: &[u8], attribute_name: &[u8]) -> bool {
-    let trimmed = line.trim_ascii_start();
-    if !trimmed.starts_with(b"[") {
-        return false;
-    }
-
-    let mut pos = 1usize;
-    while pos < trimmed.len() && trimmed[pos].is_ascii_whitespace() {
-        pos += 1;
-    }
-
-    if pos + attribute_name.len() > trimmed.len()
-        || !eq_ignore_case(&trimmed[pos..pos + attribute_name.len()], attribute_name)
-    {
-        return false;
-    }
-
-    pos += attribute_name.len();
-    if pos + b"Attribute".len() <= trimmed.len()
-        && eq_ignore_case(&trimmed[pos..pos + b"Attribute".len()], b"Attribute")
-    {
-        pos += b"Attribute".len();
-    }
-
-    while pos < trimmed.len() && trimmed[pos].is_ascii_whitespace() {
-        pos += 1;
-    }
-
-    pos < trimmed.len() && (trimmed[pos] == b']' || trimmed[pos] == b'(' || trimmed[pos] == b',')
-}
-
-fn is_csharp_test_attribute(line: &[u8]) -> Option<&'static str> {
-    if matches_csharp_attribute(line, b"TestMethod") {
-        Some("[TestMethod]")
-    } else if matches_csharp_attribute(line, b"DataTestMethod") {
-        Some("[DataTestMethod]")
-    } else {
-        None
-    }
-}
-
-fn is_csharp_attribute_or_blank(line: &[u8]) -> bool {
-    let trimmed = line.trim_ascii_start();
-    trimmed.is_empty()
-        || trimmed == b"\r"
-        || trimmed.starts_with(b"[")
-        || trimmed.starts_with(b"//")
-        || trimmed.starts_with(b"/*")
-        || trimmed.starts_with(b"*")
-}
-
-fn find_csharp_expression_body_end(content: &[u8], start: usize) -> usize {
-    let len = content.len();
-    let mut pos = start;
-    let mut in_string = false;
-    let mut in_char = false;
-    let mut paren_depth = 0i32;
-    let mut bracket_depth = 0i32;
-    let mut brace_depth = 0i32;
-
-    while pos < len {
-        if !in_string && !in_char && pos + 1 < len && content[pos] == b'/' && content[pos + 1] == b'/' {
-            pos += 2;
-            while pos < len && content[pos] != b'\n' {
-                pos += 1;
-            }
-            continue;
-        }
-        if !in_string && !in_char && pos + 1 < len && content[pos] == b'/' && content[pos + 1] == b'*' {
-            pos += 2;
-            while pos + 1 < len {
-                if content[pos] == b'*' && content[pos + 1] == b'/' {
-                    pos += 2;
-                    break;
-                }
-                pos += 1;
-            }
-            continue;
-        }
-        if !in_string && !in_char && content[pos] == b'"' {
-            in_string = true;
-            pos += 1;
-            continue;
-        }
-        if in_string {
-            if content[pos] == b'\\' && pos + 1 < len {
-                pos += 2;
-            } else if content[pos] == b'"' {
-                in_string = false;
-                pos += 1;
-            } else {
-                pos += 1;
-            }
-            continue;
-        }
-        if !in_string && !in_char && content[pos] == b'\'' {
-            in_char = true;
-            pos += 1;
-            continue;
-        }
-        if in_char {
-            if content[pos] == b'\\' && pos + 1 < len {
-                pos += 2;
-            } else if content[pos] == b'\'' {
-                in_char = false;
-                pos += 1;
-            } else {
-                pos += 1;
-            }
-            continue;
-        }
-
-        match content[pos] {
-            b'(' => paren_depth += 1,
-            b')' => {
-                if paren_depth > 0 {
-                    paren_depth -= 1;
-                }
-            }
-            b'[' => bracket_depth += 1,
-            b']' => {
-                if bracket_depth > 0 {
-                    bracket_depth -= 1;
-                }
-            }
-            b'{' => brace_depth += 1,
-            b'}' => {
-                if brace_depth > 0 {
-                    brace_depth -= 1;
-                }
-            }
-            b';' if paren_depth == 0 && bracket_depth == 0 && brace_depth == 0 => return pos + 1,
-            _ => {}
-        }
-
-        pos += 1;
-    }
-
-    len
-}
-
-fn find_csharp_body_start(content: &[u8], signature_start: usize) -> (usize, Option<usize>) {
-    let len = content.len();
-    let mut pos = signature_start;
-    let mut in_string = false;
-    let mut in_char = false;
-
-    while pos < len {
-        if !in_string && !in_char && content[pos] == b'"' {
-            in_string = true;
-            pos += 1;
-            continue;
-        }
-        if in_string {
-            if content[pos] == b'\\' && pos + 1 < len {
-                pos += 2;
-            } else if content[pos] == b'"' {
-                in_string = false;
-                pos += 1;
-            } else {
-                pos += 1;
-            }
-            continue;
-        }
-        if !in_string && !in_char && content[pos] == b'\'' {
-            in_char = true;
-            pos += 1;
-            continue;
-        }
-        if in_char {
-            if content[pos] == b'\\' && pos + 1 < len {
-                pos += 2;
-            } else if content[pos] == b'\'' {
-                in_char = false;
-                pos += 1;
-            } else {
-                pos += 1;
-            }
-            continue;
-        }
-
-        if content[pos] == b'{' {
-            return (pos, Some(pos));
-        }
-        if content[pos] == b';' {
-            return (pos + 1, None);
-        }
-        if content[pos] == b'=' && pos + 1 < len && content[pos + 1] == b'>' {
-            return (find_csharp_expression_body_end(content, pos + 2), None);
-        }
-
-        pos += 1;
-    }
-
-    (len, None)
-}
-
-fn extract_csharp_method_name(signature: &[u8]) -> String {
-    let paren_pos = match signature.iter().position(|b| *b == b'(') {
-        Some(pos) => pos,
-        None => return "<unknown>".to_string(),
-    };
-
-    let mut name_end = paren_pos;
-    while name_end > 0 && signature[name_end - 1].is_ascii_whitespace() {
-        name_end -= 1;
-    }
-
-    let mut name_start = name_end;
-    while name_start > 0 && is_ident_char(signature[name_start - 1]) {
-        name_start -= 1;
-    }
-
-    if name_start < name_end {
-        String::from_utf8_lossy(&signature[name_start..name_end]).to_string()
-    } else {
-        "<unknown>".to_string()
-    }
-}
-
-fn find_csharp_test_methods(content: &[u8]) -> Vec<TestFuncMatch> {
-    let len = content.len();
-    let mut results = Vec::new();
-    let mut pos = 0usize;
-
-    while pos < len {
-        let (line_start, line_end, next_line) = line_bounds_at(content, pos);
-        let line = &content[line_start..line_end];
-
-        let attribute_name = match is_csharp_test_attribute(line) {
-            Some(name) => name,
-            None => {
-                pos = next_line;
-                continue;
-            }
-        };
-
-        let mut has_no_aaa = has_no_aaa_exemption(line);
-        let mut signature_start = next_line;
-
-        while signature_start < len {
-            let (candidate_start, candidate_end, candidate_next) =
-                line_bounds_at(content, signature_start);
-            let candidate_line = &content[candidate_start..candidate_end];
-            if is_csharp_attribute_or_blank(candidate_line) {
-                if has_no_aaa_exemption(candidate_line) {
-                    has_no_aaa = true;
-                }
-                signature_start = candidate_next;
-            } else {
-                signature_start = candidate_start;
-                break;
-            }
-        }
-
-        let (signature_end, body_start) = find_csharp_body_start(content, signature_start);
-        if signature_start >= len {
-            pos = next_line;
-            continue;
-        }
-
-        let signature = &content[signature_start..signature_end];
-        if has_no_aaa_exemption(signature) {
-            has_no_aaa = true;
-        }
-
-        let test_name = extract_csharp_method_name(signature);
-
-        results.push(TestFuncMatch {
-            macro_name: attribute_name.to_string(),
-            test_name,
-            match_pos: line_start,
-            match_end: signature_end,
-            body_start,
-            has_no_aaa,
-        });
-
-        pos = if signature_end > next_line {
-            signature_end
-        } else {
-            next_line
-        };
-    }
-
-    results
-}
-
-fn is_csharp_method_signature_start(line: &[u8]) -> bool {
-    let trimmed = line.trim_ascii_start();
-    if trimmed.starts_with(b"[")
-        || trimmed.starts_with(b"//")
-        || trimmed.starts_with(b"*")
-        || trimmed.starts_with(b"/*")
-    {
-        return false;
-    }
-
-    let method_keywords = [
-        b"public " as &[u8],
-        b"private ",
-        b"protected ",
-        b"internal ",
-        b"static ",
-        b"async ",
-        b"void ",
-        b"Task ",
-        b"ValueTask ",
-    ];
-
-    method_keywords
-        .iter()
-        .any(|keyword| trimmed.starts_with(keyword))
-}
-
-fn find_csharp_helper_functions(content: &[u8]) -> HashMap<String, HelperFunc> {
-    let len = content.len();
-    let mut helpers = HashMap::new();
-    let mut pos = 0usize;
-
-    while pos < len {
-        let (line_start, line_end, next_line) = line_bounds_at(content, pos);
-        let line = &content[line_start..line_end];
-        if !is_csharp_method_signature_start(line) {
-            pos = next_line;
-            continue;
-        }
-
-        let (signature_end, body_start) = find_csharp_body_start(content, line_start);
-        if let Some(brace_pos) = body_start {
-            let signature = &content[line_start..signature_end];
-            let method_name = extract_csharp_method_name(signature);
-            if method_name != "<unknown>" {
-                helpers.insert(method_name, HelperFunc { brace_pos });
-            }
-        }
-
-        pos = if signature_end > next_line {
-            signature_end
-        } else {
-            next_line
-        };
-    }
-
-    helpers
-}
-
-/// Extract function body starting from start_index.
-/// Finds the opening '{' then counts braces, skipping string/char literals.
-/// Returns the body content between { and } (inclusive).
-fn extract_function_body(content: &[u8], start_index: usize) -> Option<(usize, Vec<u8>)> {
-    let len = content.len();
-
-    // Find opening brace
-    let mut brace_start = start_index;
-    while brace_start < len && content[brace_start] != b'{' {
-        brace_start += 1;
-    }
-    if brace_start >= len {
-        return None;
-    }
-
-    let mut brace_count = 1i32;
-    let mut pos = brace_start + 1;
-
-    while brace_count > 0 && pos < len {
-        let ch = content[pos];
-
-        // Skip string literals
-        if ch == b'"' {
-            pos += 1;
-            while pos < len {
-                if content[pos] == b'\\' && pos + 1 < len {
-                    pos += 2;
-                } else if content[pos] == b'"' {
-                    pos += 1;
-                    break;
-                } else {
-                    pos += 1;
-                }
-            }
-            continue;
-        }
-
-        // Skip character literals
-        if ch == b'\'' {
-            pos += 1;
-            while pos < len {
-                if content[pos] == b'\\' && pos + 1 < len {
-                    pos += 2;
-                } else if content[pos] == b'\'' {
-                    pos += 1;
-                    break;
-                } else {
-                    pos += 1;
-                }
-            }
-            continue;
-        }
-
-        if ch == b'{' {
-            brace_count += 1;
-        } else if ch == b'}' {
-            brace_count -= 1;
-        }
-        pos += 1;
-    }
-
-    if brace_count == 0 {
-        Some((brace_start, content[brace_start..pos].to_vec()))
-    } else {
-        None
-    }
-}
-
-/// AAA marker positions: (arrange_pos, act_pos, assert_pos), -1 if not found
-fn find_aaa_positions(body: &[u8]) -> [i64; 3] {
+/// AAA marker positions: (arrange_pos, act_pos, assert_pos), -1 if not found.
+/// A marker is a comment among tokens `range` that starts with the keyword.
+fn find_aaa_positions(content: &[u8], source: &SourceTokens, range: Range<usize>) -> [i64; 3] {
     let mut positions = [-1i64; 3];
 
     let keywords: [(&[u8], usize); 3] = [(b"arrange", 0), (b"act", 1), (b"assert", 2)];
 
-    let len = body.len();
+    for comment in source.comments(range) {
+        let text = comment.text(content);
+        let mut q = 2;
 
-    for (keyword, idx) in &keywords {
-        let klen = keyword.len();
-        let mut p = 0usize;
-        let mut in_string = false;
-        let mut in_char = false;
-
-        while p + klen <= len {
-            // Track string and char literals to avoid false comment matches
-            if !in_string && !in_char && body[p] == b'"' {
-                in_string = true;
-                p += 1;
-                continue;
-            }
-            if in_string {
-                if body[p] == b'\\' && p + 1 < len {
-                    p += 2; // skip escaped char
-                } else if body[p] == b'"' {
-                    in_string = false;
-                    p += 1;
-                } else {
-                    p += 1;
-                }
-                continue;
-            }
-            if !in_string && !in_char && body[p] == b'\'' {
-                in_char = true;
-                p += 1;
-                continue;
-            }
-            if in_char {
-                if body[p] == b'\\' && p + 1 < len {
-                    p += 2;
-                } else if body[p] == b'\'' {
-                    in_char = false;
-                    p += 1;
-                } else {
-                    p += 1;
-                }
-                continue;
+        // For line comments, skip additional '/' chars (e.g. "///")
+        if comment.kind == TokenKind::LineComment {
+            while q < text.len() && text[q] == b'/' {
+                q += 1;
             }
+        }
 
-            // Look for "//" or "/*" (only outside string/char literals)
-            if p + 1 < len && body[p] == b'/' && (body[p + 1] == b'/' || body[p + 1] == b'*') {
-                let is_block = body[p + 1] == b'*';
-                let comment_start = p;
-                let mut q = p + 2;
-
-                // For line comments, skip additional '/' chars (e.g. "///")
-                if !is_block {
-                    while q < len && body[q] == b'/' {
-                        q += 1;
-                    }
-                }
-
-                // Skip whitespace
-                while q < len && (body[q] == b' ' || body[q] == b'\t') {
-                    q += 1;
-                }
-
-                // Check keyword (case-insensitive)
-                if q + klen <= len && eq_ignore_case(&body[q..q + klen], keyword) {
-                    // Word boundary check: char after keyword should not be alphanumeric or _
-                    let after = q + klen;
-                    if (after >= len || !is_ident_char(body[after])) && positions[*idx] < 0 {
-                        positions[*idx] = comment_start as i64;
-                    }
-                }
+        // Skip whitespace
+        while q < text.len() && (text[q] == b' ' || text[q] == b'\t') {
+            q += 1;
+        }
 
-                // Skip rest of line/comment
-                if is_block {
-                    while q < len {
-                        if q + 1 < len && body[q] == b'*' && body[q + 1] == b'/' {
-                            q += 2;
-                            break;
-                        }
-                        q += 1;
-                    }
-                    p = q;
-                } else {
-                    while q < len && body[q] != b'\n' {
-                        q += 1;
-                    }
-                    p = q;
+        for (keyword, idx) in &keywords {
+            let klen = keyword.len();
+            // Check keyword (case-insensitive)
+            if q + klen <= text.len() && eq_ignore_case(&text[q..q + klen], keyword) {
+                // Word boundary check: char after keyword should not be alphanumeric or _
+                let after = q + klen;
+                if (after >= text.len() || !is_ident_char(text[after])) && positions[*idx] < 0 {
+                    positions[*idx] = comment.start as i64;
                 }
-            } else {
-                p += 1;
             }
         }
     }
@@ -728,29 +105,6 @@ fn eq_ignore_case(a: &[u8], b: &[u8]) -> bool {
     true
 }
 
-/// Get the full line containing a position (for checking no-aaa exemptions)
-fn get_line_at(content: &[u8], match_end: usize) -> &[u8] {
-    let len = content.len();
-    // Find start of line containing match_end
-    let mut line_start = if match_end > 0 { match_end - 1 } else { 0 };
-    while line_start > 0 && content[line_start] != b'\n' {
-        line_start -= 1;
-    }
-    if content[line_start] == b'\n' {
-        line_start += 1;
-    }
-    // Skip \r
-    while line_start < len && content[line_start] == b'\r' {
-        line_start += 1;
-    }
-    // Find end of line
-    let mut line_end = match_end;
-    while line_end < len && content[line_end] != b'\n' {
-        line_end += 1;
-    }
-    &content[line_start..line_end]
-}
-
 /// Check if a line contains "no-aaa" in a comment
 fn has_no_aaa_exemption(line: &[u8]) -> bool {
     let len = line.len();
@@ -782,248 +136,177 @@ fn has_no_aaa_exemption(line: &[u8]) -> bool {
     false
 }
 
-/// C return type keywords used to identify helper function definitions
-const RETURN_TYPES: &[&[u8]] = &[
-    b"void",
-    b"int",
-    b"bool",
-    b"char",
-    b"unsigned",
-    b"signed",
-    b"long",
-    b"short",
-    b"float",
-    b"double",
-    b"size_t",
-];
-
-fn is_return_type_prefix(word: &[u8]) -> bool {
-    for rt in RETURN_TYPES {
-        if word == *rt {
-            return true;
-        }
+/// Names a body uses that may be helpers: the functions C code calls, and for C#
+/// every identifier, since C# tests also pass helpers as delegates
+fn used_names<'a>(
+    content: &'a [u8],
+    source: &'a SourceTokens,
+    body: Range<usize>,
+    csharp: bool,
+) -> Box<dyn Iterator<Item = &'a [u8]> + 'a> {
+    if csharp {
+        Box::new(
+            source.tokens()[body]
+                .iter()
+                .filter(|token| token.kind == TokenKind::Identifier)
+                .map(|token| token.text(content)),
+        )
+    } else {
+        Box::new(source.calls(content, body))
     }
-    // uint*_t, int*_t patterns (e.g., uint32_t, int64_t)
-    if word.len() >= 5 && word[word.len() - 2] == b'_' && word[word.len() - 1] == b't' {
-        let prefix = &word[..word.len() - 2];
-        if prefix.starts_with(b"uint") || prefix.starts_with(b"int") {
-            let digits_start = if prefix.starts_with(b"uint") {
-                b"uint".len()
-            } else {
-                b"int".len()
-            };
-            return prefix[digits_start..].iter().all(|b| b.is_ascii_digit());
+}
+
+/// AAA markers as bits: 1 arrange, 2 act, 4 assert
+fn marker_bits(positions: [i64; 3]) -> u8 {
+    let mut bits = 0u8;
+    for (i, position) in positions.iter().enumerate() {
+        if *position >= 0 {
+            bits |= 1 << i;
         }
     }
-    // THANDLE(...) macro type
-    if word.len() >= b"THANDLE(".len() && word.starts_with(b"THANDLE") {
-        return true;
-    }
-    false
+    bits
 }
 
-struct HelperFunc {
-    brace_pos: usize,
+/// The helper functions of one file and the AAA markers each of them reaches:
+/// its own, and those of every helper it uses, directly or through other helpers.
+/// Built once per file; a test then costs one lookup per name its body uses.
+struct HelperGraph<'a> {
+    by_name: HashMap<&'a [u8], usize>,
+    /// Marker bits (see marker_bits) reached from each helper
+    reached: Vec<u8>,
 }
 
-/// Find helper function definitions in the file content.
-/// Returns map of function_name -> brace position for body extraction.
-fn find_helper_functions(content: &[u8]) -> HashMap<String, HelperFunc> {
-    let mut helpers = HashMap::new();
-    let len = content.len();
-    let mut pos = 0usize;
-
-    while pos < len {
-        // Must be at start of line
-        let _line_start = pos;
-
-        // Skip whitespace (for possible "static" keyword)
-        while pos < len && (content[pos] == b' ' || content[pos] == b'\t') {
-            pos += 1;
-        }
-
-        if pos >= len {
-            break;
-        }
-
-        // Check for "static " prefix
-        let mut p = pos;
-        if p + 7 <= len
-            && &content[p..p + 6] == b"static"
-            && (content[p + 6] == b' ' || content[p + 6] == b'\t')
-        {
-            p += 6;
-            while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                p += 1;
+impl<'a> HelperGraph<'a> {
+    fn new(content: &'a [u8], source: &'a SourceTokens, csharp: bool) -> Self {
+        let definitions: Vec<_> = source
+            .function_definitions(content)
+            .into_iter()
+            .filter(|definition| {
+                let name = &content[definition.name.clone()];
+                !EXCLUDED_NAMES.iter().any(|excluded| excluded.as_bytes() == name)
+            })
+            .collect();
+
+        // A later definition of the same name replaces an earlier one
+        let mut by_name: HashMap<&[u8], usize> = HashMap::new();
+        for (i, definition) in definitions.iter().enumerate() {
+            by_name.insert(&content[definition.name.clone()], i);
+        }
+
+        let mut own = vec![0u8; definitions.len()];
+        let mut edges: Vec<Vec<usize>> = vec![Vec::new(); definitions.len()];
+        for &i in by_name.values() {
+            let brace = definitions[i].body;
+            if let Some(end) = source.partner(brace) {
+                let body = brace..end + 1;
+                own[i] = marker_bits(find_aaa_positions(content, source, body.clone()));
+                edges[i] = used_names(content, source, body, csharp)
+                    .filter_map(|name| by_name.get(name).copied())
+                    .collect();
+                edges[i].sort_unstable();
+                edges[i].dedup();
             }
         }
 
-        // Check for return type
-        // Handle THANDLE(...) specially
-        if p + 7 <= len && &content[p..p + 7] == b"THANDLE" {
-            // Skip THANDLE(...)
-            while p < len && content[p] != b'(' {
-                p += 1;
-            }
-            if p < len {
-                let mut paren_depth = 1;
-                p += 1;
-                while p < len && paren_depth > 0 {
-                    if content[p] == b'(' {
-                        paren_depth += 1;
-                    }
-                    if content[p] == b')' {
-                        paren_depth -= 1;
-                    }
-                    p += 1;
-                }
-            }
-        } else {
-            // Read type word
-            let word_start = p;
-            while p < len && is_ident_char(content[p]) {
-                p += 1;
-            }
-            if p == word_start || !is_return_type_prefix(&content[word_start..p]) {
-                // Not a recognized return type, skip line
-                while pos < len && content[pos] != b'\n' {
-                    pos += 1;
-                }
-                if pos < len {
-                    pos += 1;
-                }
-                continue;
-            }
-        }
-
-        // Skip whitespace and optional pointer '*'
-        while p < len && (content[p] == b' ' || content[p] == b'\t') {
-            p += 1;
-        }
-        if p < len && content[p] == b'*' {
-            p += 1;
-        }
-        while p < len && (content[p] == b' ' || content[p] == b'\t') {
-            p += 1;
-        }
-
-        // Read function name
-        let name_start = p;
-        while p < len && is_ident_char(content[p]) {
-            p += 1;
+        Self {
+            by_name,
+            reached: propagate(&own, &edges),
         }
+    }
 
-        if p > name_start {
-            let func_name = String::from_utf8_lossy(&content[name_start..p]).to_string();
-
-            // Check it's not an excluded name
-            let excluded = EXCLUDED_NAMES.contains(&func_name.as_str());
-
-            if !excluded {
-                // Skip whitespace, expect '('
-                while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                    p += 1;
-                }
-
-                if p < len && content[p] == b'(' {
-                    // Find matching closing paren
-                    let mut paren_count = 1;
-                    p += 1;
-                    while p < len && paren_count > 0 {
-                        if content[p] == b'(' {
-                            paren_count += 1;
-                        }
-                        if content[p] == b')' {
-                            paren_count -= 1;
-                        }
-                        p += 1;
-                    }
-
-                    if paren_count == 0 {
-                        // Skip whitespace, look for '{'
-                        while p < len
-                            && (content[p] == b' '
-                                || content[p] == b'\t'
-                                || content[p] == b'\r'
-                                || content[p] == b'\n')
-                        {
-                            p += 1;
-                        }
-
-                        if p < len && content[p] == b'{' {
-                            helpers.insert(func_name, HelperFunc { brace_pos: p });
-                        }
-                    }
+    /// Marker bits reached through the helpers among `names`
+    fn reached(&self, names: impl Iterator<Item = &'a [u8]>) -> u8 {
+        let mut bits = 0u8;
+        for name in names {
+            if let Some(&i) = self.by_name.get(name) {
+                bits |= self.reached[i];
+                if bits == 7 {
+                    break;
                 }
             }
         }
-
-        // Skip to next line from original position
-        while pos < len && content[pos] != b'\n' {
-            pos += 1;
-        }
-        if pos < len {
-            pos += 1;
-        }
+        bits
     }
-
-    helpers
 }
 
-/// Find all function calls in a body: identifier followed by '('
-fn find_called_functions(body: &[u8]) -> Vec<String> {
-    let mut calls = Vec::new();
-    let len = body.len();
-    let mut p = 0usize;
-
-    while p < len {
-        // Find start of an identifier
-        if is_ident_char(body[p]) && (p == 0 || !is_ident_char(body[p - 1])) {
-            let name_start = p;
-            while p < len && is_ident_char(body[p]) {
-                p += 1;
+/// For every node, the union of `own` over the nodes it reaches (itself included).
+/// Tarjan's algorithm, without recursion: a strongly connected component (helpers
+/// calling each other) is complete when its root is popped, after every component
+/// it calls, so one pass over the edges suffices.
+fn propagate(own: &[u8], edges: &[Vec<usize>]) -> Vec<u8> {
+    const UNVISITED: usize = usize::MAX;
+    let count = own.len();
+    let mut reached = own.to_vec();
+    let mut index = vec![UNVISITED; count];
+    let mut low = vec![0usize; count];
+    let mut on_stack = vec![false; count];
+    let mut stack: Vec<usize> = Vec::new();
+    let mut next_index = 0usize;
+
+    for root in 0..count {
+        if index[root] != UNVISITED {
+            continue;
+        }
+        // (node, next edge to follow)
+        let mut frames: Vec<(usize, usize)> = vec![(root, 0)];
+        index[root] = next_index;
+        low[root] = next_index;
+        next_index += 1;
+        stack.push(root);
+        on_stack[root] = true;
+
+        while let Some(frame) = frames.last_mut() {
+            let node = frame.0;
+            if frame.1 < edges[node].len() {
+                let target = edges[node][frame.1];
+                frame.1 += 1;
+                if index[target] == UNVISITED {
+                    index[target] = next_index;
+                    low[target] = next_index;
+                    next_index += 1;
+                    stack.push(target);
+                    on_stack[target] = true;
+                    frames.push((target, 0));
+                } else if on_stack[target] {
+                    low[node] = low[node].min(index[target]);
+                } else {
+                    // A finished component
+                    reached[node] |= reached[target];
+                }
+                continue;
             }
 
-            let name = &body[name_start..p];
-            // Skip whitespace
-            while p < len && (body[p] == b' ' || body[p] == b'\t') {
-                p += 1;
-            }
-            if p < len && body[p] == b'(' {
-                if let Ok(s) = std::str::from_utf8(name) {
-                    calls.push(s.to_string());
+            frames.pop();
+            if low[node] == index[node] {
+                // Every member of the component reaches what any member reaches
+                let start = stack.iter().rposition(|&member| member == node).expect("root is on the stack");
+                let bits = stack[start..].iter().fold(0u8, |bits, &member| bits | reached[member]);
+                for &member in &stack[start..] {
+                    reached[member] = bits;
+                    on_stack[member] = false;
                 }
+                stack.truncate(start);
+            }
+            if let Some(&(parent, _)) = frames.last() {
+                low[parent] = low[parent].min(low[node]);
+                reached[parent] |= reached[node];
             }
-        } else {
-            p += 1;
         }
     }
 
-    calls
+    reached
 }
 
-fn contains_identifier(body: &[u8], name: &[u8]) -> bool {
-    if name.is_empty() {
-        return false;
-    }
-
-    let len = body.len();
-    let name_len = name.len();
-    let mut pos = 0usize;
-
-    while pos + name_len <= len {
-        if &body[pos..pos + name_len] == name {
-            let before_ok = pos == 0 || !is_ident_char(body[pos - 1]);
-            let after = pos + name_len;
-            let after_ok = after >= len || !is_ident_char(body[after]);
-            if before_ok && after_ok {
-                return true;
-            }
-        }
-        pos += 1;
-    }
-
-    false
+/// True if a comment in the test's declaration, or on the line the declaration
+/// ends on, starts with "no-aaa"
+fn is_exempt(content: &[u8], source: &SourceTokens, test: &TestFunction) -> bool {
+    let tokens = source.tokens();
+    let last = &tokens[test.declaration.end - 1];
+    let line_end = scan::memchr(b'\n', &content[last.end..]).map_or(content.len(), |i| last.end + i);
+    let end = source.first_at(line_end);
+    source
+        .comments(test.declaration.start..end.max(test.declaration.end))
+        .any(|comment| has_no_aaa_exemption(comment.text(content)))
 }
 
 impl Check for AaaComments {
@@ -1043,29 +326,52 @@ impl Check for AaaComments {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        NEEDLES
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
         self.total_test_functions = 0;
         self.exempted_tests = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+        self.total_test_functions += shard.total_test_functions;
+        self.exempted_tests += shard.exempted_tests;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig, report: &mut FileReport) {
         if file.type_flags & (FILE_TYPE_C | FILE_TYPE_CS) == 0 {
             return;
         }
 
         let filename = extract_filename(&file.path);
-        let (check_helpers, check_csharp_helpers) = if file.type_flags & FILE_TYPE_C != 0 {
+        let csharp = if file.type_flags & FILE_TYPE_C != 0 {
             // Only check C unit tests. Preserve the historical integration-test exclusion.
             if !filename.ends_with("_ut.c") {
                 return;
             }
-            (true, false)
+            false
         } else if file.type_flags & FILE_TYPE_CS != 0 {
             if !filename.to_ascii_lowercase().ends_with("tests.cs") {
                 return;
             }
-            (true, true)
+            true
         } else {
             return;
         };
@@ -1075,51 +381,48 @@ impl Check for AaaComments {
             return;
         }
 
-        let line_index = build_line_index(content);
-        let test_funcs = if check_csharp_helpers {
-            find_csharp_test_methods(content)
-        } else {
-            find_test_functions(content)
-        };
-
-        if test_funcs.is_empty() {
+        let source = file.tokens();
+        if source.test_functions().is_empty() {
             return;
         }
 
-        // Lazy-init helper functions
-        let mut helpers: Option<HashMap<String, HelperFunc>> = None;
-        let mut helper_aaa_cache: HashMap<String, [i64; 3]> = HashMap::new();
+        // Built for the first test that needs its helpers
+        let mut helpers: Option<HelperGraph> = None;
 
-        for tf in &test_funcs {
+        for tf in source.test_functions() {
             self.total_test_functions += 1;
 
-            // Check for no-aaa exemption on the test marker line
-            let test_line = get_line_at(content, tf.match_end);
-            if tf.has_no_aaa || has_no_aaa_exemption(test_line) {
+            // Check for no-aaa exemption on the test declaration
+            if is_exempt(content, source, tf) {
                 self.exempted_tests += 1;
                 continue;
             }
 
-            // Extract function body
-            let body_start = match tf.body_start {
-                Some(pos) => pos,
+            let line_num = file.lines().line_number(source.tokens()[tf.declaration.start].start);
+            let (body_start, body_end) = match tf.body {
+                Some(body) => body,
+                // A C test macro without a body is not a test
+                None if !csharp => continue,
                 None => {
-                    let line_num = line_number_at(&line_index, tf.match_pos);
-                    println!(
-                        "  [ERROR] {}:{} {}({}) - missing AAA: arrange, act, assert",
-                        file.relative_path, line_num, tf.macro_name, tf.test_name
+                    report.finding(
+                        Finding::error(format!(
+                            "{}:{} {}({}) - missing AAA: arrange, act, assert",
+                            file.relative_path,
+                            line_num,
+                            tf.kind,
+                            tf.name_text(content)
+                        ))
+                        .in_file(&file.relative_path)
+                        .at_line(line_num),
                     );
                     self.violations += 1;
                     continue;
                 }
             };
-            let body = match extract_function_body(content, body_start) {
-                Some((_, b)) => b,
-                None => continue,
-            };
+            let body = body_start..body_end + 1;
 
             // Check AAA in body
-            let mut positions = find_aaa_positions(&body);
+            let mut positions = find_aaa_positions(content, source, body.clone());
             let all_found = positions[0] >= 0 && positions[1] >= 0 && positions[2] >= 0;
 
             if all_found {
@@ -1128,77 +431,23 @@ impl Check for AaaComments {
                     continue; // Valid
                 }
                 // Wrong order
-                let line_num = line_number_at(&line_index, tf.match_pos);
-                println!(
-                    "  [ERROR] {}:{} {}({}) - AAA comments are not in correct order (should be: arrange, act, assert)",
-                    file.relative_path, line_num, tf.macro_name, tf.test_name
+                report.finding(
+                    Finding::error(format!(
+                        "{}:{} {}({}) - AAA comments are not in correct order (should be: arrange, act, assert)",
+                        file.relative_path, line_num, tf.kind, tf.name_text(content)
+                    ))
+                    .in_file(&file.relative_path)
+                    .at_line(line_num),
                 );
                 self.violations += 1;
                 continue;
             }
 
-            if check_helpers {
-                if helpers.is_none() {
-                    helpers = Some(if check_csharp_helpers {
-                        find_csharp_helper_functions(content)
-                    } else {
-                        find_helper_functions(content)
-                    });
-                }
-                let helper_map = helpers.as_ref().unwrap();
-
-                let called_fns = find_called_functions(&body);
-                for called in &called_fns {
-                    if let Some(helper) = helper_map.get(called) {
-                        let h_positions =
-                            helper_aaa_cache.entry(called.clone()).or_insert_with(|| {
-                                match extract_function_body(content, helper.brace_pos) {
-                                    Some((_, hbody)) => find_aaa_positions(&hbody),
-                                    None => [-1, -1, -1],
-                                }
-                            });
-                        if h_positions[0] >= 0 {
-                            positions[0] = 0;
-                        }
-                        if h_positions[1] >= 0 {
-                            positions[1] = 0;
-                        }
-                        if h_positions[2] >= 0 {
-                            positions[2] = 0;
-                        }
-                    }
-                    if positions[0] >= 0 && positions[1] >= 0 && positions[2] >= 0 {
-                        break;
-                    }
-                }
-
-                if check_csharp_helpers
-                    && !(positions[0] >= 0 && positions[1] >= 0 && positions[2] >= 0)
-                {
-                    for (helper_name, helper) in helper_map {
-                        if contains_identifier(&body, helper_name.as_bytes()) {
-                            let h_positions = helper_aaa_cache
-                                .entry(helper_name.clone())
-                                .or_insert_with(|| {
-                                    match extract_function_body(content, helper.brace_pos) {
-                                        Some((_, hbody)) => find_aaa_positions(&hbody),
-                                        None => [-1, -1, -1],
-                                    }
-                                });
-                            if h_positions[0] >= 0 {
-                                positions[0] = 0;
-                            }
-                            if h_positions[1] >= 0 {
-                                positions[1] = 0;
-                            }
-                            if h_positions[2] >= 0 {
-                                positions[2] = 0;
-                            }
-                        }
-                        if positions[0] >= 0 && positions[1] >= 0 && positions[2] >= 0 {
-                            break;
-                        }
-                    }
+            let graph = helpers.get_or_insert_with(|| HelperGraph::new(content, source, csharp));
+            let reached = graph.reached(used_names(content, source, body, csharp));
+            for (i, position) in positions.iter_mut().enumerate() {
+                if reached & (1 << i) != 0 && *position < 0 {
+                    *position = 0;
                 }
             }
 
@@ -1215,26 +464,52 @@ impl Check for AaaComments {
             }
 
             if !missing.is_empty() {
-                let line_num = line_number_at(&line_index, tf.match_pos);
-                println!(
-                    "  [ERROR] {}:{} {}({}) - missing AAA: {}",
-                    file.relative_path,
-                    line_num,
-                    tf.macro_name,
-                    tf.test_name,
-                    missing.join(", ")
+                report.finding(
+                    Finding::error(format!(
+                        "{}:{} {}({}) - missing AAA: {}",
+                        file.relative_path,
+                        line_num,
+                        tf.kind,
+                        tf.name_text(content),
+                        missing.join(", ")
+                    ))
+                    .in_file(&file.relative_path)
+                    .at_line(line_num),
                 );
                 self.violations += 1;
             }
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
-        println!();
-        println!(
+    fn version(&self) -> u32 {
+        3
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+        out.i32(self.total_test_functions);
+        out.i32(self.exempted_tests);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        self.total_test_functions = input.i32()?;
+        self.exempted_tests = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        out: &mut CheckOutput,
+    ) -> i32 {
+        out.line(String::new());
+        out.line(format!(
             "  Test functions: {}, exempted: {}, violations: {}",
             self.total_test_functions, self.exempted_tests, self.violations
-        );
+        ));
         self.violations
     }
 }
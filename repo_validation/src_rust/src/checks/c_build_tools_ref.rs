@@ -1,14 +1,24 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use crate::file_walker::is_path_excluded;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::git_objects::GitRepository;
+use crate::line_index::LineIndex;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
 use std::fs;
-use std::path::Path;
 use std::process::Command;
 
+const CBT: Needle = Needle::exact(b"c_build_tools");
+
 pub struct CBuildToolsRef {
+    /// Commit the pipelines must reference; None when the check does not apply
+    /// (no c-build-tools submodule) or the commit could not be determined
+    expected_sha: Option<String>,
     violations: i32,
     fixed: i32,
 }
@@ -16,6 +26,7 @@ pub struct CBuildToolsRef {
 impl CBuildToolsRef {
     pub fn new() -> Self {
         Self {
+            expected_sha: None,
             violations: 0,
             fixed: 0,
         }
@@ -49,12 +60,18 @@ fn find_cbt_submodule_path(gitmodules_content: &str) -> Option<String> {
     None
 }
 
-/// Determine expected SHA from git ls-tree, or use the provided override.
+/// Determine expected SHA from the gitlink in HEAD's tree, or use the provided override.
+/// The object database is read directly; git ls-tree is only run for layouts the
+/// reader does not support.
 fn get_expected_sha(repo_root: &str, submodule_path: &str, sha_override: &Option<String>) -> Result<String, String> {
     if let Some(sha) = sha_override {
         return Ok(sha.clone());
     }
 
+    if let Some(sha) = GitRepository::open(repo_root).and_then(|repo| repo.gitlink_at_head(submodule_path)) {
+        return Ok(sha);
+    }
+
     let output = Command::new("git")
         .args(["-C", repo_root, "ls-tree", "HEAD", submodule_path])
         .output()
@@ -76,68 +93,31 @@ fn get_expected_sha(repo_root: &str, submodule_path: &str, sha_override: &Option
     Err(format!("Could not parse submodule SHA from: {}", stdout.trim()))
 }
 
-/// Recursively find all .yml files under a directory, respecting exclusions and
-/// skipping hidden directories.
-fn find_yml_files(dir: &Path, repo_root: &str, exclude_folders: &[String], out: &mut Vec<(String, String)>) {
-    let entries = match fs::read_dir(dir) {
-        Ok(e) => e,
-        Err(_) => return,
-    };
-
-    let root_len = repo_root.len();
-
-    for entry in entries.flatten() {
-        let name = entry.file_name();
-        let name_str = name.to_string_lossy();
-
-        if name_str.starts_with('.') {
-            continue;
-        }
-
-        let full_path = entry.path();
-        let full_path_str = full_path.to_string_lossy().to_string();
-
-        let relative = if full_path_str.len() > root_len {
-            let r = &full_path_str[root_len..];
-            r.trim_start_matches(['/', '\\']).to_string()
-        } else {
-            name_str.to_string()
-        };
-
-        let ft = match entry.file_type() {
-            Ok(ft) => ft,
-            Err(_) => continue,
-        };
-
-        if ft.is_dir() {
-            if !is_path_excluded(&relative, exclude_folders) {
-                find_yml_files(&full_path, repo_root, exclude_folders, out);
-            }
-        } else if ft.is_file() && name_str.ends_with(".yml") && !is_path_excluded(&relative, exclude_folders) {
-            out.push((full_path_str, relative));
-        }
-    }
-}
-
 /// Check if a trimmed YAML line is a c_build_tools repository declaration.
 /// Matches with flexible whitespace: optional "-", then "repository:", then "c_build_tools"
 /// Mirrors PS1 regex: '^\s*-?\s*repository:\s*c_build_tools\s*$'
-fn is_cbt_repository_line(trimmed: &str) -> bool {
-    let s = trimmed.trim_start_matches('-').trim();
-    if let Some(rest) = s.strip_prefix("repository:") {
-        rest.trim() == "c_build_tools"
+fn is_cbt_repository_line(trimmed: &[u8]) -> bool {
+    let start = trimmed.iter().position(|&b| b != b'-').unwrap_or(trimmed.len());
+    let s = trimmed[start..].trim_ascii();
+    if let Some(rest) = s.strip_prefix(b"repository:") {
+        rest.trim_ascii() == b"c_build_tools"
     } else {
         false
     }
 }
 
-/// Check a single YAML file for c_build_tools repository ref.
-/// Returns (is_valid, ref_line_index, ref_value) or None if file doesn't reference c_build_tools.
-fn check_yaml_file(lines: &[String], expected_sha: &str) -> Option<(bool, usize, String)> {
+fn is_commit_sha(value: &[u8]) -> bool {
+    value.len() == 40 && value.iter().all(|b| b.is_ascii_hexdigit())
+}
+
+/// Find the ref of the c_build_tools repository declaration in a YAML file.
+/// Returns (ref_line_index, ref_value) or None if the file doesn't declare one.
+fn find_cbt_ref<'a>(lines: LineIndex<'a>) -> Option<(usize, &'a [u8])> {
     let mut in_cbt_block = false;
 
-    for (i, line) in lines.iter().enumerate() {
-        let trimmed = line.trim();
+    for i in 0..lines.len() {
+        let line = lines.line(i);
+        let trimmed = line.trim_ascii();
 
         // Match "repository: c_build_tools" with optional leading "- " and flexible whitespace
         // Pattern mirrors PS1: '^\s*-?\s*repository:\s*c_build_tools\s*$'
@@ -148,25 +128,17 @@ fn check_yaml_file(lines: &[String], expected_sha: &str) -> Option<(bool, usize,
 
         if in_cbt_block {
             // Exit block on next repository definition or non-indented non-empty line
-            if trimmed.starts_with("- repository:") {
+            if trimmed.starts_with(b"- repository:") {
                 in_cbt_block = false;
                 continue;
             }
-            if !trimmed.is_empty() && !line.starts_with(' ') && !line.starts_with('\t') {
+            if !trimmed.is_empty() && !line.starts_with(b" ") && !line.starts_with(b"\t") {
                 in_cbt_block = false;
                 continue;
             }
 
-            if let Some(rest) = trimmed.strip_prefix("ref:") {
-                let ref_value = rest.trim().to_string();
-                let is_valid = if ref_value == "refs/heads/master" {
-                    true
-                } else if ref_value.len() == 40 && ref_value.chars().all(|c| c.is_ascii_hexdigit()) {
-                    ref_value == expected_sha
-                } else {
-                    false
-                };
-                return Some((is_valid, i, ref_value));
+            if let Some(rest) = trimmed.strip_prefix(b"ref:") {
+                return Some((i, rest.trim_ascii()));
             }
         }
     }
@@ -184,22 +156,36 @@ impl Check for CBuildToolsRef {
     }
 
     fn file_types(&self) -> u32 {
-        // This check does its own file walking for .yml files
-        0
+        FILE_TYPE_YML
     }
 
     fn requires_devdoc(&self) -> bool {
         false
     }
 
-    fn init(&mut self, config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        // The expected ref is the submodule commit, which changes without the pipelines changing
+        true
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        // Files that never mention c_build_tools cannot declare it
+        &[CBT]
+    }
+
+    fn init(&mut self, config: &ValidatorConfig, out: &mut CheckOutput) {
+        self.expected_sha = None;
         self.violations = 0;
         self.fixed = 0;
 
-        println!();
-        println!("  ----------------------------------------");
-        println!("  c-build-tools Ref Validation");
-        println!("  ----------------------------------------");
+        out.line(String::new());
+        out.line("  ----------------------------------------".to_string());
+        out.line("  c-build-tools Ref Validation".to_string());
+        out.line("  ----------------------------------------".to_string());
 
         // Step 1: Find .gitmodules
         let gitmodules_path = format!("{}/.gitmodules", config.repo_root);
@@ -210,7 +196,7 @@ impl Check for CBuildToolsRef {
         } else if let Ok(content) = fs::read_to_string(&gitmodules_path_win) {
             content
         } else {
-            println!("  No .gitmodules file found. Skipping (not applicable).");
+            out.line("  No .gitmodules file found. Skipping (not applicable).".to_string());
             return;
         };
 
@@ -218,126 +204,136 @@ impl Check for CBuildToolsRef {
         let submodule_path = match find_cbt_submodule_path(&gitmodules_content) {
             Some(p) => p,
             None => {
-                println!("  No c-build-tools submodule found in .gitmodules. Skipping.");
+                out.line("  No c-build-tools submodule found in .gitmodules. Skipping.".to_string());
                 return;
             }
         };
-        println!("  c-build-tools submodule path: {}", submodule_path);
+        out.line(format!("  c-build-tools submodule path: {}", submodule_path));
 
         // Step 3: Get expected SHA
         let expected_sha = match get_expected_sha(&config.repo_root, &submodule_path, &config.submodule_sha) {
             Ok(sha) => sha,
             Err(e) => {
-                println!("  [ERROR] {}", e);
+                out.finding(Finding::error(e.to_string()));
                 self.violations = 1;
                 return;
             }
         };
-        println!("  Expected submodule SHA: {}", expected_sha);
-
-        // Step 4: Find all .yml files
-        let mut yml_files: Vec<(String, String)> = Vec::new();
-        find_yml_files(Path::new(&config.repo_root), &config.repo_root, &config.exclude_folders, &mut yml_files);
-
-        // Step 5: Check each YAML file
-        for (full_path, relative_path) in &yml_files {
-            let content = match fs::read_to_string(full_path) {
-                Ok(c) => c,
-                Err(_) => {
-                    println!("  [WARN] Cannot read file: {}", relative_path);
-                    continue;
-                }
-            };
-
-            // Quick check: does this file reference c_build_tools?
-            // Uses flexible matching (mirrors PS1: 'repository:\s*c_build_tools')
-            if !content.contains("c_build_tools") {
-                continue;
-            }
+        out.line(format!("  Expected submodule SHA: {}", expected_sha));
+
+        // Step 4: The pipeline .yml files are checked by check_file during the walk
+        self.expected_sha = Some(expected_sha);
+    }
+
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self {
+            expected_sha: self.expected_sha.clone(),
+            violations: 0,
+            fixed: 0,
+        })
+    }
 
-            let lines: Vec<String> = content.lines().map(|l| l.to_string()).collect();
-
-            let (is_valid, ref_line_idx, ref_value) = match check_yaml_file(&lines, &expected_sha) {
-                Some(result) => result,
-                None => {
-                    println!("  [WARN] No ref: found for c_build_tools in {}", relative_path);
-                    continue;
-                }
-            };
-
-            if is_valid {
-                if ref_value == "refs/heads/master" {
-                    println!("  [OK]   {} (ref: refs/heads/master)", relative_path);
-                } else {
-                    println!(
-                        "  [OK]   {} (ref: {}... matches submodule)",
-                        relative_path,
-                        &ref_value[..12.min(ref_value.len())]
-                    );
-                }
-            } else {
-                let reason = if ref_value.len() == 40 && ref_value.chars().all(|c| c.is_ascii_hexdigit()) {
-                    format!(
-                        "SHA mismatch: YAML has {}..., submodule is {}...",
-                        &ref_value[..12.min(ref_value.len())],
-                        &expected_sha[..12.min(expected_sha.len())]
-                    )
-                } else {
-                    format!(
-                        "Unexpected ref value: {} (expected refs/heads/master or a 40-char commit SHA)",
-                        ref_value
-                    )
-                };
-
-                println!("  [FAIL] {}", relative_path);
-                println!("         {}", reason);
-
-                if config.fix_mode {
-                    // Replace the ref value with the expected SHA
-                    let mut new_lines = lines.clone();
-                    let old_line = &new_lines[ref_line_idx];
-                    if let Some(ref_pos) = old_line.find("ref:") {
-                        let prefix = &old_line[..ref_pos];
-                        new_lines[ref_line_idx] = format!("{}ref: {}", prefix, expected_sha);
-
-                        let new_content = new_lines.join("\n");
-                        // Preserve original line ending: if original had trailing newline, keep it
-                        let new_content = if content.ends_with('\n') {
-                            format!("{}\n", new_content)
-                        } else {
-                            new_content
-                        };
-
-                        match fs::write(full_path, new_content.as_bytes()) {
-                            Ok(_) => {
-                                println!(
-                                    "         [FIXED] Updated ref to {}...",
-                                    &expected_sha[..12.min(expected_sha.len())]
-                                );
-                                self.fixed += 1;
-                            }
-                            Err(e) => {
-                                println!("         [ERROR] Failed to fix: {}", e);
-                                self.violations += 1;
-                            }
-                        }
-                    } else {
-                        self.violations += 1;
-                    }
-                } else {
-                    self.violations += 1;
-                }
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+        self.fixed += shard.fixed;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
+        let expected_sha = match &self.expected_sha {
+            Some(sha) => sha.as_str(),
+            None => return,
+        };
+        let relative_path = &file.relative_path;
+        let lines = file.lines();
+
+        let (ref_line_idx, ref_value) = match find_cbt_ref(lines) {
+            Some(result) => result,
+            None => {
+                report.finding(
+                    Finding::warning(format!("No ref: found for c_build_tools in {}", relative_path)).in_file(relative_path),
+                );
+                return;
             }
+        };
+        let ref_text = String::from_utf8_lossy(ref_value);
+
+        if ref_value == b"refs/heads/master" {
+            report.message(format!("  [OK]   {} (ref: refs/heads/master)", relative_path));
+            return;
+        }
+        if is_commit_sha(ref_value) && ref_value == expected_sha.as_bytes() {
+            report.message(format!("  [OK]   {} (ref: {}... matches submodule)", relative_path, &ref_text[..12]));
+            return;
+        }
+
+        let reason = if is_commit_sha(ref_value) {
+            format!(
+                "SHA mismatch: YAML has {}..., submodule is {}...",
+                &ref_text[..12],
+                &expected_sha[..12.min(expected_sha.len())]
+            )
+        } else {
+            format!(
+                "Unexpected ref value: {} (expected refs/heads/master or a 40-char commit SHA)",
+                ref_text
+            )
+        };
+
+        report.finding(
+            Finding::error(relative_path.clone())
+                .in_file(relative_path)
+                .at_line(ref_line_idx + 1)
+                .with_detail(reason),
+        );
+
+        if config.fix_mode {
+            // Replace everything from "ref:" to the end of the line with the expected SHA
+            let line = lines.line(ref_line_idx);
+            let ref_pos = line.windows(4).position(|w| w == b"ref:").unwrap_or(0);
+            let start = lines.start(ref_line_idx) + ref_pos;
+            let replacement = format!("ref: {}", expected_sha);
+            report.fix(
+                format!(
+                    "          [FIXED] Updated ref to {}...",
+                    &expected_sha[..12.min(expected_sha.len())]
+                ),
+                vec![Edit::replace(start, lines.end(ref_line_idx), replacement.as_bytes())],
+            );
+            self.fixed += 1;
+        } else {
+            self.violations += 1;
         }
     }
 
-    fn check_file(&mut self, _file: &FileInfo, _config: &ValidatorConfig) {
-        // No-op: this check does its own file walking for .yml files
+    fn version(&self) -> u32 {
+        3
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        // The result is only valid for the commit it was checked against
+        out.str(self.expected_sha.as_deref().unwrap_or(""));
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        let checked_against = input.string()?;
+        if checked_against != self.expected_sha.as_deref().unwrap_or("") {
+            return None;
+        }
+        self.violations = input.i32()?;
+        Some(())
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        out: &mut CheckOutput,
+    ) -> i32 {
         if self.fixed > 0 {
-            println!("  Files fixed: {}", self.fixed);
+            out.line(format!("  Files fixed: {}", self.fixed));
         }
         self.violations
     }
@@ -1,9 +1,16 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use std::fs;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::line_index::LineIndex;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
+
+const ENABLE_MOCKS: Needle = Needle::exact(b"ENABLE_MOCKS");
 
 pub struct EnableMocks {
     violations: i32,
@@ -114,39 +121,44 @@ fn has_force_comment(line: &[u8]) -> bool {
     j >= 2 && line[j - 1] == b'/' && line[j - 2] == b'/'
 }
 
-/// Split content into lines. Each line is the bytes without \r\n, but we track
-/// the raw length including line terminators.
-struct LineData {
-    /// Content of line without \r or \n
-    trimmed: Vec<u8>,
-    /// The raw bytes including \r\n for non-replaced lines
-    raw: Vec<u8>,
-}
+const ENABLE_MOCKS_INCLUDE: &[u8] =
+    b"#include \"umock_c/umock_c_ENABLE_MOCKS.h\" // ============================== ENABLE_MOCKS\r";
+const DISABLE_MOCKS_INCLUDE: &[u8] =
+    b"#include \"umock_c/umock_c_DISABLE_MOCKS.h\" // ============================== DISABLE_MOCKS\r";
 
-fn split_lines(content: &[u8]) -> Vec<LineData> {
-    let len = content.len();
-    let mut lines = Vec::new();
-    let mut line_start = 0usize;
+/// A deprecated #define or #undef ENABLE_MOCKS line
+struct DeprecatedLine {
+    /// Bounds of the line without its "\n" (a "\r" before it is included)
+    start: usize,
+    end: usize,
+    is_define: bool,
+}
 
-    for i in 0..=len {
-        if i == len || content[i] == b'\n' {
-            let raw_end = if i < len { i + 1 } else { i };
-            let raw = &content[line_start..raw_end];
+/// Find deprecated #define/#undef ENABLE_MOCKS lines. Only the lines holding one of
+/// `candidates` (offsets of "ENABLE_MOCKS") can match.
+fn find_deprecated_lines(content: &[u8], lines: LineIndex, candidates: &[usize]) -> Vec<DeprecatedLine> {
+    let mut found = Vec::new();
+    let mut previous_line: Option<usize> = None;
 
-            let mut trimmed_len = i - line_start;
-            if trimmed_len > 0 && content[line_start + trimmed_len - 1] == b'\r' {
-                trimmed_len -= 1;
-            }
-            let trimmed = &content[line_start..line_start + trimmed_len];
+    for &candidate in candidates {
+        let line = lines.line_of(candidate);
+        if previous_line == Some(line) {
+            continue;
+        }
+        previous_line = Some(line);
 
-            lines.push(LineData {
-                trimmed: trimmed.to_vec(),
-                raw: raw.to_vec(),
-            });
-            line_start = i + 1;
+        let (start, end) = (lines.start(line), lines.end(line));
+        let trimmed = &content[start..end];
+        if trimmed.is_empty() || has_force_comment(trimmed) {
+            continue;
+        }
+        let is_define = is_define_enable_mocks(trimmed);
+        if is_define || is_undef_enable_mocks(trimmed) {
+            let end = if end < content.len() && content[end] == b'\r' { end + 1 } else { end };
+            found.push(DeprecatedLine { start, end, is_define });
         }
     }
-    lines
+    found
 }
 
 impl Check for EnableMocks {
@@ -166,99 +178,93 @@ impl Check for EnableMocks {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[ENABLE_MOCKS]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
-        let lines = split_lines(&file.content);
-        let mut define_count = 0i32;
-        let mut undef_count = 0i32;
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
 
-        for line in &lines {
-            let trimmed = &line.trimmed;
-            if !trimmed.is_empty() && !has_force_comment(trimmed) {
-                if is_define_enable_mocks(trimmed) {
-                    define_count += 1;
-                } else if is_undef_enable_mocks(trimmed) {
-                    undef_count += 1;
-                }
-            }
-        }
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
+        let deprecated = find_deprecated_lines(&file.content, file.lines(), file.matches.offsets(ENABLE_MOCKS));
+        let define_count = deprecated.iter().filter(|line| line.is_define).count();
+        let undef_count = deprecated.len() - define_count;
 
-        let total_violations = define_count + undef_count;
+        let total_violations = deprecated.len();
         if total_violations == 0 {
             return;
         }
 
         if config.fix_mode {
-            let mut output =
-                Vec::with_capacity(file.content.len() + (total_violations as usize) * 128);
-
-            for (idx, line) in lines.iter().enumerate() {
-                let trimmed = &line.trimmed;
-                let mut replaced = false;
-
-                if !trimmed.is_empty() && !has_force_comment(trimmed) {
-                    if is_define_enable_mocks(trimmed) {
-                        let replacement = b"#include \"umock_c/umock_c_ENABLE_MOCKS.h\" // ============================== ENABLE_MOCKS";
-                        output.extend_from_slice(replacement);
-                        output.push(b'\r');
-                        replaced = true;
-                    } else if is_undef_enable_mocks(trimmed) {
-                        let replacement = b"#include \"umock_c/umock_c_DISABLE_MOCKS.h\" // ============================== DISABLE_MOCKS";
-                        output.extend_from_slice(replacement);
-                        output.push(b'\r');
-                        replaced = true;
-                    }
-                }
-
-                if !replaced {
-                    // Copy raw line bytes (without the trailing \n, we'll add it)
-                    let raw = &line.raw;
-                    if !raw.is_empty() && raw[raw.len() - 1] == b'\n' {
-                        output.extend_from_slice(&raw[..raw.len() - 1]);
-                    } else {
-                        output.extend_from_slice(raw);
-                    }
-                }
-
-                // Add newline if not the last line
-                let is_last = idx == lines.len() - 1;
-                let original_had_newline =
-                    !line.raw.is_empty() && line.raw[line.raw.len() - 1] == b'\n';
-                if !is_last || original_had_newline {
-                    if is_last && !original_had_newline {
-                        // don't add
-                    } else {
-                        output.push(b'\n');
-                    }
-                }
-            }
-
-            if fs::write(&file.path, &output).is_ok() {
-                println!(
+            // Each line keeps its "\n" and ends in "\r" before it
+            let edits = deprecated
+                .iter()
+                .map(|line| {
+                    let replacement = if line.is_define { ENABLE_MOCKS_INCLUDE } else { DISABLE_MOCKS_INCLUDE };
+                    Edit::replace(line.start, line.end, replacement)
+                })
+                .collect();
+            report.fix(
+                format!(
                     "  [FIXED] {} - replaced {} deprecated pattern(s)",
                     file.relative_path, total_violations
-                );
-            }
+                ),
+                edits,
+            );
         } else {
-            print!(
-                "  [ERROR] {} - {} deprecated ENABLE_MOCKS pattern(s)",
+            let mut message = format!(
+                "{} - {} deprecated ENABLE_MOCKS pattern(s)",
                 file.relative_path, total_violations
             );
             if define_count > 0 {
-                print!(" (#define: {})", define_count);
+                message.push_str(&format!(" (#define: {})", define_count));
             }
             if undef_count > 0 {
-                print!(" (#undef: {})", undef_count);
+                message.push_str(&format!(" (#undef: {})", undef_count));
             }
-            println!();
+            report.finding(Finding::error(message).in_file(&file.relative_path));
             self.violations += 1;
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
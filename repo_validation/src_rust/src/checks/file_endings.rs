@@ -1,9 +1,13 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use std::fs;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
 
 pub struct FileEndings {
     violations: i32,
@@ -32,11 +36,32 @@ impl Check for FileEndings {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
         let content = &file.content;
         if content.is_empty() {
             return;
@@ -63,45 +88,52 @@ impl Check for FileEndings {
         };
 
         if config.fix_mode {
+            let len = content.len();
             if last_byte == b'\n' {
                 // LF only - replace last byte with CRLF
-                let mut new_content = Vec::with_capacity(content.len() + 1);
-                new_content.extend_from_slice(&content[..content.len() - 1]);
-                new_content.extend_from_slice(b"\r\n");
-                if fs::write(&file.path, &new_content).is_ok() {
-                    println!(
-                        "  [FIXED] {} - converted LF to CRLF at end of file",
-                        file.relative_path
-                    );
-                }
+                report.fix(
+                    format!("  [FIXED] {} - converted LF to CRLF at end of file", file.relative_path),
+                    vec![Edit::replace(len - 1, len, b"\r\n")],
+                );
             } else if last_byte == b'\r' {
                 // CR only - append LF
-                let mut new_content = content.clone();
-                new_content.push(b'\n');
-                if fs::write(&file.path, &new_content).is_ok() {
-                    println!(
-                        "  [FIXED] {} - appended LF after CR at end of file",
-                        file.relative_path
-                    );
-                }
+                report.fix(
+                    format!("  [FIXED] {} - appended LF after CR at end of file", file.relative_path),
+                    vec![Edit::insert(len, b"\n")],
+                );
             } else {
                 // No newline - append CRLF
-                let mut new_content = content.clone();
-                new_content.extend_from_slice(b"\r\n");
-                if fs::write(&file.path, &new_content).is_ok() {
-                    println!(
-                        "  [FIXED] {} - appended CRLF at end of file",
-                        file.relative_path
-                    );
-                }
+                report.fix(
+                    format!("  [FIXED] {} - appended CRLF at end of file", file.relative_path),
+                    vec![Edit::insert(len, b"\r\n")],
+                );
             }
         } else {
-            println!("  [ERROR] {} - {}", file.relative_path, issue);
+            report.finding(Finding::error(format!("{} - {}", file.relative_path, issue)).in_file(&file.relative_path));
             self.violations += 1;
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -14,17 +14,76 @@ pub mod srs_format;
 pub mod srs_uniqueness;
 pub mod test_spec_tags;
 
-use crate::config::{FileInfo, ValidatorConfig};
+use crate::codec::{Decoder, Encoder};
+use crate::config::{CheckOutput, FileInfo, FileReport, ValidatorConfig};
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
+use std::any::Any;
 
-pub trait Check {
+/// Lets merge() recover the concrete type of a shard from a Box<dyn Check>.
+pub trait AsAny {
+    fn into_any(self: Box<Self>) -> Box<dyn Any>;
+}
+
+impl<T: Any> AsAny for T {
+    fn into_any(self: Box<Self>) -> Box<dyn Any> {
+        self
+    }
+}
+
+pub trait Check: AsAny + Send {
     fn name(&self) -> &str;
     fn description(&self) -> &str;
     fn file_types(&self) -> u32;
     fn requires_devdoc(&self) -> bool;
-    fn init(&mut self, config: &ValidatorConfig);
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig);
-    /// Returns violation count (0 = passed)
-    fn finalize(&mut self, config: &ValidatorConfig) -> i32;
+    /// True when the result for one file depends on other files (e.g. tag lookups).
+    /// In incremental mode such checks still see every file; the others only see changed files.
+    fn cross_file(&self) -> bool;
+    /// True for checks that read the shared SRS index in finalize(). The walker only
+    /// builds the index when at least one active check needs it.
+    fn uses_srs_index(&self) -> bool;
+    /// Byte strings at least one of which a file must contain for this check to report
+    /// anything about it. Files containing none of them are not passed to check_file;
+    /// the others carry the offsets of every occurrence in FileInfo::matches.
+    /// An empty list means the check sees every file of its types.
+    fn needles(&self) -> &'static [Needle];
+    /// Reset the check for a new run. Anything to print goes to `out`.
+    fn init(&mut self, config: &ValidatorConfig, out: &mut CheckOutput);
+    /// Create an empty shard of this check for a worker thread.
+    /// A shard only receives check_file calls; its state is folded back with merge().
+    fn fork(&self) -> Box<dyn Check>;
+    /// Fold a shard created by fork() back into this check
+    fn merge(&mut self, shard: Box<dyn Check>);
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport);
+    /// Version of this check's per-file logic, stored with cached results.
+    /// Bump it whenever check_file output or the shard encoding changes.
+    fn version(&self) -> u32;
+    /// Serialize the state of a shard that has seen exactly one file (for the result cache).
+    /// The file's path and ordinal are not saved; load_shard() takes them from the task.
+    fn save_shard(&self, out: &mut Encoder);
+    /// Restore a shard saved by save_shard() as if check_file had just seen the task's file.
+    /// Returns None if the data is malformed.
+    fn load_shard(&mut self, input: &mut Decoder, file: &FileTask) -> Option<()>;
+    /// Returns violation count (0 = passed). Fixes that need every file's results
+    /// (--fix mode) are queued on `fixes`; they are written after all checks finalize.
+    /// Findings and statistics go to `out`, never to stdout.
+    fn finalize(
+        &mut self,
+        config: &ValidatorConfig,
+        srs_index: &SrsIndex,
+        fixes: &mut PendingFixes,
+        out: &mut CheckOutput,
+    ) -> i32;
+}
+
+/// Downcast a shard handed to merge() back to the concrete check type
+pub fn downcast_shard<T: Check + 'static>(shard: Box<dyn Check>) -> Box<T> {
+    match shard.into_any().downcast::<T>() {
+        Ok(s) => s,
+        Err(_) => panic!("merge() called with a shard of a different check"),
+    }
 }
 
 pub fn all_checks() -> Vec<Box<dyn Check>> {
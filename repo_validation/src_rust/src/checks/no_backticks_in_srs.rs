@@ -1,9 +1,17 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use std::fs;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::prefilter::Needle;
+use crate::scan;
+use crate::srs_index::SrsIndex;
+
+/// A requirement can only contain backticks if the file has one
+const BACKTICK: Needle = Needle::exact(b"`");
 
 pub struct NoBackticksInSrs {
     violations: i32,
@@ -24,7 +32,7 @@ fn find_srs_backticks(content: &[u8]) -> i32 {
 
     while p + 4 < len {
         // Find 'S'
-        let srs = match content[p..].iter().position(|&b| b == b'S') {
+        let srs = match scan::memchr(b'S', &content[p..]) {
             Some(pos) => p + pos,
             None => break,
         };
@@ -60,13 +68,9 @@ fn find_srs_backticks(content: &[u8]) -> i32 {
                 // Check for opening bracket
                 if q < len && content[q] == b'[' {
                     q += 1;
-                    let mut has_backtick = false;
-                    while q < len && content[q] != b']' {
-                        if content[q] == b'`' {
-                            has_backtick = true;
-                        }
-                        q += 1;
-                    }
+                    let close = scan::memchr(b']', &content[q..]).map_or(len, |i| q + i);
+                    let has_backtick = scan::memchr(b'`', &content[q..close]).is_some();
+                    q = close;
 
                     if has_backtick && q < len && content[q] == b']' {
                         count += 1;
@@ -82,10 +86,11 @@ fn find_srs_backticks(content: &[u8]) -> i32 {
     count
 }
 
-/// Fix: remove backticks from SRS bracketed text
-fn fix_srs_backticks(content: &[u8]) -> Vec<u8> {
+/// Fix: remove backticks from SRS bracketed text. Returns one edit per bracketed
+/// text that contains backticks.
+fn fix_srs_backticks(content: &[u8]) -> Vec<Edit> {
     let len = content.len();
-    let mut result = Vec::with_capacity(len);
+    let mut edits = Vec::new();
     let mut p = 0usize;
 
     while p < len {
@@ -95,67 +100,57 @@ fn fix_srs_backticks(content: &[u8]) -> Vec<u8> {
             && content[p + 2] == b'S'
             && content[p + 3] == b'_'
         {
-            // Copy "SRS_"
-            result.push(content[p]);
-            result.push(content[p + 1]);
-            result.push(content[p + 2]);
-            result.push(content[p + 3]);
             p += 4;
 
-            // Copy module/tag chars
+            // Skip module/tag chars
             while p < len
                 && ((content[p] >= b'A' && content[p] <= b'Z')
                     || (content[p] >= b'0' && content[p] <= b'9')
                     || content[p] == b'_')
             {
-                result.push(content[p]);
                 p += 1;
             }
 
-            // Copy whitespace
+            // Skip whitespace
             while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                result.push(content[p]);
                 p += 1;
             }
 
             // Check for colon
             if p < len && content[p] == b':' {
-                result.push(content[p]);
                 p += 1;
 
-                // Copy whitespace
+                // Skip whitespace
                 while p < len && (content[p] == b' ' || content[p] == b'\t') {
-                    result.push(content[p]);
                     p += 1;
                 }
 
                 // Check for bracket
                 if p < len && content[p] == b'[' {
-                    result.push(content[p]);
                     p += 1;
 
-                    // Inside bracket: copy everything except backticks until ]
-                    while p < len && content[p] != b']' {
-                        if content[p] != b'`' {
-                            result.push(content[p]);
-                        }
-                        p += 1;
+                    // Inside bracket: drop every backtick until ]
+                    let close = scan::memchr(b']', &content[p..]).map_or(len, |i| p + i);
+                    let text = &content[p..close];
+                    if scan::memchr(b'`', text).is_some() {
+                        let stripped: Vec<u8> = text.iter().copied().filter(|&b| b != b'`').collect();
+                        edits.push(Edit::replace(p, close, &stripped));
                     }
+                    p = close;
 
-                    // Copy closing bracket if present
+                    // Skip closing bracket if present
                     if p < len && content[p] == b']' {
-                        result.push(content[p]);
                         p += 1;
                     }
                 }
             }
         } else {
-            result.push(content[p]);
-            p += 1;
+            // Skip to the next possible "SRS_"
+            p = scan::memchr(b'S', &content[p + 1..]).map_or(len, |i| p + 1 + i);
         }
     }
 
-    result
+    edits
 }
 
 impl Check for NoBackticksInSrs {
@@ -175,33 +170,76 @@ impl Check for NoBackticksInSrs {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[BACKTICK]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
         let match_count = find_srs_backticks(&file.content);
 
         if match_count > 0 {
             if config.fix_mode {
-                let fixed = fix_srs_backticks(&file.content);
-                if fs::write(&file.path, &fixed).is_ok() {
-                    println!(
+                report.fix(
+                    format!(
                         "  [FIXED] {} - removed backticks from {} SRS requirement(s)",
                         file.relative_path, match_count
-                    );
-                }
+                    ),
+                    fix_srs_backticks(&file.content),
+                );
             } else {
-                println!(
-                    "  [ERROR] {} - {} SRS requirement(s) contain backticks",
-                    file.relative_path, match_count
+                report.finding(
+                    Finding::error(format!(
+                        "{} - {} SRS requirement(s) contain backticks",
+                        file.relative_path, match_count
+                    ))
+                    .in_file(&file.relative_path),
                 );
                 self.violations += 1;
             }
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -1,9 +1,15 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use std::fs;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
+
+const TAB: Needle = Needle::exact(b"\t");
 
 pub struct NoTabs {
     violations: i32,
@@ -32,55 +38,77 @@ impl Check for NoTabs {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[TAB]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
-        let content = &file.content;
-        let mut tab_count = 0i32;
-        let mut first_tab_line: i32 = -1;
-        let mut current_line = 1i32;
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
 
-        for &b in content.iter() {
-            if b == b'\t' {
-                tab_count += 1;
-                if first_tab_line < 0 {
-                    first_tab_line = current_line;
-                }
-            }
-            if b == b'\n' {
-                current_line += 1;
-            }
-        }
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
+        let tabs = file.matches.offsets(TAB);
+        let tab_count = tabs.len() as i32;
 
         if tab_count > 0 {
             if config.fix_mode {
-                let mut new_content = Vec::with_capacity(content.len() + (tab_count as usize) * 3);
-                for &b in content.iter() {
-                    if b == b'\t' {
-                        new_content.extend_from_slice(b"    ");
-                    } else {
-                        new_content.push(b);
-                    }
-                }
-                if fs::write(&file.path, &new_content).is_ok() {
-                    println!(
-                        "  [FIXED] {} - replaced {} tab(s) with spaces",
-                        file.relative_path, tab_count
-                    );
-                }
+                let edits = tabs.iter().map(|&tab| Edit::replace(tab, tab + 1, b"    ")).collect();
+                report.fix(
+                    format!("  [FIXED] {} - replaced {} tab(s) with spaces", file.relative_path, tab_count),
+                    edits,
+                );
             } else {
-                println!(
-                    "  [ERROR] {} - contains {} tab(s), first at line {}",
-                    file.relative_path, tab_count, first_tab_line
+                let first_tab_line = file.lines().line_number(tabs[0]);
+                report.finding(
+                    Finding::error(format!(
+                        "{} - contains {} tab(s), first at line {}",
+                        file.relative_path, tab_count, first_tab_line
+                    ))
+                    .in_file(&file.relative_path)
+                    .at_line(first_tab_line),
                 );
                 self.violations += 1;
             }
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -1,9 +1,16 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
-use std::fs;
+use crate::file_walker::FileTask;
+use crate::fixes::{Edit, PendingFixes};
+use crate::line_index::LineIndex;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
+
+const VLD_H: Needle = Needle::exact(b"vld.h");
 
 pub struct NoVldInclude {
     violations: i32,
@@ -164,34 +171,107 @@ fn is_blank_or_comment(line: &[u8]) -> bool {
     false
 }
 
-struct LineInfo {
-    /// Line content without \r\n
-    trimmed: Vec<u8>,
-    /// Raw bytes including \r\n
-    raw: Vec<u8>,
-}
+/// Deletions that remove vld.h includes and `#ifdef USE_VLD` blocks holding nothing
+/// else, plus the edit keeping the file's CRLF ending. Returns the edits and the
+/// number of includes/blocks removed.
+fn plan_vld_removal(content: &[u8], lines: LineIndex) -> (Vec<Edit>, i32) {
+    let line_count = lines.len();
+    // A line's raw bytes run up to the next line's start (the terminator included)
+    let raw_end = |i: usize| if i + 1 < line_count { lines.start(i + 1) } else { content.len() };
+    let mut edits = Vec::new();
+    let mut removed = 0i32;
+    let mut idx = 0;
+
+    while idx < line_count {
+        let mut was_removed = false;
+
+        // Check if this is an #ifdef USE_VLD block
+        if is_ifdef_use_vld(lines.line(idx)) {
+            let mut j = idx + 1;
+            let mut found_vld = false;
+            let mut found_endif = false;
+            let mut only_vld = true;
+
+            while j < line_count {
+                let line = lines.line(j);
+                if is_vld_include(line) {
+                    found_vld = true;
+                    j += 1;
+                } else if is_endif(line) {
+                    found_endif = true;
+                    break;
+                } else if is_blank_or_comment(line) {
+                    j += 1;
+                } else {
+                    only_vld = false;
+                    break;
+                }
+            }
 
-fn parse_lines(content: &[u8]) -> Vec<LineInfo> {
-    let len = content.len();
-    let mut lines = Vec::new();
-    let mut line_start = 0usize;
+            if found_vld && found_endif && only_vld {
+                removed += 1;
+                edits.push(Edit::delete(lines.start(idx), raw_end(j)));
+                idx = j + 1; // skip past #endif
+                was_removed = true;
+            }
+        }
 
-    for i in 0..=len {
-        if i == len || content[i] == b'\n' {
-            let raw_end = if i < len { i + 1 } else { i };
-            let raw = content[line_start..raw_end].to_vec();
+        if !was_removed {
+            let line = lines.line(idx);
+            if is_vld_include(line) && !line_has_force_comment(line) {
+                removed += 1;
+                edits.push(Edit::delete(lines.start(idx), raw_end(idx)));
+            }
+            idx += 1;
+        }
+    }
 
-            let mut trimmed_len = i - line_start;
-            if trimmed_len > 0 && content[line_start + trimmed_len - 1] == b'\r' {
-                trimmed_len -= 1;
+    // Ensure the result ends with CRLF. Find the last two bytes that survive the
+    // deletions (which are sorted and disjoint).
+    let last_kept_before = |end: usize| {
+        let mut end = end;
+        for edit in edits.iter().rev() {
+            if edit.end == end {
+                end = edit.start;
+            } else if edit.end < end {
+                break;
+            }
+        }
+        end.checked_sub(1)
+    };
+    if let Some(last) = last_kept_before(content.len()) {
+        if let Some(before_last) = last_kept_before(last) {
+            if content[last] == b'\n' && content[before_last] != b'\r' {
+                edits.push(Edit::replace(last, last + 1, b"\r\n"));
+            } else if content[last] != b'\n' {
+                edits.push(Edit::insert(last + 1, b"\r\n"));
             }
-            let trimmed = content[line_start..line_start + trimmed_len].to_vec();
+        }
+    }
+
+    (edits, removed)
+}
+
+/// Count vld.h includes without a force comment. Only the lines holding one of
+/// `candidates` (offsets of "vld.h") can match.
+fn count_vld_includes(content: &[u8], lines: LineIndex, candidates: &[usize]) -> i32 {
+    let mut count = 0i32;
+    let mut next_line = 0usize;
+
+    for &candidate in candidates {
+        if candidate < next_line {
+            continue;
+        }
+        let line = lines.line_of(candidate);
+        let (start, end) = (lines.start(line), lines.end(line));
+        next_line = end + 1;
 
-            lines.push(LineInfo { trimmed, raw });
-            line_start = i + 1;
+        let line = &content[start..end];
+        if is_vld_include(line) && !line_has_force_comment(line) {
+            count += 1;
         }
     }
-    lines
+    count
 }
 
 impl Check for NoVldInclude {
@@ -211,105 +291,75 @@ impl Check for NoVldInclude {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[VLD_H]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
-        let lines = parse_lines(&file.content);
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
 
-        // Count violations
-        let mut violation_count = 0i32;
-        for line in &lines {
-            if is_vld_include(&line.trimmed) && !line_has_force_comment(&line.trimmed) {
-                violation_count += 1;
-            }
-        }
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
 
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
+        let violation_count = count_vld_includes(&file.content, file.lines(), file.matches.offsets(VLD_H));
         if violation_count == 0 {
             return;
         }
 
         if config.fix_mode {
-            let mut output = Vec::with_capacity(file.content.len());
-            let mut removed = 0i32;
-            let line_count = lines.len();
-            let mut idx = 0;
-
-            while idx < line_count {
-                let mut was_removed = false;
-
-                // Check if this is an #ifdef USE_VLD block
-                if is_ifdef_use_vld(&lines[idx].trimmed) {
-                    let mut j = idx + 1;
-                    let mut found_vld = false;
-                    let mut found_endif = false;
-                    let mut only_vld = true;
-
-                    while j < line_count {
-                        if is_vld_include(&lines[j].trimmed) {
-                            found_vld = true;
-                            j += 1;
-                        } else if is_endif(&lines[j].trimmed) {
-                            found_endif = true;
-                            break;
-                        } else if is_blank_or_comment(&lines[j].trimmed) {
-                            j += 1;
-                        } else {
-                            only_vld = false;
-                            break;
-                        }
-                    }
-
-                    if found_vld && found_endif && only_vld {
-                        removed += 1;
-                        idx = j + 1; // skip past #endif
-                        was_removed = true;
-                    }
-                }
-
-                if !was_removed {
-                    if is_vld_include(&lines[idx].trimmed)
-                        && !line_has_force_comment(&lines[idx].trimmed)
-                    {
-                        removed += 1;
-                    } else {
-                        output.extend_from_slice(&lines[idx].raw);
-                    }
-                    idx += 1;
-                }
-            }
-
-            // Ensure file ends with CRLF
-            if output.len() >= 2
-                && !(output[output.len() - 2] == b'\r' && output[output.len() - 1] == b'\n')
-            {
-                if output[output.len() - 1] == b'\n' {
-                    let last = output.len() - 1;
-                    output[last] = b'\r';
-                    output.push(b'\n');
-                } else {
-                    output.push(b'\r');
-                    output.push(b'\n');
-                }
-            }
-
-            if fs::write(&file.path, &output).is_ok() {
-                println!(
-                    "  [FIXED] {} - removed {} vld.h include(s)",
-                    file.relative_path, removed
-                );
-            }
+            let (edits, removed) = plan_vld_removal(&file.content, file.lines());
+            report.fix(
+                format!("  [FIXED] {} - removed {} vld.h include(s)", file.relative_path, removed),
+                edits,
+            );
         } else {
-            println!(
-                "  [ERROR] {} - contains {} vld.h include(s)",
-                file.relative_path, violation_count
+            report.finding(
+                Finding::error(format!(
+                    "{} - contains {} vld.h include(s)",
+                    file.relative_path, violation_count
+                ))
+                .in_file(&file.relative_path),
             );
             self.violations += 1;
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -1,8 +1,13 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
 use std::path::MAIN_SEPARATOR;
 
 pub struct RequirementsNaming {
@@ -15,48 +20,46 @@ impl RequirementsNaming {
     }
 }
 
+const SRS_PREFIX: Needle = Needle::exact(b"SRS_");
+
 /// Check if content contains an SRS tag pattern: SRS_XXXXXX_DD_DDD
-fn content_has_srs_tag(content: &[u8]) -> bool {
+/// `srs_offsets` are the offsets of every "SRS_" in the content
+fn content_has_srs_tag(content: &[u8], srs_offsets: &[usize]) -> bool {
     let len = content.len();
     if len < 16 {
         return false;
     }
 
-    let mut i = 0;
-    while i + 15 < len {
-        if content[i] == b'S'
-            && content[i + 1] == b'R'
-            && content[i + 2] == b'S'
-            && content[i + 3] == b'_'
-        {
-            let mut p = i + 4;
-            let mut found_upper = false;
-
-            while p < len.saturating_sub(6) {
-                if content[p] >= b'A' && content[p] <= b'Z' {
-                    found_upper = true;
-                }
-                if found_upper
-                    && content[p] == b'_'
-                    && content[p + 1].is_ascii_digit()
-                    && content[p + 2].is_ascii_digit()
-                    && content[p + 3] == b'_'
-                    && content[p + 4].is_ascii_digit()
-                    && content[p + 5].is_ascii_digit()
-                    && content[p + 6].is_ascii_digit()
-                {
-                    return true;
-                }
-                if !((content[p] >= b'A' && content[p] <= b'Z')
-                    || (content[p] >= b'0' && content[p] <= b'9')
-                    || content[p] == b'_')
-                {
-                    break;
-                }
-                p += 1;
+    for &i in srs_offsets {
+        if i + 15 >= len {
+            break;
+        }
+        let mut p = i + 4;
+        let mut found_upper = false;
+
+        while p < len.saturating_sub(6) {
+            if content[p] >= b'A' && content[p] <= b'Z' {
+                found_upper = true;
             }
+            if found_upper
+                && content[p] == b'_'
+                && content[p + 1].is_ascii_digit()
+                && content[p + 2].is_ascii_digit()
+                && content[p + 3] == b'_'
+                && content[p + 4].is_ascii_digit()
+                && content[p + 5].is_ascii_digit()
+                && content[p + 6].is_ascii_digit()
+            {
+                return true;
+            }
+            if !((content[p] >= b'A' && content[p] <= b'Z')
+                || (content[p] >= b'0' && content[p] <= b'9')
+                || content[p] == b'_')
+            {
+                break;
+            }
+            p += 1;
         }
-        i += 1;
     }
     false
 }
@@ -78,18 +81,39 @@ impl Check for RequirementsNaming {
         true
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[SRS_PREFIX]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, config: &ValidatorConfig, report: &mut FileReport) {
         if file.type_flags & FILE_TYPE_MD == 0 {
             return;
         }
         if file.type_flags & FILE_FLAG_IN_DEVDOC == 0 {
             return;
         }
-        if !content_has_srs_tag(&file.content) {
+        if !content_has_srs_tag(&file.content, file.matches.offsets(SRS_PREFIX)) {
             return;
         }
 
@@ -114,29 +138,50 @@ impl Check for RequirementsNaming {
             }
             let base = &file.path[..file.path.len() - 3];
             let new_path = format!("{}{}", base, "_requirements.md");
-            if std::fs::rename(&file.path, &new_path).is_ok() {
-                let new_filename = if let Some(pos) = new_path.rfind(MAIN_SEPARATOR) {
-                    &new_path[pos + 1..]
-                } else if let Some(pos) = new_path.rfind('/') {
-                    &new_path[pos + 1..]
-                } else {
-                    &new_path
-                };
-                println!("  [FIXED] {} -> {}", file.relative_path, new_filename);
+            let new_filename = if let Some(pos) = new_path.rfind(MAIN_SEPARATOR) {
+                &new_path[pos + 1..]
+            } else if let Some(pos) = new_path.rfind('/') {
+                &new_path[pos + 1..]
             } else {
-                println!("  [ERROR] Failed to rename {}", file.relative_path);
-                self.violations += 1;
-            }
+                &new_path
+            };
+            // The rename happens with the file's other fixes, after all checks ran
+            report.rename(
+                format!("  [FIXED] {} -> {}", file.relative_path, new_filename),
+                new_path.clone(),
+            );
         } else {
-            println!(
-                "  [ERROR] {} - requirement file should be named with '_requirements.md' suffix",
-                file.relative_path
+            report.finding(
+                Finding::error(format!(
+                    "{} - requirement file should be named with '_requirements.md' suffix",
+                    file.relative_path
+                ))
+                .in_file(&file.relative_path),
             );
             self.violations += 1;
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -1,8 +1,16 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::srs_index::SrsIndex;
+
+/// Tag definitions start with "**SRS_" (after an optional list marker)
+const BOLD_SRS_PREFIX: Needle = Needle::exact(b"**SRS_");
 
 pub struct SrsFormat {
     violations: i32,
@@ -47,19 +55,49 @@ impl Check for SrsFormat {
         true
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[BOLD_SRS_PREFIX]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig, report: &mut FileReport) {
         let content = match std::str::from_utf8(&file.content) {
             Ok(s) => s,
             Err(_) => return,
         };
 
-        let lines: Vec<&str> = content.lines().collect();
+        let index = file.lines();
+        let line_at = |i: usize| &content[index.start(i)..index.end(i)];
 
-        for (line_idx, line) in lines.iter().enumerate() {
+        // Only lines containing "**SRS_" can hold a tag
+        let mut previous_line: Option<usize> = None;
+        for &candidate in file.matches.offsets(BOLD_SRS_PREFIX) {
+            let line_idx = index.line_of(candidate);
+            if previous_line == Some(line_idx) {
+                continue;
+            }
+            previous_line = Some(line_idx);
+            let line = line_at(line_idx);
             let line_num = line_idx + 1;
 
             // Trim leading whitespace
@@ -93,9 +131,13 @@ impl Check for SrsFormat {
             let has_bold_open = line.contains("[**");
 
             if !has_bold_open {
-                println!(
-                    "  [ERROR] {}:{} {} - missing bold opening bracket [**",
-                    file.relative_path, line_num, tag
+                report.finding(
+                    Finding::error(format!(
+                        "{}:{} {} - missing bold opening bracket [**",
+                        file.relative_path, line_num, tag
+                    ))
+                    .in_file(&file.relative_path)
+                    .at_line(line_num),
                 );
                 self.violations += 1;
                 continue;
@@ -108,9 +150,10 @@ impl Check for SrsFormat {
             }
 
             // Scan subsequent lines for **]** (multi-line tag)
-            let max_scan = std::cmp::min(lines.len(), line_idx + 50);
+            let max_scan = std::cmp::min(index.len(), line_idx + 50);
             let mut close_line_idx: Option<usize> = None;
-            for (scan_offset, subsequent) in lines[line_idx + 1..max_scan].iter().enumerate() {
+            for subsequent_idx in line_idx + 1..max_scan {
+                let subsequent = line_at(subsequent_idx);
                 let st = subsequent.trim_start();
                 // Strip optional list markers before checking for new tag
                 let after_list = if st.starts_with("* ") || st.starts_with("- ") {
@@ -123,7 +166,7 @@ impl Check for SrsFormat {
                     break;
                 }
                 if subsequent.contains("**]**") {
-                    close_line_idx = Some(line_idx + 1 + scan_offset);
+                    close_line_idx = Some(subsequent_idx);
                     break;
                 }
             }
@@ -133,32 +176,48 @@ impl Check for SrsFormat {
                 // If all intermediate lines are blank AND the close line itself has no
                 // content besides **]**, the tag should have been single-line.
                 let all_intermediate_blank = (line_idx + 1..close_idx)
-                    .all(|i| lines[i].trim().is_empty());
+                    .all(|i| line_at(i).trim().is_empty());
                 let close_has_content =
-                    !lines[close_idx].replace("**]**", "").trim().is_empty();
+                    !line_at(close_idx).replace("**]**", "").trim().is_empty();
                 if all_intermediate_blank && !close_has_content {
-                    println!(
-                        "  [ERROR] {}:{} {} - gratuitous multi-line tag (closing **]** should be on same line)",
-                        file.relative_path, line_num, tag
+                    report.finding(
+                        Finding::error(format!(
+                            "{}:{} {} - gratuitous multi-line tag (closing **]** should be on same line)",
+                            file.relative_path, line_num, tag
+                        ))
+                        .in_file(&file.relative_path)
+                        .at_line(line_num),
                     );
                     self.violations += 1;
                 }
             } else {
                 // No closing found
                 if line.contains("]*/") {
-                    println!(
-                        "  [ERROR] {}:{} {} - C-comment-style closing ]*/ (should be **]**)",
-                        file.relative_path, line_num, tag
+                    report.finding(
+                        Finding::error(format!(
+                            "{}:{} {} - C-comment-style closing ]*/ (should be **]**)",
+                            file.relative_path, line_num, tag
+                        ))
+                        .in_file(&file.relative_path)
+                        .at_line(line_num),
                     );
                 } else if line.contains("**]") {
-                    println!(
-                        "  [ERROR] {}:{} {} - missing trailing ** after **]",
-                        file.relative_path, line_num, tag
+                    report.finding(
+                        Finding::error(format!(
+                            "{}:{} {} - missing trailing ** after **]",
+                            file.relative_path, line_num, tag
+                        ))
+                        .in_file(&file.relative_path)
+                        .at_line(line_num),
                     );
                 } else {
-                    println!(
-                        "  [ERROR] {}:{} {} - missing closing **]**",
-                        file.relative_path, line_num, tag
+                    report.finding(
+                        Finding::error(format!(
+                            "{}:{} {} - missing closing **]**",
+                            file.relative_path, line_num, tag
+                        ))
+                        .in_file(&file.relative_path)
+                        .at_line(line_num),
                     );
                 }
                 self.violations += 1;
@@ -166,7 +225,26 @@ impl Check for SrsFormat {
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
+    fn version(&self) -> u32 {
+        1
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
         self.violations
     }
 }
@@ -2,45 +2,23 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 use crate::checks::Check;
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::srs_index::{MarkdownEntry, SrsIndex};
 use std::collections::HashMap;
 use std::path::MAIN_SEPARATOR;
 
-struct SrsEntry {
-    file_path: String,
-    line_number: i32,
-}
-
-pub struct SrsUniqueness {
-    tags: HashMap<String, SrsEntry>,
-    total_tags: i32,
-    duplicate_found: bool,
-    files_scanned: i32,
-}
+/// Reports SRS tags defined more than once across requirement documents.
+/// The tags are collected by the shared SRS index, so this check has no per-file work.
+pub struct SrsUniqueness {}
 
 impl SrsUniqueness {
     pub fn new() -> Self {
-        Self {
-            tags: HashMap::new(),
-            total_tags: 0,
-            duplicate_found: false,
-            files_scanned: 0,
-        }
-    }
-}
-
-fn is_srs_module_char(c: u8) -> bool {
-    c.is_ascii_uppercase() || c.is_ascii_digit() || c == b'_'
-}
-
-fn compute_line_number(content: &[u8], offset: usize) -> i32 {
-    let mut line = 1;
-    for &byte in &content[..offset] {
-        if byte == b'\n' {
-            line += 1;
-        }
+        Self {}
     }
-    line
 }
 
 fn extract_filename(path: &str) -> &str {
@@ -63,147 +41,89 @@ impl Check for SrsUniqueness {
     }
 
     fn file_types(&self) -> u32 {
-        FILE_TYPE_MD
+        // Requirement documents are read by the SRS index builder
+        0
     }
 
     fn requires_devdoc(&self) -> bool {
         true
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
-        self.tags.clear();
-        self.total_tags = 0;
-        self.duplicate_found = false;
-        self.files_scanned = 0;
+    fn cross_file(&self) -> bool {
+        true
     }
 
-    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig) {
-        if file.type_flags & FILE_TYPE_MD == 0 {
-            return;
-        }
-        if file.type_flags & FILE_FLAG_IN_DEVDOC == 0 {
-            return;
-        }
+    fn uses_srs_index(&self) -> bool {
+        true
+    }
 
-        self.files_scanned += 1;
+    fn needles(&self) -> &'static [Needle] {
+        &[]
+    }
 
-        let content = &file.content;
-        let len = content.len();
-        let mut p = 0usize;
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {}
 
-        while p + 6 < len {
-            // Find '*'
-            let star = match content[p..].iter().position(|&b| b == b'*') {
-                Some(pos) => p + pos,
-                None => break,
-            };
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
 
-            if star + 6 >= len {
-                break;
-            }
+    fn merge(&mut self, _shard: Box<dyn Check>) {
+        // Shards never see any work: all state lives in the SRS index
+    }
+
+    fn check_file(&mut self, _file: &FileInfo, _config: &ValidatorConfig, _report: &mut FileReport) {
+        // No-op: requirement documents are parsed by the SRS index builder
+    }
 
-            if content[star + 1] == b'*'
-                && content[star + 2] == b'S'
-                && content[star + 3] == b'R'
-                && content[star + 4] == b'S'
-                && content[star + 5] == b'_'
-            {
-                let tag_start = star + 2; // 'S' of SRS
-                let mut colon = star + 6; // after "**SRS_"
-
-                // Scan forward for ':' (end of tag)
-                while colon < len
-                    && content[colon] != b':'
-                    && content[colon] != b'\n'
-                    && content[colon] != b'\r'
-                {
-                    if !is_srs_module_char(content[colon]) {
-                        break;
-                    }
-                    colon += 1;
-                }
-
-                if colon >= len || content[colon] != b':' {
-                    p = star + 2;
-                    continue;
-                }
-
-                // Validate tag ends with _DD_DDD
-                let tag_len = colon - tag_start;
-                if tag_len < 11 {
-                    p = star + 2;
-                    continue;
-                }
-
-                let c = content; // alias
-                if !c[colon - 1].is_ascii_digit()
-                    || !c[colon - 2].is_ascii_digit()
-                    || !c[colon - 3].is_ascii_digit()
-                    || c[colon - 4] != b'_'
-                    || !c[colon - 5].is_ascii_digit()
-                    || !c[colon - 6].is_ascii_digit()
-                    || c[colon - 7] != b'_'
-                {
-                    p = star + 2;
-                    continue;
-                }
-
-                if colon - 7 <= star + 6 {
-                    p = star + 2;
-                    continue;
-                }
-
-                if tag_len >= 256 {
-                    p = star + 2;
-                    continue;
-                }
-
-                let tag = match std::str::from_utf8(&content[tag_start..colon]) {
-                    Ok(s) => s.to_string(),
-                    Err(_) => {
-                        p = star + 2;
-                        continue;
-                    }
-                };
-
-                let line = compute_line_number(content, star);
-                self.total_tags += 1;
-
-                if let Some(existing) = self.tags.get(&tag) {
-                    self.duplicate_found = true;
-
-                    let fname1 = extract_filename(&existing.file_path);
-                    let fname2 = extract_filename(&file.path);
-
-                    println!("  [ERROR] Duplicate SRS tag: {}", tag);
-                    println!(
-                        "          First occurrence: {}:{}",
-                        fname1, existing.line_number
-                    );
-                    println!("          Duplicate found in: {}:{}", fname2, line);
-                } else {
-                    self.tags.insert(
-                        tag,
-                        SrsEntry {
-                            file_path: file.path.clone(),
-                            line_number: line,
-                        },
-                    );
-                }
-
-                p = colon + 1;
+    fn version(&self) -> u32 {
+        2
+    }
+
+    fn save_shard(&self, _out: &mut Encoder) {
+        // Nothing to save: check_file is a no-op
+    }
+
+    fn load_shard(&mut self, _input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        out: &mut CheckOutput,
+    ) -> i32 {
+        // Index entries are in walk order, so the "first occurrence" does not
+        // depend on which worker saw which document
+        let mut first_seen: HashMap<&str, MarkdownEntry> = HashMap::new();
+        let mut duplicate_found = false;
+        let mut total_tags = 0usize;
+        for occurrence in srs_index.markdown_entries().filter(|e| e.is_definition) {
+            total_tags += 1;
+            if let Some(existing) = first_seen.get(occurrence.tag) {
+                duplicate_found = true;
+
+                let fname1 = extract_filename(existing.document);
+                let fname2 = extract_filename(occurrence.document);
+
+                out.finding(
+                    Finding::error(format!("Duplicate SRS tag: {}", occurrence.tag))
+                        .in_file(occurrence.document)
+                        .at_line(occurrence.line as usize)
+                        .with_detail(format!("First occurrence: {}:{}", fname1, existing.line))
+                        .with_detail(format!("Duplicate found in: {}:{}", fname2, occurrence.line)),
+                );
             } else {
-                p = star + 1;
+                first_seen.insert(occurrence.tag, occurrence);
             }
         }
-    }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
-        println!();
-        println!("  Requirement documents scanned: {}", self.files_scanned);
-        println!("  Total SRS tags found: {}", self.total_tags);
+        out.line(String::new());
+        out.line(format!("  Requirement documents scanned: {}", srs_index.document_count()));
+        out.line(format!("  Total SRS tags found: {}", total_tags));
 
-        if self.duplicate_found {
+        if duplicate_found {
             1
         } else {
             0
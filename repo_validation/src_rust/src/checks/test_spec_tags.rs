@@ -1,8 +1,16 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-use crate::checks::Check;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::prefilter::Needle;
+use crate::scan;
+use crate::srs_index::SrsIndex;
+
+const TEST_FUNCTION: Needle = Needle::exact(b"TEST_FUNCTION");
 
 pub struct TestSpecTags {
     violations: i32,
@@ -22,116 +30,25 @@ impl TestSpecTags {
     }
 }
 
-struct LineIndex {
-    starts: Vec<usize>,
-    lengths: Vec<usize>,
-}
-
-fn build_line_index(content: &[u8]) -> LineIndex {
-    let len = content.len();
-    let mut starts = Vec::new();
-    let mut lengths = Vec::new();
-    let mut line_start = 0usize;
-
-    for i in 0..=len {
-        if i == len || content[i] == b'\n' {
-            let mut line_len = i - line_start;
-            if line_len > 0 && content[line_start + line_len - 1] == b'\r' {
-                line_len -= 1;
-            }
-            starts.push(line_start);
-            lengths.push(line_len);
-            line_start = i + 1;
-        }
-    }
-
-    LineIndex { starts, lengths }
-}
-
-fn get_line<'a>(content: &'a [u8], index: &LineIndex, i: usize) -> &'a [u8] {
-    &content[index.starts[i]..index.starts[i] + index.lengths[i]]
-}
-
-/// Check if line starts with TEST_FUNCTION( or PARAMETERIZED_TEST_FUNCTION(
-/// Returns: 0 = not a test function, 1 = TEST_FUNCTION, 2 = PARAMETERIZED_TEST_FUNCTION
-fn is_test_function_line(line: &[u8]) -> u8 {
-    let len = line.len();
-    let mut p = 0;
-    while p < len && (line[p] == b' ' || line[p] == b'\t') {
-        p += 1;
-    }
-
-    if len - p >= 28
-        && &line[p..p + 27] == b"PARAMETERIZED_TEST_FUNCTION"
-        && (line[p + 27] == b'(' || line[p + 27] == b' ' || line[p + 27] == b'\t')
-    {
-        2
-    } else if len - p >= 14
-        && &line[p..p + 13] == b"TEST_FUNCTION"
-        && (line[p + 13] == b'(' || line[p + 13] == b' ' || line[p + 13] == b'\t')
-    {
-        1
-    } else {
-        0
-    }
-}
-
-/// Extract test function name from TEST_FUNCTION(name) or PARAMETERIZED_TEST_FUNCTION(name, ...) line
-/// For PARAMETERIZED_TEST_FUNCTION, extract up to the first comma (not closing paren)
-fn extract_test_name(line: &[u8], macro_type: u8) -> String {
-    let open = match line.iter().position(|&b| b == b'(') {
-        Some(p) => p + 1,
-        None => return String::new(),
-    };
-
-    let end_delim = if macro_type == 2 {
-        // PARAMETERIZED_TEST_FUNCTION: name ends at first comma
-        line[open..]
-            .iter()
-            .position(|&b| b == b',')
-            .map(|p| open + p)
-            .or_else(|| {
-                line[open..]
-                    .iter()
-                    .position(|&b| b == b')')
-                    .map(|p| open + p)
-            })
-    } else {
-        line[open..]
-            .iter()
-            .position(|&b| b == b')')
-            .map(|p| open + p)
-    };
-
-    let close = match end_delim {
-        Some(p) => p,
-        None => return String::new(),
-    };
-
-    let mut start = open;
-    let mut end = close;
-    while start < end && (line[start] == b' ' || line[start] == b'\t') {
-        start += 1;
-    }
-    while end > start && (line[end - 1] == b' ' || line[end - 1] == b'\t') {
-        end -= 1;
-    }
-
-    String::from_utf8_lossy(&line[start..end]).to_string()
-}
-
-/// Check if line contains "// no-srs" or "/* no-srs */" (case-insensitive)
+/// Check if a comment is "// no-srs" or "/* no-srs */" (case-insensitive)
 fn has_no_srs_exemption(line: &[u8]) -> bool {
     let len = line.len();
     if len < 6 {
         return false;
     }
 
-    for i in 0..len.saturating_sub(5) {
+    // Anchor on the '-' of "no-srs"
+    for dash in scan::memchr_iter(b'-', line) {
+        if dash < 2 {
+            continue;
+        }
+        if dash + 4 > len {
+            break;
+        }
+        let i = dash - 2;
         let ci = |idx: usize, lower: u8, upper: u8| line[idx] == lower || line[idx] == upper;
         if ci(i, b'n', b'N')
             && ci(i + 1, b'o', b'O')
-            && line[i + 2] == b'-'
             && ci(i + 3, b's', b'S')
             && ci(i + 4, b'r', b'R')
             && ci(i + 5, b's', b'S')
@@ -163,16 +80,18 @@ fn has_no_srs_exemption(line: &[u8]) -> bool {
     false
 }
 
-/// Check if line contains a Tests_ spec tag: Tests_<something>_DD_DDD
+/// Check if a comment contains a Tests_ spec tag: Tests_<something>_DD_DDD
 fn has_tests_spec_tag(line: &[u8]) -> bool {
     let len = line.len();
     if len < 7 {
         return false;
     }
 
-    for i in 0..len.saturating_sub(6) {
-        if line[i] == b'T'
-            && line[i + 1] == b'e'
+    for i in scan::memchr_iter(b'T', line) {
+        if i + 7 > len {
+            break;
+        }
+        if line[i + 1] == b'e'
             && line[i + 2] == b's'
             && line[i + 3] == b't'
             && line[i + 4] == b's'
@@ -207,42 +126,6 @@ fn has_tests_spec_tag(line: &[u8]) -> bool {
     false
 }
 
-fn is_blank_line(line: &[u8]) -> bool {
-    line.iter().all(|&b| b == b' ' || b == b'\t')
-}
-
-/// Check if line looks like it's part of a comment
-fn is_comment_line(line: &[u8]) -> bool {
-    let len = line.len();
-    let mut p = 0;
-    while p < len && (line[p] == b' ' || line[p] == b'\t') {
-        p += 1;
-    }
-    if p >= len {
-        return true; // blank = continue searching
-    }
-    if p + 1 < len && line[p] == b'/' && line[p + 1] == b'*' {
-        return true;
-    }
-    if line[p] == b'*' {
-        return true;
-    }
-    if p + 1 < len && line[p] == b'/' && line[p + 1] == b'/' {
-        return true;
-    }
-
-    // Check if line ends with */
-    let mut q = len;
-    while q > p && (line[q - 1] == b' ' || line[q - 1] == b'\t') {
-        q -= 1;
-    }
-    if q - p >= 2 && line[q - 2] == b'*' && line[q - 1] == b'/' {
-        return true;
-    }
-
-    false
-}
-
 impl Check for TestSpecTags {
     fn name(&self) -> &str {
         "test_spec_tags"
@@ -260,14 +143,38 @@ impl Check for TestSpecTags {
         false
     }
 
-    fn init(&mut self, _config: &ValidatorConfig) {
+    fn cross_file(&self) -> bool {
+        false
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[TEST_FUNCTION]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
         self.violations = 0;
         self.total_test_functions = 0;
         self.tests_with_tags = 0;
         self.exempted_tests = 0;
     }
 
-    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig) {
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        self.violations += shard.violations;
+        self.total_test_functions += shard.total_test_functions;
+        self.tests_with_tags += shard.tests_with_tags;
+        self.exempted_tests += shard.exempted_tests;
+    }
+
+    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig, report: &mut FileReport) {
         if file.type_flags & FILE_TYPE_C == 0 {
             return;
         }
@@ -285,94 +192,80 @@ impl Check for TestSpecTags {
             return;
         }
 
-        let index = build_line_index(&file.content);
-        let line_count = index.starts.len();
-
-        for i in 0..line_count {
-            let line = get_line(&file.content, &index, i);
-
-            let macro_type = is_test_function_line(line);
-
-            if macro_type != 0 {
-                self.total_test_functions += 1;
-
-                if has_no_srs_exemption(line) {
-                    self.exempted_tests += 1;
-                    self.tests_with_tags += 1;
-                } else {
-                    // Search backwards for Tests_ spec tag
-                    let mut found_tag = false;
-                    let mut search_idx = i as i32 - 1;
-                    let mut in_multiline_comment = false;
-
-                    while search_idx >= 0 {
-                        let prev = get_line(&file.content, &index, search_idx as usize);
-
-                        if has_tests_spec_tag(prev) {
-                            found_tag = true;
-                        }
-
-                        if is_blank_line(prev) {
-                            search_idx -= 1;
-                        } else {
-                            // Track multi-line comment state (searching backwards)
-                            let mut has_start = false;
-                            let mut has_end = false;
-                            let prev_len = prev.len();
-                            for k in 0..prev_len.saturating_sub(1) {
-                                if prev[k] == b'/' && prev[k + 1] == b'*' {
-                                    has_start = true;
-                                }
-                                if prev[k] == b'*' && prev[k + 1] == b'/' {
-                                    has_end = true;
-                                }
-                            }
-
-                            if has_start && has_end {
-                                // Single-line block comment
-                            } else if has_start {
-                                in_multiline_comment = false;
-                            } else if has_end {
-                                in_multiline_comment = true;
-                            }
-
-                            if in_multiline_comment || is_comment_line(prev) {
-                                search_idx -= 1;
-                            } else {
-                                break;
-                            }
-                        }
-                    }
+        let content = &file.content;
+        let source = file.tokens();
+        let index = file.lines();
 
-                    if found_tag {
-                        self.tests_with_tags += 1;
-                    } else {
-                        let macro_name = if macro_type == 2 {
-                            "PARAMETERIZED_TEST_FUNCTION"
-                        } else {
-                            "TEST_FUNCTION"
-                        };
-                        let test_name = extract_test_name(line, macro_type);
-                        println!(
-                            "  [ERROR] {}:{} {}({}) - missing spec tag",
-                            file.relative_path,
-                            i + 1,
-                            macro_name,
-                            test_name
-                        );
-                        self.violations += 1;
-                    }
-                }
+        for test in source.test_functions() {
+            if test.kind != "TEST_FUNCTION" && test.kind != "PARAMETERIZED_TEST_FUNCTION" {
+                continue;
+            }
+            self.total_test_functions += 1;
+
+            // Exemption: a comment on the macro's line
+            let macro_start = source.tokens()[test.declaration.start].start;
+            let line = index.line_of(macro_start);
+            let line_comments = source.first_at(macro_start)..source.first_at(index.end(line));
+            if source.comments(line_comments).any(|comment| has_no_srs_exemption(comment.text(content))) {
+                self.exempted_tests += 1;
+                self.tests_with_tags += 1;
+                continue;
+            }
+
+            // The spec tag goes in the comment block right above the test
+            if source
+                .comments(test.comments.clone())
+                .any(|comment| has_tests_spec_tag(comment.text(content)))
+            {
+                self.tests_with_tags += 1;
+            } else {
+                report.finding(
+                    Finding::error(format!(
+                        "{}:{} {}({}) - missing spec tag",
+                        file.relative_path,
+                        line + 1,
+                        test.kind,
+                        test.name_text(content)
+                    ))
+                    .in_file(&file.relative_path)
+                    .at_line(line + 1),
+                );
+                self.violations += 1;
             }
         }
     }
 
-    fn finalize(&mut self, _config: &ValidatorConfig) -> i32 {
-        println!();
-        println!(
+    fn version(&self) -> u32 {
+        2
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.i32(self.violations);
+        out.i32(self.total_test_functions);
+        out.i32(self.tests_with_tags);
+        out.i32(self.exempted_tests);
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, _file: &FileTask) -> Option<()> {
+        self.violations = input.i32()?;
+        self.total_test_functions = input.i32()?;
+        self.tests_with_tags = input.i32()?;
+        self.exempted_tests = input.i32()?;
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        out: &mut CheckOutput,
+    ) -> i32 {
+        out.line(String::new());
+        out.line(format!(
             "  Unit test files: TEST_FUNCTION declarations: {}, with tags: {}, exempted: {}, missing: {}",
             self.total_test_functions, self.tests_with_tags, self.exempted_tests, self.violations
-        );
+        ));
         self.violations
     }
 }
@@ -1,6 +1,17 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+use std::cell::OnceCell;
+use std::collections::HashSet;
+
+use crate::c_lexer::{Language, SourceTokens};
+use crate::changed_files::StagedFiles;
+use crate::exclusions::Exclusions;
+use crate::fixes::{Edit, Fix};
+use crate::line_index::{LineIndex, LineTable};
+use crate::memory::FileContent;
+use crate::prefilter::MatchTable;
+
 /// File type classification bitmask
 pub const FILE_TYPE_C: u32 = 0x0001;
 pub const FILE_TYPE_H: u32 = 0x0002;
@@ -9,6 +20,7 @@ pub const FILE_TYPE_HPP: u32 = 0x0008;
 pub const FILE_TYPE_CS: u32 = 0x0010;
 pub const FILE_TYPE_MD: u32 = 0x0020;
 pub const FILE_TYPE_TXT: u32 = 0x0040;
+pub const FILE_TYPE_YML: u32 = 0x0080;
 
 /// File location flags
 pub const FILE_FLAG_IN_DEVDOC: u32 = 0x0100;
@@ -18,13 +30,209 @@ pub struct FileInfo {
     pub path: String,
     pub relative_path: String,
     pub type_flags: u32,
-    pub content: Vec<u8>,
+    /// Read into memory or, under --max-memory, mapped when large
+    pub content: FileContent,
+    /// Position of the file in walk order. Cross-file checks use it to report
+    /// results in the same order no matter which worker thread saw the file.
+    pub ordinal: usize,
+    /// Occurrences of the needles declared by the active checks (see Check::needles)
+    pub matches: MatchTable,
+    /// Built on first use by FileInfo::lines
+    pub line_table: OnceCell<LineTable>,
+    /// Built on first use by FileInfo::tokens
+    pub tokens: OnceCell<SourceTokens>,
+}
+
+impl FileInfo {
+    /// Line table of the content, shared by all checks that run on this file
+    pub fn lines(&self) -> LineIndex<'_> {
+        LineIndex::new(self.line_table.get_or_init(|| LineTable::new(&self.content)), &self.content)
+    }
+
+    /// Tokens and test table of a C or C# file, shared by all checks that run on this file
+    pub fn tokens(&self) -> &SourceTokens {
+        self.tokens.get_or_init(|| {
+            let language = if self.type_flags & FILE_TYPE_CS != 0 { Language::CSharp } else { Language::C };
+            SourceTokens::new(&self.content, language)
+        })
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum Severity {
+    /// Printed as [ERROR]: the check fails
+    Error,
+    /// Printed as [WARN]: reported, but the check still passes
+    Warning,
+}
+
+/// A problem found by a check. Reports print it as "[ERROR] <message>" (or
+/// [WARN]), followed by each detail on a line of its own, aligned with the message.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct Finding {
+    pub severity: Severity,
+    /// The file it is about, relative to the repository root
+    pub path: Option<String>,
+    /// 1-based line of that file it points at
+    pub line: Option<usize>,
+    /// What is wrong, as printed after the severity tag
+    pub message: String,
+    /// Lines printed under the message (for example the other file of a duplicate)
+    pub details: Vec<String>,
+}
+
+impl Finding {
+    pub fn error(message: String) -> Self {
+        Self::new(Severity::Error, message)
+    }
+
+    pub fn warning(message: String) -> Self {
+        Self::new(Severity::Warning, message)
+    }
+
+    fn new(severity: Severity, message: String) -> Self {
+        Self {
+            severity,
+            path: None,
+            line: None,
+            message,
+            details: Vec::new(),
+        }
+    }
+
+    pub fn in_file(mut self, relative_path: &str) -> Self {
+        self.path = Some(relative_path.to_string());
+        self
+    }
+
+    pub fn at_line(mut self, line: usize) -> Self {
+        self.line = Some(line);
+        self
+    }
+
+    pub fn with_detail(mut self, text: String) -> Self {
+        self.details.push(text);
+        self
+    }
+
+    /// The finding as reports print it, indented by `indent` spaces
+    pub fn render(&self, indent: usize) -> String {
+        let tag = match self.severity {
+            Severity::Error => "[ERROR]",
+            Severity::Warning => "[WARN]",
+        };
+        let mut text = format!("{:indent$}{} {}", "", tag, self.message, indent = indent);
+        for detail in &self.details {
+            text.push_str(&format!("\n{:indent$}{}", "", detail, indent = indent + tag.len() + 1));
+        }
+        text
+    }
+}
+
+/// Output produced by the checks for a single file.
+/// Messages are printed by the walker in file order, so a parallel run
+/// prints exactly what a sequential run would.
+#[derive(Default)]
+pub struct FileReport {
+    pub messages: Vec<String>,
+    /// The findings among the messages, for the library API
+    pub findings: Vec<Finding>,
+    /// Fixes proposed in --fix mode, in check order (see crate::fixes)
+    pub fixes: Vec<Fix>,
+}
+
+impl FileReport {
+    /// Print `text`, which is not a finding (for example a file that passed)
+    pub fn message(&mut self, text: String) {
+        self.messages.push(text);
+    }
+
+    pub fn finding(&mut self, finding: Finding) {
+        self.messages.push(finding.render(2));
+        self.findings.push(finding);
+    }
+
+    /// Propose a fix made of `edits` to FileInfo::content and announce it with `text`.
+    /// The walker replaces `text` with an error if the fix conflicts with an earlier one.
+    pub fn fix(&mut self, text: String, edits: Vec<Edit>) {
+        self.fixes.push(Fix {
+            message: self.messages.len(),
+            edits,
+            rename_to: None,
+        });
+        self.messages.push(text);
+    }
+
+    /// Propose renaming the file to `new_path`, announced with `text`
+    pub fn rename(&mut self, text: String, new_path: String) {
+        self.fixes.push(Fix {
+            message: self.messages.len(),
+            edits: Vec::new(),
+            rename_to: Some(new_path),
+        });
+        self.messages.push(text);
+    }
+}
+
+/// Output of a check's init() and finalize(): statistics, and the findings that
+/// need every file's results. The binary prints the lines where the check
+/// produced them; the library API returns the findings.
+#[derive(Default)]
+pub struct CheckOutput {
+    pub lines: Vec<String>,
+    pub findings: Vec<Finding>,
+}
+
+impl CheckOutput {
+    pub fn line(&mut self, text: String) {
+        self.lines.push(text);
+    }
+
+    pub fn finding(&mut self, finding: Finding) {
+        self.lines.push(finding.render(2));
+        self.findings.push(finding);
+    }
+
+    /// A finding listed under a heading line, one level deeper
+    pub fn nested_finding(&mut self, finding: Finding) {
+        self.lines.push(finding.render(4));
+        self.findings.push(finding);
+    }
 }
 
 pub struct ValidatorConfig {
     pub repo_root: String,
-    pub exclude_folders: Vec<String>,
+    /// Excluded folders (--exclude-folders) and whether .gitignore is honored (--gitignore)
+    pub exclusions: Exclusions,
     pub fix_mode: bool,
     /// Optional override for the c-build-tools submodule SHA (used for testing)
     pub submodule_sha: Option<String>,
+    /// Number of worker threads used to run checks (1 = run on the calling thread)
+    pub jobs: usize,
+    /// Result cache file (--cache); None when caching is off
+    pub cache_path: Option<String>,
+    /// Incremental mode (--changed-since, --paths-from, --staged): normalized relative
+    /// paths of the changed files. Only cross-file checks look at files outside this set.
+    pub changed_paths: Option<HashSet<String>>,
+    /// Write the SRS tag index to this file after the walk (--srs-index-out)
+    pub srs_index_out: Option<String>,
+    /// Print per-check timings after the summary (--timings)
+    pub timings: bool,
+    /// Write a Chrome trace of the run to this file (--trace-out)
+    pub trace_out: Option<String>,
+    /// One of the repositories of a --workspace run, sharing its result cache
+    pub workspace: bool,
+    /// --staged: the index content of the staged files, checked instead of the
+    /// working tree copies
+    pub staged: Option<StagedFiles>,
+    /// Read files ahead in batches through io_uring when the walk has several
+    /// workers and no result cache (--batched-reads)
+    pub batched_reads: bool,
+    /// Bytes of file content the walk may hold in memory at once (--max-memory),
+    /// large files being mapped instead of read (see crate::memory). None: no limit.
+    pub max_memory: Option<u64>,
+    /// Under max_memory, map large files instead of reading them. Off with --watch:
+    /// the files of a long run get edited, and reading a mapped file that another
+    /// process truncates raises SIGBUS.
+    pub map_files: bool,
 }
@@ -0,0 +1,378 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Directory enumeration for the walker (Linux on x86_64, aarch64 and riscv64,
+//! whose open flags and syscall numbers are below; other targets walk with
+//! fs::read_dir).
+//!
+//! Each directory is opened with openat relative to its parent's descriptor, so
+//! the kernel never resolves a full path again, and read with getdents64 into a
+//! buffer each thread reuses. Entries are classified by the type the kernel
+//! reports: only file systems that do not report one cost a stat.
+//!
+//! Directories are read ahead by reader threads while the calling thread visits
+//! the files. The visit order is the depth-first order of a sequential walk, so
+//! file ordinals and the report do not depend on the number of readers: readers
+//! always take the pending directory that comes first in that order, and at most
+//! DIRS_AHEAD directories are read before the visitor gets to them. When the
+//! visitor needs a directory nobody has started, it reads it itself; with no
+//! readers it reads every directory itself.
+//!
+//! A directory that cannot be opened is skipped, and one whose entries cannot be
+//! read is listed up to the error, as the fs::read_dir walk does.
+
+use std::collections::{BTreeMap, HashMap};
+use std::ffi::{CStr, CString};
+use std::fs;
+use std::io;
+use std::os::raw::{c_char, c_int, c_long};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread;
+
+use crate::exclusions::{DirScope, WalkFilter};
+
+/// Directories read or being read that the visitor has not reached yet
+const DIRS_AHEAD: usize = 256;
+
+const AT_FDCWD: c_int = -100;
+const O_RDONLY: c_int = 0;
+const O_CLOEXEC: c_int = 0o2000000;
+// The generic value is O_DIRECT on arm64
+#[cfg(any(target_arch = "x86_64", target_arch = "riscv64"))]
+const O_DIRECTORY: c_int = 0o200000;
+#[cfg(target_arch = "aarch64")]
+const O_DIRECTORY: c_int = 0o40000;
+
+const DT_UNKNOWN: u8 = 0;
+const DT_DIR: u8 = 4;
+const DT_REG: u8 = 8;
+
+#[cfg(target_arch = "x86_64")]
+const SYS_GETDENTS64: c_long = 217;
+#[cfg(any(target_arch = "aarch64", target_arch = "riscv64"))]
+const SYS_GETDENTS64: c_long = 61;
+
+/// Bytes of entries fetched per getdents64 call
+const DIRENT_BUFFER: usize = 32 * 1024;
+
+/// Offsets in struct linux_dirent64 (d_ino, d_off, d_reclen, d_type, d_name)
+const DIRENT_RECLEN: usize = 16;
+const DIRENT_TYPE: usize = 18;
+const DIRENT_NAME: usize = 19;
+
+extern "C" {
+    fn syscall(number: c_long, ...) -> c_long;
+    fn openat(dirfd: c_int, pathname: *const c_char, flags: c_int, ...) -> c_int;
+    fn close(fd: c_int) -> c_int;
+}
+
+/// An open directory whose subdirectories are still to be opened
+struct DirHandle {
+    fd: c_int,
+}
+
+impl Drop for DirHandle {
+    fn drop(&mut self) {
+        if self.fd != AT_FDCWD {
+            unsafe { close(self.fd) };
+        }
+    }
+}
+
+/// Position of a directory in the depth-first order: the index of each directory
+/// on the way down among the entries of its parent
+type Key = Vec<u32>;
+
+/// A directory to read
+struct DirJob {
+    parent: Arc<DirHandle>,
+    name: CString,
+    /// Relative path of the directory ("" for the root)
+    relative: String,
+    scope: DirScope,
+}
+
+enum Entry {
+    /// A file, by its range in Listing::names
+    File(usize, usize),
+    Dir(Key),
+}
+
+/// The entries of a directory the walk visits, in directory order
+#[derive(Default)]
+struct Listing {
+    relative: String,
+    names: String,
+    entries: Vec<Entry>,
+}
+
+struct State {
+    pending: BTreeMap<Key, DirJob>,
+    read: HashMap<Key, Listing>,
+    /// Directories taken by a reader, or read, and not yet visited
+    ahead: usize,
+    /// The visitor is done: readers exit
+    finished: bool,
+}
+
+struct Shared<'a> {
+    repo_root: &'a str,
+    readers: usize,
+    filter: &'a WalkFilter<'a>,
+    state: Mutex<State>,
+    /// Signalled to readers when a directory becomes pending or the visitor catches up
+    work: Condvar,
+    /// Signalled to the visitor when a reader has read a directory
+    listed: Condvar,
+}
+
+/// Stops the readers however the visitor leaves
+struct Finish<'a, 'b>(&'a Shared<'b>);
+
+impl Drop for Finish<'_, '_> {
+    fn drop(&mut self) {
+        self.0.state.lock().unwrap().finished = true;
+        self.0.work.notify_all();
+    }
+}
+
+/// Visit (full path, relative path) of every file under `repo_root` that `filter`
+/// includes, in depth-first order, reading directories ahead on `readers` threads
+pub fn walk(repo_root: &str, filter: &WalkFilter, readers: usize, visit: &mut dyn FnMut(&str, &str)) {
+    let name = match CString::new(repo_root) {
+        Ok(name) if !repo_root.is_empty() => name,
+        _ => return,
+    };
+    let root_key: Key = Vec::new();
+    let mut pending = BTreeMap::new();
+    pending.insert(
+        root_key.clone(),
+        DirJob {
+            parent: Arc::new(DirHandle { fd: AT_FDCWD }),
+            name,
+            relative: String::new(),
+            scope: filter.root(),
+        },
+    );
+    let shared = Shared {
+        repo_root,
+        readers,
+        filter,
+        state: Mutex::new(State {
+            pending,
+            read: HashMap::new(),
+            ahead: 0,
+            finished: false,
+        }),
+        work: Condvar::new(),
+        listed: Condvar::new(),
+    };
+
+    thread::scope(|scope| {
+        let shared = &shared;
+        for _ in 0..readers {
+            scope.spawn(move || read_ahead(shared));
+        }
+        let _finish = Finish(shared);
+        visit_tree(shared, root_key, visit);
+    });
+}
+
+fn read_ahead(shared: &Shared) {
+    let mut buffer = vec![0u8; DIRENT_BUFFER];
+    loop {
+        let (key, job) = {
+            let mut state = shared.state.lock().unwrap();
+            loop {
+                if state.finished {
+                    return;
+                }
+                if state.ahead < DIRS_AHEAD {
+                    if let Some(first) = state.pending.pop_first() {
+                        state.ahead += 1;
+                        break first;
+                    }
+                }
+                state = shared.work.wait(state).unwrap();
+            }
+        };
+        let (listing, children) = read_dir(shared, &key, job, &mut buffer);
+        let found = children.len();
+        let mut state = shared.state.lock().unwrap();
+        state.pending.extend(children);
+        state.read.insert(key, listing);
+        drop(state);
+        shared.listed.notify_one();
+        wake_readers(shared, found);
+    }
+}
+
+fn wake_readers(shared: &Shared, pending: usize) {
+    for _ in 0..pending.min(shared.readers) {
+        shared.work.notify_one();
+    }
+}
+
+/// The listing of the directory at `key`: read by a reader, or by the caller when
+/// no reader has taken it yet
+fn take_listing(shared: &Shared, key: &Key, buffer: &mut [u8]) -> Listing {
+    let mut state = shared.state.lock().unwrap();
+    loop {
+        if let Some(listing) = state.read.remove(key) {
+            let was_full = state.ahead == DIRS_AHEAD;
+            state.ahead -= 1;
+            drop(state);
+            if was_full {
+                wake_readers(shared, 1);
+            }
+            return listing;
+        }
+        if let Some(job) = state.pending.remove(key) {
+            drop(state);
+            let (listing, children) = read_dir(shared, key, job, buffer);
+            let found = children.len();
+            shared.state.lock().unwrap().pending.extend(children);
+            wake_readers(shared, found);
+            return listing;
+        }
+        // A reader is on it
+        state = shared.listed.wait(state).unwrap();
+    }
+}
+
+/// Visit the files of the tree at `root` depth-first, building each path in one buffer
+fn visit_tree(shared: &Shared, root: Key, visit: &mut dyn FnMut(&str, &str)) {
+    let mut full_path = format!("{}/", shared.repo_root);
+    let root_len = full_path.len();
+    let mut buffer = vec![0u8; DIRENT_BUFFER];
+
+    // Each level: its listing and the next entry to visit
+    let mut stack: Vec<(Listing, usize)> = vec![(take_listing(shared, &root, &mut buffer), 0)];
+    let mut dir_len = set_dir(&mut full_path, root_len, &stack[0].0.relative);
+    while let Some((listing, next)) = stack.last_mut() {
+        let Some(entry) = listing.entries.get(*next) else {
+            stack.pop();
+            if let Some((parent, _)) = stack.last() {
+                dir_len = set_dir(&mut full_path, root_len, &parent.relative);
+            }
+            continue;
+        };
+        *next += 1;
+        match entry {
+            Entry::File(start, end) => {
+                full_path.truncate(dir_len);
+                full_path.push_str(&listing.names[*start..*end]);
+                visit(&full_path, &full_path[root_len..]);
+            }
+            Entry::Dir(key) => {
+                let child = take_listing(shared, key, &mut buffer);
+                dir_len = set_dir(&mut full_path, root_len, &child.relative);
+                stack.push((child, 0));
+            }
+        }
+    }
+}
+
+/// Put the directory at `relative` into the path buffer; returns where its entries' names go
+fn set_dir(full_path: &mut String, root_len: usize, relative: &str) -> usize {
+    full_path.truncate(root_len);
+    if !relative.is_empty() {
+        full_path.push_str(relative);
+        full_path.push('/');
+    }
+    full_path.len()
+}
+
+/// Read one directory: the files the walk visits, and the subdirectories it enters
+/// as jobs keyed below `key`. A directory that cannot be opened is skipped.
+fn read_dir(shared: &Shared, key: &Key, job: DirJob, buffer: &mut [u8]) -> (Listing, Vec<(Key, DirJob)>) {
+    let relative = job.relative.clone();
+    let mut listing = Listing::default();
+    let mut children = Vec::new();
+    // Like fs::read_dir errors in the walk of other targets: an unreadable
+    // directory (e.g., permission errors) keeps the entries read before the error
+    let _ = list_dir(shared, key, job, buffer, &mut listing, &mut children);
+    listing.relative = relative;
+    (listing, children)
+}
+
+/// Add the entries of the directory of `job` to `listing` and `children`, up to
+/// the first error
+fn list_dir(
+    shared: &Shared,
+    key: &Key,
+    job: DirJob,
+    buffer: &mut [u8],
+    listing: &mut Listing,
+    children: &mut Vec<(Key, DirJob)>,
+) -> io::Result<()> {
+    let fd = unsafe { openat(job.parent.fd, job.name.as_ptr(), O_RDONLY | O_DIRECTORY | O_CLOEXEC) };
+    // The parent stays open until its last subdirectory is opened
+    drop(job.parent);
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    let handle = Arc::new(DirHandle { fd });
+
+    // Relative path of each entry, built on the directory's own
+    let mut relative = job.relative;
+    if !relative.is_empty() {
+        relative.push('/');
+    }
+    let base_len = relative.len();
+    let mut index = 0u32;
+    loop {
+        let filled = unsafe { syscall(SYS_GETDENTS64, fd, buffer.as_mut_ptr(), buffer.len()) };
+        if filled < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        if filled == 0 {
+            return Ok(());
+        }
+        let mut offset = 0usize;
+        while offset < filled as usize {
+            let record = &buffer[offset..];
+            offset += u16::from_ne_bytes([record[DIRENT_RECLEN], record[DIRENT_RECLEN + 1]]) as usize;
+            let name_bytes = CStr::from_bytes_until_nul(&record[DIRENT_NAME..]).map(CStr::to_bytes).unwrap_or_default();
+            // Hidden entries, "." and ".." included
+            if name_bytes.is_empty() || name_bytes[0] == b'.' {
+                continue;
+            }
+            let name = String::from_utf8_lossy(name_bytes);
+            relative.truncate(base_len);
+            relative.push_str(&name);
+
+            // Symbolic links are neither files nor directories to the walk
+            let file_type = match record[DIRENT_TYPE] {
+                DT_UNKNOWN => match fs::symlink_metadata(format!("{}/{}", shared.repo_root, relative)) {
+                    Ok(meta) if meta.is_dir() => DT_DIR,
+                    Ok(meta) if meta.is_file() => DT_REG,
+                    _ => continue,
+                },
+                file_type => file_type,
+            };
+            if file_type == DT_DIR {
+                let full_path = format!("{}/{}", shared.repo_root, relative);
+                if let Some(scope) = shared.filter.enter_dir(&job.scope, &name, &relative, full_path.as_ref()) {
+                    let mut child_key = key.clone();
+                    child_key.push(index);
+                    index += 1;
+                    listing.entries.push(Entry::Dir(child_key.clone()));
+                    children.push((
+                        child_key,
+                        DirJob {
+                            parent: Arc::clone(&handle),
+                            name: CString::new(name_bytes).expect("directory entry names have no NUL"),
+                            relative: relative.clone(),
+                            scope,
+                        },
+                    ));
+                }
+            } else if file_type == DT_REG && shared.filter.includes_file(&job.scope, &name, &relative) {
+                let start = listing.names.len();
+                listing.names.push_str(&name);
+                listing.entries.push(Entry::File(start, listing.names.len()));
+            }
+        }
+    }
+}
@@ -0,0 +1,393 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Compiled path exclusions for the walkers.
+//!
+//! The excluded folders are compiled once into a trie of path components. A walker
+//! carries the trie node of the directory it is in (a DirScope), so deciding on an
+//! entry costs at most one lookup, however many folders are excluded.
+//!
+//! With --gitignore, .git/info/exclude and the .gitignore files of the directories on
+//! the way down are honored as well: an ignored directory is pruned without being
+//! read. Only the pattern syntax of gitignore(5) is implemented; the index is not
+//! consulted, so a tracked file that matches an ignore pattern is skipped too.
+//!
+//! A DirScope shares the ignore files of its parents instead of borrowing the
+//! walker's state, so the directories of a tree can be read on several threads.
+
+use std::borrow::Cow;
+use std::collections::HashMap;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+
+/// Folders every run skips, whatever --exclude-folders adds
+pub const DEFAULT_EXCLUDED_FOLDERS: [&str; 2] = ["deps", "cmake"];
+
+#[derive(Default)]
+struct TrieNode {
+    children: HashMap<String, usize>,
+    /// An excluded folder ends at this node
+    excluded: bool,
+}
+
+pub struct Exclusions {
+    /// The folders as given, for display
+    folders: Vec<String>,
+    /// Trie of the folder components; node 0 is the repository root
+    nodes: Vec<TrieNode>,
+    /// Honor .gitignore and .git/info/exclude (--gitignore)
+    gitignore: bool,
+}
+
+fn components(path: &str) -> impl Iterator<Item = &str> {
+    path.split(['/', '\\']).filter(|c| !c.is_empty() && *c != ".")
+}
+
+impl Exclusions {
+    pub fn new(folders: Vec<String>, gitignore: bool) -> Self {
+        let mut nodes = vec![TrieNode::default()];
+        for folder in &folders {
+            let mut node = 0;
+            let mut depth = 0;
+            for component in components(folder) {
+                node = match nodes[node].children.get(component) {
+                    Some(&child) => child,
+                    None => {
+                        nodes.push(TrieNode::default());
+                        let child = nodes.len() - 1;
+                        nodes[node].children.insert(component.to_string(), child);
+                        child
+                    }
+                };
+                depth += 1;
+            }
+            // An empty folder would exclude the whole tree
+            if depth > 0 {
+                nodes[node].excluded = true;
+            }
+        }
+        Self { folders, nodes, gitignore }
+    }
+
+    pub fn folders(&self) -> &[String] {
+        &self.folders
+    }
+
+    pub fn gitignore(&self) -> bool {
+        self.gitignore
+    }
+
+    /// True when `relative_path` is an excluded folder or lies below one. Does not
+    /// look at .gitignore files; walkers use WalkFilter instead.
+    pub fn is_excluded(&self, relative_path: &str) -> bool {
+        let mut node = 0;
+        for component in components(relative_path) {
+            match self.nodes[node].children.get(component) {
+                Some(&child) if self.nodes[child].excluded => return true,
+                Some(&child) => node = child,
+                None => return false,
+            }
+        }
+        false
+    }
+
+    /// Node of the entry `name` of the directory at `node`: Err(()) when the entry
+    /// is excluded, Ok(None) once the path has left the trie
+    fn step(&self, node: Option<usize>, name: &str) -> Result<Option<usize>, ()> {
+        let child = match node {
+            Some(node) => self.nodes[node].children.get(name).copied(),
+            None => return Ok(None),
+        };
+        match child {
+            Some(child) if self.nodes[child].excluded => Err(()),
+            child => Ok(child),
+        }
+    }
+}
+
+/// One line of a .gitignore file
+struct IgnoreRule {
+    pattern: Vec<u8>,
+    negated: bool,
+    /// Trailing slash: only matches directories
+    dir_only: bool,
+    /// The pattern contains a slash: it matches the path relative to the
+    /// .gitignore directory instead of the name
+    anchored: bool,
+}
+
+impl IgnoreRule {
+    fn parse(line: &str) -> Option<IgnoreRule> {
+        let line = line.trim_end_matches(['\r', '\n']);
+        // Trailing spaces are ignored unless escaped
+        let bytes = line.as_bytes();
+        let mut end = bytes.len();
+        while end > 0 && bytes[end - 1] == b' ' && !(end >= 2 && bytes[end - 2] == b'\\') {
+            end -= 1;
+        }
+        let line = &line[..end];
+        if line.is_empty() || line.starts_with('#') {
+            return None;
+        }
+        let (negated, line) = match line.strip_prefix('!') {
+            Some(rest) => (true, rest),
+            None => (false, line),
+        };
+        let line = line.strip_prefix('\\').filter(|rest| rest.starts_with(['#', '!'])).unwrap_or(line);
+        let (dir_only, line) = match line.strip_suffix('/') {
+            Some(rest) => (true, rest),
+            None => (false, line),
+        };
+        let anchored = line.contains('/');
+        let line = line.strip_prefix('/').unwrap_or(line);
+        if line.is_empty() {
+            return None;
+        }
+        Some(IgnoreRule {
+            pattern: line.as_bytes().to_vec(),
+            negated,
+            dir_only,
+            anchored,
+        })
+    }
+}
+
+/// The rules of one .gitignore file (or of .git/info/exclude)
+struct IgnoreFile {
+    /// Relative path of the directory the file applies to ("" for the root)
+    base: String,
+    rules: Vec<IgnoreRule>,
+}
+
+fn read_ignore_file(path: &Path, base: &str) -> Option<IgnoreFile> {
+    let content = fs::read_to_string(path).ok()?;
+    let rules: Vec<IgnoreRule> = content.lines().filter_map(IgnoreRule::parse).collect();
+    if rules.is_empty() {
+        return None;
+    }
+    Some(IgnoreFile {
+        base: base.to_string(),
+        rules,
+    })
+}
+
+/// The git directory of the repository: .git, or where a .git file points
+fn git_dir(repo_root: &str) -> Option<PathBuf> {
+    let dot_git = Path::new(repo_root).join(".git");
+    if dot_git.is_dir() {
+        return Some(dot_git);
+    }
+    let content = fs::read_to_string(&dot_git).ok()?;
+    let target = content.lines().next()?.strip_prefix("gitdir:")?.trim();
+    Some(Path::new(repo_root).join(target))
+}
+
+/// An ignore file in effect for a directory, linked to the ones of its parents
+struct IgnoreChain {
+    file: IgnoreFile,
+    outer: Option<Arc<IgnoreChain>>,
+}
+
+fn chain(outer: Option<Arc<IgnoreChain>>, file: Option<IgnoreFile>) -> Option<Arc<IgnoreChain>> {
+    match file {
+        Some(file) => Some(Arc::new(IgnoreChain { file, outer })),
+        None => outer,
+    }
+}
+
+/// Where a walker is: in the exclusion trie, and under which ignore files
+#[derive(Clone)]
+pub struct DirScope {
+    node: Option<usize>,
+    /// Innermost ignore file in effect; None without --gitignore or until one is found
+    ignore: Option<Arc<IgnoreChain>>,
+}
+
+/// Decides which entries a walker visits: not hidden, not in an excluded folder and,
+/// with --gitignore, not ignored
+pub struct WalkFilter<'a> {
+    exclusions: &'a Exclusions,
+    /// .git/info/exclude and the root .gitignore
+    root_ignore: Option<Arc<IgnoreChain>>,
+}
+
+impl<'a> WalkFilter<'a> {
+    pub fn new(exclusions: &'a Exclusions, repo_root: &str) -> Self {
+        let root_ignore = if exclusions.gitignore {
+            // info/exclude has a lower precedence than the root .gitignore
+            let exclude = git_dir(repo_root).and_then(|dir| read_ignore_file(&dir.join("info").join("exclude"), ""));
+            let root = read_ignore_file(&Path::new(repo_root).join(".gitignore"), "");
+            chain(chain(None, exclude), root)
+        } else {
+            None
+        };
+        Self { exclusions, root_ignore }
+    }
+
+    pub fn root(&self) -> DirScope {
+        DirScope {
+            node: Some(0),
+            ignore: self.root_ignore.clone(),
+        }
+    }
+
+    /// Enter each directory of `relative_dir` in turn from the root, for walks that
+    /// start below it. None when one of them is pruned.
+    pub fn descend_to(&self, repo_root: &str, relative_dir: &str) -> Option<DirScope> {
+        let mut scope = self.root();
+        let mut relative = String::new();
+        for component in components(relative_dir) {
+            if !relative.is_empty() {
+                relative.push('/');
+            }
+            relative.push_str(component);
+            let full_path = Path::new(repo_root).join(&relative);
+            scope = self.enter_dir(&scope, component, &relative, &full_path)?;
+        }
+        Some(scope)
+    }
+
+    /// Scope of the subdirectory `name` of the directory at `parent`, or None when
+    /// it is pruned
+    pub fn enter_dir(&self, parent: &DirScope, name: &str, relative_path: &str, full_path: &Path) -> Option<DirScope> {
+        if name.starts_with('.') {
+            return None;
+        }
+        let node = self.exclusions.step(parent.node, name).ok()?;
+        if !self.exclusions.gitignore {
+            return Some(DirScope { node, ignore: None });
+        }
+        if is_ignored(parent.ignore.as_deref(), relative_path, name, true) {
+            return None;
+        }
+        let file = read_ignore_file(&full_path.join(".gitignore"), &normalize(relative_path));
+        Some(DirScope {
+            node,
+            ignore: chain(parent.ignore.clone(), file),
+        })
+    }
+
+    /// True when the walker should visit the file `name` of the directory at `parent`
+    pub fn includes_file(&self, parent: &DirScope, name: &str, relative_path: &str) -> bool {
+        if name.starts_with('.') || self.exclusions.step(parent.node, name).is_err() {
+            return false;
+        }
+        !self.exclusions.gitignore || !is_ignored(parent.ignore.as_deref(), relative_path, name, false)
+    }
+}
+
+fn normalize(relative_path: &str) -> Cow<'_, str> {
+    if relative_path.contains('\\') {
+        Cow::Owned(relative_path.replace('\\', "/"))
+    } else {
+        Cow::Borrowed(relative_path)
+    }
+}
+
+/// The last matching rule of the innermost .gitignore that has one decides
+fn is_ignored(innermost: Option<&IgnoreChain>, relative_path: &str, name: &str, is_dir: bool) -> bool {
+    let relative_path = normalize(relative_path);
+    let mut link = innermost;
+    while let Some(IgnoreChain { file, outer }) = link {
+        link = outer.as_deref();
+        let path = if file.base.is_empty() {
+            &relative_path[..]
+        } else {
+            match relative_path.strip_prefix(file.base.as_str()).and_then(|rest| rest.strip_prefix('/')) {
+                Some(rest) => rest,
+                None => continue,
+            }
+        };
+        for rule in file.rules.iter().rev() {
+            if rule.dir_only && !is_dir {
+                continue;
+            }
+            let text = if rule.anchored { path } else { name };
+            if glob_match(&rule.pattern, text.as_bytes(), true) {
+                return !rule.negated;
+            }
+        }
+    }
+    false
+}
+
+/// Match `text` against a gitignore pattern: `*` and `?` do not cross `/`, `**`
+/// as a whole component crosses any number of them, `[...]` is a class and `\`
+/// escapes. `at_component` tells whether `pattern` starts a path component.
+fn glob_match(pattern: &[u8], text: &[u8], at_component: bool) -> bool {
+    let Some(&first) = pattern.first() else {
+        return text.is_empty();
+    };
+    match first {
+        b'*' if at_component && pattern.get(1) == Some(&b'*') && matches!(pattern.get(2), None | Some(&b'/')) => {
+            if pattern.len() == 2 {
+                return true;
+            }
+            // "**/": zero or more whole directories
+            let rest = &pattern[3..];
+            (0..=text.len())
+                .filter(|&i| i == 0 || text[i - 1] == b'/')
+                .any(|i| glob_match(rest, &text[i..], true))
+        }
+        b'*' => {
+            let rest = &pattern[1..];
+            for i in 0..=text.len() {
+                if glob_match(rest, &text[i..], false) {
+                    return true;
+                }
+                if i < text.len() && text[i] == b'/' {
+                    break;
+                }
+            }
+            false
+        }
+        b'?' => !text.is_empty() && text[0] != b'/' && glob_match(&pattern[1..], &text[1..], false),
+        b'[' => match match_class(&pattern[1..], text.first().copied()) {
+            Some((true, used)) => glob_match(&pattern[1 + used..], &text[1..], false),
+            Some((false, _)) => false,
+            // No closing bracket: a literal '['
+            None => text.first() == Some(&b'[') && glob_match(&pattern[1..], &text[1..], false),
+        },
+        b'\\' if pattern.len() > 1 => {
+            text.first() == Some(&pattern[1]) && glob_match(&pattern[2..], &text[1..], pattern[1] == b'/')
+        }
+        literal => text.first() == Some(&literal) && glob_match(&pattern[1..], &text[1..], literal == b'/'),
+    }
+}
+
+/// Match `c` against the class starting after '['. Returns whether it matched and
+/// the length of the class including the ']', or None when the class is unterminated.
+fn match_class(class: &[u8], c: Option<u8>) -> Option<(bool, usize)> {
+    let mut i = 0;
+    let negated = matches!(class.first(), Some(b'!') | Some(b'^'));
+    if negated {
+        i += 1;
+    }
+    let mut matched = false;
+    let mut first = true;
+    while i < class.len() {
+        let mut low = class[i];
+        if low == b']' && !first {
+            let matched = matched != negated && c.is_some_and(|c| c != b'/');
+            return Some((matched, i + 1));
+        }
+        first = false;
+        if low == b'\\' && i + 1 < class.len() {
+            i += 1;
+            low = class[i];
+        }
+        let mut high = low;
+        if i + 2 < class.len() && class[i + 1] == b'-' && class[i + 2] != b']' {
+            high = class[i + 2];
+            i += 2;
+        }
+        if let Some(c) = c {
+            if low <= c && c <= high {
+                matched = true;
+            }
+        }
+        i += 1;
+    }
+    None
+}
@@ -1,11 +1,47 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+use std::cell::OnceCell;
+use std::collections::HashMap;
 use std::fs;
+use std::io::{self, Write};
 use std::path::{Path, MAIN_SEPARATOR};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Arc};
+use std::thread;
+#[cfg(target_os = "linux")]
+use std::time::Instant;
 
-use crate::checks::Check;
+use crate::cache::{file_stamp, CachedFile, CheckRecord, RecordsBuilder, ResultCache};
+use crate::changed_files::normalize_relative_path;
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
 use crate::config::*;
+#[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64")))]
+use crate::dir_reader;
+#[cfg(not(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64"))))]
+use crate::exclusions::DirScope;
+use crate::exclusions::WalkFilter;
+use crate::fixes::{self, FilePlan, PendingFixes};
+use crate::hash::hash64;
+use crate::memory::{self, FileContent, MemoryBudget};
+use crate::prefilter::{MatchTable, Prefilter};
+use crate::srs_index::{SrsIndex, SrsIndexBuilder};
+use crate::timings::{Profiler, TID_FIRST_WORKER, TID_WALKER};
+#[cfg(target_os = "linux")]
+use crate::uring::{self, BatchReader};
+use crate::work_queue::WorkQueue;
+
+/// A file queued for the workers, with its content when the walker read it ahead
+type QueuedFile = (FileTask, Option<FileContent>);
+
+/// Threads reading directories ahead of the walker
+#[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64")))]
+const MAX_DIR_READERS: usize = 8;
+
+/// Files with content that a walker reading ahead lets wait for the workers
+#[cfg(target_os = "linux")]
+const READ_AHEAD_FILES: usize = 4 * uring::POOL_BUFFERS;
 
 /// Classify a filename by extension, returning a bitmask value.
 /// Uses u32 bitmask (not an enum) because file_types flags are combined
@@ -21,6 +57,7 @@ pub fn classify_file_type(filename: &str) -> u32 {
             ".cs" => FILE_TYPE_CS,
             ".md" => FILE_TYPE_MD,
             ".txt" => FILE_TYPE_TXT,
+            ".yml" => FILE_TYPE_YML,
             _ => 0,
         }
     } else {
@@ -43,30 +80,522 @@ pub fn is_in_devdoc_directory(relative_path: &str) -> bool {
     false
 }
 
-pub fn is_path_excluded(relative_path: &str, exclude_folders: &[String]) -> bool {
-    for folder in exclude_folders {
-        if folder.is_empty() {
+/// A file the walker selected for checking
+pub struct FileTask {
+    pub full_path: String,
+    pub relative_path: String,
+    pub type_flags: u32,
+    pub ordinal: usize,
+    /// False in incremental mode when the file is not in the changed set
+    pub changed: bool,
+}
+
+/// The parts of a check the walker needs to decide whether a file is wanted.
+/// Copied out of the checks so the walker thread does not borrow them.
+struct CheckFilter {
+    file_types: u32,
+    requires_devdoc: bool,
+    cross_file: bool,
+    /// Prefilter ids of the check's needles (empty: the check sees every file)
+    needles: Vec<usize>,
+}
+
+impl CheckFilter {
+    fn wants(&self, type_flags: u32, changed: bool) -> bool {
+        if !changed && !self.cross_file {
+            return false;
+        }
+        if self.requires_devdoc && type_flags & FILE_FLAG_IN_DEVDOC == 0 {
+            return false;
+        }
+        self.file_types & type_flags != 0
+    }
+
+    /// False when the file contains none of the check's needles
+    fn finds_needles(&self, matches: &MatchTable) -> bool {
+        self.needles.is_empty() || matches.any(&self.needles)
+    }
+}
+
+/// Everything processing one file produced
+struct FileOutcome {
+    report: FileReport,
+    /// The findings among the report's messages, by check (index into the checks
+    /// that found something), in check order
+    findings: Vec<(usize, Vec<Finding>)>,
+    /// Entry for the new result cache (None when caching is off or the file was unreadable)
+    cache_entry: Option<CachedFile>,
+    /// True when every check result for the file was replayed from the cache
+    from_cache: bool,
+    /// True when the file was found as the cache held it: the same size and
+    /// trusted mtime, and a record for every check (cache_entry is a copy of it)
+    unchanged: bool,
+    /// Fixes accepted for the file (--fix mode) and the content they apply to
+    fix: Option<(Vec<u8>, FilePlan)>,
+}
+
+/// The result cache of a walk, and the number it stores the records of each check
+/// under (by index into the checks)
+#[derive(Clone, Copy)]
+struct CacheLookup<'a> {
+    results: &'a ResultCache,
+    check_ids: &'a [u32],
+}
+
+/// Result of one walk over the repository
+pub struct Walk {
+    /// Empty unless a check uses it or --srs-index-out was given
+    pub srs_index: SrsIndex,
+    /// Per-file results of this walk, to reuse on the next one (None when caching is off)
+    pub cache: Option<ResultCache>,
+}
+
+/// Run the checks over the repository, collecting the SRS index on the way.
+/// Unchanged files replay their results from `cache` (None turns caching off);
+/// the results are saved to config.cache_path when it is set, unless every file
+/// was found as the cache held it. Fixes proposed by the checks are queued on
+/// `fixes` in walk order. Time spent per check and per file is recorded on `profiler`.
+/// The messages of each file are written to `out` in walk order, and `collect`
+/// receives every file a check looked at, with the findings of each check (by
+/// index into `checks`) that found something in it. Fails on the first error
+/// writing to `out`, once the walk is over.
+pub fn walk_repository(
+    config: &ValidatorConfig,
+    checks: &mut Vec<Box<dyn Check>>,
+    fixes: &mut PendingFixes,
+    cache: Option<ResultCache>,
+    profiler: &mut Profiler,
+    out: &mut dyn Write,
+    collect: &mut dyn FnMut(&FileTask, Vec<(usize, Vec<Finding>)>),
+) -> io::Result<Walk> {
+    // The index is collected by a hidden check running alongside the others
+    let build_index =
+        config.srs_index_out.is_some() || checks.iter().any(|check| check.uses_srs_index());
+    if build_index {
+        let mut builder: Box<dyn Check> = Box::new(SrsIndexBuilder::new());
+        builder.init(config, &mut CheckOutput::default());
+        checks.push(builder);
+    }
+
+    // Every check gets its record number before the workers share the cache
+    let mut cache = cache;
+    let check_ids: Vec<u32> = match &mut cache {
+        Some(cache) => checks.iter().map(|check| cache.check_id(check.name(), check.version())).collect(),
+        None => Vec::new(),
+    };
+    let lookup = cache.as_ref().map(|results| CacheLookup {
+        results,
+        check_ids: &check_ids,
+    });
+
+    let mut cache_entries: Vec<(String, CachedFile)> = Vec::new();
+    let mut files_checked = 0usize;
+    let mut files_from_cache = 0usize;
+    let mut files_unchanged = 0usize;
+    let mut written: io::Result<()> = Ok(());
+    let mut collect_outcome = |task: FileTask, outcome: FileOutcome| {
+        if written.is_ok() {
+            written = print_report(out, &outcome.report);
+        }
+        collect(&task, outcome.findings);
+        if let Some((content, plan)) = outcome.fix {
+            fixes.add_file(&task.full_path, &task.relative_path, content, plan);
+        }
+        if outcome.from_cache {
+            files_from_cache += 1;
+        } else {
+            files_checked += 1;
+        }
+        if outcome.unchanged {
+            files_unchanged += 1;
+        }
+        if let Some(entry) = outcome.cache_entry {
+            cache_entries.push((task.relative_path, entry));
+        }
+    };
+
+    if config.jobs <= 1 {
+        walk_sequential(config, checks, lookup, profiler, &mut collect_outcome);
+    } else {
+        walk_parallel(config, checks, lookup, config.jobs, profiler, &mut collect_outcome);
+    }
+    written?;
+
+    let mut changed = false;
+    let cache = cache.map(|mut cache| {
+        // The other repositories of a workspace keep their results for the next one
+        if config.workspace {
+            cache.absorb(cache_entries);
+            return cache;
+        }
+        // A walk that found every file as the cache held it leaves the cache as it
+        // was. An incremental run skips most unchanged files and keeps their results.
+        let incremental = config.changed_paths.is_some();
+        if files_unchanged < cache_entries.len() || !(incremental || cache_entries.len() == cache.len()) {
+            cache.update(cache_entries, incremental);
+            changed = true;
+        }
+        cache
+    });
+    if cache.is_some() && (config.cache_path.is_some() || config.workspace) {
+        writeln!(
+            out,
+            "Result cache: reused results for {} file(s), checked {} file(s)",
+            files_from_cache, files_checked
+        )?;
+    }
+    if let (Some(path), Some(cache)) = (&config.cache_path, &cache) {
+        if changed {
+            if let Err(e) = cache.save(path, &config.repo_root) {
+                writeln!(out, "  [WARN] Could not write result cache {}: {}", path, e)?;
+            }
+        }
+    }
+
+    let srs_index = if build_index {
+        let builder = checks.pop().expect("SRS index builder was added above");
+        downcast_shard::<SrsIndexBuilder>(builder).build()
+    } else {
+        SrsIndex::default()
+    };
+    Ok(Walk { srs_index, cache })
+}
+
+/// Run the checks over files the caller holds in memory (editor buffers, git
+/// blobs) instead of walking the disk, collecting the SRS index on the way.
+/// Paths are relative to config.repo_root. Hidden and excluded paths are skipped
+/// as in a walk; .gitignore files are not consulted. Files are checked in the
+/// order given, on the calling thread, without the result cache; fixes are not
+/// queued. `collect` receives every file a check looked at, with the findings of
+/// each check (by index into `checks`) that found something in it.
+pub fn check_buffers(
+    config: &ValidatorConfig,
+    checks: &mut Vec<Box<dyn Check>>,
+    files: &mut dyn Iterator<Item = (String, Vec<u8>)>,
+    profiler: &mut Profiler,
+    collect: &mut dyn FnMut(&FileTask, Vec<(usize, Vec<Finding>)>),
+) -> SrsIndex {
+    let build_index =
+        config.srs_index_out.is_some() || checks.iter().any(|check| check.uses_srs_index());
+    if build_index {
+        let mut builder: Box<dyn Check> = Box::new(SrsIndexBuilder::new());
+        builder.init(config, &mut CheckOutput::default());
+        checks.push(builder);
+    }
+
+    let prefilter = build_prefilter(checks);
+    let filters = check_filters(checks, &prefilter);
+    let mut ordinal = 0usize;
+    for (path, content) in files {
+        let relative = normalize_relative_path(&path);
+        if relative.split('/').any(|name| name.starts_with('.')) || config.exclusions.is_excluded(&relative) {
             continue;
         }
-        if relative_path.starts_with(folder.as_str()) {
-            let rest = &relative_path[folder.len()..];
-            if rest.is_empty()
-                || rest.starts_with(MAIN_SEPARATOR)
-                || rest.starts_with('/')
-                || rest.starts_with('\\')
-            {
-                return true;
+        let full_path = Path::new(&config.repo_root).join(&relative).to_string_lossy().to_string();
+        let task = match select_file(config, &filters, &full_path, &relative, ordinal) {
+            Some(task) => task,
+            None => continue,
+        };
+        ordinal += 1;
+
+        let file_info = make_file_info(&task, content.into(), &prefilter, profiler);
+        let mut reports = Vec::new();
+        for (index, (check, filter)) in checks.iter_mut().zip(&filters).enumerate() {
+            if filter.wants(task.type_flags, task.changed) && filter.finds_needles(&file_info.matches) {
+                let mut report = FileReport::default();
+                let started = profiler.start();
+                check.check_file(&file_info, config, &mut report);
+                profiler.check_file(started, index, check.name(), &task.relative_path, file_info.content.len());
+                if !report.findings.is_empty() {
+                    reports.push((index, report.findings));
+                }
+            }
+        }
+        collect(&task, reports);
+    }
+
+    if build_index {
+        let builder = checks.pop().expect("SRS index builder was added above");
+        downcast_shard::<SrsIndexBuilder>(builder).build()
+    } else {
+        SrsIndex::default()
+    }
+}
+
+/// One automaton over the needles of every check
+fn build_prefilter(checks: &[Box<dyn Check>]) -> Prefilter {
+    Prefilter::new(
+        checks
+            .iter()
+            .flat_map(|check| check.needles().iter().copied())
+            .collect(),
+    )
+}
+
+fn check_filters(checks: &[Box<dyn Check>], prefilter: &Prefilter) -> Vec<CheckFilter> {
+    checks
+        .iter()
+        .map(|check| CheckFilter {
+            file_types: check.file_types(),
+            requires_devdoc: check.requires_devdoc(),
+            cross_file: check.cross_file(),
+            needles: check
+                .needles()
+                .iter()
+                .map(|&needle| prefilter.needle_id(needle).expect("needle was added to the prefilter"))
+                .collect(),
+        })
+        .collect()
+}
+
+fn print_report(out: &mut dyn Write, report: &FileReport) -> io::Result<()> {
+    for message in &report.messages {
+        writeln!(out, "{}", message)?;
+    }
+    Ok(())
+}
+
+fn walk_sequential(
+    config: &ValidatorConfig,
+    checks: &mut [Box<dyn Check>],
+    cache: Option<CacheLookup>,
+    profiler: &mut Profiler,
+    collect: &mut dyn FnMut(FileTask, FileOutcome),
+) {
+    let prefilter = build_prefilter(checks);
+    let filters = check_filters(checks, &prefilter);
+    let budget = config.max_memory.map(MemoryBudget::new);
+    let mut ordinal = 0usize;
+    walk_files(config, &mut |full_path, relative| {
+        if let Some(task) = select_file(config, &filters, full_path, relative, ordinal) {
+            ordinal += 1;
+            let outcome = process_file(config, checks, &filters, &prefilter, cache, budget.as_ref(), profiler, &task, None);
+            collect(task, outcome);
+        }
+    });
+}
+
+/// Walk on one thread while `jobs` workers run the checks. Each worker owns a
+/// shard of every check (see Check::fork); the shards are merged back once the
+/// walk completes. Reports are printed in walk order, so output matches a
+/// sequential run. Without a result cache the walker reads the files ahead for
+/// the workers (see read_ahead); with one, a worker only reads a file whose
+/// stamp changed. Whoever reads a file takes its size from the memory budget,
+/// if there is one, and the worker gives it back once the file is checked.
+fn walk_parallel(
+    config: &ValidatorConfig,
+    checks: &mut [Box<dyn Check>],
+    cache: Option<CacheLookup>,
+    jobs: usize,
+    profiler: &mut Profiler,
+    collect: &mut dyn FnMut(FileTask, FileOutcome),
+) {
+    let prefilter = build_prefilter(checks);
+    let filters = check_filters(checks, &prefilter);
+    let queue: WorkQueue<QueuedFile> = WorkQueue::new(jobs);
+    let batched_reads = config.batched_reads && cache.is_none() && config.staged.is_none();
+    let budget = config.max_memory.map(MemoryBudget::new);
+    // Cleared before the walker queues anything when it cannot read ahead. Files
+    // the walker reads ahead hold their reservations in the queue: a worker that
+    // then waited for room to read a file itself could wait for files nobody is
+    // left to check, so it retries the reads that failed outside the budget.
+    let reading_ahead = AtomicBool::new(batched_reads);
+    let mut shards: Vec<Vec<Box<dyn Check>>> = (0..jobs)
+        .map(|_| checks.iter().map(|check| check.fork()).collect())
+        .collect();
+    let mut walker_profiler = profiler.fork(TID_WALKER, "walker");
+    let mut worker_profilers: Vec<Profiler> = (0..jobs)
+        .map(|worker| profiler.fork(TID_FIRST_WORKER + worker as u32, &format!("worker {}", worker)))
+        .collect();
+    let (sender, receiver) = mpsc::channel::<(FileTask, FileOutcome)>();
+
+    thread::scope(|scope| {
+        let queue = &queue;
+        let filters = &filters;
+        let prefilter = &prefilter;
+        let budget = budget.as_ref();
+        let reading_ahead = &reading_ahead;
+
+        let walker_profiler = &mut walker_profiler;
+        scope.spawn(move || {
+            let started = walker_profiler.start();
+            if !(batched_reads && read_ahead(config, filters, queue, budget, walker_profiler)) {
+                reading_ahead.store(false, Ordering::Relaxed);
+                let mut ordinal = 0usize;
+                walk_files(config, &mut |full_path, relative| {
+                    if let Some(task) = select_file(config, filters, full_path, relative, ordinal) {
+                        ordinal += 1;
+                        queue.push(task.ordinal, (task, None));
+                    }
+                });
             }
+            queue.close();
+            walker_profiler.span(started, "enumerate files", None);
+        });
+
+        for (worker, (shard, worker_profiler)) in shards.iter_mut().zip(&mut worker_profilers).enumerate() {
+            let sender = sender.clone();
+            scope.spawn(move || {
+                while let Some((task, content)) = queue.pop(worker) {
+                    let budget = if reading_ahead.load(Ordering::Relaxed) { None } else { budget };
+                    let outcome =
+                        process_file(config, shard, filters, prefilter, cache, budget, worker_profiler, &task, content);
+                    if sender.send((task, outcome)).is_err() {
+                        break;
+                    }
+                }
+            });
+        }
+        drop(sender);
+
+        // Collect outcomes in walk order as soon as every earlier file is done
+        let mut waiting: HashMap<usize, (FileTask, FileOutcome)> = HashMap::new();
+        let mut next = 0usize;
+        for (task, outcome) in receiver {
+            waiting.insert(task.ordinal, (task, outcome));
+            while let Some((task, outcome)) = waiting.remove(&next) {
+                collect(task, outcome);
+                next += 1;
+            }
+        }
+    });
+
+    for worker_shards in shards {
+        for (check, shard) in checks.iter_mut().zip(worker_shards) {
+            check.merge(shard);
         }
     }
+    profiler.merge(walker_profiler);
+    for worker_profiler in worker_profilers {
+        profiler.merge(worker_profiler);
+    }
+}
+
+/// Enumerate the files for walk_parallel and queue them with their content, read
+/// in io_uring batches while the workers check the files already queued. Under
+/// --max-memory, files to map are mapped here instead, and each content waits
+/// for room in `budget` before it is queued, which holds further reads back until
+/// the workers catch up. Returns false, having queued nothing, when io_uring is
+/// not available.
+#[cfg(target_os = "linux")]
+fn read_ahead(
+    config: &ValidatorConfig,
+    filters: &[CheckFilter],
+    queue: &WorkQueue<QueuedFile>,
+    budget: Option<&Arc<MemoryBudget>>,
+    profiler: &mut Profiler,
+) -> bool {
+    // Files to map are mapped below instead of read to the end
+    let max_len = config.max_memory.map(|max_memory| memory::map_threshold(max_memory) - 1);
+    let mut reader: BatchReader<(FileTask, Option<Instant>)> = match BatchReader::new(max_len) {
+        Ok(reader) => reader,
+        Err(_) => return false,
+    };
+    let mut done = Vec::new();
+    let hand_off = |done: &mut Vec<((FileTask, Option<Instant>), io::Result<Vec<u8>>)>, profiler: &mut Profiler| {
+        for ((task, started), content) in done.drain(..) {
+            // The worker retries a failed read and skips the file if it fails again
+            let content = match (content, config.max_memory) {
+                (Ok(content), _) => {
+                    profiler.read(started, &task.relative_path, content.len());
+                    Some(match budget {
+                        Some(budget) => {
+                            let reservation = budget.reserve(content.len() as u64);
+                            FileContent::reserved(content, reservation)
+                        }
+                        None => content.into(),
+                    })
+                }
+                (Err(e), Some(max_memory)) if e.kind() == io::ErrorKind::FileTooLarge => {
+                    let content = memory::read_within(&task.full_path, max_memory, config.map_files, budget).ok();
+                    if let Some(content) = &content {
+                        profiler.read(started, &task.relative_path, content.len());
+                    }
+                    content
+                }
+                (Err(_), _) => None,
+            };
+            queue.push(task.ordinal, (task, content));
+        }
+    };
+
+    let mut ordinal = 0usize;
+    walk_files(config, &mut |full_path, relative| {
+        if let Some(task) = select_file(config, filters, full_path, relative, ordinal) {
+            ordinal += 1;
+            queue.wait_below(READ_AHEAD_FILES);
+            let started = profiler.start();
+            reader.submit(full_path, (task, started), &mut done);
+            hand_off(&mut done, profiler);
+        }
+    });
+    reader.finish(&mut done);
+    hand_off(&mut done, profiler);
+    true
+}
+
+#[cfg(not(target_os = "linux"))]
+fn read_ahead(
+    _config: &ValidatorConfig,
+    _filters: &[CheckFilter],
+    _queue: &WorkQueue<QueuedFile>,
+    _budget: Option<&Arc<MemoryBudget>>,
+    _profiler: &mut Profiler,
+) -> bool {
     false
 }
 
-pub fn walk_repository(config: &ValidatorConfig, checks: &mut [Box<dyn Check>]) {
-    walk_directory_recursive(config, checks, Path::new(&config.repo_root));
+/// Visit (full path, relative path) of every file the run checks. In --staged mode
+/// the staged files come from the list git diff gave, after the walk of the other
+/// files: a file staged and then deleted from the working tree is still committed.
+fn walk_files(config: &ValidatorConfig, visit: &mut dyn FnMut(&str, &str)) {
+    let Some(staged) = &config.staged else {
+        return walk_directory(config, visit);
+    };
+    walk_directory(config, &mut |full_path, relative| {
+        if !staged.is_staged(relative) {
+            visit(full_path, relative);
+        }
+    });
+    let filter = WalkFilter::new(&config.exclusions, &config.repo_root);
+    for relative in staged.staged_paths() {
+        let (dir, name) = relative.rsplit_once('/').unwrap_or(("", relative));
+        let included = filter
+            .descend_to(&config.repo_root, dir)
+            .is_some_and(|scope| filter.includes_file(&scope, name, relative));
+        if included {
+            let full_path = Path::new(&config.repo_root).join(relative).to_string_lossy().to_string();
+            visit(&full_path, relative);
+        }
+    }
+}
+
+/// Visit (full path, relative path) of every file under the repository root that is
+/// not hidden, excluded or (with --gitignore) ignored. Pruned directories are not read.
+/// Files are visited depth-first, in directory order, on the calling thread.
+pub fn walk_directory(config: &ValidatorConfig, visit: &mut dyn FnMut(&str, &str)) {
+    let filter = WalkFilter::new(&config.exclusions, &config.repo_root);
+    #[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64")))]
+    {
+        // Directories are read ahead when files are checked on several threads
+        let readers = if config.jobs > 1 { config.jobs.min(MAX_DIR_READERS) } else { 0 };
+        dir_reader::walk(&config.repo_root, &filter, readers, visit);
+    }
+    #[cfg(not(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64"))))]
+    {
+        let root = filter.root();
+        walk_directory_recursive(config, &filter, &root, Path::new(&config.repo_root), visit);
+    }
 }
 
-fn walk_directory_recursive(config: &ValidatorConfig, checks: &mut [Box<dyn Check>], dir: &Path) {
+#[cfg(not(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64"))))]
+fn walk_directory_recursive(
+    config: &ValidatorConfig,
+    filter: &WalkFilter,
+    scope: &DirScope,
+    dir: &Path,
+    visit: &mut dyn FnMut(&str, &str),
+) {
     let entries = match fs::read_dir(dir) {
         Ok(e) => e,
         Err(_) => return,
@@ -109,21 +638,23 @@ fn walk_directory_recursive(config: &ValidatorConfig, checks: &mut [Box<dyn Chec
         };
 
         if file_type.is_dir() {
-            if !is_path_excluded(&relative, &config.exclude_folders) {
-                walk_directory_recursive(config, checks, &full_path);
+            if let Some(child) = filter.enter_dir(scope, &name_str, &relative, &full_path) {
+                walk_directory_recursive(config, filter, &child, &full_path, visit);
             }
-        } else if file_type.is_file() && !is_path_excluded(&relative, &config.exclude_folders) {
-            process_file(config, checks, &full_path_str, &relative);
+        } else if file_type.is_file() && filter.includes_file(scope, &name_str, &relative) {
+            visit(&full_path_str, &relative);
         }
     }
 }
 
-fn process_file(
+/// Classify a file and decide whether any active check wants it
+fn select_file(
     config: &ValidatorConfig,
-    checks: &mut [Box<dyn Check>],
+    filters: &[CheckFilter],
     full_path: &str,
     relative_path: &str,
-) {
+    ordinal: usize,
+) -> Option<FileTask> {
     // Extract filename
     let filename = if let Some(pos) = full_path.rfind(MAIN_SEPARATOR) {
         &full_path[pos + 1..]
@@ -135,13 +666,11 @@ fn process_file(
 
     let file_type = classify_file_type(filename);
     if file_type == 0 {
-        return;
+        return None;
     }
 
-    let in_devdoc = is_in_devdoc_directory(relative_path);
-
     let mut flags = file_type;
-    if in_devdoc {
+    if is_in_devdoc_directory(relative_path) {
         flags |= FILE_FLAG_IN_DEVDOC;
     }
 
@@ -150,43 +679,280 @@ fn process_file(
         flags |= FILE_FLAG_IS_UT;
     }
 
+    // A file whose deletion is staged is not part of the commit
+    if config.staged.as_ref().is_some_and(|staged| staged.is_deleted(relative_path)) {
+        return None;
+    }
+
+    let changed = match &config.changed_paths {
+        Some(paths) => paths.contains(&normalize_relative_path(relative_path)),
+        None => true,
+    };
+
     // Determine if any active check needs this file
-    let needed = checks.iter().any(|check| {
-        if check.requires_devdoc() && !in_devdoc {
-            return false;
+    if !filters.iter().any(|filter| filter.wants(flags, changed)) {
+        return None;
+    }
+
+    Some(FileTask {
+        full_path: full_path.to_string(),
+        relative_path: relative_path.to_string(),
+        type_flags: flags,
+        ordinal,
+        changed,
+    })
+}
+
+fn process_file(
+    config: &ValidatorConfig,
+    checks: &mut [Box<dyn Check>],
+    filters: &[CheckFilter],
+    prefilter: &Prefilter,
+    cache: Option<CacheLookup>,
+    budget: Option<&Arc<MemoryBudget>>,
+    profiler: &mut Profiler,
+    task: &FileTask,
+    content: Option<FileContent>,
+) -> FileOutcome {
+    let started = profiler.start();
+    let outcome = match cache {
+        Some(cache) => process_file_cached(config, checks, filters, prefilter, cache, budget, profiler, task),
+        None => process_file_uncached(config, checks, filters, prefilter, budget, profiler, task, content),
+    };
+    profiler.span(started, "file", Some(&task.relative_path));
+    outcome
+}
+
+fn process_file_uncached(
+    config: &ValidatorConfig,
+    checks: &mut [Box<dyn Check>],
+    filters: &[CheckFilter],
+    prefilter: &Prefilter,
+    budget: Option<&Arc<MemoryBudget>>,
+    profiler: &mut Profiler,
+    task: &FileTask,
+    content: Option<FileContent>,
+) -> FileOutcome {
+    let mut report = FileReport::default();
+    let mut findings = Vec::new();
+    let mut fix = None;
+
+    // Read file content unless the walker read it ahead (skip unreadable files
+    // with a silent continue, matching the original PowerShell scripts' try/catch
+    // behavior that printed [WARN] and continued to the next file)
+    if let Some(content) = content.or_else(|| read_file(config, budget, task, profiler)) {
+        let file_info = make_file_info(task, content, prefilter, profiler);
+        for (index, (check, filter)) in checks.iter_mut().zip(filters).enumerate() {
+            if filter.wants(task.type_flags, task.changed) && filter.finds_needles(&file_info.matches) {
+                let started = profiler.start();
+                check.check_file(&file_info, config, &mut report);
+                profiler.check_file(started, index, check.name(), &task.relative_path, file_info.content.len());
+                if !report.findings.is_empty() {
+                    findings.push((index, std::mem::take(&mut report.findings)));
+                }
+            }
         }
-        if check.file_types() & file_type == 0 {
-            return false;
+        if !report.fixes.is_empty() {
+            let plan = fixes::plan_file(&task.relative_path, &mut report);
+            fix = Some((file_info.content.into_vec(), plan));
         }
-        true
-    });
+    }
 
-    if !needed {
-        return;
+    FileOutcome {
+        report,
+        findings,
+        cache_entry: None,
+        from_cache: false,
+        unchanged: false,
+        fix,
     }
+}
 
-    // Read file content (skip unreadable files with a silent continue,
-    // matching the original PowerShell scripts' try/catch behavior that
-    // printed [WARN] and continued to the next file)
-    let content = match fs::read(full_path) {
-        Ok(c) => c,
-        Err(_) => return,
+/// Content of the file of `task`, read (taking its size from `budget`, if given)
+/// or mapped under --max-memory
+fn read_file(
+    config: &ValidatorConfig,
+    budget: Option<&Arc<MemoryBudget>>,
+    task: &FileTask,
+    profiler: &mut Profiler,
+) -> Option<FileContent> {
+    let started = profiler.start();
+    if let Some(content) = config.staged.as_ref().and_then(|staged| staged.content(&task.relative_path)) {
+        profiler.read(started, &task.relative_path, content.len());
+        return Some(content.to_vec().into());
+    }
+    let content = match config.max_memory {
+        Some(max_memory) => memory::read_within(&task.full_path, max_memory, config.map_files, budget).ok()?,
+        None => fs::read(&task.full_path).ok()?.into(),
     };
+    profiler.read(started, &task.relative_path, content.len());
+    Some(content)
+}
 
-    let file_info = FileInfo {
-        path: full_path.to_string(),
-        relative_path: relative_path.to_string(),
-        type_flags: flags,
+fn make_file_info(task: &FileTask, content: FileContent, prefilter: &Prefilter, profiler: &mut Profiler) -> FileInfo {
+    let started = profiler.start();
+    let matches = prefilter.scan(&content);
+    profiler.prefilter(started, &task.relative_path);
+    FileInfo {
+        path: task.full_path.clone(),
+        relative_path: task.relative_path.clone(),
+        type_flags: task.type_flags,
         content,
+        ordinal: task.ordinal,
+        matches,
+        line_table: OnceCell::new(),
+        tokens: OnceCell::new(),
+    }
+}
+
+/// Run the checks on one file, replaying cached results for every check whose
+/// record is still valid. Checks are run on a fresh shard so that the shard state
+/// after this single file can be saved alongside the messages it produced.
+fn process_file_cached(
+    config: &ValidatorConfig,
+    checks: &mut [Box<dyn Check>],
+    filters: &[CheckFilter],
+    prefilter: &Prefilter,
+    cache: CacheLookup,
+    budget: Option<&Arc<MemoryBudget>>,
+    profiler: &mut Profiler,
+    task: &FileTask,
+) -> FileOutcome {
+    // Fix mode never uses the cache, so this path has no fixes to queue
+    let mut outcome = FileOutcome {
+        report: FileReport::default(),
+        findings: Vec::new(),
+        cache_entry: None,
+        from_cache: false,
+        unchanged: false,
+        fix: None,
+    };
+
+    // Staged content has no modification time: its stamp never matches, so it is
+    // always looked up by hash and never trusted by a later run
+    let staged = config.staged.as_ref().and_then(|staged| staged.content(&task.relative_path));
+    let (size, mtime_ns) = match (staged, fs::metadata(&task.full_path)) {
+        (Some(content), _) => (content.len() as u64, 0),
+        (None, Ok(meta)) => file_stamp(&meta),
+        (None, Err(_)) => return outcome,
     };
 
-    for check in checks.iter_mut() {
-        if check.requires_devdoc() && !in_devdoc {
+    // Find the cached results for the file's current content: trust size and
+    // mtime when they are unambiguous, otherwise look the content hash up
+    let mut content: Option<FileContent> = None;
+    let mut stat_matched = false;
+    let previous = match cache.results.get(&task.relative_path) {
+        Some(entry) if staged.is_none() && cache.results.stat_matches(entry, size, mtime_ns) => {
+            stat_matched = true;
+            Some(entry)
+        }
+        Some(_) => match read_file(config, budget, task, profiler) {
+            Some(c) => {
+                let found = cache.results.find(&task.relative_path, c.len() as u64, hash64(&c));
+                content = Some(c);
+                found
+            }
+            None => return outcome,
+        },
+        None => None,
+    };
+
+    // Replay every wanted check that has a valid record
+    let mut replayed: Vec<Option<(CheckRecord, Vec<String>, Vec<Finding>)>> = vec![None; checks.len()];
+    if let Some(entry) = previous {
+        for (index, (check, filter)) in checks.iter_mut().zip(filters).enumerate() {
+            if !filter.wants(task.type_flags, task.changed) {
+                continue;
+            }
+            let Some(record) = entry.record(cache.check_ids[index]) else {
+                continue;
+            };
+            let (Some(messages), Some(findings)) = (record.messages(), record.findings()) else {
+                continue;
+            };
+            let mut shard = check.fork();
+            if shard.load_shard(&mut Decoder::new(record.shard), task).is_some() {
+                check.merge(shard);
+                replayed[index] = Some((record, messages, findings));
+            }
+        }
+    }
+
+    let needs_run = checks
+        .iter()
+        .zip(filters)
+        .zip(&replayed)
+        .any(|((_, filter), record)| filter.wants(task.type_flags, task.changed) && record.is_none());
+    if !needs_run {
+        // Messages go out in check order
+        for (index, replay) in replayed.into_iter().enumerate() {
+            if let Some((_, messages, findings)) = replay {
+                outcome.report.messages.extend(messages);
+                if !findings.is_empty() {
+                    outcome.findings.push((index, findings));
+                }
+            }
+        }
+        outcome.from_cache = true;
+        outcome.unchanged = stat_matched;
+        outcome.cache_entry = previous.map(|entry| entry.restamped(mtime_ns));
+        return outcome;
+    }
+
+    // Run the remaining wanted checks
+    let content = match content {
+        Some(c) => c,
+        None => match read_file(config, budget, task, profiler) {
+            Some(c) => c,
+            None => return outcome,
+        },
+    };
+    let hash = hash64(&content);
+    let file_info = make_file_info(task, content, prefilter, profiler);
+    let mut records = RecordsBuilder::new();
+    let mut names: Vec<&str> = Vec::new();
+    for (index, (check, filter)) in checks.iter_mut().zip(filters).enumerate() {
+        if !filter.wants(task.type_flags, task.changed) {
             continue;
         }
-        if check.file_types() & file_type == 0 {
+        names.extend(cache.results.check_name(cache.check_ids[index]));
+        // Messages go out in check order, whether replayed or freshly produced
+        if let Some((record, messages, findings)) = replayed[index].take() {
+            records.add_record(&record);
+            outcome.report.messages.extend(messages);
+            if !findings.is_empty() {
+                outcome.findings.push((index, findings));
+            }
             continue;
         }
-        check.check_file(&file_info, config);
+        let mut shard = check.fork();
+        let mut report = FileReport::default();
+        // A skipped check still gets a record: its empty shard and no messages
+        if filter.finds_needles(&file_info.matches) {
+            let started = profiler.start();
+            shard.check_file(&file_info, config, &mut report);
+            profiler.check_file(started, index, check.name(), &task.relative_path, file_info.content.len());
+        }
+        let mut out = Encoder::new();
+        shard.save_shard(&mut out);
+        check.merge(shard);
+        records.add(cache.check_ids[index], &report.messages, &report.findings, &out.into_bytes());
+        outcome.report.messages.extend(report.messages);
+        if !report.findings.is_empty() {
+            outcome.findings.push((index, report.findings));
+        }
     }
+
+    // Keep records of checks that were not run this time (e.g. filtered out by
+    // --check) so that a later full run can still reuse them
+    if let Some(entry) = previous {
+        for record in entry.records() {
+            if cache.results.check_name(record.check).is_some_and(|name| !names.contains(&name)) {
+                records.add_record(&record);
+            }
+        }
+    }
+
+    outcome.cache_entry = Some(records.finish(size, mtime_ns, hash));
+    outcome
 }
@@ -0,0 +1,266 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Fix pipeline for --fix mode.
+//!
+//! Checks never write files themselves. check_file() describes each fix as byte-range
+//! edits of the content it was given (FileReport::fix); cross-file checks add theirs
+//! to PendingFixes in finalize(). The fixes for one file are merged in check order:
+//! a fix that overlaps an earlier one is dropped as a whole and reported, so the
+//! result does not depend on which worker ran which file, and running --fix again
+//! applies it to the updated content. Once every check has finalized, each file is
+//! written exactly once, to a temporary file next to it that is renamed over it.
+
+use std::collections::HashMap;
+use std::fs;
+use std::io::{self, Write};
+
+use crate::config::FileReport;
+
+/// Replace content[start..end] with `replacement` (start == end inserts)
+pub struct Edit {
+    pub start: usize,
+    pub end: usize,
+    pub replacement: Vec<u8>,
+}
+
+impl Edit {
+    pub fn replace(start: usize, end: usize, replacement: &[u8]) -> Self {
+        Self {
+            start,
+            end,
+            replacement: replacement.to_vec(),
+        }
+    }
+
+    pub fn insert(at: usize, text: &[u8]) -> Self {
+        Self::replace(at, at, text)
+    }
+
+    pub fn delete(start: usize, end: usize) -> Self {
+        Self::replace(start, end, b"")
+    }
+
+    /// Replaced ranges conflict when they share a byte. An insertion conflicts with
+    /// an edit at the same offset and with a range it touches, even at its ends:
+    /// text appended after a line that another fix deletes would be left dangling.
+    fn overlaps(&self, other: &Edit) -> bool {
+        match (self.start == self.end, other.start == other.end) {
+            (true, true) => self.start == other.start,
+            (true, false) => other.start <= self.start && self.start <= other.end,
+            (false, true) => self.start <= other.start && other.start <= self.end,
+            (false, false) => self.start < other.end && other.start < self.end,
+        }
+    }
+}
+
+/// One check's fix for one file: applied completely or not at all
+pub struct Fix {
+    /// Index in FileReport::messages of the message announcing the fix
+    pub message: usize,
+    pub edits: Vec<Edit>,
+    /// New path of the file (requirements_naming)
+    pub rename_to: Option<String>,
+}
+
+/// The fixes accepted for one file
+#[derive(Default)]
+pub struct FilePlan {
+    /// Sorted by (start, end) and pairwise non-overlapping
+    edits: Vec<Edit>,
+    rename_to: Option<String>,
+    /// Fixes dropped because they conflicted with an accepted one
+    conflicts: i32,
+}
+
+impl FilePlan {
+    /// Accept every edit of a fix, or none of them if one overlaps an accepted edit
+    /// (or another edit of the same fix). An edit identical to an accepted one is
+    /// not a conflict: two checks may agree on a change, e.g. the CRLF at the end of
+    /// the file. Returns false when the fix was dropped.
+    fn try_add(&mut self, mut edits: Vec<Edit>, rename_to: Option<String>) -> bool {
+        edits.retain(|edit| !self.contains(edit));
+        edits.sort_by_key(|edit| (edit.start, edit.end));
+        let self_overlapping = edits.windows(2).any(|pair| pair[0].overlaps(&pair[1]));
+        if self_overlapping
+            || (rename_to.is_some() && self.rename_to.is_some())
+            || edits.iter().any(|edit| self.conflicts_with(edit))
+        {
+            self.conflicts += 1;
+            return false;
+        }
+
+        for edit in edits {
+            let at = self.edits.partition_point(|e| (e.start, e.end) < (edit.start, edit.end));
+            self.edits.insert(at, edit);
+        }
+        if rename_to.is_some() {
+            self.rename_to = rename_to;
+        }
+        true
+    }
+
+    fn contains(&self, edit: &Edit) -> bool {
+        let at = self.edits.partition_point(|e| (e.start, e.end) < (edit.start, edit.end));
+        at < self.edits.len()
+            && self.edits[at].start == edit.start
+            && self.edits[at].end == edit.end
+            && self.edits[at].replacement == edit.replacement
+    }
+
+    /// Since accepted edits are sorted and disjoint, only the neighbours of the
+    /// insertion point can overlap
+    fn conflicts_with(&self, edit: &Edit) -> bool {
+        let at = self.edits.partition_point(|e| (e.start, e.end) < (edit.start, edit.end));
+        (at > 0 && self.edits[at - 1].overlaps(edit))
+            || (at < self.edits.len() && self.edits[at].overlaps(edit))
+    }
+
+    fn is_empty(&self) -> bool {
+        self.edits.is_empty() && self.rename_to.is_none()
+    }
+
+    fn apply(&self, content: &[u8]) -> Vec<u8> {
+        let added: usize = self.edits.iter().map(|edit| edit.replacement.len()).sum();
+        let mut out = Vec::with_capacity(content.len() + added);
+        let mut copied = 0usize;
+        for edit in &self.edits {
+            out.extend_from_slice(&content[copied..edit.start]);
+            out.extend_from_slice(&edit.replacement);
+            copied = edit.end;
+        }
+        out.extend_from_slice(&content[copied..]);
+        out
+    }
+}
+
+/// Merge the fixes a file's checks proposed, in check order. The message of a
+/// dropped fix is replaced with an error.
+pub fn plan_file(relative_path: &str, report: &mut FileReport) -> FilePlan {
+    let mut plan = FilePlan::default();
+    for fix in std::mem::take(&mut report.fixes) {
+        if !plan.try_add(fix.edits, fix.rename_to) {
+            report.messages[fix.message] = conflict_message(relative_path);
+        }
+    }
+    plan
+}
+
+fn conflict_message(relative_path: &str) -> String {
+    format!(
+        "  [ERROR] {} - fix overlaps an earlier fix to the same file and was not applied (run --fix again)",
+        relative_path
+    )
+}
+
+struct PendingFile {
+    path: String,
+    relative_path: String,
+    /// Content the edits refer to; None when only finalize() fixed the file, in
+    /// which case it is read just before writing
+    content: Option<Vec<u8>>,
+    plan: FilePlan,
+}
+
+/// Fixes waiting to be written, in the order their files were walked
+#[derive(Default)]
+pub struct PendingFixes {
+    files: Vec<PendingFile>,
+    by_path: HashMap<String, usize>,
+}
+
+impl PendingFixes {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Queue the plan the walker built for a file together with the content its
+    /// edits refer to
+    pub fn add_file(&mut self, path: &str, relative_path: &str, content: Vec<u8>, plan: FilePlan) {
+        self.by_path.insert(path.to_string(), self.files.len());
+        self.files.push(PendingFile {
+            path: path.to_string(),
+            relative_path: relative_path.to_string(),
+            content: Some(content),
+            plan,
+        });
+    }
+
+    /// Add a fix from finalize(). The edits refer to the content the file had
+    /// during the walk. Returns false (and counts a failure) when it conflicts
+    /// with a fix already queued for the file.
+    pub fn add(&mut self, path: &str, relative_path: &str, edits: Vec<Edit>) -> bool {
+        let index = match self.by_path.get(path) {
+            Some(&index) => index,
+            None => {
+                self.by_path.insert(path.to_string(), self.files.len());
+                self.files.push(PendingFile {
+                    path: path.to_string(),
+                    relative_path: relative_path.to_string(),
+                    content: None,
+                    plan: FilePlan::default(),
+                });
+                self.files.len() - 1
+            }
+        };
+        self.files[index].plan.try_add(edits, None)
+    }
+
+    /// Write every fixed file once. Reports files that could not be written to
+    /// `out` and returns the number of failures, including fixes dropped for conflicts.
+    pub fn write_all(self, out: &mut dyn Write) -> io::Result<i32> {
+        let mut failures = 0i32;
+        for file in self.files {
+            failures += file.plan.conflicts;
+            if file.plan.is_empty() {
+                continue;
+            }
+            if let Err(e) = write_file(&file) {
+                writeln!(out, "  [ERROR] Failed to write fixes to {}: {}", file.relative_path, e)?;
+                failures += 1;
+            }
+        }
+        Ok(failures)
+    }
+}
+
+fn write_file(file: &PendingFile) -> io::Result<()> {
+    let target = file.plan.rename_to.as_deref().unwrap_or(&file.path);
+    if file.plan.edits.is_empty() {
+        return fs::rename(&file.path, target);
+    }
+
+    let content = match &file.content {
+        Some(content) => apply_checked(&file.plan, content)?,
+        None => apply_checked(&file.plan, &fs::read(&file.path)?)?,
+    };
+    write_atomic_from(&file.path, target, &content)?;
+    if target != file.path {
+        fs::remove_file(&file.path)?;
+    }
+    Ok(())
+}
+
+fn apply_checked(plan: &FilePlan, content: &[u8]) -> io::Result<Vec<u8>> {
+    match plan.edits.last() {
+        Some(edit) if edit.end > content.len() => Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "file changed while it was being fixed",
+        )),
+        _ => Ok(plan.apply(content)),
+    }
+}
+
+/// Write `content` to `target` through a temporary file renamed over it, so readers
+/// never see a partially written file. Keeps the permissions of `original`.
+fn write_atomic_from(original: &str, target: &str, content: &[u8]) -> io::Result<()> {
+    let temp_path = format!("{}.tmp", target);
+    fs::write(&temp_path, content)?;
+    if let Ok(meta) = fs::metadata(original) {
+        // Best effort: a failure here leaves the default permissions
+        let _ = fs::set_permissions(&temp_path, meta.permissions());
+    }
+    fs::rename(&temp_path, target).inspect_err(|_| {
+        let _ = fs::remove_file(&temp_path);
+    })
+}
@@ -0,0 +1,453 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Read-only access to a git repository's object database, enough to resolve
+//! HEAD -> commit -> tree -> gitlink without spawning git.
+//!
+//! Supported: .git directories and .git files (submodules, worktrees) with their
+//! commondir, loose and packed refs, loose objects, version 2 pack indexes and
+//! packs with offset and reference deltas, and objects/info/alternates. Anything
+//! else (SHA-256 repositories, reftable, missing objects of partial clones) makes
+//! the lookup return None, and the caller falls back to running git.
+
+use std::fs::{self, File};
+use std::io::{Read, Seek, SeekFrom};
+use std::path::{Path, PathBuf};
+
+use crate::inflate::{zlib_decompress, InflateError};
+
+const OBJECT_ID_LEN: usize = 20;
+/// Symbolic refs followed before giving up
+const MAX_REF_DEPTH: usize = 5;
+/// Delta chains followed before giving up (git's default --depth is 50)
+const MAX_DELTA_DEPTH: usize = 1000;
+/// Sizes in object headers are untrusted: never reserve more than this up front
+const MAX_PREALLOC: usize = 1 << 24;
+const IDX_MAGIC: [u8; 4] = [0xff, b't', b'O', b'c'];
+const IDX_FANOUT_OFFSET: u64 = 8;
+const IDX_NAMES_OFFSET: u64 = IDX_FANOUT_OFFSET + 256 * 4;
+
+const OBJ_COMMIT: u8 = 1;
+const OBJ_TREE: u8 = 2;
+const OBJ_BLOB: u8 = 3;
+const OBJ_TAG: u8 = 4;
+const OBJ_OFS_DELTA: u8 = 6;
+const OBJ_REF_DELTA: u8 = 7;
+
+type ObjectId = [u8; OBJECT_ID_LEN];
+
+fn parse_hex_id(hex: &str) -> Option<ObjectId> {
+    let hex = hex.as_bytes();
+    if hex.len() != OBJECT_ID_LEN * 2 {
+        return None;
+    }
+    let mut id = [0u8; OBJECT_ID_LEN];
+    for (i, pair) in hex.chunks_exact(2).enumerate() {
+        let digit = |c: u8| (c as char).to_digit(16);
+        id[i] = (digit(pair[0])? * 16 + digit(pair[1])?) as u8;
+    }
+    Some(id)
+}
+
+fn to_hex(id: &ObjectId) -> String {
+    id.iter().map(|b| format!("{:02x}", b)).collect()
+}
+
+fn read_line(path: &Path) -> Option<String> {
+    let content = fs::read_to_string(path).ok()?;
+    Some(content.lines().next()?.trim().to_string())
+}
+
+/// A pack and its index
+struct Pack {
+    idx_path: PathBuf,
+    pack_path: PathBuf,
+}
+
+impl Pack {
+    /// Offset of `id` in the pack, from the version 2 index
+    fn find(&self, id: &ObjectId) -> Option<u64> {
+        let mut idx = File::open(&self.idx_path).ok()?;
+        let mut header = [0u8; 8];
+        idx.read_exact(&mut header).ok()?;
+        if header[..4] != IDX_MAGIC || u32::from_be_bytes(header[4..].try_into().unwrap()) != 2 {
+            return None;
+        }
+        let mut fanout = [0u8; 256 * 4];
+        idx.read_exact(&mut fanout).ok()?;
+        let fanout_at = |i: usize| u32::from_be_bytes(fanout[i * 4..i * 4 + 4].try_into().unwrap()) as u64;
+        let total = fanout_at(255);
+        let first = if id[0] == 0 { 0 } else { fanout_at(id[0] as usize - 1) };
+        let last = fanout_at(id[0] as usize);
+        if first >= last {
+            return None;
+        }
+
+        // The ids of the bucket are sorted
+        let mut names = vec![0u8; ((last - first) as usize) * OBJECT_ID_LEN];
+        idx.seek(SeekFrom::Start(IDX_NAMES_OFFSET + first * OBJECT_ID_LEN as u64)).ok()?;
+        idx.read_exact(&mut names).ok()?;
+        let position = names
+            .chunks_exact(OBJECT_ID_LEN)
+            .collect::<Vec<_>>()
+            .binary_search(&&id[..])
+            .ok()? as u64
+            + first;
+
+        // Names, then CRCs, then 4-byte offsets, then 8-byte offsets for large packs
+        let offsets_at = IDX_NAMES_OFFSET + total * (OBJECT_ID_LEN as u64 + 4);
+        let mut word = [0u8; 4];
+        idx.seek(SeekFrom::Start(offsets_at + position * 4)).ok()?;
+        idx.read_exact(&mut word).ok()?;
+        let offset = u32::from_be_bytes(word);
+        if offset & 0x8000_0000 == 0 {
+            return Some(offset as u64);
+        }
+        let mut large = [0u8; 8];
+        let large_at = offsets_at + total * 4 + (offset & 0x7fff_ffff) as u64 * 8;
+        idx.seek(SeekFrom::Start(large_at)).ok()?;
+        idx.read_exact(&mut large).ok()?;
+        Some(u64::from_be_bytes(large))
+    }
+}
+
+/// Inflate the zlib stream at the current position of `file`, which decompresses
+/// to `size` bytes. The compressed length is not stored, so read a generous chunk
+/// and grow it if the stream runs past its end.
+fn inflate_at(file: &mut File, at: u64, size: usize) -> Option<Vec<u8>> {
+    // The stream cannot run past the end of the pack
+    let available = file.metadata().ok()?.len().saturating_sub(at);
+    let available = usize::try_from(available).unwrap_or(usize::MAX);
+    let mut chunk = size.checked_add(size / 2)?.checked_add(1024)?;
+    loop {
+        let mut compressed = Vec::with_capacity(chunk.min(available));
+        file.seek(SeekFrom::Start(at)).ok()?;
+        file.by_ref().take(chunk as u64).read_to_end(&mut compressed).ok()?;
+        match zlib_decompress(&compressed, size.min(MAX_PREALLOC)) {
+            Ok((data, _)) if data.len() == size => return Some(data),
+            Err(InflateError::NeedInput) if compressed.len() == chunk => chunk = chunk.checked_mul(4)?,
+            _ => return None,
+        }
+    }
+}
+
+/// Little-endian base-128 size used by deltas
+fn delta_size(delta: &[u8], pos: &mut usize) -> Option<usize> {
+    let mut size = 0usize;
+    let mut shift = 0;
+    loop {
+        let byte = *delta.get(*pos)?;
+        *pos += 1;
+        size |= ((byte & 0x7f) as usize) << shift;
+        shift += 7;
+        if byte & 0x80 == 0 || shift > 56 {
+            return Some(size);
+        }
+    }
+}
+
+fn apply_delta(base: &[u8], delta: &[u8]) -> Option<Vec<u8>> {
+    let mut pos = 0;
+    if delta_size(delta, &mut pos)? != base.len() {
+        return None;
+    }
+    let result_size = delta_size(delta, &mut pos)?;
+    let mut out = Vec::with_capacity(result_size.min(MAX_PREALLOC));
+    while pos < delta.len() {
+        let op = delta[pos];
+        pos += 1;
+        if op & 0x80 != 0 {
+            // Copy from the base: the low 4 bits select offset bytes, the next 3 size bytes
+            let mut offset = 0usize;
+            let mut size = 0usize;
+            for i in 0..4 {
+                if op & (1 << i) != 0 {
+                    offset |= (*delta.get(pos)? as usize) << (8 * i);
+                    pos += 1;
+                }
+            }
+            for i in 0..3 {
+                if op & (0x10 << i) != 0 {
+                    size |= (*delta.get(pos)? as usize) << (8 * i);
+                    pos += 1;
+                }
+            }
+            if size == 0 {
+                size = 0x10000;
+            }
+            out.extend_from_slice(base.get(offset..offset.checked_add(size)?)?);
+        } else if op != 0 {
+            // Insert the next `op` bytes
+            out.extend_from_slice(delta.get(pos..pos + op as usize)?);
+            pos += op as usize;
+        } else {
+            return None;
+        }
+        if out.len() > result_size {
+            return None;
+        }
+    }
+    if out.len() == result_size {
+        Some(out)
+    } else {
+        None
+    }
+}
+
+pub struct GitRepository {
+    /// Per-worktree directory (HEAD)
+    git_dir: PathBuf,
+    /// Shared directory (objects, refs, packed-refs); git_dir unless a commondir file says otherwise
+    common_dir: PathBuf,
+    /// objects/ and its alternates
+    object_dirs: Vec<PathBuf>,
+    packs: Vec<Pack>,
+}
+
+impl GitRepository {
+    /// Open the repository whose work tree is `repo_root`
+    pub fn open(repo_root: &str) -> Option<Self> {
+        let dot_git = Path::new(repo_root).join(".git");
+        let git_dir = if dot_git.is_dir() {
+            dot_git
+        } else {
+            // "gitdir: <path>", relative to the work tree
+            let target = read_line(&dot_git)?.strip_prefix("gitdir:")?.trim().to_string();
+            Path::new(repo_root).join(target)
+        };
+        let common_dir = match read_line(&git_dir.join("commondir")) {
+            Some(relative) => git_dir.join(relative),
+            None => git_dir.clone(),
+        };
+
+        // Only SHA-1 object names are understood
+        if let Ok(config) = fs::read_to_string(common_dir.join("config")) {
+            let sha256 = |line: &str| {
+                let line = line.trim().to_ascii_lowercase();
+                line.starts_with("objectformat") && line.contains("sha256")
+            };
+            if config.lines().any(sha256) {
+                return None;
+            }
+        }
+
+        let objects = common_dir.join("objects");
+        let mut object_dirs = vec![objects.clone()];
+        if let Ok(alternates) = fs::read_to_string(objects.join("info").join("alternates")) {
+            for line in alternates.lines().map(str::trim).filter(|l| !l.is_empty() && !l.starts_with('#')) {
+                object_dirs.push(objects.join(line));
+            }
+        }
+
+        let mut packs = Vec::new();
+        for dir in &object_dirs {
+            let entries = match fs::read_dir(dir.join("pack")) {
+                Ok(entries) => entries,
+                Err(_) => continue,
+            };
+            for entry in entries.flatten() {
+                let idx_path = entry.path();
+                if idx_path.extension().is_some_and(|e| e == "idx") {
+                    let pack_path = idx_path.with_extension("pack");
+                    if pack_path.is_file() {
+                        packs.push(Pack { idx_path, pack_path });
+                    }
+                }
+            }
+        }
+
+        Some(Self {
+            git_dir,
+            common_dir,
+            object_dirs,
+            packs,
+        })
+    }
+
+    /// Object id of `name` ("HEAD" or a full ref name), following symbolic refs
+    fn resolve_ref(&self, name: &str) -> Option<ObjectId> {
+        let mut name = name.to_string();
+        for _ in 0..MAX_REF_DEPTH {
+            // HEAD and other pseudo-refs are per worktree, branches are shared
+            let dir = if name.starts_with("refs/") { &self.common_dir } else { &self.git_dir };
+            let value = match read_line(&dir.join(&name)) {
+                Some(value) => value,
+                None => self.packed_ref(&name)?,
+            };
+            match value.strip_prefix("ref:") {
+                Some(target) => name = target.trim().to_string(),
+                None => return parse_hex_id(&value),
+            }
+        }
+        None
+    }
+
+    fn packed_ref(&self, name: &str) -> Option<String> {
+        let packed = fs::read_to_string(self.common_dir.join("packed-refs")).ok()?;
+        packed
+            .lines()
+            .filter(|line| !line.starts_with('#') && !line.starts_with('^'))
+            .find_map(|line| {
+                let (id, ref_name) = line.split_once(' ')?;
+                (ref_name.trim() == name).then(|| id.to_string())
+            })
+    }
+
+    /// Type and content of an object
+    fn read_object(&self, id: &ObjectId) -> Option<(u8, Vec<u8>)> {
+        self.read_object_at_depth(id, 0)
+    }
+
+    /// Type and content of an object reached `depth` deltas down a chain
+    fn read_object_at_depth(&self, id: &ObjectId, depth: usize) -> Option<(u8, Vec<u8>)> {
+        let hex = to_hex(id);
+        for dir in &self.object_dirs {
+            let path = dir.join(&hex[..2]).join(&hex[2..]);
+            if let Ok(compressed) = fs::read(&path) {
+                return Self::parse_loose(&compressed);
+            }
+        }
+        for pack in &self.packs {
+            if let Some(offset) = pack.find(id) {
+                let mut file = File::open(&pack.pack_path).ok()?;
+                return self.read_packed(&mut file, offset, depth);
+            }
+        }
+        None
+    }
+
+    /// A loose object: zlib of "<type> <size>\0<content>"
+    fn parse_loose(compressed: &[u8]) -> Option<(u8, Vec<u8>)> {
+        let (data, _) = zlib_decompress(compressed, compressed.len() * 2).ok()?;
+        let header_end = data.iter().position(|&b| b == 0)?;
+        let header = std::str::from_utf8(&data[..header_end]).ok()?;
+        let (kind, size) = header.split_once(' ')?;
+        let kind = match kind {
+            "commit" => OBJ_COMMIT,
+            "tree" => OBJ_TREE,
+            "blob" => OBJ_BLOB,
+            "tag" => OBJ_TAG,
+            _ => return None,
+        };
+        let content = data[header_end + 1..].to_vec();
+        if content.len() != size.parse::<usize>().ok()? {
+            return None;
+        }
+        Some((kind, content))
+    }
+
+    fn read_packed(&self, file: &mut File, offset: u64, depth: usize) -> Option<(u8, Vec<u8>)> {
+        if depth > MAX_DELTA_DEPTH {
+            return None;
+        }
+        // Header: type and size, then the base of a delta, at most a few dozen bytes
+        let mut header = Vec::with_capacity(32);
+        file.seek(SeekFrom::Start(offset)).ok()?;
+        file.by_ref().take(32).read_to_end(&mut header).ok()?;
+
+        let mut pos = 0;
+        let mut byte = *header.get(pos)?;
+        pos += 1;
+        let kind = (byte >> 4) & 7;
+        let mut size = (byte & 0x0f) as usize;
+        let mut shift = 4;
+        while byte & 0x80 != 0 {
+            byte = *header.get(pos)?;
+            pos += 1;
+            // A size that does not fit is corrupt, not something to wrap
+            if shift > usize::BITS - 7 {
+                return None;
+            }
+            size |= ((byte & 0x7f) as usize) << shift;
+            shift += 7;
+        }
+
+        match kind {
+            OBJ_COMMIT | OBJ_TREE | OBJ_BLOB | OBJ_TAG => {
+                let data = inflate_at(file, offset + pos as u64, size)?;
+                Some((kind, data))
+            }
+            OBJ_OFS_DELTA => {
+                // Big-endian base-128 distance back to the base, with an offset of 1 per continuation
+                let mut byte = *header.get(pos)?;
+                pos += 1;
+                let mut distance = (byte & 0x7f) as u64;
+                while byte & 0x80 != 0 {
+                    byte = *header.get(pos)?;
+                    pos += 1;
+                    distance = ((distance + 1) << 7) | (byte & 0x7f) as u64;
+                }
+                let delta = inflate_at(file, offset + pos as u64, size)?;
+                let (base_kind, base) = self.read_packed(file, offset.checked_sub(distance)?, depth + 1)?;
+                Some((base_kind, apply_delta(&base, &delta)?))
+            }
+            OBJ_REF_DELTA => {
+                let base_id: ObjectId = header.get(pos..pos + OBJECT_ID_LEN)?.try_into().ok()?;
+                pos += OBJECT_ID_LEN;
+                let delta = inflate_at(file, offset + pos as u64, size)?;
+                let (base_kind, base) = self.read_object_at_depth(&base_id, depth + 1)?;
+                Some((base_kind, apply_delta(&base, &delta)?))
+            }
+            _ => None,
+        }
+    }
+
+    /// The tree of a commit, peeling tags
+    fn commit_tree(&self, id: &ObjectId) -> Option<ObjectId> {
+        let mut id = *id;
+        for _ in 0..MAX_REF_DEPTH {
+            let (kind, content) = self.read_object(&id)?;
+            let first_line = content.split(|&b| b == b'\n').next()?;
+            let first_line = std::str::from_utf8(first_line).ok()?;
+            match kind {
+                OBJ_COMMIT => return parse_hex_id(first_line.strip_prefix("tree ")?),
+                OBJ_TAG => id = parse_hex_id(first_line.strip_prefix("object ")?)?,
+                _ => return None,
+            }
+        }
+        None
+    }
+
+    /// Mode and id of the entry `name` of a tree
+    fn tree_entry(&self, tree: &ObjectId, name: &str) -> Option<(u32, ObjectId)> {
+        let (kind, content) = self.read_object(tree)?;
+        if kind != OBJ_TREE {
+            return None;
+        }
+        // Entries: "<octal mode> <name>\0<20-byte id>"
+        let mut pos = 0;
+        while pos < content.len() {
+            let space = pos + content[pos..].iter().position(|&b| b == b' ')?;
+            let nul = space + content[space..].iter().position(|&b| b == 0)?;
+            let id_end = nul + 1 + OBJECT_ID_LEN;
+            if &content[space + 1..nul] == name.as_bytes() {
+                let mode = u32::from_str_radix(std::str::from_utf8(&content[pos..space]).ok()?, 8).ok()?;
+                return Some((mode, content.get(nul + 1..id_end)?.try_into().ok()?));
+            }
+            pos = id_end;
+        }
+        None
+    }
+
+    /// Commit recorded at `path` (a submodule) in the tree of HEAD
+    pub fn gitlink_at_head(&self, path: &str) -> Option<String> {
+        const GITLINK_MODE: u32 = 0o160000;
+        const TREE_MODE: u32 = 0o40000;
+
+        let head = self.resolve_ref("HEAD")?;
+        let mut tree = self.commit_tree(&head)?;
+        let components: Vec<&str> = path.split(['/', '\\']).filter(|c| !c.is_empty() && *c != ".").collect();
+        let (last, parents) = components.split_last()?;
+        for component in parents {
+            let (mode, id) = self.tree_entry(&tree, component)?;
+            if mode != TREE_MODE {
+                return None;
+            }
+            tree = id;
+        }
+        match self.tree_entry(&tree, last)? {
+            (GITLINK_MODE, id) => Some(to_hex(&id)),
+            _ => None,
+        }
+    }
+}
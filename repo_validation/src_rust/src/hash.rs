@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Stable 64-bit content hash.
+//!
+//! std's DefaultHasher is not guaranteed to produce the same values across Rust
+//! releases, so anything persisted to disk (the result cache) uses this instead.
+//! It is a multiply-fold hash over 8-byte words: fast, and good enough to detect
+//! changed content. It is not meant to resist deliberately crafted collisions.
+
+const SEED: u64 = 0x243f_6a88_85a3_08d3;
+const K0: u64 = 0xa076_1d64_78bd_642f;
+const K1: u64 = 0xe703_7ed1_a0b4_28db;
+
+fn fold(a: u64, b: u64) -> u64 {
+    let product = (a as u128).wrapping_mul(b as u128);
+    (product as u64) ^ ((product >> 64) as u64)
+}
+
+/// Fold `a` and `b` into one word. The product alone is 0 whenever either operand
+/// is, which would drop the other one (a content word equal to K1, say); both are
+/// folded back in so that every input bit always reaches the result.
+fn mix(a: u64, b: u64) -> u64 {
+    fold(a, b) ^ a ^ b.rotate_left(32)
+}
+
+fn read_u64(bytes: &[u8]) -> u64 {
+    let mut word = [0u8; 8];
+    word.copy_from_slice(&bytes[..8]);
+    u64::from_le_bytes(word)
+}
+
+/// Hash a byte slice
+pub fn hash64(bytes: &[u8]) -> u64 {
+    let mut state = SEED ^ (bytes.len() as u64).wrapping_mul(K0);
+
+    let mut chunks = bytes.chunks_exact(16);
+    for chunk in &mut chunks {
+        let a = read_u64(&chunk[..8]);
+        let b = read_u64(&chunk[8..]);
+        state = mix(a ^ K0 ^ state, b ^ K1);
+    }
+
+    let rest = chunks.remainder();
+    if !rest.is_empty() {
+        let mut tail = [0u8; 16];
+        tail[..rest.len()].copy_from_slice(rest);
+        let a = read_u64(&tail[..8]);
+        let b = read_u64(&tail[8..]);
+        state = mix(a ^ K0 ^ state, b ^ K1 ^ rest.len() as u64);
+    }
+
+    mix(state ^ K1, state ^ K0 ^ bytes.len() as u64)
+}
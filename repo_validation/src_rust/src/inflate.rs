@@ -0,0 +1,281 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! zlib (RFC 1950) and DEFLATE (RFC 1951) decompression, for reading git objects.
+//!
+//! Huffman codes are decoded one bit at a time from the code length counts, as in
+//! zlib's reference decoder puff.c. That is slower than table-driven decoding but
+//! small, and git metadata objects are only a few KB.
+
+#[derive(Debug, PartialEq, Eq)]
+pub enum InflateError {
+    /// The input ended before the stream did; retry with more of it
+    NeedInput,
+    Corrupt,
+}
+
+const MAX_BITS: usize = 15;
+const MAX_LITLEN_CODES: usize = 288;
+const MAX_DIST_CODES: usize = 30;
+
+const LENGTH_BASE: [u16; 29] = [
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+];
+const LENGTH_EXTRA: [u8; 29] = [0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0];
+const DIST_BASE: [u16; 30] = [
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577,
+];
+const DIST_EXTRA: [u8; 30] = [0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13];
+/// Order in which the code length code lengths are stored in a dynamic block header
+const CODE_LENGTH_ORDER: [usize; 19] = [16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15];
+
+struct Bits<'a> {
+    input: &'a [u8],
+    pos: usize,
+    buffer: u32,
+    count: u32,
+}
+
+impl Bits<'_> {
+    /// The next `n` (at most 16) bits, least significant first
+    fn take(&mut self, n: u32) -> Result<u32, InflateError> {
+        while self.count < n {
+            let byte = *self.input.get(self.pos).ok_or(InflateError::NeedInput)?;
+            self.pos += 1;
+            self.buffer |= (byte as u32) << self.count;
+            self.count += 8;
+        }
+        let value = self.buffer & ((1u32 << n) - 1);
+        self.buffer >>= n;
+        self.count -= n;
+        Ok(value)
+    }
+
+    /// Drop the bits left in the current byte
+    fn align(&mut self) {
+        self.buffer = 0;
+        self.count = 0;
+    }
+
+    fn byte(&mut self) -> Result<u8, InflateError> {
+        let byte = *self.input.get(self.pos).ok_or(InflateError::NeedInput)?;
+        self.pos += 1;
+        Ok(byte)
+    }
+}
+
+/// A canonical Huffman code: the number of codes of each length, and the symbols
+/// ordered by code
+struct Huffman {
+    counts: [u16; MAX_BITS + 1],
+    symbols: Vec<u16>,
+}
+
+impl Huffman {
+    fn new(lengths: &[u8]) -> Result<Self, InflateError> {
+        let mut counts = [0u16; MAX_BITS + 1];
+        for &length in lengths {
+            counts[length as usize] += 1;
+        }
+        // Reject over-subscribed codes; incomplete ones are allowed (single distance codes)
+        let mut left = 1i32;
+        for &count in &counts[1..] {
+            left = (left << 1) - count as i32;
+            if left < 0 {
+                return Err(InflateError::Corrupt);
+            }
+        }
+        let mut offsets = [0u16; MAX_BITS + 2];
+        for length in 1..=MAX_BITS {
+            offsets[length + 1] = offsets[length] + counts[length];
+        }
+        let mut symbols = vec![0u16; lengths.len()];
+        for (symbol, &length) in lengths.iter().enumerate() {
+            if length != 0 {
+                symbols[offsets[length as usize] as usize] = symbol as u16;
+                offsets[length as usize] += 1;
+            }
+        }
+        counts[0] = 0;
+        Ok(Self { counts, symbols })
+    }
+
+    fn decode(&self, bits: &mut Bits) -> Result<u16, InflateError> {
+        let mut code = 0i32;
+        let mut first = 0i32;
+        let mut index = 0i32;
+        for length in 1..=MAX_BITS {
+            code |= bits.take(1)? as i32;
+            let count = self.counts[length] as i32;
+            if code - first < count {
+                return Ok(self.symbols[(index + code - first) as usize]);
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        Err(InflateError::Corrupt)
+    }
+}
+
+fn fixed_codes() -> (Huffman, Huffman) {
+    let mut lengths = [0u8; MAX_LITLEN_CODES];
+    lengths[..144].fill(8);
+    lengths[144..256].fill(9);
+    lengths[256..280].fill(7);
+    lengths[280..].fill(8);
+    let litlen = Huffman::new(&lengths).unwrap();
+    let dist = Huffman::new(&[5u8; MAX_DIST_CODES]).unwrap();
+    (litlen, dist)
+}
+
+fn dynamic_codes(bits: &mut Bits) -> Result<(Huffman, Huffman), InflateError> {
+    let litlen_count = bits.take(5)? as usize + 257;
+    let dist_count = bits.take(5)? as usize + 1;
+    let code_length_count = bits.take(4)? as usize + 4;
+    if litlen_count > MAX_LITLEN_CODES || dist_count > MAX_DIST_CODES {
+        return Err(InflateError::Corrupt);
+    }
+
+    let mut code_lengths = [0u8; 19];
+    for &symbol in &CODE_LENGTH_ORDER[..code_length_count] {
+        code_lengths[symbol] = bits.take(3)? as u8;
+    }
+    let code_length_code = Huffman::new(&code_lengths)?;
+
+    let mut lengths = vec![0u8; litlen_count + dist_count];
+    let mut i = 0;
+    while i < lengths.len() {
+        let symbol = code_length_code.decode(bits)?;
+        let (value, repeat) = match symbol {
+            0..=15 => (symbol as u8, 1),
+            16 => {
+                let previous = *lengths[..i].last().ok_or(InflateError::Corrupt)?;
+                (previous, 3 + bits.take(2)? as usize)
+            }
+            17 => (0, 3 + bits.take(3)? as usize),
+            18 => (0, 11 + bits.take(7)? as usize),
+            _ => return Err(InflateError::Corrupt),
+        };
+        if i + repeat > lengths.len() {
+            return Err(InflateError::Corrupt);
+        }
+        lengths[i..i + repeat].fill(value);
+        i += repeat;
+    }
+    if lengths[256] == 0 {
+        // No end-of-block code
+        return Err(InflateError::Corrupt);
+    }
+    let litlen = Huffman::new(&lengths[..litlen_count])?;
+    let dist = Huffman::new(&lengths[litlen_count..])?;
+    Ok((litlen, dist))
+}
+
+fn inflate_block(bits: &mut Bits, litlen: &Huffman, dist: &Huffman, out: &mut Vec<u8>) -> Result<(), InflateError> {
+    loop {
+        let symbol = litlen.decode(bits)? as usize;
+        if symbol < 256 {
+            out.push(symbol as u8);
+            continue;
+        }
+        if symbol == 256 {
+            return Ok(());
+        }
+        let symbol = symbol - 257;
+        if symbol >= LENGTH_BASE.len() {
+            return Err(InflateError::Corrupt);
+        }
+        let length = LENGTH_BASE[symbol] as usize + bits.take(LENGTH_EXTRA[symbol] as u32)? as usize;
+        let symbol = dist.decode(bits)? as usize;
+        if symbol >= DIST_BASE.len() {
+            return Err(InflateError::Corrupt);
+        }
+        let distance = DIST_BASE[symbol] as usize + bits.take(DIST_EXTRA[symbol] as u32)? as usize;
+        if distance > out.len() {
+            return Err(InflateError::Corrupt);
+        }
+        // The copy may overlap its own output, so go byte by byte
+        let start = out.len() - distance;
+        for i in 0..length {
+            out.push(out[start + i]);
+        }
+    }
+}
+
+/// Decompress a raw DEFLATE stream. Returns the output and the number of input
+/// bytes consumed.
+pub fn inflate(input: &[u8], size_hint: usize) -> Result<(Vec<u8>, usize), InflateError> {
+    let mut bits = Bits {
+        input,
+        pos: 0,
+        buffer: 0,
+        count: 0,
+    };
+    let mut out = Vec::with_capacity(size_hint);
+    loop {
+        let last = bits.take(1)? == 1;
+        match bits.take(2)? {
+            0 => {
+                bits.align();
+                let len = bits.byte()? as usize | (bits.byte()? as usize) << 8;
+                let complement = bits.byte()? as usize | (bits.byte()? as usize) << 8;
+                if len != !complement & 0xffff {
+                    return Err(InflateError::Corrupt);
+                }
+                let data = input.get(bits.pos..bits.pos + len).ok_or(InflateError::NeedInput)?;
+                out.extend_from_slice(data);
+                bits.pos += len;
+            }
+            1 => {
+                let (litlen, dist) = fixed_codes();
+                inflate_block(&mut bits, &litlen, &dist, &mut out)?;
+            }
+            2 => {
+                let (litlen, dist) = dynamic_codes(&mut bits)?;
+                inflate_block(&mut bits, &litlen, &dist, &mut out)?;
+            }
+            _ => return Err(InflateError::Corrupt),
+        }
+        if last {
+            // Bits left in the buffer belong to the last byte read
+            return Ok((out, bits.pos));
+        }
+    }
+}
+
+fn adler32(data: &[u8]) -> u32 {
+    const MOD: u32 = 65521;
+    let (mut a, mut b) = (1u32, 0u32);
+    // 5552 is the most bytes that can be summed before b overflows
+    for chunk in data.chunks(5552) {
+        for &byte in chunk {
+            a += byte as u32;
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+    }
+    (b << 16) | a
+}
+
+/// Decompress a zlib stream and verify its checksum. Returns the output and the
+/// number of input bytes consumed.
+pub fn zlib_decompress(input: &[u8], size_hint: usize) -> Result<(Vec<u8>, usize), InflateError> {
+    if input.len() < 2 {
+        return Err(InflateError::NeedInput);
+    }
+    let (cmf, flags) = (input[0], input[1]);
+    // Deflate, a window of at most 32K, a valid header check and no preset dictionary
+    if cmf & 0x0f != 8 || cmf >> 4 > 7 || ((cmf as u16) << 8 | flags as u16) % 31 != 0 || flags & 0x20 != 0 {
+        return Err(InflateError::Corrupt);
+    }
+    let (out, used) = inflate(&input[2..], size_hint)?;
+    let end = 2 + used;
+    let checksum = input.get(end..end + 4).ok_or(InflateError::NeedInput)?;
+    if u32::from_be_bytes(checksum.try_into().unwrap()) != adler32(&out) {
+        return Err(InflateError::Corrupt);
+    }
+    Ok((out, end + 4))
+}
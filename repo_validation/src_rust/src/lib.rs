@@ -0,0 +1,229 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Repository validator for the c-build-tools based repositories.
+//!
+//! The repo_validator_rs binary walks a repository on disk and prints a report
+//! (validate()). Tools that already hold the files - git hooks, editors - use
+//! the api module instead: it runs the same checks on in-memory buffers and
+//! returns structured findings. The other modules are public for the binary.
+
+pub mod api;
+pub mod c_lexer;
+pub mod cache;
+pub mod changed_files;
+pub mod checks;
+pub mod codec;
+pub mod config;
+#[cfg(all(target_os = "linux", any(target_arch = "x86_64", target_arch = "aarch64", target_arch = "riscv64")))]
+pub mod dir_reader;
+pub mod exclusions;
+pub mod file_walker;
+pub mod fixes;
+pub mod git_objects;
+pub mod hash;
+pub mod inflate;
+pub mod line_index;
+pub mod memory;
+pub mod prefilter;
+pub mod scan;
+pub mod srs_index;
+pub mod timings;
+#[cfg(target_os = "linux")]
+pub mod uring;
+#[cfg(target_os = "linux")]
+pub mod watch;
+pub mod work_queue;
+pub mod workspace;
+
+pub use api::{validate_files, CheckSummary, Finding, Severity, Validation, Validator};
+
+use std::io::{self, Write};
+
+use cache::ResultCache;
+use checks::Check;
+use config::{CheckOutput, ValidatorConfig};
+use file_walker::FileTask;
+
+/// Print the options of the run and the checks it will run
+pub fn print_header(config: &ValidatorConfig, active_checks: &[Box<dyn Check>]) {
+    println!("========================================");
+    println!("Repository Validator");
+    println!("========================================");
+    println!("Repository Root: {}", config.repo_root);
+    println!("Fix Mode: {}", if config.fix_mode { "ON" } else { "OFF" });
+    println!("Worker threads: {}", config.jobs);
+    if let Some(path) = &config.cache_path {
+        println!("Result cache: {}", path);
+    }
+    if let Some(paths) = &config.changed_paths {
+        if config.staged.is_some() {
+            println!("Staged mode: {} staged path(s)", paths.len());
+        } else {
+            println!("Incremental mode: {} changed path(s)", paths.len());
+        }
+    }
+    print!("Excluded folders: ");
+    for (idx, folder) in config.exclusions.folders().iter().enumerate() {
+        if idx > 0 {
+            print!(", ");
+        }
+        print!("{}", folder);
+    }
+    println!();
+    if config.exclusions.gitignore() {
+        println!("Ignored paths: .gitignore, .git/info/exclude");
+    }
+    print!("Active checks: ");
+    for (idx, check) in active_checks.iter().enumerate() {
+        if idx > 0 {
+            print!(", ");
+        }
+        print!("{}", check.name());
+    }
+    println!("\n");
+}
+
+fn print_lines(out: &mut dyn Write, check_output: &CheckOutput) -> io::Result<()> {
+    for line in &check_output.lines {
+        writeln!(out, "{}", line)?;
+    }
+    Ok(())
+}
+
+/// What a run found, as data (see validate_into)
+pub struct Outcome {
+    pub violations: i32,
+    /// Findings of the checks' init() and finalize(), in check order: those that
+    /// are not about a single file's content, or need every file's results
+    pub check_findings: Vec<Finding>,
+    /// Every active check, in check order
+    pub checks: Vec<CheckSummary>,
+    /// The results to reuse next time (None when caching is off)
+    pub cache: Option<ResultCache>,
+}
+
+/// Run the active checks over the repository, printing their findings, the summary
+/// and the verdict. Unchanged files replay their results from `cache` (None turns
+/// caching off). Returns the number of violations and the results to reuse next time,
+/// or the error that kept the SRS index (--srs-index-out) or the trace (--trace-out)
+/// from being written; the caller decides whether the process exits.
+pub fn validate(
+    config: &ValidatorConfig,
+    active_checks: &mut Vec<Box<dyn Check>>,
+    cache: Option<ResultCache>,
+) -> io::Result<(i32, Option<ResultCache>)> {
+    let outcome = validate_into(config, active_checks, cache, &mut io::stdout(), &mut |_, _| {})?;
+    Ok((outcome.violations, outcome.cache))
+}
+
+/// validate(), printing the report to `out`. `on_file` receives every file a
+/// check looked at, with the findings the checks reported for it; the other
+/// findings are returned with the verdict of each check.
+pub fn validate_into(
+    config: &ValidatorConfig,
+    active_checks: &mut Vec<Box<dyn Check>>,
+    cache: Option<ResultCache>,
+    out: &mut dyn Write,
+    on_file: &mut dyn FnMut(&FileTask, Vec<Finding>),
+) -> io::Result<Outcome> {
+    let mut profiler = timings::Profiler::new(config);
+    let mut outcome = Outcome {
+        violations: 0,
+        check_findings: Vec::new(),
+        checks: Vec::new(),
+        cache: None,
+    };
+
+    // Initialize checks
+    for (index, check) in active_checks.iter_mut().enumerate() {
+        let started = profiler.start();
+        let mut check_output = CheckOutput::default();
+        check.init(config, &mut check_output);
+        profiler.check_phase(started, index, check.name(), "init");
+        print_lines(out, &check_output)?;
+        outcome
+            .check_findings
+            .extend(check_output.findings.into_iter().map(|finding| Finding::new(check.name(), finding)));
+    }
+
+    // Walk repository and run checks
+    writeln!(out, "Scanning repository...")?;
+    let mut fixes = fixes::PendingFixes::new();
+    let started = profiler.start();
+    let names: Vec<String> = active_checks.iter().map(|check| check.name().to_string()).collect();
+    let mut collect = |task: &FileTask, reports: Vec<(usize, Vec<config::Finding>)>| {
+        let findings = reports
+            .into_iter()
+            .flat_map(|(index, reported)| {
+                let name = &names[index];
+                reported.into_iter().map(move |finding| Finding::new(name, finding))
+            })
+            .collect();
+        on_file(task, findings);
+    };
+    let walk = file_walker::walk_repository(config, active_checks, &mut fixes, cache, &mut profiler, out, &mut collect)?;
+    profiler.span(started, "walk", None);
+    let srs_index = walk.srs_index;
+
+    if let Some(path) = &config.srs_index_out {
+        srs_index
+            .write_to(path)
+            .map_err(|e| io::Error::new(e.kind(), format!("could not write SRS index {}: {}", path, e)))?;
+        writeln!(out, "SRS index written to {}", path)?;
+    }
+
+    // Finalize checks
+    writeln!(out)?;
+    writeln!(out, "========================================")?;
+    writeln!(out, "Validation Summary")?;
+    writeln!(out, "========================================")?;
+
+    for (index, check) in active_checks.iter_mut().enumerate() {
+        let started = profiler.start();
+        let mut check_output = CheckOutput::default();
+        let check_result = check.finalize(config, &srs_index, &mut fixes, &mut check_output);
+        profiler.check_phase(started, index, check.name(), "finalize");
+        print_lines(out, &check_output)?;
+        let status = if check_result == 0 {
+            "PASSED"
+        } else {
+            "FAILED"
+        };
+        writeln!(out, "  {:<25} [{}]", check.name(), status)?;
+        if check_result > 0 {
+            outcome.violations += check_result;
+        }
+        outcome
+            .check_findings
+            .extend(check_output.findings.into_iter().map(|finding| Finding::new(check.name(), finding)));
+        outcome.checks.push(CheckSummary {
+            name: check.name().to_string(),
+            violations: check_result.max(0),
+        });
+    }
+
+    // Every fixed file is written once, after all checks had their say
+    let started = profiler.start();
+    outcome.violations += fixes.write_all(out)?;
+    profiler.span(started, "write fixes", None);
+
+    if config.timings {
+        profiler.print_table(out)?;
+    }
+    if let Some(path) = &config.trace_out {
+        profiler
+            .write_trace(path)
+            .map_err(|e| io::Error::new(e.kind(), format!("could not write trace {}: {}", path, e)))?;
+        writeln!(out, "Trace written to {}", path)?;
+    }
+
+    writeln!(out)?;
+    if outcome.violations > 0 {
+        writeln!(out, "[VALIDATION FAILED]")?;
+    } else {
+        writeln!(out, "[VALIDATION PASSED]")?;
+    }
+    outcome.cache = walk.cache;
+    Ok(outcome)
+}
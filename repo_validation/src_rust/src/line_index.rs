@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Line table for one file's content, built once and shared by every check that
+//! reports line numbers or walks the file line by line (see FileInfo::lines).
+
+use std::cell::RefCell;
+
+use crate::scan;
+
+/// Content from which the table keeps one offset per chunk of lines instead of one per line
+const CHUNKED_BYTES: usize = 8 << 20;
+
+/// Lines per chunk in a chunked table
+const CHUNK_LINES: usize = 1024;
+
+/// Start offset of the lines of one file. A small file has one chunk holding every
+/// line. A huge one keeps the start of every CHUNK_LINES-th line only: the starts
+/// of a chunk's lines are found by scanning it when one of them is looked up, and
+/// kept until a line of another chunk is, so walking the lines in order scans the
+/// content once.
+pub struct LineTable {
+    lines: usize,
+    chunk_lines: usize,
+    /// Offset of the first line of every chunk
+    chunks: Vec<usize>,
+    /// Index of the chunk last scanned, and the start of each of its lines
+    /// followed by the start of the next line (content length + 1 after the last)
+    scanned: RefCell<(usize, Vec<usize>)>,
+}
+
+impl LineTable {
+    pub fn new(content: &[u8]) -> Self {
+        if content.len() < CHUNKED_BYTES {
+            let starts = scan_lines(content, 0, usize::MAX, scan::count_newlines(content) + 2);
+            return Self {
+                lines: starts.len() - 1,
+                chunk_lines: usize::MAX,
+                chunks: vec![0],
+                scanned: RefCell::new((0, starts)),
+            };
+        }
+
+        let mut chunks = vec![0];
+        let mut lines = 1;
+        for i in scan::memchr_iter(b'\n', content) {
+            if lines % CHUNK_LINES == 0 {
+                chunks.push(i + 1);
+            }
+            lines += 1;
+        }
+        Self {
+            lines,
+            chunk_lines: CHUNK_LINES,
+            chunks,
+            scanned: RefCell::new((usize::MAX, Vec::new())),
+        }
+    }
+}
+
+/// Starts of up to `count` lines from `start`, followed by the start of the next line
+fn scan_lines(content: &[u8], start: usize, count: usize, capacity: usize) -> Vec<usize> {
+    let mut starts = Vec::with_capacity(capacity);
+    starts.push(start);
+    for i in scan::memchr_iter(b'\n', &content[start..]) {
+        starts.push(start + i + 1);
+        if starts.len() > count {
+            return starts;
+        }
+    }
+    starts.push(content.len() + 1);
+    starts
+}
+
+/// The lines of a content through its LineTable. Lines end at '\n'; a line's text
+/// excludes the terminator, and a '\r' right before it, so CRLF and LF files give
+/// the same line text. Content that ends with '\n' has a final empty line.
+#[derive(Clone, Copy)]
+pub struct LineIndex<'a> {
+    table: &'a LineTable,
+    content: &'a [u8],
+}
+
+impl<'a> LineIndex<'a> {
+    pub fn new(table: &'a LineTable, content: &'a [u8]) -> Self {
+        Self { table, content }
+    }
+
+    /// Number of lines (at least 1, even for empty content)
+    pub fn len(&self) -> usize {
+        self.table.lines
+    }
+
+    /// 0-based index of the line containing byte `offset`. An offset at a line
+    /// terminator belongs to the line it ends; the content length to the last line.
+    pub fn line_of(&self, offset: usize) -> usize {
+        let chunk = self.table.chunks.partition_point(|&start| start <= offset) - 1;
+        self.with_chunk(chunk, |first, starts| first + starts.partition_point(|&start| start <= offset) - 1)
+    }
+
+    /// 1-based line number of byte `offset`, as printed in messages
+    pub fn line_number(&self, offset: usize) -> usize {
+        self.line_of(offset) + 1
+    }
+
+    /// Offset of the first byte of line `line`
+    pub fn start(&self, line: usize) -> usize {
+        self.bounds(line).0
+    }
+
+    /// Offset just past the text of line `line` (its '\r' or '\n', or the content length)
+    pub fn end(&self, line: usize) -> usize {
+        self.bounds(line).1
+    }
+
+    /// Text of line `line` without its terminator
+    pub fn line(&self, line: usize) -> &'a [u8] {
+        let (start, end) = self.bounds(line);
+        &self.content[start..end]
+    }
+
+    fn bounds(&self, line: usize) -> (usize, usize) {
+        let chunk = line / self.table.chunk_lines;
+        self.with_chunk(chunk, |first, starts| {
+            let (start, next) = (starts[line - first], starts[line - first + 1]);
+            let mut end = next - 1;
+            if end > start && self.content[end - 1] == b'\r' {
+                end -= 1;
+            }
+            (start, end)
+        })
+    }
+
+    /// Call `f` with the index of the first line of `chunk` and the starts of its lines
+    fn with_chunk<R>(&self, chunk: usize, f: impl FnOnce(usize, &[usize]) -> R) -> R {
+        let mut scanned = self.table.scanned.borrow_mut();
+        if scanned.0 != chunk {
+            let starts = scan_lines(self.content, self.table.chunks[chunk], self.table.chunk_lines, CHUNK_LINES + 1);
+            *scanned = (chunk, starts);
+        }
+        f(chunk * self.table.chunk_lines, &scanned.1)
+    }
+}
@@ -1,21 +1,40 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-mod checks;
-mod config;
-mod file_walker;
-
-use config::ValidatorConfig;
+use repo_validator_rs::cache::ResultCache;
+use repo_validator_rs::config::ValidatorConfig;
+use repo_validator_rs::exclusions::{Exclusions, DEFAULT_EXCLUDED_FOLDERS};
+#[cfg(target_os = "linux")]
+use repo_validator_rs::watch;
+use repo_validator_rs::{changed_files, checks, memory, print_header, validate, workspace};
+use std::collections::HashSet;
 use std::process;
 
 fn print_usage(program_name: &str, checks: &[Box<dyn checks::Check>]) {
-    println!("Usage: {} --repo-root <path> [options]\n", program_name);
+    println!("Usage: {} --repo-root <path> [options]", program_name);
+    println!("       {} --workspace <manifest> [options]\n", program_name);
     println!("Options:");
     println!("  --repo-root <path>        Repository root directory (required)");
     println!("  --exclude-folders <list>   Comma-separated list of folders to exclude");
+    println!("  --gitignore                Also skip files and folders ignored by .gitignore or .git/info/exclude");
     println!("  --fix                      Automatically fix validation errors");
     println!("  --check <name>             Run only the specified check (can be repeated)");
     println!("  --submodule-sha <sha>      Override c-build-tools submodule SHA (for testing)");
+    println!("  --jobs <n>                 Number of worker threads (default: number of cores)");
+    println!("  --cache <path>             Reuse per-file results stored in <path> for unchanged files");
+    println!("  --changed-since <ref>      Only check files changed since the merge base with <ref>");
+    println!("  --paths-from <file>        Only check the files listed in <file> (one path per line)");
+    println!("  --staged                   Check the staged content of the files staged for commit");
+    println!("  --srs-index-out <path>     Write the SRS tag index to <path>");
+    println!("  --timings                  Print time, files and bytes per check, and the slowest files");
+    println!("  --trace-out <path>         Write a Chrome trace of the run to <path>");
+    println!("  --watch                    Keep running and re-validate files as they change (Linux)");
+    println!("  --socket <path>            Serve the latest results of --watch on a Unix socket");
+    println!("                             (default: <repo-root>/.repo_validator.sock)");
+    println!("  --workspace <manifest>     Validate every repository root listed in <manifest> (one per line)");
+    println!("  --batched-reads            Read files ahead in io_uring batches for the workers (Linux)");
+    println!("  --max-memory <size>        Hold at most <size> bytes of file content at once (K, M or G suffix);");
+    println!("                             files of 1/16 of it or more are mapped instead of read (Linux)");
     println!("  --list-checks              List all available checks");
     println!("  --help                     Show this help message");
     println!("\nAvailable checks:");
@@ -32,10 +51,26 @@ fn main() {
 
     let mut repo_root: Option<String> = None;
     let mut exclude_str = String::new();
+    let mut gitignore = false;
     let mut fix_mode = false;
     let mut enabled_check_names: Vec<String> = Vec::new();
     let mut list_checks = false;
     let mut submodule_sha: Option<String> = None;
+    let mut cache_path: Option<String> = None;
+    let mut changed_since: Option<String> = None;
+    let mut paths_from: Option<String> = None;
+    let mut staged_mode = false;
+    let mut srs_index_out: Option<String> = None;
+    let mut timings = false;
+    let mut trace_out: Option<String> = None;
+    let mut watch_mode = false;
+    let mut socket_path: Option<String> = None;
+    let mut workspace_manifest: Option<String> = None;
+    let mut batched_reads = false;
+    let mut max_memory: Option<u64> = None;
+    let mut jobs = std::thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1);
 
     let mut i = 1;
     while i < args.len() {
@@ -70,6 +105,90 @@ fn main() {
                     }
                 }
             }
+            "--jobs" | "-j" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    match args[i].trim().parse::<usize>() {
+                        Ok(n) if n > 0 => jobs = n,
+                        _ => {
+                            eprintln!("Error: --jobs expects a positive number, got '{}'", args[i]);
+                            process::exit(1);
+                        }
+                    }
+                }
+            }
+            "--cache" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    let val = args[i].trim().to_string();
+                    if !val.is_empty() {
+                        cache_path = Some(val);
+                    }
+                }
+            }
+            "--changed-since" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    changed_since = Some(args[i].trim().to_string());
+                }
+            }
+            "--paths-from" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    paths_from = Some(args[i].clone());
+                }
+            }
+            "--staged" => {
+                staged_mode = true;
+            }
+            "--srs-index-out" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    srs_index_out = Some(args[i].clone());
+                }
+            }
+            "--gitignore" => {
+                gitignore = true;
+            }
+            "--timings" => {
+                timings = true;
+            }
+            "--trace-out" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    trace_out = Some(args[i].clone());
+                }
+            }
+            "--watch" => {
+                watch_mode = true;
+            }
+            "--socket" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    socket_path = Some(args[i].clone());
+                }
+            }
+            "--workspace" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    workspace_manifest = Some(args[i].clone());
+                }
+            }
+            "--batched-reads" => {
+                batched_reads = true;
+            }
+            "--max-memory" => {
+                if i + 1 < args.len() {
+                    i += 1;
+                    match memory::parse_size(&args[i]) {
+                        Some(bytes) => max_memory = Some(bytes),
+                        None => {
+                            eprintln!("Error: --max-memory expects a size such as 512M, got '{}'", args[i]);
+                            process::exit(1);
+                        }
+                    }
+                }
+            }
             "--list-checks" => {
                 list_checks = true;
             }
@@ -90,8 +209,27 @@ fn main() {
         process::exit(0);
     }
 
+    if workspace_manifest.is_some()
+        && (repo_root.is_some()
+            || watch_mode
+            || cache_path.is_some()
+            || changed_since.is_some()
+            || paths_from.is_some()
+            || staged_mode
+            || srs_index_out.is_some()
+            || trace_out.is_some())
+    {
+        eprintln!(
+            "Error: --workspace cannot be combined with --repo-root, --watch, --cache, --changed-since, \
+             --paths-from, --staged, --srs-index-out or --trace-out"
+        );
+        process::exit(1);
+    }
+
     let repo_root = match repo_root {
         Some(r) => r,
+        // Each repository of the workspace gets its own root
+        None if workspace_manifest.is_some() => String::new(),
         None => {
             eprintln!("Error: --repo-root is required\n");
             print_usage(program_name, &all_checks);
@@ -103,22 +241,81 @@ fn main() {
     let repo_root = repo_root.trim_end_matches(['/', '\\']).to_string();
 
     // Parse exclude folders - always include deps and cmake as defaults
-    let mut exclude_folders: Vec<String> = vec!["deps".to_string(), "cmake".to_string()];
+    let mut exclude_folders: Vec<String> = DEFAULT_EXCLUDED_FOLDERS.iter().map(|folder| folder.to_string()).collect();
 
     if !exclude_str.is_empty() {
         for tok in exclude_str.split(',') {
             let trimmed = tok.trim();
-            if !trimmed.is_empty() && trimmed != "deps" && trimmed != "cmake" {
+            if !trimmed.is_empty() && !DEFAULT_EXCLUDED_FOLDERS.contains(&trimmed) {
                 exclude_folders.push(trimmed.to_string());
             }
         }
     }
 
+    if watch_mode && (fix_mode || changed_since.is_some() || paths_from.is_some()) {
+        eprintln!("Error: --watch cannot be combined with --fix, --changed-since or --paths-from");
+        process::exit(1);
+    }
+
+    // Fixes would write staged content over the working tree
+    if staged_mode && (watch_mode || fix_mode || changed_since.is_some() || paths_from.is_some()) {
+        eprintln!("Error: --staged cannot be combined with --watch, --fix, --changed-since or --paths-from");
+        process::exit(1);
+    }
+
+    // Incremental mode: the union of the changed files from git and from the list file
+    let mut changed_paths: Option<HashSet<String>> = None;
+    if let Some(git_ref) = &changed_since {
+        match changed_files::changed_since(&repo_root, git_ref) {
+            Ok(paths) => changed_paths.get_or_insert_with(HashSet::new).extend(paths),
+            Err(e) => {
+                eprintln!("Error: --changed-since {}: {}", git_ref, e);
+                process::exit(1);
+            }
+        }
+    }
+    if let Some(list_path) = &paths_from {
+        match changed_files::paths_from_file(&repo_root, list_path) {
+            Ok(paths) => changed_paths.get_or_insert_with(HashSet::new).extend(paths),
+            Err(e) => {
+                eprintln!("Error: --paths-from: {}", e);
+                process::exit(1);
+            }
+        }
+    }
+
+    // Staged mode: the staged files are the changed set
+    let mut staged = None;
+    if staged_mode {
+        match changed_files::staged_files(&repo_root) {
+            Ok(files) => {
+                changed_paths = Some(files.paths());
+                staged = Some(files);
+            }
+            Err(e) => {
+                eprintln!("Error: --staged: {}", e);
+                process::exit(1);
+            }
+        }
+    }
+
     let config = ValidatorConfig {
         repo_root,
-        exclude_folders,
+        exclusions: Exclusions::new(exclude_folders, gitignore),
         fix_mode,
         submodule_sha,
+        jobs,
+        // Fixes rewrite files while they are being checked; never reuse or record those results
+        cache_path: if fix_mode { None } else { cache_path },
+        changed_paths,
+        srs_index_out,
+        timings,
+        trace_out,
+        workspace: workspace_manifest.is_some(),
+        staged,
+        batched_reads,
+        max_memory,
+        map_files: !watch_mode,
     };
 
     // Select active checks
@@ -136,64 +333,57 @@ fn main() {
         process::exit(1);
     }
 
-    // Print header
-    println!("========================================");
-    println!("Repository Validator");
-    println!("========================================");
-    println!("Repository Root: {}", config.repo_root);
-    println!("Fix Mode: {}", if config.fix_mode { "ON" } else { "OFF" });
-    print!("Excluded folders: ");
-    for (idx, folder) in config.exclude_folders.iter().enumerate() {
-        if idx > 0 {
-            print!(", ");
-        }
-        print!("{}", folder);
-    }
-    println!();
-    print!("Active checks: ");
-    for (idx, check) in active_checks.iter().enumerate() {
-        if idx > 0 {
-            print!(", ");
+    if let Some(manifest) = &workspace_manifest {
+        let roots = match workspace::read_manifest(manifest) {
+            Ok(roots) => roots,
+            Err(e) => {
+                eprintln!("Error: --workspace {}", e);
+                process::exit(1);
+            }
+        };
+        match workspace::run(&config, &mut active_checks, &roots) {
+            Ok(failed) => process::exit(if failed > 0 { 1 } else { 0 }),
+            Err(e) => {
+                eprintln!("Error: {}", e);
+                process::exit(1);
+            }
         }
-        print!("{}", check.name());
-    }
-    println!("\n");
-
-    // Initialize checks
-    for check in active_checks.iter_mut() {
-        check.init(&config);
     }
 
-    // Walk repository and run checks
-    println!("Scanning repository...");
-    file_walker::walk_repository(&config, &mut active_checks);
+    print_header(&config, &active_checks);
 
-    // Finalize checks
-    let mut total_violations = 0;
-    println!();
-    println!("========================================");
-    println!("Validation Summary");
-    println!("========================================");
+    if watch_mode {
+        let socket_path =
+            socket_path.unwrap_or_else(|| format!("{}/.repo_validator.sock", config.repo_root));
+        run_watch(config, &mut active_checks, &socket_path);
+    }
 
-    for check in active_checks.iter_mut() {
-        let check_result = check.finalize(&config);
-        let status = if check_result == 0 {
-            "PASSED"
-        } else {
-            "FAILED"
-        };
-        println!("  {:<25} [{}]", check.name(), status);
-        if check_result > 0 {
-            total_violations += check_result;
+    let cache = config
+        .cache_path
+        .as_ref()
+        .map(|path| ResultCache::load(path, &config.repo_root));
+    match validate(&config, &mut active_checks, cache) {
+        Ok((total_violations, _)) => process::exit(if total_violations > 0 { 1 } else { 0 }),
+        Err(e) => {
+            eprintln!("Error: {}", e);
+            process::exit(1);
         }
     }
+}
 
-    println!();
-    if total_violations > 0 {
-        println!("[VALIDATION FAILED]");
-        process::exit(1);
-    } else {
-        println!("[VALIDATION PASSED]");
-        process::exit(0);
+#[cfg(target_os = "linux")]
+fn run_watch(config: ValidatorConfig, active_checks: &mut Vec<Box<dyn checks::Check>>, socket_path: &str) -> ! {
+    match watch::run(config, active_checks, socket_path) {
+        Ok(()) => process::exit(0),
+        Err(e) => {
+            eprintln!("Error: --watch: {}", e);
+            process::exit(1);
+        }
     }
 }
+
+#[cfg(not(target_os = "linux"))]
+fn run_watch(_config: ValidatorConfig, _active_checks: &mut Vec<Box<dyn checks::Check>>, _socket_path: &str) -> ! {
+    eprintln!("Error: --watch is only supported on Linux");
+    process::exit(1);
+}
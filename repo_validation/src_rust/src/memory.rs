@@ -0,0 +1,226 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Memory budget of a walk (--max-memory) and the file contents it accounts for.
+//!
+//! Every file takes a reservation of its size from the budget before it is read,
+//! and gives it back once its checks are done. A thread whose reservation does
+//! not fit waits for other files to finish, so readers slow down to the pace of
+//! the checks instead of piling contents up. A file larger than the whole budget
+//! is still checked, alone.
+//!
+//! Files of at least map_threshold() bytes are mapped instead of read (Linux):
+//! their content is not copied to the heap, and its pages stay clean page cache
+//! pages, which the kernel can reclaim under pressure and which leave the process
+//! as soon as the file is unmapped.
+//!
+//! A mapping is not a copy: if another process truncates a mapped file, reading
+//! the pages past its new end raises SIGBUS and kills the run. One-shot runs
+//! accept that, like any tool reading files that are rewritten under it; --watch,
+//! which keeps checking files while they are edited, reads them instead.
+
+use std::fs::File;
+use std::io::{self, Read};
+use std::ops::Deref;
+use std::sync::{Arc, Condvar, Mutex};
+
+/// Share of the budget from which a file is mapped instead of read
+const MAP_FRACTION: u64 = 16;
+
+/// Parse a --max-memory size: a number of bytes with an optional K, M or G suffix
+/// (powers of 1024)
+pub fn parse_size(text: &str) -> Option<u64> {
+    let text = text.trim();
+    let (digits, shift) = match text.as_bytes().last()?.to_ascii_uppercase() {
+        b'K' => (&text[..text.len() - 1], 10),
+        b'M' => (&text[..text.len() - 1], 20),
+        b'G' => (&text[..text.len() - 1], 30),
+        _ => (text, 0),
+    };
+    let value: u64 = digits.parse().ok()?;
+    value.checked_mul(1 << shift).filter(|&bytes| bytes > 0)
+}
+
+/// Size from which a file is mapped instead of read under a budget of `max_memory` bytes
+pub fn map_threshold(max_memory: u64) -> u64 {
+    (max_memory / MAP_FRACTION).max(1)
+}
+
+/// Load the file at `path` under a budget of `max_memory` bytes once `budget`, if
+/// given, has room for it: map it when it is large and `map` allows, otherwise read it
+#[cfg_attr(not(target_os = "linux"), allow(unused_variables))]
+pub fn read_within(path: &str, max_memory: u64, map: bool, budget: Option<&Arc<MemoryBudget>>) -> io::Result<FileContent> {
+    let mut file = File::open(path)?;
+    let len = file.metadata()?.len();
+    let reservation = budget.map(|budget| budget.reserve(len));
+    #[cfg(target_os = "linux")]
+    if map && len >= map_threshold(max_memory) {
+        return Ok(FileContent {
+            bytes: Bytes::Mapped(Mapping::new(&file, len as usize)?),
+            _reservation: reservation,
+        });
+    }
+    let mut content = Vec::with_capacity(len as usize);
+    file.read_to_end(&mut content)?;
+    Ok(FileContent {
+        bytes: Bytes::Owned(content),
+        _reservation: reservation,
+    })
+}
+
+/// Bytes of file content the threads of a walk may hold at once
+pub struct MemoryBudget {
+    limit: u64,
+    held: Mutex<u64>,
+    released: Condvar,
+}
+
+impl MemoryBudget {
+    pub fn new(limit: u64) -> Arc<Self> {
+        Arc::new(Self {
+            limit,
+            held: Mutex::new(0),
+            released: Condvar::new(),
+        })
+    }
+
+    /// Take `bytes` from the budget, waiting until they fit. A request larger than
+    /// the budget is granted once nothing else is held.
+    pub fn reserve(self: &Arc<Self>, bytes: u64) -> Reservation {
+        let mut held = self.held.lock().unwrap();
+        while *held > 0 && *held + bytes > self.limit {
+            held = self.released.wait(held).unwrap();
+        }
+        *held += bytes;
+        Reservation {
+            budget: Arc::clone(self),
+            bytes,
+        }
+    }
+}
+
+/// Bytes taken from a MemoryBudget, given back when dropped
+pub struct Reservation {
+    budget: Arc<MemoryBudget>,
+    bytes: u64,
+}
+
+impl Drop for Reservation {
+    fn drop(&mut self) {
+        *self.budget.held.lock().unwrap() -= self.bytes;
+        self.budget.released.notify_all();
+    }
+}
+
+enum Bytes {
+    Owned(Vec<u8>),
+    #[cfg(target_os = "linux")]
+    Mapped(Mapping),
+}
+
+/// Content of one file, read into memory or mapped, holding its reservation if
+/// it has one
+pub struct FileContent {
+    bytes: Bytes,
+    _reservation: Option<Reservation>,
+}
+
+impl FileContent {
+    /// Content read into memory under `reservation`
+    pub fn reserved(content: Vec<u8>, reservation: Reservation) -> Self {
+        Self {
+            bytes: Bytes::Owned(content),
+            _reservation: Some(reservation),
+        }
+    }
+
+    /// The content as an owned buffer, returning its reservation to the budget
+    pub fn into_vec(self) -> Vec<u8> {
+        match self.bytes {
+            Bytes::Owned(content) => content,
+            #[cfg(target_os = "linux")]
+            Bytes::Mapped(mapping) => mapping.to_vec(),
+        }
+    }
+}
+
+impl From<Vec<u8>> for FileContent {
+    fn from(content: Vec<u8>) -> Self {
+        Self {
+            bytes: Bytes::Owned(content),
+            _reservation: None,
+        }
+    }
+}
+
+impl Deref for FileContent {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        match &self.bytes {
+            Bytes::Owned(content) => content,
+            #[cfg(target_os = "linux")]
+            Bytes::Mapped(mapping) => mapping,
+        }
+    }
+}
+
+#[cfg(target_os = "linux")]
+use mapping::Mapping;
+
+#[cfg(target_os = "linux")]
+mod mapping {
+    use std::fs::File;
+    use std::io;
+    use std::ops::Deref;
+    use std::os::fd::AsRawFd;
+    use std::os::raw::{c_int, c_long, c_void};
+    use std::ptr;
+
+    const PROT_READ: c_int = 1;
+    const MAP_PRIVATE: c_int = 2;
+    const MADV_SEQUENTIAL: c_int = 2;
+
+    extern "C" {
+        fn mmap(addr: *mut c_void, length: usize, prot: c_int, flags: c_int, fd: c_int, offset: c_long) -> *mut c_void;
+        fn munmap(addr: *mut c_void, length: usize) -> c_int;
+        fn madvise(addr: *mut c_void, length: usize, advice: c_int) -> c_int;
+    }
+
+    /// A read-only private mapping of a file, unmapped when dropped. Pages past
+    /// the end of a file truncated since it was mapped raise SIGBUS when read.
+    pub struct Mapping {
+        address: *mut c_void,
+        len: usize,
+    }
+
+    // The mapping is never written and only unmapped by its owner
+    unsafe impl Send for Mapping {}
+    unsafe impl Sync for Mapping {}
+
+    impl Mapping {
+        pub fn new(file: &File, len: usize) -> io::Result<Self> {
+            let address = unsafe { mmap(ptr::null_mut(), len, PROT_READ, MAP_PRIVATE, file.as_raw_fd(), 0) };
+            if address as isize == -1 {
+                return Err(io::Error::last_os_error());
+            }
+            // The checks scan from start to end: let the kernel read ahead
+            unsafe { madvise(address, len, MADV_SEQUENTIAL) };
+            Ok(Self { address, len })
+        }
+    }
+
+    impl Deref for Mapping {
+        type Target = [u8];
+
+        fn deref(&self) -> &[u8] {
+            unsafe { std::slice::from_raw_parts(self.address as *const u8, self.len) }
+        }
+    }
+
+    impl Drop for Mapping {
+        fn drop(&mut self) {
+            unsafe { munmap(self.address, self.len) };
+        }
+    }
+}
@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Single-pass multi-needle prefilter.
+//!
+//! Checks declare the byte strings they look for (Check::needles). Before any check
+//! runs on a file, one Aho-Corasick pass over the content records the offset of every
+//! occurrence of every needle (FileInfo::matches). The walker does not run a check on
+//! a file that contains none of its needles, and the checks that do run can start from
+//! the recorded offsets instead of scanning the content from the beginning.
+
+use std::collections::VecDeque;
+use std::sync::Arc;
+
+use crate::scan;
+
+/// A byte string a check looks for
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub struct Needle {
+    pub bytes: &'static [u8],
+    /// Match ASCII letters in either case
+    pub ignore_case: bool,
+}
+
+impl Needle {
+    pub const fn exact(bytes: &'static [u8]) -> Self {
+        Self {
+            bytes,
+            ignore_case: false,
+        }
+    }
+
+    pub const fn ignore_case(bytes: &'static [u8]) -> Self {
+        Self {
+            bytes,
+            ignore_case: true,
+        }
+    }
+}
+
+const NO_STATE: u32 = u32::MAX;
+
+/// Aho-Corasick automaton over all needles of the active checks, compiled to a
+/// DFA over byte classes (bytes that no needle contains share one class).
+///
+/// When any needle ignores case, the automaton matches every needle on ASCII
+/// case-folded input and occurrences of exact needles are verified afterwards.
+pub struct Prefilter {
+    needles: Arc<Vec<Needle>>,
+    classes: [u8; 256],
+    class_count: usize,
+    /// transitions[state * class_count + class] = next state
+    transitions: Vec<u32>,
+    /// Needles ending in each state (including through failure links)
+    outputs: Vec<Vec<u32>>,
+    folded: bool,
+    /// The bytes that leave the start state, when there are at most three of them:
+    /// the scan then jumps between them with memchr instead of stepping the automaton
+    start_bytes: Vec<u8>,
+}
+
+impl Prefilter {
+    pub fn new(needles: Vec<Needle>) -> Self {
+        let mut unique: Vec<Needle> = Vec::new();
+        for needle in needles {
+            assert!(!needle.bytes.is_empty(), "prefilter needles must not be empty");
+            if !unique.contains(&needle) {
+                unique.push(needle);
+            }
+        }
+
+        let folded = unique.iter().any(|n| n.ignore_case);
+        let key = |b: u8| if folded { b.to_ascii_lowercase() } else { b };
+
+        // Class 0 is "no needle contains this byte"
+        let mut classes = [0u8; 256];
+        let mut class_count = 1usize;
+        for needle in &unique {
+            for &b in needle.bytes {
+                let k = key(b);
+                if classes[k as usize] == 0 {
+                    classes[k as usize] = class_count as u8;
+                    class_count += 1;
+                }
+            }
+        }
+        if folded {
+            for b in b'A'..=b'Z' {
+                classes[b as usize] = classes[b.to_ascii_lowercase() as usize];
+            }
+        }
+
+        // Trie
+        let mut transitions: Vec<u32> = vec![NO_STATE; class_count];
+        let mut outputs: Vec<Vec<u32>> = vec![Vec::new()];
+        for (id, needle) in unique.iter().enumerate() {
+            let mut state = 0usize;
+            for &b in needle.bytes {
+                let slot = state * class_count + classes[key(b) as usize] as usize;
+                if transitions[slot] == NO_STATE {
+                    transitions[slot] = outputs.len() as u32;
+                    outputs.push(Vec::new());
+                    transitions.extend(std::iter::repeat(NO_STATE).take(class_count));
+                }
+                state = transitions[slot] as usize;
+            }
+            outputs[state].push(id as u32);
+        }
+
+        // Resolve failure links breadth-first so that every state has a transition
+        // for every class
+        let mut failure = vec![0u32; outputs.len()];
+        let mut queue: VecDeque<usize> = VecDeque::new();
+        for class in 0..class_count {
+            match transitions[class] {
+                NO_STATE => transitions[class] = 0,
+                next => queue.push_back(next as usize),
+            }
+        }
+        while let Some(state) = queue.pop_front() {
+            let fail = failure[state] as usize;
+            let inherited = outputs[fail].clone();
+            outputs[state].extend(inherited);
+            for class in 0..class_count {
+                let slot = state * class_count + class;
+                let fallback = transitions[fail * class_count + class];
+                match transitions[slot] {
+                    NO_STATE => transitions[slot] = fallback,
+                    next => {
+                        failure[next as usize] = fallback;
+                        queue.push_back(next as usize);
+                    }
+                }
+            }
+        }
+
+        let mut start_bytes: Vec<u8> = (0..=255u8)
+            .filter(|&b| transitions[classes[b as usize] as usize] != 0)
+            .collect();
+        if start_bytes.len() > 3 {
+            start_bytes.clear();
+        }
+
+        Self {
+            needles: Arc::new(unique),
+            classes,
+            class_count,
+            transitions,
+            outputs,
+            folded,
+            start_bytes,
+        }
+    }
+
+    /// Index of a needle in match tables, if it was given to new()
+    pub fn needle_id(&self, needle: Needle) -> Option<usize> {
+        self.needles.iter().position(|n| *n == needle)
+    }
+
+    /// Distance to the next byte that can start a match
+    fn skip_to_start_byte(&self, rest: &[u8]) -> Option<usize> {
+        match self.start_bytes[..] {
+            [a] => scan::memchr(a, rest),
+            [a, b] => scan::memchr2(a, b, rest),
+            [a, b, c] => scan::memchr3(a, b, c, rest),
+            _ => Some(0),
+        }
+    }
+
+    /// Record every occurrence of every needle in `content`
+    pub fn scan(&self, content: &[u8]) -> MatchTable {
+        let mut offsets: Vec<Vec<usize>> = vec![Vec::new(); self.needles.len()];
+        if !self.needles.is_empty() {
+            let can_skip = !self.start_bytes.is_empty();
+            let mut state = 0usize;
+            let mut i = 0usize;
+            while i < content.len() {
+                if state == 0 && can_skip {
+                    match self.skip_to_start_byte(&content[i..]) {
+                        Some(skip) => i += skip,
+                        None => break,
+                    }
+                }
+                let class = self.classes[content[i] as usize] as usize;
+                state = self.transitions[state * self.class_count + class] as usize;
+                for &id in &self.outputs[state] {
+                    let needle = &self.needles[id as usize];
+                    let start = i + 1 - needle.bytes.len();
+                    if self.folded && !needle.ignore_case && &content[start..=i] != needle.bytes {
+                        continue;
+                    }
+                    offsets[id as usize].push(start);
+                }
+                i += 1;
+            }
+        }
+        MatchTable {
+            needles: Arc::clone(&self.needles),
+            offsets,
+        }
+    }
+}
+
+/// Offsets of needle occurrences in one file
+pub struct MatchTable {
+    needles: Arc<Vec<Needle>>,
+    offsets: Vec<Vec<usize>>,
+}
+
+impl MatchTable {
+    /// Start offsets of every occurrence of `needle` (overlapping ones included),
+    /// in ascending order. Only needles declared by an active check are recorded.
+    pub fn offsets(&self, needle: Needle) -> &[usize] {
+        match self.needles.iter().position(|n| *n == needle) {
+            Some(id) => &self.offsets[id],
+            None => panic!(
+                "needle \"{}\" was not declared by any active check",
+                String::from_utf8_lossy(needle.bytes)
+            ),
+        }
+    }
+
+    /// True when at least one of the needles (by id) occurs
+    pub fn any(&self, ids: &[usize]) -> bool {
+        ids.iter().any(|&id| !self.offsets[id].is_empty())
+    }
+}
@@ -0,0 +1,656 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Byte-scanning kernels for the checks' hot loops.
+//!
+//! Every kernel has a portable implementation (8 bytes at a time in a u64) and
+//! SIMD implementations: SSE2 and AVX2 on x86_64, NEON on aarch64. The fastest
+//! implementation the CPU supports is chosen once, on first use. All
+//! implementations return exactly the same results.
+//!
+//! This file does not depend on the rest of the crate so that the scan_kernels
+//! benchmark (benches/scan_kernels.rs) can include it directly.
+
+use std::sync::OnceLock;
+
+/// One implementation of every kernel
+pub struct Kernels {
+    #[allow(dead_code)] // read by the scan_kernels benchmark
+    pub name: &'static str,
+    /// Offset of the first occurrence of a byte
+    pub memchr: fn(u8, &[u8]) -> Option<usize>,
+    /// Offset of the first occurrence of either byte
+    pub memchr2: fn(u8, u8, &[u8]) -> Option<usize>,
+    /// Offset of the first occurrence of any of three bytes
+    pub memchr3: fn(u8, u8, u8, &[u8]) -> Option<usize>,
+    /// Offset of the last occurrence of a byte
+    pub memrchr: fn(u8, &[u8]) -> Option<usize>,
+    /// Number of occurrences of a byte
+    pub count: fn(u8, &[u8]) -> usize,
+    /// Offset of the first occurrence of the two-byte sequence `first second`
+    pub find_pair: fn(u8, u8, &[u8]) -> Option<usize>,
+}
+
+/// Below this length the portable code wins over the indirect call into a SIMD kernel
+const SHORT: usize = 16;
+
+static SELECTED: OnceLock<&'static Kernels> = OnceLock::new();
+
+/// The kernels used by the checks (the fastest ones this CPU supports)
+pub fn kernels() -> &'static Kernels {
+    SELECTED.get_or_init(|| available_kernels().pop().expect("portable kernels are always available"))
+}
+
+/// Every implementation this CPU supports, slowest first
+#[allow(dead_code)] // only used directly by the scan_kernels benchmark
+pub fn available_kernels() -> Vec<&'static Kernels> {
+    #[allow(unused_mut)]
+    let mut list: Vec<&'static Kernels> = vec![&portable::KERNELS];
+    #[cfg(target_arch = "x86_64")]
+    {
+        list.push(&sse2::KERNELS);
+        if std::arch::is_x86_feature_detected!("avx2") {
+            list.push(&avx2::KERNELS);
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        list.push(&neon::KERNELS);
+    }
+    list
+}
+
+pub fn memchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+    if haystack.len() < SHORT {
+        return haystack.iter().position(|&b| b == needle);
+    }
+    (kernels().memchr)(needle, haystack)
+}
+
+pub fn memchr2(needle1: u8, needle2: u8, haystack: &[u8]) -> Option<usize> {
+    if haystack.len() < SHORT {
+        return haystack.iter().position(|&b| b == needle1 || b == needle2);
+    }
+    (kernels().memchr2)(needle1, needle2, haystack)
+}
+
+pub fn memchr3(needle1: u8, needle2: u8, needle3: u8, haystack: &[u8]) -> Option<usize> {
+    if haystack.len() < SHORT {
+        return haystack
+            .iter()
+            .position(|&b| b == needle1 || b == needle2 || b == needle3);
+    }
+    (kernels().memchr3)(needle1, needle2, needle3, haystack)
+}
+
+pub fn memrchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+    if haystack.len() < SHORT {
+        return haystack.iter().rposition(|&b| b == needle);
+    }
+    (kernels().memrchr)(needle, haystack)
+}
+
+pub fn count_byte(needle: u8, haystack: &[u8]) -> usize {
+    if haystack.len() < SHORT {
+        return haystack.iter().filter(|&&b| b == needle).count();
+    }
+    (kernels().count)(needle, haystack)
+}
+
+pub fn count_newlines(haystack: &[u8]) -> usize {
+    count_byte(b'\n', haystack)
+}
+
+pub fn find_pair(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+    if haystack.len() < SHORT {
+        return haystack.windows(2).position(|w| w[0] == first && w[1] == second);
+    }
+    (kernels().find_pair)(first, second, haystack)
+}
+
+/// Offsets of every occurrence of a byte, in ascending order
+pub fn memchr_iter(needle: u8, haystack: &[u8]) -> impl Iterator<Item = usize> + '_ {
+    let mut start = 0usize;
+    std::iter::from_fn(move || {
+        let found = start + memchr(needle, &haystack[start..])?;
+        start = found + 1;
+        Some(found)
+    })
+}
+
+/// Portable kernels: eight bytes at a time in a u64
+mod portable {
+    use super::Kernels;
+
+    pub static KERNELS: Kernels = Kernels {
+        name: "portable",
+        memchr,
+        memchr2,
+        memchr3,
+        memrchr,
+        count,
+        find_pair,
+    };
+
+    const LO7: u64 = 0x7f7f_7f7f_7f7f_7f7f;
+    const ONES: u64 = 0x0101_0101_0101_0101;
+
+    fn splat(b: u8) -> u64 {
+        ONES * b as u64
+    }
+
+    /// 0x80 in every byte of `x` that is zero, 0x00 elsewhere (exact: no false positives)
+    fn zero_bytes(x: u64) -> u64 {
+        !(((x & LO7) + LO7) | x | LO7)
+    }
+
+    fn word(haystack: &[u8], i: usize) -> u64 {
+        let mut bytes = [0u8; 8];
+        bytes.copy_from_slice(&haystack[i..i + 8]);
+        u64::from_le_bytes(bytes)
+    }
+
+    /// Find the first word (or tail byte) whose match mask is non-zero
+    fn first(haystack: &[u8], mask: impl Fn(u64) -> u64, is_match: impl Fn(u8) -> bool) -> Option<usize> {
+        let len = haystack.len();
+        let mut i = 0usize;
+        while i + 8 <= len {
+            let m = mask(word(haystack, i));
+            if m != 0 {
+                return Some(i + (m.trailing_zeros() / 8) as usize);
+            }
+            i += 8;
+        }
+        haystack[i..].iter().position(|&b| is_match(b)).map(|p| i + p)
+    }
+
+    pub fn memchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        first(haystack, |w| zero_bytes(w ^ n), |b| b == needle)
+    }
+
+    pub fn memchr2(needle1: u8, needle2: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2) = (splat(needle1), splat(needle2));
+        first(
+            haystack,
+            |w| zero_bytes(w ^ n1) | zero_bytes(w ^ n2),
+            |b| b == needle1 || b == needle2,
+        )
+    }
+
+    pub fn memchr3(needle1: u8, needle2: u8, needle3: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2, n3) = (splat(needle1), splat(needle2), splat(needle3));
+        first(
+            haystack,
+            |w| zero_bytes(w ^ n1) | zero_bytes(w ^ n2) | zero_bytes(w ^ n3),
+            |b| b == needle1 || b == needle2 || b == needle3,
+        )
+    }
+
+    pub fn memrchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        let mut end = haystack.len();
+        while end >= 8 {
+            let m = zero_bytes(word(haystack, end - 8) ^ n);
+            if m != 0 {
+                return Some(end - 8 + (7 - m.leading_zeros() / 8) as usize);
+            }
+            end -= 8;
+        }
+        haystack[..end].iter().rposition(|&b| b == needle)
+    }
+
+    pub fn count(needle: u8, haystack: &[u8]) -> usize {
+        let n = splat(needle);
+        let len = haystack.len();
+        let mut total = 0usize;
+        let mut i = 0usize;
+        while i + 8 <= len {
+            total += zero_bytes(word(haystack, i) ^ n).count_ones() as usize;
+            i += 8;
+        }
+        total + haystack[i..].iter().filter(|&&b| b == needle).count()
+    }
+
+    pub fn find_pair(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+        let (f, s) = (splat(first), splat(second));
+        let len = haystack.len();
+        let mut i = 0usize;
+        while i + 9 <= len {
+            let m = zero_bytes(word(haystack, i) ^ f) & zero_bytes(word(haystack, i + 1) ^ s);
+            if m != 0 {
+                return Some(i + (m.trailing_zeros() / 8) as usize);
+            }
+            i += 8;
+        }
+        haystack[i..]
+            .windows(2)
+            .position(|w| w[0] == first && w[1] == second)
+            .map(|p| i + p)
+    }
+}
+
+/// SSE2 kernels (part of the x86_64 baseline, so always available there)
+#[cfg(target_arch = "x86_64")]
+mod sse2 {
+    use super::{portable, Kernels};
+    use std::arch::x86_64::*;
+
+    pub static KERNELS: Kernels = Kernels {
+        name: "sse2",
+        memchr,
+        memchr2,
+        memchr3,
+        memrchr,
+        count,
+        find_pair,
+    };
+
+    const WIDTH: usize = 16;
+
+    /// One bit per byte of the 16 bytes at `haystack[i..]` that equal the splatted needle
+    fn eq_mask(haystack: &[u8], i: usize, needle: __m128i) -> u32 {
+        debug_assert!(i + WIDTH <= haystack.len());
+        // SAFETY: the 16 bytes at i are in bounds; SSE2 is part of the x86_64 baseline
+        unsafe {
+            let chunk = _mm_loadu_si128(haystack.as_ptr().add(i) as *const __m128i);
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)) as u32
+        }
+    }
+
+    fn splat(b: u8) -> __m128i {
+        // SAFETY: SSE2 is part of the x86_64 baseline
+        unsafe { _mm_set1_epi8(b as i8) }
+    }
+
+    fn first(haystack: &[u8], mask: impl Fn(usize) -> u32) -> Option<(usize, usize)> {
+        let mut i = 0usize;
+        while i + WIDTH <= haystack.len() {
+            let m = mask(i);
+            if m != 0 {
+                return Some((i, m.trailing_zeros() as usize));
+            }
+            i += WIDTH;
+        }
+        None
+    }
+
+    fn tail_start(len: usize) -> usize {
+        len - len % WIDTH
+    }
+
+    pub fn memchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        match first(haystack, |i| eq_mask(haystack, i, n)) {
+            Some((i, bit)) => Some(i + bit),
+            None => {
+                let i = tail_start(haystack.len());
+                portable::memchr(needle, &haystack[i..]).map(|p| i + p)
+            }
+        }
+    }
+
+    pub fn memchr2(needle1: u8, needle2: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2) = (splat(needle1), splat(needle2));
+        match first(haystack, |i| eq_mask(haystack, i, n1) | eq_mask(haystack, i, n2)) {
+            Some((i, bit)) => Some(i + bit),
+            None => {
+                let i = tail_start(haystack.len());
+                portable::memchr2(needle1, needle2, &haystack[i..]).map(|p| i + p)
+            }
+        }
+    }
+
+    pub fn memchr3(needle1: u8, needle2: u8, needle3: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2, n3) = (splat(needle1), splat(needle2), splat(needle3));
+        let mask = |i| eq_mask(haystack, i, n1) | eq_mask(haystack, i, n2) | eq_mask(haystack, i, n3);
+        match first(haystack, mask) {
+            Some((i, bit)) => Some(i + bit),
+            None => {
+                let i = tail_start(haystack.len());
+                portable::memchr3(needle1, needle2, needle3, &haystack[i..]).map(|p| i + p)
+            }
+        }
+    }
+
+    pub fn memrchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        let mut end = haystack.len();
+        while end >= WIDTH {
+            let m = eq_mask(haystack, end - WIDTH, n);
+            if m != 0 {
+                return Some(end - WIDTH + (31 - m.leading_zeros()) as usize);
+            }
+            end -= WIDTH;
+        }
+        portable::memrchr(needle, &haystack[..end])
+    }
+
+    pub fn count(needle: u8, haystack: &[u8]) -> usize {
+        let len = haystack.len();
+        let mut total = 0usize;
+        let mut i = 0usize;
+        // SAFETY: every load reads 16 bytes at i with i + 16 <= len; SSE2 is baseline
+        unsafe {
+            let n = _mm_set1_epi8(needle as i8);
+            let zero = _mm_setzero_si128();
+            while i + WIDTH <= len {
+                // Per-byte counters (cmpeq yields -1 per match) overflow after 255 rounds
+                let rounds = ((len - i) / WIDTH).min(255);
+                let mut acc = zero;
+                for _ in 0..rounds {
+                    let chunk = _mm_loadu_si128(haystack.as_ptr().add(i) as *const __m128i);
+                    acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(chunk, n));
+                    i += WIDTH;
+                }
+                let sums = _mm_sad_epu8(acc, zero);
+                total += _mm_cvtsi128_si64(sums) as usize
+                    + _mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)) as usize;
+            }
+        }
+        total + portable::count(needle, &haystack[i..])
+    }
+
+    pub fn find_pair(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+        let (f, s) = (splat(first), splat(second));
+        let len = haystack.len();
+        let mut i = 0usize;
+        while i + WIDTH < len {
+            let m = eq_mask(haystack, i, f) & eq_mask(haystack, i + 1, s);
+            if m != 0 {
+                return Some(i + m.trailing_zeros() as usize);
+            }
+            i += WIDTH;
+        }
+        portable::find_pair(first, second, &haystack[i..]).map(|p| i + p)
+    }
+}
+
+/// AVX2 kernels, used only when the CPU reports AVX2 support
+#[cfg(target_arch = "x86_64")]
+mod avx2 {
+    use super::{portable, Kernels};
+    use std::arch::x86_64::*;
+
+    pub static KERNELS: Kernels = Kernels {
+        name: "avx2",
+        memchr,
+        memchr2,
+        memchr3,
+        memrchr,
+        count,
+        find_pair,
+    };
+
+    const WIDTH: usize = 32;
+
+    // The safe wrappers below are only reachable through KERNELS, which
+    // available_kernels() hands out after detecting AVX2.
+
+    #[target_feature(enable = "avx2")]
+    unsafe fn eq_mask(ptr: *const u8, needle: __m256i) -> u32 {
+        let chunk = _mm256_loadu_si256(ptr as *const __m256i);
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)) as u32
+    }
+
+    /// First occurrence of any of two or three needles
+    #[target_feature(enable = "avx2")]
+    unsafe fn memchr_avx2(needles: &[u8], haystack: &[u8]) -> Option<usize> {
+        let len = haystack.len();
+        let ptr = haystack.as_ptr();
+        let n1 = _mm256_set1_epi8(needles[0] as i8);
+        let n2 = _mm256_set1_epi8(needles[1] as i8);
+        let n3 = _mm256_set1_epi8(needles[needles.len() - 1] as i8);
+        let mut i = 0usize;
+        while i + WIDTH <= len {
+            let p = ptr.add(i);
+            let m = eq_mask(p, n1) | eq_mask(p, n2) | eq_mask(p, n3);
+            if m != 0 {
+                return Some(i + m.trailing_zeros() as usize);
+            }
+            i += WIDTH;
+        }
+        haystack[i..]
+            .iter()
+            .position(|b| needles.contains(b))
+            .map(|p| i + p)
+    }
+
+    #[target_feature(enable = "avx2")]
+    unsafe fn memchr1_avx2(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = _mm256_set1_epi8(needle as i8);
+        let mut i = 0usize;
+        while i + WIDTH <= haystack.len() {
+            let m = eq_mask(haystack.as_ptr().add(i), n);
+            if m != 0 {
+                return Some(i + m.trailing_zeros() as usize);
+            }
+            i += WIDTH;
+        }
+        portable::memchr(needle, &haystack[i..]).map(|p| i + p)
+    }
+
+    pub fn memchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        // SAFETY: see above
+        unsafe { memchr1_avx2(needle, haystack) }
+    }
+
+    pub fn memchr2(needle1: u8, needle2: u8, haystack: &[u8]) -> Option<usize> {
+        // SAFETY: see above
+        unsafe { memchr_avx2(&[needle1, needle2], haystack) }
+    }
+
+    pub fn memchr3(needle1: u8, needle2: u8, needle3: u8, haystack: &[u8]) -> Option<usize> {
+        // SAFETY: see above
+        unsafe { memchr_avx2(&[needle1, needle2, needle3], haystack) }
+    }
+
+    #[target_feature(enable = "avx2")]
+    unsafe fn memrchr_avx2(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = _mm256_set1_epi8(needle as i8);
+        let mut end = haystack.len();
+        while end >= WIDTH {
+            let m = eq_mask(haystack.as_ptr().add(end - WIDTH), n);
+            if m != 0 {
+                return Some(end - WIDTH + (31 - m.leading_zeros()) as usize);
+            }
+            end -= WIDTH;
+        }
+        portable::memrchr(needle, &haystack[..end])
+    }
+
+    pub fn memrchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        // SAFETY: see above
+        unsafe { memrchr_avx2(needle, haystack) }
+    }
+
+    #[target_feature(enable = "avx2")]
+    unsafe fn count_avx2(needle: u8, haystack: &[u8]) -> usize {
+        let len = haystack.len();
+        let n = _mm256_set1_epi8(needle as i8);
+        let zero = _mm256_setzero_si256();
+        let mut total = 0usize;
+        let mut i = 0usize;
+        while i + WIDTH <= len {
+            // Per-byte counters (cmpeq yields -1 per match) overflow after 255 rounds
+            let rounds = ((len - i) / WIDTH).min(255);
+            let mut acc = zero;
+            for _ in 0..rounds {
+                let chunk = _mm256_loadu_si256(haystack.as_ptr().add(i) as *const __m256i);
+                acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(chunk, n));
+                i += WIDTH;
+            }
+            let sums = _mm256_sad_epu8(acc, zero);
+            let halves = _mm_add_epi64(
+                _mm256_castsi256_si128(sums),
+                _mm256_extracti128_si256::<1>(sums),
+            );
+            total += _mm_cvtsi128_si64(halves) as usize
+                + _mm_cvtsi128_si64(_mm_unpackhi_epi64(halves, halves)) as usize;
+        }
+        total + portable::count(needle, &haystack[i..])
+    }
+
+    pub fn count(needle: u8, haystack: &[u8]) -> usize {
+        // SAFETY: see above
+        unsafe { count_avx2(needle, haystack) }
+    }
+
+    #[target_feature(enable = "avx2")]
+    unsafe fn find_pair_avx2(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+        let f = _mm256_set1_epi8(first as i8);
+        let s = _mm256_set1_epi8(second as i8);
+        let len = haystack.len();
+        let ptr = haystack.as_ptr();
+        let mut i = 0usize;
+        while i + WIDTH < len {
+            let m = eq_mask(ptr.add(i), f) & eq_mask(ptr.add(i + 1), s);
+            if m != 0 {
+                return Some(i + m.trailing_zeros() as usize);
+            }
+            i += WIDTH;
+        }
+        portable::find_pair(first, second, &haystack[i..]).map(|p| i + p)
+    }
+
+    pub fn find_pair(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+        // SAFETY: see above
+        unsafe { find_pair_avx2(first, second, haystack) }
+    }
+}
+
+/// NEON kernels (part of the aarch64 baseline)
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use super::{portable, Kernels};
+    use std::arch::aarch64::*;
+
+    pub static KERNELS: Kernels = Kernels {
+        name: "neon",
+        memchr,
+        memchr2,
+        memchr3,
+        memrchr,
+        count,
+        find_pair,
+    };
+
+    const WIDTH: usize = 16;
+
+    /// Compare the 16 bytes at `haystack[i..]` with the splatted needle (0xFF per match)
+    fn eq(haystack: &[u8], i: usize, needle: uint8x16_t) -> uint8x16_t {
+        debug_assert!(i + WIDTH <= haystack.len());
+        // SAFETY: the 16 bytes at i are in bounds; NEON is part of the aarch64 baseline
+        unsafe { vceqq_u8(vld1q_u8(haystack.as_ptr().add(i)), needle) }
+    }
+
+    fn splat(b: u8) -> uint8x16_t {
+        // SAFETY: NEON is part of the aarch64 baseline
+        unsafe { vdupq_n_u8(b) }
+    }
+
+    /// Four bits per byte of a comparison result: nibble k is 0xF when byte k matched
+    fn nibble_mask(matches: uint8x16_t) -> u64 {
+        // SAFETY: NEON is part of the aarch64 baseline
+        unsafe {
+            let narrowed = vshrn_n_u16::<4>(vreinterpretq_u16_u8(matches));
+            vget_lane_u64::<0>(vreinterpret_u64_u8(narrowed))
+        }
+    }
+
+    fn first(haystack: &[u8], matches: impl Fn(usize) -> uint8x16_t) -> Option<usize> {
+        let mut i = 0usize;
+        while i + WIDTH <= haystack.len() {
+            let m = nibble_mask(matches(i));
+            if m != 0 {
+                return Some(i + (m.trailing_zeros() / 4) as usize);
+            }
+            i += WIDTH;
+        }
+        None
+    }
+
+    fn tail_start(len: usize) -> usize {
+        len - len % WIDTH
+    }
+
+    fn or(a: uint8x16_t, b: uint8x16_t) -> uint8x16_t {
+        // SAFETY: NEON is part of the aarch64 baseline
+        unsafe { vorrq_u8(a, b) }
+    }
+
+    pub fn memchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        first(haystack, |i| eq(haystack, i, n)).or_else(|| {
+            let i = tail_start(haystack.len());
+            portable::memchr(needle, &haystack[i..]).map(|p| i + p)
+        })
+    }
+
+    pub fn memchr2(needle1: u8, needle2: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2) = (splat(needle1), splat(needle2));
+        first(haystack, |i| or(eq(haystack, i, n1), eq(haystack, i, n2))).or_else(|| {
+            let i = tail_start(haystack.len());
+            portable::memchr2(needle1, needle2, &haystack[i..]).map(|p| i + p)
+        })
+    }
+
+    pub fn memchr3(needle1: u8, needle2: u8, needle3: u8, haystack: &[u8]) -> Option<usize> {
+        let (n1, n2, n3) = (splat(needle1), splat(needle2), splat(needle3));
+        let matches = |i| or(or(eq(haystack, i, n1), eq(haystack, i, n2)), eq(haystack, i, n3));
+        first(haystack, matches).or_else(|| {
+            let i = tail_start(haystack.len());
+            portable::memchr3(needle1, needle2, needle3, &haystack[i..]).map(|p| i + p)
+        })
+    }
+
+    pub fn memrchr(needle: u8, haystack: &[u8]) -> Option<usize> {
+        let n = splat(needle);
+        let mut end = haystack.len();
+        while end >= WIDTH {
+            let m = nibble_mask(eq(haystack, end - WIDTH, n));
+            if m != 0 {
+                return Some(end - WIDTH + (15 - m.leading_zeros() / 4) as usize);
+            }
+            end -= WIDTH;
+        }
+        portable::memrchr(needle, &haystack[..end])
+    }
+
+    pub fn count(needle: u8, haystack: &[u8]) -> usize {
+        let len = haystack.len();
+        let n = splat(needle);
+        let mut total = 0usize;
+        let mut i = 0usize;
+        while i + WIDTH <= len {
+            // Per-byte counters (a match is 0xFF, i.e. -1) overflow after 255 rounds
+            let rounds = ((len - i) / WIDTH).min(255);
+            // SAFETY: NEON is part of the aarch64 baseline
+            unsafe {
+                let mut acc = vdupq_n_u8(0);
+                for _ in 0..rounds {
+                    acc = vsubq_u8(acc, eq(haystack, i, n));
+                    i += WIDTH;
+                }
+                total += vaddlvq_u8(acc) as usize;
+            }
+        }
+        total + portable::count(needle, &haystack[i..])
+    }
+
+    pub fn find_pair(first: u8, second: u8, haystack: &[u8]) -> Option<usize> {
+        let (f, s) = (splat(first), splat(second));
+        let len = haystack.len();
+        let mut i = 0usize;
+        while i + WIDTH < len {
+            // SAFETY: NEON is part of the aarch64 baseline
+            let both = unsafe { vandq_u8(eq(haystack, i, f), eq(haystack, i + 1, s)) };
+            let m = nibble_mask(both);
+            if m != 0 {
+                return Some(i + (m.trailing_zeros() / 4) as usize);
+            }
+            i += WIDTH;
+        }
+        portable::find_pair(first, second, &haystack[i..]).map(|p| i + p)
+    }
+}
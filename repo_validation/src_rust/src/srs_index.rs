@@ -0,0 +1,1709 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Shared SRS tag index.
+//!
+//! Requirement documents (devdoc/*.md) and C/C# sources are parsed once per run by
+//! SrsIndexBuilder, a hidden check that the walker adds whenever an active check
+//! needs the index (Check::uses_srs_index). Because the builder is a check, it is
+//! sharded across workers, replayed from the result cache and kept complete in
+//! incremental mode like any other cross-file check. After the walk it becomes an
+//! SrsIndex, which every check receives in finalize(). While collecting, each shard
+//! packs the strings of its tags into an arena and keeps fixed-size records of spans.
+//!
+//! SrsIndex stores each distinct string (tag, path, text) once in a string pool and
+//! refers to it by id. write_to() serializes it into a flat file of fixed-width
+//! little-endian records that can be memory-mapped by other tools; the layout is
+//! documented in repo_validation/README.md.
+
+use std::collections::HashMap;
+use std::fs;
+use std::io;
+
+use crate::checks::{downcast_shard, Check};
+use crate::codec::{Decoder, Encoder};
+use crate::config::*;
+use crate::file_walker::FileTask;
+use crate::fixes::PendingFixes;
+use crate::hash::hash64;
+use crate::prefilter::Needle;
+use crate::scan;
+
+/// A **SRS_...: tag found in a requirement document
+pub struct MarkdownTag {
+    /// Byte offset of the leading "**"
+    pub offset: usize,
+    pub tag: String,
+    pub line: u32,
+    /// Written as "**SRS_TAG:" (the form srs_uniqueness counts)
+    pub is_definition: bool,
+    /// Requirement text when written as "**SRS_TAG: [** text **]**", markdown stripped
+    pub text: Option<String>,
+    /// Hash of the text as srs_consistency compares it (0 without text)
+    pub text_hash: u64,
+}
+
+/// Parse a requirement document. Tags are returned in document order, with `line`
+/// left at 0 for the caller to fill in from the file's line index.
+pub fn scan_requirement_document(content: &[u8]) -> Vec<MarkdownTag> {
+    let definitions = scan_tag_definitions(content);
+    let requirements = match std::str::from_utf8(content) {
+        Ok(text) => extract_markdown_requirements(text),
+        Err(_) => Vec::new(),
+    };
+
+    // Both scanners report tags in offset order; merge them, joining the two
+    // views of a tag that starts at the same "**"
+    let mut tags: Vec<MarkdownTag> = Vec::with_capacity(definitions.len().max(requirements.len()));
+    let mut definitions = definitions.into_iter().peekable();
+    let mut requirements = requirements.into_iter().peekable();
+    loop {
+        let take_definition = match (definitions.peek(), requirements.peek()) {
+            (Some(d), Some(r)) => d.0 <= r.0,
+            (Some(_), None) => true,
+            (None, Some(_)) => false,
+            (None, None) => break,
+        };
+        if take_definition {
+            let (offset, tag) = definitions.next().unwrap();
+            let (text, text_hash) = match requirements.peek() {
+                Some(r) if r.0 == offset => {
+                    let (_, _, text, hash) = requirements.next().unwrap();
+                    (Some(text), hash)
+                }
+                _ => (None, 0),
+            };
+            tags.push(MarkdownTag {
+                offset,
+                tag,
+                line: 0,
+                is_definition: true,
+                text,
+                text_hash,
+            });
+        } else {
+            let (offset, tag, text, text_hash) = requirements.next().unwrap();
+            tags.push(MarkdownTag {
+                offset,
+                tag,
+                line: 0,
+                is_definition: false,
+                text: Some(text),
+                text_hash,
+            });
+        }
+    }
+
+    tags
+}
+
+/// Find "**SRS_MODULE_DD_DDD:" tag definitions as (offset of the leading "**", tag)
+fn scan_tag_definitions(content: &[u8]) -> Vec<(usize, String)> {
+    let mut tags = Vec::new();
+    let len = content.len();
+    let mut p = 0usize;
+
+    while p + 6 < len {
+        // Find '*'
+        let star = match scan::memchr(b'*', &content[p..]) {
+            Some(pos) => p + pos,
+            None => break,
+        };
+
+        if star + 6 >= len {
+            break;
+        }
+
+        if content[star + 1] == b'*'
+            && content[star + 2] == b'S'
+            && content[star + 3] == b'R'
+            && content[star + 4] == b'S'
+            && content[star + 5] == b'_'
+        {
+            let tag_start = star + 2; // 'S' of SRS
+            let mut colon = star + 6; // after "**SRS_"
+
+            // Scan forward for ':' (end of tag)
+            while colon < len
+                && content[colon] != b':'
+                && content[colon] != b'\n'
+                && content[colon] != b'\r'
+            {
+                if !is_srs_tag_char(content[colon]) {
+                    break;
+                }
+                colon += 1;
+            }
+
+            if colon >= len || content[colon] != b':' {
+                p = star + 2;
+                continue;
+            }
+
+            // Validate tag ends with _DD_DDD
+            let tag_len = colon - tag_start;
+            if tag_len < 11 || !validate_srs_tag_format(&content[tag_start..colon]) {
+                p = star + 2;
+                continue;
+            }
+
+            if colon - 7 <= star + 6 {
+                p = star + 2;
+                continue;
+            }
+
+            if tag_len >= 256 {
+                p = star + 2;
+                continue;
+            }
+
+            let tag = match std::str::from_utf8(&content[tag_start..colon]) {
+                Ok(s) => s.to_string(),
+                Err(_) => {
+                    p = star + 2;
+                    continue;
+                }
+            };
+
+            tags.push((star, tag));
+            p = colon + 1;
+        } else {
+            p = star + 1;
+        }
+    }
+
+    tags
+}
+
+enum ItalicState {
+    Text,
+    /// After a '*'
+    Star,
+    /// After a '*' and the start of a word, held in `TextNormalizer::word`
+    Word,
+}
+
+/// Normalizes requirement text in a single pass, into buffers reused from one tag
+/// to the next, and hashes the result as srs_consistency compares it (ASCII
+/// case-insensitive). Markdown text goes through the stages below in order, each
+/// character handed from one to the next:
+/// - Remove bold markers: "**" pairs up left to right (an odd one out is kept)
+/// - Remove italics *word* (but not C pointer *ptr syntax)
+/// - Remove backticks: each pairs with the next (an odd one out is kept)
+/// - Unescape markdown: \< -> <, \> -> >, \\ -> \, etc.
+/// - Collapse whitespace runs to one space and trim
+///
+/// C text only has its whitespace collapsed.
+struct TextNormalizer {
+    text: String,
+    /// `text` with ASCII letters lowercased, which is what gets hashed
+    folded: Vec<u8>,
+    italic: ItalicState,
+    word: String,
+    backticks_left: usize,
+    escaped: bool,
+    pending_space: bool,
+}
+
+impl TextNormalizer {
+    fn new() -> Self {
+        Self {
+            text: String::new(),
+            folded: Vec::new(),
+            italic: ItalicState::Text,
+            word: String::new(),
+            backticks_left: 0,
+            escaped: false,
+            pending_space: false,
+        }
+    }
+
+    fn reset(&mut self) {
+        self.text.clear();
+        self.folded.clear();
+        self.italic = ItalicState::Text;
+        self.word.clear();
+        self.escaped = false;
+        self.pending_space = false;
+    }
+
+    /// Normalize requirement text from a markdown document. Returns the hash of the
+    /// result; the text is in `self.text`.
+    fn markdown(&mut self, raw: &str) -> u64 {
+        self.reset();
+        let bytes = raw.as_bytes();
+
+        // Removing markers never creates or splits a "**" or backtick, so the ones
+        // that pair up are known from the input
+        let mut bold_markers = 0usize;
+        let mut i = 0;
+        while let Some(offset) = scan::find_pair(b'*', b'*', &bytes[i..]) {
+            bold_markers += 1;
+            i += offset + 2;
+        }
+        let mut bold_left = bold_markers & !1;
+        self.backticks_left = bytes.iter().filter(|&&b| b == b'`').count() & !1;
+
+        let mut i = 0;
+        while i < bytes.len() {
+            if bytes[i] == b'*' && bytes.get(i + 1) == Some(&b'*') {
+                if bold_left > 0 {
+                    bold_left -= 1;
+                } else {
+                    self.italics('*');
+                    self.italics('*');
+                }
+                i += 2;
+                continue;
+            }
+            let c = raw[i..].chars().next().unwrap();
+            self.italics(c);
+            i += c.len_utf8();
+        }
+
+        // Flush a '*' or *word that never closed
+        match self.italic {
+            ItalicState::Text => {}
+            ItalicState::Star => self.backticks('*'),
+            ItalicState::Word => {
+                self.backticks('*');
+                self.flush_word();
+            }
+        }
+        self.italic = ItalicState::Text;
+        if self.escaped {
+            self.escaped = false;
+            self.collapse('\\');
+        }
+        hash64(&self.folded)
+    }
+
+    /// Normalize requirement text from a C or C# comment. Returns the hash of the
+    /// result; the text is in `self.text`.
+    fn c_text(&mut self, raw: &str) -> u64 {
+        self.reset();
+        for c in raw.chars() {
+            self.collapse(c);
+        }
+        hash64(&self.folded)
+    }
+
+    fn italics(&mut self, c: char) {
+        match self.italic {
+            ItalicState::Text => {
+                if c == '*' {
+                    self.italic = ItalicState::Star;
+                } else {
+                    self.backticks(c);
+                }
+            }
+            ItalicState::Star => {
+                if c.is_alphanumeric() {
+                    self.word.push(c);
+                    self.italic = ItalicState::Word;
+                } else {
+                    self.backticks('*');
+                    self.italic = ItalicState::Text;
+                    self.italics(c);
+                }
+            }
+            ItalicState::Word => {
+                if c.is_alphanumeric() || c == '_' {
+                    self.word.push(c);
+                } else if c == '*' {
+                    // *word*: drop both asterisks
+                    self.flush_word();
+                    self.italic = ItalicState::Text;
+                } else {
+                    self.backticks('*');
+                    self.flush_word();
+                    self.italic = ItalicState::Text;
+                    self.backticks(c);
+                }
+            }
+        }
+    }
+
+    fn flush_word(&mut self) {
+        let word = std::mem::take(&mut self.word);
+        for c in word.chars() {
+            self.backticks(c);
+        }
+        self.word = word;
+        self.word.clear();
+    }
+
+    fn backticks(&mut self, c: char) {
+        if c == '`' && self.backticks_left > 0 {
+            self.backticks_left -= 1;
+        } else {
+            self.unescape(c);
+        }
+    }
+
+    fn unescape(&mut self, c: char) {
+        if self.escaped {
+            self.escaped = false;
+            self.collapse(c);
+        } else if c == '\\' {
+            self.escaped = true;
+        } else {
+            self.collapse(c);
+        }
+    }
+
+    fn collapse(&mut self, c: char) {
+        if c.is_whitespace() {
+            self.pending_space = !self.text.is_empty();
+            return;
+        }
+        if self.pending_space {
+            self.pending_space = false;
+            self.push(' ');
+        }
+        self.push(c);
+    }
+
+    fn push(&mut self, c: char) {
+        self.text.push(c);
+        let mut utf8 = [0u8; 4];
+        self.folded.extend_from_slice(c.to_ascii_lowercase().encode_utf8(&mut utf8).as_bytes());
+    }
+}
+
+/// Extract requirements from markdown content as (offset of the leading "**", tag, clean text,
+/// text hash). Pattern: **SRS_MODULE_DD_DDD: [** text **]**
+fn extract_markdown_requirements(content: &str) -> Vec<(usize, String, String, u64)> {
+    let mut tags = Vec::new();
+    let mut normalizer = TextNormalizer::new();
+
+    // Use byte scanning to find the pattern
+    let bytes = content.as_bytes();
+    let len = bytes.len();
+    let mut p = 0usize;
+
+    while p + 10 < len {
+        // Find "**SRS_"
+        if p + 6 < len
+            && bytes[p] == b'*'
+            && bytes[p + 1] == b'*'
+            && bytes[p + 2] == b'S'
+            && bytes[p + 3] == b'R'
+            && bytes[p + 4] == b'S'
+            && bytes[p + 5] == b'_'
+        {
+            let tag_start = p + 2; // Start of "SRS_"
+            let mut q = p + 6;
+
+            // Scan tag chars (uppercase letters, digits, underscore)
+            while q < len && is_srs_tag_char(bytes[q]) {
+                q += 1;
+            }
+
+            let tag_end = q;
+
+            // Expect ':' (possibly after closing '**' if tag is **SRS_TAG**: [** pattern)
+            if q >= len {
+                p += 2;
+                continue;
+            }
+
+            if bytes[q] == b':' {
+                // Standard: **SRS_TAG: [** text **]**
+                q += 1;
+            } else if q + 2 < len
+                && bytes[q] == b'*'
+                && bytes[q + 1] == b'*'
+                && bytes[q + 2] == b':'
+            {
+                // Alternate: **SRS_TAG**: [** text **]**
+                q += 3;
+            } else {
+                p += 2;
+                continue;
+            }
+
+            // Validate tag format: SRS_MODULE_DD_DDD
+            let tag_bytes = &bytes[tag_start..tag_end];
+            if !validate_srs_tag_format(tag_bytes) {
+                p += 2;
+                continue;
+            }
+
+            // Skip whitespace and bold close markers (**) between colon and opening bracket
+            // Handles both: **SRS_TAG: [** text **]** and **SRS_TAG:** [** text **]**
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t' || bytes[q] == b'*') {
+                q += 1;
+            }
+
+            // Expect "[**"
+            if q + 3 > len || bytes[q] != b'[' || bytes[q + 1] != b'*' || bytes[q + 2] != b'*' {
+                p += 2;
+                continue;
+            }
+            q += 3;
+
+            // Skip whitespace after [**
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Find "**]**" ending - scan across newlines (matching PS1 Singleline regex behavior)
+            // Stop if we encounter another **SRS_ tag start to avoid crossing tag boundaries
+            let text_start = q;
+            let mut text_end = None;
+            let scan_limit = std::cmp::min(len, text_start + 4096);
+            while q + 5 <= scan_limit {
+                if bytes[q] == b'*'
+                    && bytes[q + 1] == b'*'
+                    && bytes[q + 2] == b']'
+                    && bytes[q + 3] == b'*'
+                    && bytes[q + 4] == b'*'
+                {
+                    text_end = Some(q);
+                    break;
+                }
+                // Stop at another **SRS_ tag (don't cross tag boundaries)
+                if q > text_start
+                    && q + 6 < len
+                    && bytes[q] == b'*'
+                    && bytes[q + 1] == b'*'
+                    && bytes[q + 2] == b'S'
+                    && bytes[q + 3] == b'R'
+                    && bytes[q + 4] == b'S'
+                    && bytes[q + 5] == b'_'
+                {
+                    break;
+                }
+                q += 1;
+            }
+
+            if let Some(te) = text_end {
+                // Trim trailing whitespace from text
+                let mut actual_end = te;
+                while actual_end > text_start
+                    && (bytes[actual_end - 1] == b' ' || bytes[actual_end - 1] == b'\t')
+                {
+                    actual_end -= 1;
+                }
+
+                // The delimiters are ASCII, so these are character boundaries
+                let tag = content[tag_start..tag_end].to_string();
+                let hash = normalizer.markdown(&content[text_start..actual_end]);
+
+                tags.push((p, tag, normalizer.text.clone(), hash));
+
+                p = te + 5;
+            } else {
+                p += 2;
+            }
+        } else {
+            // Jump to the next '*'
+            match scan::memchr(b'*', &bytes[p + 1..]) {
+                Some(offset) => p += 1 + offset,
+                None => break,
+            }
+        }
+    }
+
+    tags
+}
+
+fn is_srs_tag_char(b: u8) -> bool {
+    b.is_ascii_uppercase() || b.is_ascii_digit() || b == b'_'
+}
+
+/// Validate tag has format SRS_MODULE_DD_DDD (ends with _NN_NNN)
+fn validate_srs_tag_format(tag: &[u8]) -> bool {
+    let len = tag.len();
+    if len < 11 {
+        // SRS_ + at least 1 char module + _DD_DDD = 11+
+        return false;
+    }
+    // Check ends with _DD_DDD
+    len >= 11
+        && tag[len - 1].is_ascii_digit()
+        && tag[len - 2].is_ascii_digit()
+        && tag[len - 3].is_ascii_digit()
+        && tag[len - 4] == b'_'
+        && tag[len - 5].is_ascii_digit()
+        && tag[len - 6].is_ascii_digit()
+        && tag[len - 7] == b'_'
+}
+
+/// A Codes_SRS_/Tests_SRS_ comment found in C or C# source
+pub struct CodeTag {
+    pub tag: String,
+    /// "Codes" or "Tests"
+    pub prefix: String,
+    pub text: String,
+    /// Hash of the text as srs_consistency compares it
+    pub text_hash: u64,
+    pub original_match: String,
+    /// Offsets in original_match of the tag, and of the text before normalization
+    pub tag_range: (u32, u32),
+    pub raw_text_range: (u32, u32),
+    pub match_index: usize,
+    pub has_duplication: bool,
+    pub is_incomplete: bool,
+    /// 1-based line of match_index (filled in by SrsIndexBuilder)
+    pub line: u32,
+}
+
+/// Extract SRS tags from C code.
+/// Handles block comments, incomplete block comments, and line comments.
+fn extract_c_srs_tags(content: &str) -> Vec<CodeTag> {
+    let mut tags = Vec::new();
+    let mut normalizer = TextNormalizer::new();
+    let mut complete_ranges: Vec<(usize, usize)> = Vec::new();
+
+    // Phase 1: Find complete block comments: /*..Codes/Tests_SRS_MODULE_DD_DDD: [ text ]*/
+    let bytes = content.as_bytes();
+    let len = bytes.len();
+
+    // Find block comments
+    {
+        let mut p = 0usize;
+        while p + 2 < len {
+            // Jump to the next "/*"
+            match scan::find_pair(b'/', b'*', &bytes[p..len - 1]) {
+                Some(offset) => p += offset,
+                None => break,
+            }
+            let comment_start = p;
+            // Skip additional * chars
+            let mut q = p + 2;
+            while q < len && bytes[q] == b'*' {
+                q += 1;
+            }
+            // Skip whitespace
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Check for Codes_ or Tests_ prefix
+            let prefix = if q + 6 <= len && &bytes[q..q + 6] == b"Codes_" {
+                q += 6;
+                "Codes"
+            } else if q + 6 <= len && &bytes[q..q + 6] == b"Tests_" {
+                q += 6;
+                "Tests"
+            } else {
+                p += 1;
+                continue;
+            };
+
+            // Expect "SRS_"
+            if q + 4 > len || &bytes[q..q + 4] != b"SRS_" {
+                p += 1;
+                continue;
+            }
+            let tag_start = q; // Start of SRS_
+            q += 4;
+
+            // Scan tag chars
+            while q < len && is_srs_tag_char(bytes[q]) {
+                q += 1;
+            }
+            let tag_end = q;
+
+            // Validate tag format
+            let tag_bytes = &bytes[tag_start..tag_end];
+            if !validate_srs_tag_format(tag_bytes) {
+                p += 1;
+                continue;
+            }
+
+            // Skip optional whitespace before colon
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Expect ':'
+            if q >= len || bytes[q] != b':' {
+                p += 1;
+                continue;
+            }
+            q += 1;
+
+            // Skip whitespace
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Expect '['
+            if q >= len || bytes[q] != b'[' {
+                p += 1;
+                continue;
+            }
+            q += 1;
+
+            // Skip whitespace after [
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+            let actual_text_start = q;
+
+            // Scan for ]*/ (complete) on the same line
+            // Limit scanning to same line
+            let line_end = find_line_end(bytes, q);
+
+            // Look for ] followed by optional whitespace and */
+            let mut found_complete = false;
+            let mut found_incomplete = false;
+            let mut text_end_pos = q;
+            let mut comment_end_pos = q;
+
+            // Search for ]*/  or just */ (incomplete)
+            let mut scan = q;
+            while scan < line_end {
+                if bytes[scan] == b']' {
+                    // Found ], look for */ after optional whitespace
+                    let mut after_bracket = scan + 1;
+                    while after_bracket < line_end
+                        && (bytes[after_bracket] == b' ' || bytes[after_bracket] == b'\t')
+                    {
+                        after_bracket += 1;
+                    }
+                    // Check for */ (possibly with extra *)
+                    if after_bracket + 1 < len
+                        && bytes[after_bracket] == b'*'
+                        && bytes[after_bracket + 1] == b'/'
+                    {
+                        text_end_pos = scan;
+                        comment_end_pos = after_bracket + 2;
+                        found_complete = true;
+                        // Don't break - keep looking for LAST ]*/ on this line
+                    } else if after_bracket + 2 < len
+                        && bytes[after_bracket] == b'*'
+                        && bytes[after_bracket + 1] == b'*'
+                        && bytes[after_bracket + 2] == b'/'
+                    {
+                        text_end_pos = scan;
+                        comment_end_pos = after_bracket + 3;
+                        found_complete = true;
+                    }
+                }
+                scan += 1;
+            }
+
+            if !found_complete {
+                // Look for incomplete: text followed by */ without ]
+                // PS1 incomplete pattern requires text to NOT contain ']'
+                scan = q;
+                let mut has_bracket_in_text = false;
+                while scan + 1 < line_end {
+                    if bytes[scan] == b']' {
+                        has_bracket_in_text = true;
+                    }
+                    if bytes[scan] == b'*' && bytes[scan + 1] == b'/' {
+                        if !has_bracket_in_text {
+                            text_end_pos = scan;
+                            comment_end_pos = scan + 2;
+                            found_incomplete = true;
+                        }
+                        break;
+                    }
+                    scan += 1;
+                }
+            }
+
+            if found_complete || found_incomplete {
+                // The delimiters are ASCII, so these are character boundaries
+                let tag = content[tag_start..tag_end].to_string();
+                let text_hash = normalizer.c_text(&content[actual_text_start..text_end_pos]);
+                let original = content[comment_start..comment_end_pos].to_string();
+
+                // Check for duplication
+                let has_duplication = original.matches("]*/").count() > 1;
+
+                complete_ranges.push((comment_start, comment_end_pos));
+
+                tags.push(CodeTag {
+                    tag,
+                    prefix: prefix.to_string(),
+                    text: normalizer.text.clone(),
+                    text_hash,
+                    original_match: original,
+                    tag_range: ((tag_start - comment_start) as u32, (tag_end - comment_start) as u32),
+                    raw_text_range: ((actual_text_start - comment_start) as u32, (text_end_pos - comment_start) as u32),
+                    match_index: comment_start,
+                    has_duplication,
+                    is_incomplete: found_incomplete && !found_complete,
+                line: 0,
+                });
+
+                p = comment_end_pos;
+            } else {
+                p += 1;
+            }
+        }
+    }
+
+    // Phase 2: Find line comments: // Codes_SRS_MODULE_DD_DDD: [ text ]
+    {
+        let mut p = 0usize;
+        while p + 2 < len {
+            // Jump to the start of the next // comment
+            match scan::find_pair(b'/', b'/', &bytes[p..len - 1]) {
+                Some(offset) => p += offset,
+                None => break,
+            }
+            let comment_start = p;
+            let mut q = p + 2;
+
+            // Skip whitespace
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Check for Codes_ or Tests_ prefix
+            let prefix = if q + 6 <= len && &bytes[q..q + 6] == b"Codes_" {
+                q += 6;
+                "Codes"
+            } else if q + 6 <= len && &bytes[q..q + 6] == b"Tests_" {
+                q += 6;
+                "Tests"
+            } else {
+                p += 1;
+                continue;
+            };
+
+            // Expect "SRS_"
+            if q + 4 > len || &bytes[q..q + 4] != b"SRS_" {
+                p += 1;
+                continue;
+            }
+            let tag_start = q;
+            q += 4;
+
+            // Scan tag chars
+            while q < len && is_srs_tag_char(bytes[q]) {
+                q += 1;
+            }
+            let tag_end = q;
+
+            if !validate_srs_tag_format(&bytes[tag_start..tag_end]) {
+                p += 1;
+                continue;
+            }
+
+            // Skip optional whitespace before colon
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Expect ':'
+            if q >= len || bytes[q] != b':' {
+                p += 1;
+                continue;
+            }
+            q += 1;
+
+            // Skip whitespace
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+
+            // Expect '['
+            if q >= len || bytes[q] != b'[' {
+                p += 1;
+                continue;
+            }
+            q += 1;
+
+            // Skip whitespace
+            while q < len && (bytes[q] == b' ' || bytes[q] == b'\t') {
+                q += 1;
+            }
+            let text_start = q;
+
+            // Find end of line
+            let line_end = find_line_end(bytes, q);
+
+            // Find the last ] on this line
+            let mut last_bracket = None;
+            for i in (text_start..line_end).rev() {
+                if bytes[i] == b']' {
+                    last_bracket = Some(i);
+                    break;
+                }
+            }
+
+            let text_end = last_bracket.unwrap_or(line_end);
+
+            // Check that this doesn't overlap with a block comment match
+            let overlaps = complete_ranges
+                .iter()
+                .any(|(s, e)| comment_start >= *s && comment_start < *e);
+            if overlaps {
+                p += 1;
+                continue;
+            }
+
+            let tag = content[tag_start..tag_end].to_string();
+            let text_hash = normalizer.c_text(&content[text_start..text_end]);
+
+            let original_end = if last_bracket.is_some() {
+                text_end + 1
+            } else {
+                line_end
+            };
+            let original = content[comment_start..original_end].to_string();
+
+            tags.push(CodeTag {
+                tag,
+                prefix: prefix.to_string(),
+                text: normalizer.text.clone(),
+                text_hash,
+                original_match: original,
+                tag_range: ((tag_start - comment_start) as u32, (tag_end - comment_start) as u32),
+                raw_text_range: ((text_start - comment_start) as u32, (text_end - comment_start) as u32),
+                match_index: comment_start,
+                has_duplication: false,
+                is_incomplete: last_bracket.is_none(),
+                line: 0,
+            });
+
+            p = line_end;
+        }
+    }
+
+    tags
+}
+
+fn find_line_end(bytes: &[u8], start: usize) -> usize {
+    match scan::memchr2(b'\n', b'\r', &bytes[start..]) {
+        Some(offset) => start + offset,
+        None => bytes.len(),
+    }
+}
+
+/// Parse a C or C# source file. Tags are returned in the order srs_consistency reports them,
+/// with `line` left at 0 for the caller to fill in from the file's line index.
+pub fn scan_source_file(content: &str) -> Vec<CodeTag> {
+    extract_c_srs_tags(content)
+}
+
+/// A string in a TagArena: chunk index, start and length
+#[derive(Clone, Copy)]
+struct Span {
+    chunk: u32,
+    start: u32,
+    len: u32,
+}
+
+impl Span {
+    /// The span once its arena's chunks follow `chunks` others
+    fn rebase(self, chunks: u32) -> Span {
+        Span {
+            chunk: self.chunk + chunks,
+            ..self
+        }
+    }
+}
+
+const ARENA_CHUNK_SIZE: usize = 64 * 1024;
+
+/// Strings up to which a merged shard is copied into the arena rather than
+/// handing over its chunks, most of which it left empty. A shard replayed from the
+/// result cache holds the tags of a single file.
+const SMALL_SHARD_BYTES: usize = ARENA_CHUNK_SIZE / 4;
+
+/// The strings collected by one builder shard, packed into fixed-size chunks so that
+/// a tag costs one small record rather than a heap allocation per string. Chunks are
+/// never reallocated, and merging shards moves chunks rather than copying bytes.
+#[derive(Default)]
+struct TagArena {
+    chunks: Vec<String>,
+    /// Spans in each chunk not yet released
+    live: Vec<u32>,
+}
+
+impl TagArena {
+    fn push(&mut self, value: &str) -> Span {
+        let fits = match self.chunks.last() {
+            Some(chunk) => chunk.capacity() - chunk.len() >= value.len(),
+            None => false,
+        };
+        if !fits {
+            // Longer strings get a chunk of their own
+            self.chunks.push(String::with_capacity(value.len().max(ARENA_CHUNK_SIZE)));
+            self.live.push(0);
+        }
+        let chunk = self.chunks.len() - 1;
+        self.live[chunk] += 1;
+        let data = &mut self.chunks[chunk];
+        let start = data.len();
+        data.push_str(value);
+        Span {
+            chunk: chunk as u32,
+            start: start as u32,
+            len: value.len() as u32,
+        }
+    }
+
+    fn get(&self, span: Span) -> &str {
+        &self.chunks[span.chunk as usize][span.start as usize..(span.start + span.len) as usize]
+    }
+
+    /// Mark a span as read for the last time; a chunk is freed with its last span
+    fn release(&mut self, span: Span) {
+        let chunk = span.chunk as usize;
+        self.live[chunk] -= 1;
+        if self.live[chunk] == 0 {
+            self.chunks[chunk] = String::new();
+        }
+    }
+
+    fn append(&mut self, other: TagArena) {
+        self.chunks.extend(other.chunks);
+        self.live.extend(other.live);
+    }
+}
+
+struct CollectedMarkdownTag {
+    tag: Span,
+    text: Option<Span>,
+    text_hash: u64,
+    line: u32,
+    is_definition: bool,
+}
+
+struct CollectedCodeTag {
+    tag: Span,
+    text: Span,
+    text_hash: u64,
+    original_match: Span,
+    tag_range: (u32, u32),
+    raw_text_range: (u32, u32),
+    match_index: usize,
+    line: u32,
+    is_test: bool,
+    has_duplication: bool,
+    is_incomplete: bool,
+}
+
+/// A requirement document; its tags are `markdown_tags[first_tag..first_tag + tag_count]`
+struct ScannedDocument {
+    relative_path: Span,
+    ordinal: usize,
+    first_tag: u32,
+    tag_count: u32,
+}
+
+/// A C or C# source; its tags are `code_tags[first_tag..first_tag + tag_count]`
+struct ScannedSource {
+    full_path: Span,
+    relative_path: Span,
+    ordinal: usize,
+    first_tag: u32,
+    tag_count: u32,
+}
+
+/// Hidden check that collects the per-file input of the SRS index
+pub struct SrsIndexBuilder {
+    arena: TagArena,
+    documents: Vec<ScannedDocument>,
+    sources: Vec<ScannedSource>,
+    markdown_tags: Vec<CollectedMarkdownTag>,
+    code_tags: Vec<CollectedCodeTag>,
+}
+
+impl SrsIndexBuilder {
+    pub fn new() -> Self {
+        Self {
+            arena: TagArena::default(),
+            documents: Vec::new(),
+            sources: Vec::new(),
+            markdown_tags: Vec::new(),
+            code_tags: Vec::new(),
+        }
+    }
+
+    fn push_document(&mut self, relative_path: &str, ordinal: usize, tags: &[MarkdownTag]) {
+        let first_tag = self.markdown_tags.len() as u32;
+        for tag in tags {
+            let record = CollectedMarkdownTag {
+                tag: self.arena.push(&tag.tag),
+                text: tag.text.as_deref().map(|text| self.arena.push(text)),
+                text_hash: tag.text_hash,
+                line: tag.line,
+                is_definition: tag.is_definition,
+            };
+            self.markdown_tags.push(record);
+        }
+        self.documents.push(ScannedDocument {
+            relative_path: self.arena.push(relative_path),
+            ordinal,
+            first_tag,
+            tag_count: tags.len() as u32,
+        });
+    }
+
+    fn push_source(&mut self, full_path: &str, relative_path: &str, ordinal: usize, tags: &[CodeTag]) {
+        let first_tag = self.code_tags.len() as u32;
+        for tag in tags {
+            let record = CollectedCodeTag {
+                tag: self.arena.push(&tag.tag),
+                text: self.arena.push(&tag.text),
+                text_hash: tag.text_hash,
+                original_match: self.arena.push(&tag.original_match),
+                tag_range: tag.tag_range,
+                raw_text_range: tag.raw_text_range,
+                match_index: tag.match_index,
+                line: tag.line,
+                is_test: tag.prefix == "Tests",
+                has_duplication: tag.has_duplication,
+                is_incomplete: tag.is_incomplete,
+            };
+            self.code_tags.push(record);
+        }
+        self.sources.push(ScannedSource {
+            full_path: self.arena.push(full_path),
+            relative_path: self.arena.push(relative_path),
+            ordinal,
+            first_tag,
+            tag_count: tags.len() as u32,
+        });
+    }
+
+    /// Append the documents and sources of `shard`, copying its strings into this
+    /// builder's arena
+    fn copy_shard(&mut self, shard: &Self) {
+        for document in &shard.documents {
+            let first_tag = self.markdown_tags.len() as u32;
+            let tags = document.first_tag as usize..(document.first_tag + document.tag_count) as usize;
+            for tag in &shard.markdown_tags[tags] {
+                let record = CollectedMarkdownTag {
+                    tag: self.arena.push(shard.arena.get(tag.tag)),
+                    text: tag.text.map(|text| self.arena.push(shard.arena.get(text))),
+                    text_hash: tag.text_hash,
+                    line: tag.line,
+                    is_definition: tag.is_definition,
+                };
+                self.markdown_tags.push(record);
+            }
+            self.documents.push(ScannedDocument {
+                relative_path: self.arena.push(shard.arena.get(document.relative_path)),
+                ordinal: document.ordinal,
+                first_tag,
+                tag_count: document.tag_count,
+            });
+        }
+
+        for source in &shard.sources {
+            let first_tag = self.code_tags.len() as u32;
+            let tags = source.first_tag as usize..(source.first_tag + source.tag_count) as usize;
+            for tag in &shard.code_tags[tags] {
+                let record = CollectedCodeTag {
+                    tag: self.arena.push(shard.arena.get(tag.tag)),
+                    text: self.arena.push(shard.arena.get(tag.text)),
+                    text_hash: tag.text_hash,
+                    original_match: self.arena.push(shard.arena.get(tag.original_match)),
+                    tag_range: tag.tag_range,
+                    raw_text_range: tag.raw_text_range,
+                    match_index: tag.match_index,
+                    line: tag.line,
+                    is_test: tag.is_test,
+                    has_duplication: tag.has_duplication,
+                    is_incomplete: tag.is_incomplete,
+                };
+                self.code_tags.push(record);
+            }
+            self.sources.push(ScannedSource {
+                full_path: self.arena.push(shard.arena.get(source.full_path)),
+                relative_path: self.arena.push(shard.arena.get(source.relative_path)),
+                ordinal: source.ordinal,
+                first_tag,
+                tag_count: source.tag_count,
+            });
+        }
+    }
+
+    /// Build the index from everything collected, in walk order. Arena chunks are
+    /// freed as soon as everything in them is interned.
+    pub fn build(mut self) -> SrsIndex {
+        self.documents.sort_by_key(|d| d.ordinal);
+        self.sources.sort_by_key(|s| s.ordinal);
+
+        let arena = &mut self.arena;
+        let mut index = SrsIndex::default();
+        for document in &self.documents {
+            let document_id = index.documents.len() as u32;
+            index.documents.push(index.strings.intern(arena.get(document.relative_path)));
+            arena.release(document.relative_path);
+            let tags = document.first_tag as usize..(document.first_tag + document.tag_count) as usize;
+            for tag in &self.markdown_tags[tags] {
+                let tag_id = index.strings.intern(arena.get(tag.tag));
+                arena.release(tag.tag);
+                let text = match tag.text {
+                    Some(span) => {
+                        let id = index.strings.intern(arena.get(span));
+                        arena.release(span);
+                        id
+                    }
+                    None => NO_STRING,
+                };
+                let record = index.markdown.len() as u32;
+                if text != NO_STRING {
+                    index.requirements.entry(tag_id).or_insert(record);
+                }
+                index.markdown.push(MarkdownRecord {
+                    tag: tag_id,
+                    document: document_id,
+                    line: tag.line,
+                    text,
+                    is_definition: tag.is_definition,
+                    text_hash: tag.text_hash,
+                });
+            }
+        }
+
+        for source in &self.sources {
+            let source_id = index.sources.len() as u32;
+            index.sources.push(SourceRecord {
+                path: index.strings.intern(arena.get(source.full_path)),
+                relative_path: index.strings.intern(arena.get(source.relative_path)),
+            });
+            arena.release(source.full_path);
+            arena.release(source.relative_path);
+            let tags = source.first_tag as usize..(source.first_tag + source.tag_count) as usize;
+            for tag in &self.code_tags[tags] {
+                index.references.push(ReferenceRecord {
+                    tag: index.strings.intern(arena.get(tag.tag)),
+                    source: source_id,
+                    line: tag.line,
+                    is_test: tag.is_test,
+                    text: index.strings.intern(arena.get(tag.text)),
+                    original_match: index.strings.intern(arena.get(tag.original_match)),
+                    match_index: tag.match_index,
+                    has_duplication: tag.has_duplication,
+                    is_incomplete: tag.is_incomplete,
+                    text_hash: tag.text_hash,
+                });
+                arena.release(tag.tag);
+                arena.release(tag.text);
+                arena.release(tag.original_match);
+            }
+        }
+
+        index.strings.shrink_to_fit();
+        index
+    }
+}
+
+impl Check for SrsIndexBuilder {
+    fn name(&self) -> &str {
+        "srs_index"
+    }
+
+    fn description(&self) -> &str {
+        "Collects SRS tags from requirement documents and sources for the shared SRS index"
+    }
+
+    fn file_types(&self) -> u32 {
+        FILE_TYPE_MD | FILE_TYPE_C | FILE_TYPE_CS
+    }
+
+    fn requires_devdoc(&self) -> bool {
+        false
+    }
+
+    fn cross_file(&self) -> bool {
+        true
+    }
+
+    fn uses_srs_index(&self) -> bool {
+        false
+    }
+
+    fn needles(&self) -> &'static [Needle] {
+        &[]
+    }
+
+    fn init(&mut self, _config: &ValidatorConfig, _out: &mut CheckOutput) {
+        *self = Self::new();
+    }
+
+    fn fork(&self) -> Box<dyn Check> {
+        Box::new(Self::new())
+    }
+
+    fn merge(&mut self, shard: Box<dyn Check>) {
+        let shard = downcast_shard::<Self>(shard);
+        if self.documents.is_empty() && self.sources.is_empty() {
+            // The first shard is taken over rather than copied
+            *self = *shard;
+            return;
+        }
+        if shard.arena.chunks.iter().map(String::len).sum::<usize>() < SMALL_SHARD_BYTES {
+            self.copy_shard(&shard);
+            return;
+        }
+        // Append the shard's chunks and tag lists, moving its spans and tag ranges along
+        let base = self.arena.chunks.len() as u32;
+        let first_markdown = self.markdown_tags.len() as u32;
+        let first_code = self.code_tags.len() as u32;
+        self.arena.append(shard.arena);
+        self.markdown_tags.extend(shard.markdown_tags.into_iter().map(|tag| CollectedMarkdownTag {
+            tag: tag.tag.rebase(base),
+            text: tag.text.map(|span| span.rebase(base)),
+            ..tag
+        }));
+        self.code_tags.extend(shard.code_tags.into_iter().map(|tag| CollectedCodeTag {
+            tag: tag.tag.rebase(base),
+            text: tag.text.rebase(base),
+            original_match: tag.original_match.rebase(base),
+            ..tag
+        }));
+        self.documents.extend(shard.documents.into_iter().map(|document| ScannedDocument {
+            relative_path: document.relative_path.rebase(base),
+            first_tag: document.first_tag + first_markdown,
+            ..document
+        }));
+        self.sources.extend(shard.sources.into_iter().map(|source| ScannedSource {
+            full_path: source.full_path.rebase(base),
+            relative_path: source.relative_path.rebase(base),
+            first_tag: source.first_tag + first_code,
+            ..source
+        }));
+    }
+
+    fn check_file(&mut self, file: &FileInfo, _config: &ValidatorConfig, _report: &mut FileReport) {
+        if file.type_flags & FILE_TYPE_MD != 0 {
+            if file.type_flags & FILE_FLAG_IN_DEVDOC != 0 {
+                let mut tags = scan_requirement_document(&file.content);
+                for tag in tags.iter_mut() {
+                    tag.line = file.lines().line_number(tag.offset) as u32;
+                }
+                self.push_document(&file.relative_path, file.ordinal, &tags);
+            }
+            return;
+        }
+
+        if file.type_flags & (FILE_TYPE_C | FILE_TYPE_CS) == 0 {
+            return;
+        }
+
+        // Sources that are not valid UTF-8 still count as scanned
+        let mut tags = match std::str::from_utf8(&file.content) {
+            Ok(content) => scan_source_file(content),
+            Err(_) => Vec::new(),
+        };
+        for tag in tags.iter_mut() {
+            tag.line = file.lines().line_number(tag.match_index) as u32;
+        }
+        self.push_source(&file.path, &file.relative_path, file.ordinal, &tags);
+    }
+
+    fn version(&self) -> u32 {
+        4
+    }
+
+    fn save_shard(&self, out: &mut Encoder) {
+        out.u32(self.documents.len() as u32);
+        for document in &self.documents {
+            out.u32(document.tag_count);
+            let tags = document.first_tag as usize..(document.first_tag + document.tag_count) as usize;
+            for tag in &self.markdown_tags[tags] {
+                out.str(self.arena.get(tag.tag));
+                out.u32(tag.line);
+                out.bool(tag.is_definition);
+                out.bool(tag.text.is_some());
+                if let Some(text) = tag.text {
+                    out.str(self.arena.get(text));
+                    out.u64(tag.text_hash);
+                }
+            }
+        }
+
+        out.u32(self.sources.len() as u32);
+        for source in &self.sources {
+            out.u32(source.tag_count);
+            let tags = source.first_tag as usize..(source.first_tag + source.tag_count) as usize;
+            // The tag and the text are taken back out of the original match
+            for tag in &self.code_tags[tags] {
+                out.str(self.arena.get(tag.original_match));
+                out.u32(tag.tag_range.0);
+                out.u32(tag.tag_range.1);
+                out.u32(tag.raw_text_range.0);
+                out.u32(tag.raw_text_range.1);
+                out.bool(tag.is_test);
+                out.usize(tag.match_index);
+                out.bool(tag.has_duplication);
+                out.bool(tag.is_incomplete);
+                out.u32(tag.line);
+            }
+        }
+    }
+
+    fn load_shard(&mut self, input: &mut Decoder, file: &FileTask) -> Option<()> {
+        let document_count = input.u32()?;
+        for _ in 0..document_count {
+            let tag_count = input.u32()?;
+            let first_tag = self.markdown_tags.len() as u32;
+            for _ in 0..tag_count {
+                let tag = self.arena.push(&input.string()?);
+                let line = input.u32()?;
+                let is_definition = input.bool()?;
+                let (text, text_hash) = if input.bool()? {
+                    (Some(self.arena.push(&input.string()?)), input.u64()?)
+                } else {
+                    (None, 0)
+                };
+                self.markdown_tags.push(CollectedMarkdownTag {
+                    tag,
+                    text,
+                    text_hash,
+                    line,
+                    is_definition,
+                });
+            }
+            self.documents.push(ScannedDocument {
+                relative_path: self.arena.push(&file.relative_path),
+                ordinal: file.ordinal,
+                first_tag,
+                tag_count,
+            });
+        }
+
+        let source_count = input.u32()?;
+        let mut normalizer = TextNormalizer::new();
+        for _ in 0..source_count {
+            let tag_count = input.u32()?;
+            let first_tag = self.code_tags.len() as u32;
+            for _ in 0..tag_count {
+                let original_match = input.string()?;
+                let tag_range = (input.u32()?, input.u32()?);
+                let raw_text_range = (input.u32()?, input.u32()?);
+                let tag_text = original_match.get(tag_range.0 as usize..tag_range.1 as usize)?;
+                let text_hash = normalizer.c_text(original_match.get(raw_text_range.0 as usize..raw_text_range.1 as usize)?);
+                let tag = CollectedCodeTag {
+                    tag: self.arena.push(tag_text),
+                    text: self.arena.push(&normalizer.text),
+                    text_hash,
+                    original_match: self.arena.push(&original_match),
+                    tag_range,
+                    raw_text_range,
+                    is_test: input.bool()?,
+                    match_index: input.usize()?,
+                    has_duplication: input.bool()?,
+                    is_incomplete: input.bool()?,
+                    line: input.u32()?,
+                };
+                self.code_tags.push(tag);
+            }
+            self.sources.push(ScannedSource {
+                full_path: self.arena.push(&file.full_path),
+                relative_path: self.arena.push(&file.relative_path),
+                ordinal: file.ordinal,
+                first_tag,
+                tag_count,
+            });
+        }
+        Some(())
+    }
+
+    fn finalize(
+        &mut self,
+        _config: &ValidatorConfig,
+        _srs_index: &SrsIndex,
+        _fixes: &mut PendingFixes,
+        _out: &mut CheckOutput,
+    ) -> i32 {
+        // Never reported: the walker turns the builder into an SrsIndex instead
+        0
+    }
+}
+
+type StrId = u32;
+const NO_STRING: StrId = u32::MAX;
+
+/// Append-only pool holding every distinct string once
+#[derive(Default)]
+struct StringPool {
+    data: String,
+    spans: Vec<(u32, u32)>,
+    /// Lookup used while building; a second string with the same hash goes to `collisions`
+    by_hash: HashMap<u64, StrId>,
+    collisions: HashMap<String, StrId>,
+}
+
+impl StringPool {
+    fn get(&self, id: StrId) -> &str {
+        let (start, len) = self.spans[id as usize];
+        &self.data[start as usize..(start + len) as usize]
+    }
+
+    fn find(&self, value: &str) -> Option<StrId> {
+        match self.by_hash.get(&hash64(value.as_bytes())) {
+            Some(&id) if self.get(id) == value => Some(id),
+            Some(_) => self.collisions.get(value).copied(),
+            None => None,
+        }
+    }
+
+    fn intern(&mut self, value: &str) -> StrId {
+        if let Some(id) = self.find(value) {
+            return id;
+        }
+        let id = self.spans.len() as StrId;
+        self.spans.push((self.data.len() as u32, value.len() as u32));
+        self.data.push_str(value);
+        let hash = hash64(value.as_bytes());
+        if self.by_hash.contains_key(&hash) {
+            self.collisions.insert(value.to_string(), id);
+        } else {
+            self.by_hash.insert(hash, id);
+        }
+        id
+    }
+
+    fn shrink_to_fit(&mut self) {
+        self.data.shrink_to_fit();
+        self.spans.shrink_to_fit();
+    }
+}
+
+struct MarkdownRecord {
+    tag: StrId,
+    document: u32,
+    line: u32,
+    text: StrId,
+    is_definition: bool,
+    text_hash: u64,
+}
+
+struct SourceRecord {
+    path: StrId,
+    relative_path: StrId,
+}
+
+struct ReferenceRecord {
+    tag: StrId,
+    source: u32,
+    line: u32,
+    is_test: bool,
+    text: StrId,
+    original_match: StrId,
+    match_index: usize,
+    has_duplication: bool,
+    is_incomplete: bool,
+    text_hash: u64,
+}
+
+/// A tag occurrence in a requirement document
+pub struct MarkdownEntry<'a> {
+    pub tag: &'a str,
+    /// Relative path of the requirement document
+    pub document: &'a str,
+    pub line: u32,
+    /// Written as "**SRS_TAG:" (the form srs_uniqueness counts)
+    pub is_definition: bool,
+    /// Requirement text, markdown stripped, when written as "**SRS_TAG: [** text **]**"
+    pub text: Option<&'a str>,
+    /// Hash of the text, ASCII case-insensitive (0 without text)
+    pub text_hash: u64,
+}
+
+/// A Codes_SRS_/Tests_SRS_ comment in a source file
+pub struct CodeReference<'a> {
+    pub tag: &'a str,
+    pub path: &'a str,
+    pub relative_path: &'a str,
+    /// "Codes" or "Tests"
+    pub prefix: &'static str,
+    pub text: &'a str,
+    pub original_match: &'a str,
+    pub match_index: usize,
+    pub has_duplication: bool,
+    pub is_incomplete: bool,
+    pub text_hash: u64,
+}
+
+/// Every SRS tag of the repository: tag -> requirement documents (file, line, text,
+/// text hash) and the code and test comments referencing it. Entries are in walk order.
+#[derive(Default)]
+pub struct SrsIndex {
+    strings: StringPool,
+    /// Relative paths of the requirement documents
+    documents: Vec<StrId>,
+    sources: Vec<SourceRecord>,
+    markdown: Vec<MarkdownRecord>,
+    references: Vec<ReferenceRecord>,
+    /// Tag -> first markdown record defining requirement text for it
+    requirements: HashMap<StrId, u32>,
+}
+
+impl SrsIndex {
+    pub fn document_count(&self) -> usize {
+        self.documents.len()
+    }
+
+    pub fn source_count(&self) -> usize {
+        self.sources.len()
+    }
+
+    /// Number of distinct tags with requirement text
+    pub fn requirement_count(&self) -> usize {
+        self.requirements.len()
+    }
+
+    fn markdown_entry(&self, record: &MarkdownRecord) -> MarkdownEntry<'_> {
+        MarkdownEntry {
+            tag: self.strings.get(record.tag),
+            document: self.strings.get(self.documents[record.document as usize]),
+            line: record.line,
+            is_definition: record.is_definition,
+            text: if record.text == NO_STRING {
+                None
+            } else {
+                Some(self.strings.get(record.text))
+            },
+            text_hash: record.text_hash,
+        }
+    }
+
+    pub fn markdown_entries(&self) -> impl Iterator<Item = MarkdownEntry<'_>> {
+        self.markdown.iter().map(move |record| self.markdown_entry(record))
+    }
+
+    /// The requirement text for a tag: its first occurrence with text in walk order
+    pub fn requirement(&self, tag: &str) -> Option<MarkdownEntry<'_>> {
+        let tag_id = self.strings.find(tag)?;
+        let record = *self.requirements.get(&tag_id)?;
+        Some(self.markdown_entry(&self.markdown[record as usize]))
+    }
+
+    pub fn code_references(&self) -> impl Iterator<Item = CodeReference<'_>> {
+        self.references.iter().map(move |record| {
+            let source = &self.sources[record.source as usize];
+            CodeReference {
+                tag: self.strings.get(record.tag),
+                path: self.strings.get(source.path),
+                relative_path: self.strings.get(source.relative_path),
+                prefix: if record.is_test { "Tests" } else { "Codes" },
+                text: self.strings.get(record.text),
+                original_match: self.strings.get(record.original_match),
+                match_index: record.match_index,
+                has_duplication: record.has_duplication,
+                is_incomplete: record.is_incomplete,
+                text_hash: record.text_hash,
+            }
+        })
+    }
+
+    /// Serialize the index (see "SRS index file format" in repo_validation/README.md).
+    /// The file is written next to the destination and renamed over it.
+    pub fn write_to(&self, path: &str) -> io::Result<()> {
+        // Group occurrences by tag, tags sorted by name
+        let mut by_tag: HashMap<StrId, (Vec<u32>, Vec<u32>)> = HashMap::new();
+        for (i, record) in self.markdown.iter().enumerate() {
+            by_tag.entry(record.tag).or_default().0.push(i as u32);
+        }
+        for (i, record) in self.references.iter().enumerate() {
+            by_tag.entry(record.tag).or_default().1.push(i as u32);
+        }
+        let mut tags: Vec<StrId> = by_tag.keys().copied().collect();
+        tags.sort_by(|a, b| self.strings.get(*a).cmp(self.strings.get(*b)));
+
+        let mut tag_table = Vec::with_capacity(tags.len() * TAG_RECORD_SIZE);
+        let mut markdown_table = Vec::with_capacity(self.markdown.len() * MARKDOWN_RECORD_SIZE);
+        let mut reference_table = Vec::with_capacity(self.references.len() * REFERENCE_RECORD_SIZE);
+        let mut markdown_written = 0u32;
+        let mut references_written = 0u32;
+        for tag in &tags {
+            let (markdown, references) = &by_tag[tag];
+            let requirement = match self.requirements.get(tag) {
+                Some(record) => markdown_written + markdown.iter().position(|m| m == record).unwrap() as u32,
+                None => u32::MAX,
+            };
+            put_u32(&mut tag_table, &[
+                *tag,
+                markdown_written,
+                markdown.len() as u32,
+                references_written,
+                references.len() as u32,
+                requirement,
+            ]);
+            for &m in markdown {
+                let record = &self.markdown[m as usize];
+                put_u32(&mut markdown_table, &[
+                    record.document,
+                    record.line,
+                    record.text,
+                    record.is_definition as u32,
+                ]);
+                markdown_table.extend_from_slice(&record.text_hash.to_le_bytes());
+            }
+            for &r in references {
+                let record = &self.references[r as usize];
+                let flags = record.is_test as u32
+                    | (record.has_duplication as u32) << 1
+                    | (record.is_incomplete as u32) << 2;
+                put_u32(&mut reference_table, &[record.source, record.line, record.text, flags]);
+                reference_table.extend_from_slice(&record.text_hash.to_le_bytes());
+            }
+            markdown_written += markdown.len() as u32;
+            references_written += references.len() as u32;
+        }
+
+        let mut span_table = Vec::with_capacity(self.strings.spans.len() * 8);
+        for &(start, len) in &self.strings.spans {
+            put_u32(&mut span_table, &[start, len]);
+        }
+        let mut document_table = Vec::with_capacity(self.documents.len() * 4);
+        put_u32(&mut document_table, &self.documents);
+        let mut source_table = Vec::with_capacity(self.sources.len() * 4);
+        for source in &self.sources {
+            put_u32(&mut source_table, &[source.relative_path]);
+        }
+
+        let sections: [(&[u8], usize); 7] = [
+            (&span_table, 8),
+            (self.strings.data.as_bytes(), 1),
+            (&document_table, 4),
+            (&source_table, 4),
+            (&tag_table, TAG_RECORD_SIZE),
+            (&markdown_table, MARKDOWN_RECORD_SIZE),
+            (&reference_table, REFERENCE_RECORD_SIZE),
+        ];
+
+        let mut out = Vec::new();
+        out.extend_from_slice(INDEX_MAGIC);
+        put_u32(&mut out, &[INDEX_FORMAT_VERSION, 0]);
+        let mut offset = align8(INDEX_HEADER_SIZE);
+        for (bytes, record_size) in &sections {
+            out.extend_from_slice(&(offset as u64).to_le_bytes());
+            put_u32(&mut out, &[(bytes.len() / record_size) as u32, *record_size as u32]);
+            offset = align8(offset + bytes.len());
+        }
+        for (bytes, _) in &sections {
+            out.resize(align8(out.len()), 0);
+            out.extend_from_slice(bytes);
+        }
+
+        let temp_path = format!("{}.tmp", path);
+        fs::write(&temp_path, out)?;
+        fs::rename(&temp_path, path)
+    }
+}
+
+const INDEX_MAGIC: &[u8; 8] = b"SRSINDEX";
+const INDEX_FORMAT_VERSION: u32 = 2;
+/// Magic, version, reserved word and one (offset, count, record size) triple per section
+const INDEX_HEADER_SIZE: usize = 16 + 7 * 16;
+const TAG_RECORD_SIZE: usize = 24;
+const MARKDOWN_RECORD_SIZE: usize = 24;
+const REFERENCE_RECORD_SIZE: usize = 24;
+
+fn align8(value: usize) -> usize {
+    (value + 7) & !7
+}
+
+fn put_u32(out: &mut Vec<u8>, values: &[u32]) {
+    for value in values {
+        out.extend_from_slice(&value.to_le_bytes());
+    }
+}
@@ -0,0 +1,315 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Per-check timing (--timings) and Chrome trace output (--trace-out).
+//!
+//! Every thread that runs checks owns a Profiler; the profilers of the walker and
+//! worker threads are merged back when the walk completes, like check shards. Statistics are kept per
+//! check index (the order of the active checks, followed by the SRS index builder).
+//! When neither option is given, start() returns None and nothing is recorded.
+
+use std::fs;
+use std::io::{self, Write};
+use std::time::{Duration, Instant};
+
+use crate::config::ValidatorConfig;
+
+/// Slowest files listed per check by --timings
+const SLOWEST_FILES: usize = 5;
+
+/// Thread ids used in the trace
+pub const TID_MAIN: u32 = 0;
+pub const TID_WALKER: u32 = 1;
+pub const TID_FIRST_WORKER: u32 = 2;
+
+#[derive(Default, Clone)]
+struct CheckStats {
+    name: String,
+    files: usize,
+    bytes: u64,
+    /// Time spent in check_file, summed over threads
+    file_time: Duration,
+    /// Time spent in init and finalize
+    other_time: Duration,
+    /// Slowest check_file calls, slowest first
+    slowest: Vec<(Duration, String)>,
+}
+
+impl CheckStats {
+    fn add_slow_file(&mut self, elapsed: Duration, relative_path: &str) {
+        if self.slowest.len() == SLOWEST_FILES && elapsed <= self.slowest[SLOWEST_FILES - 1].0 {
+            return;
+        }
+        let at = self.slowest.partition_point(|(d, _)| *d >= elapsed);
+        self.slowest.insert(at, (elapsed, relative_path.to_string()));
+        self.slowest.truncate(SLOWEST_FILES);
+    }
+}
+
+/// A complete ("X") trace event
+struct TraceEvent {
+    name: String,
+    category: &'static str,
+    start: Duration,
+    duration: Duration,
+    tid: u32,
+    /// Relative path of the file the event belongs to
+    file: Option<String>,
+}
+
+pub struct Profiler {
+    /// --timings or --trace-out was given
+    enabled: bool,
+    /// --trace-out was given: keep every event
+    tracing: bool,
+    /// Start of the run; trace timestamps are relative to it
+    epoch: Instant,
+    tid: u32,
+    thread_names: Vec<(u32, String)>,
+    checks: Vec<CheckStats>,
+    files_read: usize,
+    bytes_read: u64,
+    read_time: Duration,
+    prefilter_time: Duration,
+    events: Vec<TraceEvent>,
+}
+
+impl Profiler {
+    pub fn new(config: &ValidatorConfig) -> Self {
+        Self {
+            enabled: config.timings || config.trace_out.is_some(),
+            tracing: config.trace_out.is_some(),
+            epoch: Instant::now(),
+            tid: TID_MAIN,
+            thread_names: vec![(TID_MAIN, "main".to_string())],
+            checks: Vec::new(),
+            files_read: 0,
+            bytes_read: 0,
+            read_time: Duration::ZERO,
+            prefilter_time: Duration::ZERO,
+            events: Vec::new(),
+        }
+    }
+
+    /// An empty profiler with the same settings and epoch, for another thread
+    pub fn fork(&self, tid: u32, thread_name: &str) -> Self {
+        Self {
+            enabled: self.enabled,
+            tracing: self.tracing,
+            epoch: self.epoch,
+            tid,
+            thread_names: vec![(tid, thread_name.to_string())],
+            checks: Vec::new(),
+            files_read: 0,
+            bytes_read: 0,
+            read_time: Duration::ZERO,
+            prefilter_time: Duration::ZERO,
+            events: Vec::new(),
+        }
+    }
+
+    pub fn merge(&mut self, other: Profiler) {
+        for (index, theirs) in other.checks.into_iter().enumerate() {
+            let ours = self.stats(index, &theirs.name);
+            ours.files += theirs.files;
+            ours.bytes += theirs.bytes;
+            ours.file_time += theirs.file_time;
+            ours.other_time += theirs.other_time;
+            for (elapsed, path) in &theirs.slowest {
+                ours.add_slow_file(*elapsed, path);
+            }
+        }
+        self.files_read += other.files_read;
+        self.bytes_read += other.bytes_read;
+        self.read_time += other.read_time;
+        self.prefilter_time += other.prefilter_time;
+        self.thread_names.extend(other.thread_names);
+        self.events.extend(other.events);
+    }
+
+    /// Start timing something; None when profiling is off
+    pub fn start(&self) -> Option<Instant> {
+        if self.enabled {
+            Some(Instant::now())
+        } else {
+            None
+        }
+    }
+
+    fn stats(&mut self, index: usize, name: &str) -> &mut CheckStats {
+        if self.checks.len() <= index {
+            self.checks.resize(index + 1, CheckStats::default());
+        }
+        let stats = &mut self.checks[index];
+        if stats.name.is_empty() {
+            stats.name = name.to_string();
+        }
+        stats
+    }
+
+    fn trace(&mut self, started: Instant, elapsed: Duration, name: &str, category: &'static str, file: Option<&str>) {
+        if self.tracing {
+            self.events.push(TraceEvent {
+                name: name.to_string(),
+                category,
+                start: started.duration_since(self.epoch),
+                duration: elapsed,
+                tid: self.tid,
+                file: file.map(str::to_string),
+            });
+        }
+    }
+
+    /// Record a check_file call of check `index` on a file of `bytes` bytes
+    pub fn check_file(&mut self, started: Option<Instant>, index: usize, name: &str, relative_path: &str, bytes: usize) {
+        if let Some(started) = started {
+            let elapsed = started.elapsed();
+            let stats = self.stats(index, name);
+            stats.files += 1;
+            stats.bytes += bytes as u64;
+            stats.file_time += elapsed;
+            stats.add_slow_file(elapsed, relative_path);
+            self.trace(started, elapsed, name, "check", Some(relative_path));
+        }
+    }
+
+    /// Record a call to the init or finalize (`phase`) of check `index`
+    pub fn check_phase(&mut self, started: Option<Instant>, index: usize, name: &str, phase: &str) {
+        if let Some(started) = started {
+            let elapsed = started.elapsed();
+            self.stats(index, name).other_time += elapsed;
+            self.trace(started, elapsed, &format!("{} {}", name, phase), "check", None);
+        }
+    }
+
+    /// Record reading a file of `bytes` bytes
+    pub fn read(&mut self, started: Option<Instant>, relative_path: &str, bytes: usize) {
+        if let Some(started) = started {
+            let elapsed = started.elapsed();
+            self.files_read += 1;
+            self.bytes_read += bytes as u64;
+            self.read_time += elapsed;
+            self.trace(started, elapsed, "read", "io", Some(relative_path));
+        }
+    }
+
+    /// Record the needle scan of a file
+    pub fn prefilter(&mut self, started: Option<Instant>, relative_path: &str) {
+        if let Some(started) = started {
+            let elapsed = started.elapsed();
+            self.prefilter_time += elapsed;
+            self.trace(started, elapsed, "prefilter", "scan", Some(relative_path));
+        }
+    }
+
+    /// Record a span that only shows up in the trace (the walk, processing one file, ...)
+    pub fn span(&mut self, started: Option<Instant>, name: &str, file: Option<&str>) {
+        if let Some(started) = started {
+            self.trace(started, started.elapsed(), name, "walk", file);
+        }
+    }
+
+    /// Print the --timings table to `out`
+    pub fn print_table(&self, out: &mut dyn Write) -> io::Result<()> {
+        let ms = |d: Duration| d.as_secs_f64() * 1000.0;
+        let mb = |bytes: u64| bytes as f64 / (1024.0 * 1024.0);
+
+        writeln!(out)?;
+        writeln!(out, "========================================")?;
+        writeln!(out, "Timings")?;
+        writeln!(out, "========================================")?;
+        writeln!(
+            out,
+            "  {:<25} {:>8} {:>10} {:>12} {:>12} {:>12}",
+            "Check", "Files", "MB", "Files ms", "Other ms", "Total ms"
+        )?;
+        for stats in self.checks.iter().filter(|stats| !stats.name.is_empty()) {
+            writeln!(
+                out,
+                "  {:<25} {:>8} {:>10.2} {:>12.2} {:>12.2} {:>12.2}",
+                stats.name,
+                stats.files,
+                mb(stats.bytes),
+                ms(stats.file_time),
+                ms(stats.other_time),
+                ms(stats.file_time + stats.other_time)
+            )?;
+        }
+        writeln!(
+            out,
+            "  {:<25} {:>8} {:>10.2} {:>12.2}",
+            "(read)",
+            self.files_read,
+            mb(self.bytes_read),
+            ms(self.read_time)
+        )?;
+        writeln!(out, "  {:<25} {:>8} {:>10} {:>12.2}", "(prefilter)", "", "", ms(self.prefilter_time))?;
+        writeln!(out, "  Files ms is check_file time summed over all worker threads; Other ms is init and finalize.")?;
+
+        writeln!(out)?;
+        writeln!(out, "  Slowest files per check:")?;
+        for stats in self.checks.iter().filter(|stats| !stats.slowest.is_empty()) {
+            writeln!(out, "    {}", stats.name)?;
+            for (elapsed, path) in &stats.slowest {
+                writeln!(out, "      {:>10.3} ms  {}", ms(*elapsed), path)?;
+            }
+        }
+        Ok(())
+    }
+
+    /// Write the recorded events in the Chrome trace-event format
+    pub fn write_trace(&self, path: &str) -> io::Result<()> {
+        let mut out = String::with_capacity(128 + self.events.len() * 128);
+        out.push_str("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        let mut first = true;
+        let mut separator = |out: &mut String| {
+            if !first {
+                out.push_str(",\n");
+            }
+            first = false;
+        };
+
+        let mut thread_names = self.thread_names.clone();
+        thread_names.sort();
+        for (tid, name) in &thread_names {
+            separator(&mut out);
+            out.push_str(&format!(
+                "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":{}}}}}",
+                tid,
+                json_string(name)
+            ));
+        }
+        for event in &self.events {
+            separator(&mut out);
+            out.push_str(&format!(
+                "{{\"name\":{},\"cat\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3},\"dur\":{:.3}",
+                json_string(&event.name),
+                event.category,
+                event.tid,
+                event.start.as_secs_f64() * 1e6,
+                event.duration.as_secs_f64() * 1e6
+            ));
+            if let Some(file) = &event.file {
+                out.push_str(&format!(",\"args\":{{\"file\":{}}}", json_string(file)));
+            }
+            out.push('}');
+        }
+        out.push_str("\n]}\n");
+        fs::write(path, out)
+    }
+}
+
+fn json_string(text: &str) -> String {
+    let mut out = String::with_capacity(text.len() + 2);
+    out.push('"');
+    for c in text.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => out.push_str(&format!("\\u{:04x}", c as u32)),
+            c => out.push(c),
+        }
+    }
+    out.push('"');
+    out
+}
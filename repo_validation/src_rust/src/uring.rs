@@ -0,0 +1,412 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Batched file reads through io_uring (Linux only).
+//!
+//! With a cold page cache, reading one file at a time leaves the disk idle
+//! between requests. BatchReader keeps up to POOL_BUFFERS reads in flight: the
+//! caller opens files one after the other and each read goes into a buffer of a
+//! fixed pool, registered with the kernel when the locked-memory limit allows it.
+//! A completed buffer is copied into the file's content and returns to the pool.
+//! The rest of the file, if any, comes with blocking reads up to one that returns
+//! 0: a read shorter than the buffer does not prove end of file on every file
+//! system (NFS, FUSE, overlays). Past a length limit the caller reads a file its
+//! own way.
+//!
+//! Kernels without io_uring, and sandboxes that forbid it, fail BatchReader::new;
+//! callers then read with fs::read. When io_uring_enter fails later on (ENOMEM,
+//! a seccomp filter), the reader redoes the reads in flight and every later one
+//! with blocking reads.
+
+use std::fs::File;
+use std::io::{self, Read, Seek, SeekFrom};
+use std::os::raw::{c_int, c_long, c_void};
+use std::os::unix::io::AsRawFd;
+use std::ptr;
+use std::sync::atomic::{AtomicU32, Ordering};
+
+const SYS_IO_URING_SETUP: c_long = 425;
+const SYS_IO_URING_ENTER: c_long = 426;
+const SYS_IO_URING_REGISTER: c_long = 427;
+
+const IORING_OFF_SQ_RING: c_long = 0;
+const IORING_OFF_CQ_RING: c_long = 0x800_0000;
+const IORING_OFF_SQES: c_long = 0x1000_0000;
+const IORING_ENTER_GETEVENTS: u32 = 1;
+const IORING_REGISTER_BUFFERS: u32 = 0;
+const IORING_OP_READV: u8 = 1;
+const IORING_OP_READ_FIXED: u8 = 4;
+
+const PROT_READ: c_int = 0x1;
+const PROT_WRITE: c_int = 0x2;
+const MAP_SHARED: c_int = 0x01;
+const MAP_POPULATE: c_int = 0x08000;
+
+const EINTR: i32 = 4;
+const EAGAIN: i32 = 11;
+const EBUSY: i32 = 16;
+
+/// Reads in flight at most, one per buffer
+pub const POOL_BUFFERS: usize = 64;
+/// Size of a pool buffer; most sources fit in one
+const BUFFER_SIZE: usize = 128 * 1024;
+/// Reads queued before they are handed to the kernel together
+const SUBMIT_BATCH: u32 = 8;
+
+#[repr(C)]
+#[derive(Default)]
+struct SqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct CqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// struct io_uring_params
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqRingOffsets,
+    cq_off: CqRingOffsets,
+}
+
+/// struct io_uring_sqe, with the fields a read uses
+#[repr(C)]
+struct Sqe {
+    opcode: u8,
+    flags: u8,
+    ioprio: u16,
+    fd: i32,
+    off: u64,
+    addr: u64,
+    len: u32,
+    rw_flags: u32,
+    user_data: u64,
+    buf_index: u16,
+    personality: u16,
+    splice_fd_in: i32,
+    addr3: u64,
+    pad: u64,
+}
+
+#[repr(C)]
+struct Cqe {
+    user_data: u64,
+    res: i32,
+    flags: u32,
+}
+
+#[repr(C)]
+struct IoVec {
+    base: *mut u8,
+    len: usize,
+}
+
+extern "C" {
+    fn syscall(number: c_long, ...) -> c_long;
+    fn mmap(addr: *mut c_void, len: usize, prot: c_int, flags: c_int, fd: c_int, offset: c_long) -> *mut c_void;
+    fn munmap(addr: *mut c_void, len: usize) -> c_int;
+    fn close(fd: c_int) -> c_int;
+}
+
+/// One of the ring's shared memory areas
+struct Mapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(fd: c_int, len: usize, offset: c_long) -> io::Result<Self> {
+        let ptr = unsafe { mmap(ptr::null_mut(), len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset) };
+        if ptr as isize == -1 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Self { ptr: ptr as *mut u8, len })
+    }
+
+    fn at<T>(&self, offset: u32) -> *mut T {
+        unsafe { self.ptr.add(offset as usize) as *mut T }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        unsafe { munmap(self.ptr as *mut c_void, self.len) };
+    }
+}
+
+/// Reads of many files in flight at once. `T` travels with each read and comes
+/// back with its content.
+pub struct BatchReader<T> {
+    ring_fd: c_int,
+    sq_ring: Mapping,
+    cq_ring: Mapping,
+    sqes: Mapping,
+    sq_off: SqRingOffsets,
+    cq_off: CqRingOffsets,
+    /// POOL_BUFFERS buffers of BUFFER_SIZE bytes, never reallocated
+    pool: Vec<u8>,
+    iovecs: Vec<IoVec>,
+    /// Buffers are registered: reads use READ_FIXED instead of READV
+    registered: bool,
+    free: Vec<usize>,
+    /// The file being read into each buffer, and its key
+    in_flight: Vec<Option<(File, T)>>,
+    /// Reads written to the submission ring but not yet handed to the kernel
+    queued: u32,
+    /// Files longer than this fail with ErrorKind::FileTooLarge instead of being read to the end
+    max_len: Option<u64>,
+    /// io_uring_enter failed: reads are blocking reads from then on
+    broken: bool,
+}
+
+impl<T> BatchReader<T> {
+    /// A reader of files of at most `max_len` bytes, if given, beyond the first buffer
+    pub fn new(max_len: Option<u64>) -> io::Result<Self> {
+        let mut params = Params::default();
+        let fd = unsafe { syscall(SYS_IO_URING_SETUP, POOL_BUFFERS as u32, &mut params as *mut Params) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        let ring_fd = fd as c_int;
+        let mapped = (|| {
+            let sq_len = params.sq_off.array as usize + params.sq_entries as usize * 4;
+            let cq_len = params.cq_off.cqes as usize + params.cq_entries as usize * std::mem::size_of::<Cqe>();
+            let sqes_len = params.sq_entries as usize * std::mem::size_of::<Sqe>();
+            Ok::<_, io::Error>((
+                Mapping::new(ring_fd, sq_len, IORING_OFF_SQ_RING)?,
+                Mapping::new(ring_fd, cq_len, IORING_OFF_CQ_RING)?,
+                Mapping::new(ring_fd, sqes_len, IORING_OFF_SQES)?,
+            ))
+        })();
+        let (sq_ring, cq_ring, sqes) = match mapped {
+            Ok(mapped) => mapped,
+            Err(e) => {
+                unsafe { close(ring_fd) };
+                return Err(e);
+            }
+        };
+
+        let mut pool = vec![0u8; POOL_BUFFERS * BUFFER_SIZE];
+        let iovecs: Vec<IoVec> = pool
+            .chunks_exact_mut(BUFFER_SIZE)
+            .map(|buffer| IoVec {
+                base: buffer.as_mut_ptr(),
+                len: BUFFER_SIZE,
+            })
+            .collect();
+        // Registration pins the pool; it fails under a low RLIMIT_MEMLOCK on older kernels
+        let registered = unsafe {
+            syscall(SYS_IO_URING_REGISTER, ring_fd, IORING_REGISTER_BUFFERS, iovecs.as_ptr(), iovecs.len() as u32)
+        } == 0;
+
+        Ok(Self {
+            ring_fd,
+            sq_ring,
+            cq_ring,
+            sqes,
+            sq_off: params.sq_off,
+            cq_off: params.cq_off,
+            pool,
+            iovecs,
+            registered,
+            free: (0..POOL_BUFFERS).rev().collect(),
+            in_flight: (0..POOL_BUFFERS).map(|_| None).collect(),
+            queued: 0,
+            max_len,
+            broken: false,
+        })
+    }
+
+    /// Start reading the file at `path`. Blocks while every buffer is in flight.
+    /// Reads that completed in the meantime are appended to `done` with their key.
+    pub fn submit(&mut self, path: &str, key: T, done: &mut Vec<(T, io::Result<Vec<u8>>)>) {
+        let file = match File::open(path) {
+            Ok(file) => file,
+            Err(e) => {
+                done.push((key, Err(e)));
+                return;
+            }
+        };
+        while !self.broken && self.free.is_empty() {
+            self.enter(1, done);
+            self.reap(done);
+        }
+        if self.broken {
+            let content = self.read_rest(file, Vec::new());
+            done.push((key, content));
+            return;
+        }
+        let buffer = self.free.pop().expect("a buffer was freed above");
+
+        // Submission entries are indexed like the buffers: one entry per read in flight
+        let sqe = Sqe {
+            opcode: if self.registered { IORING_OP_READ_FIXED } else { IORING_OP_READV },
+            flags: 0,
+            ioprio: 0,
+            fd: file.as_raw_fd(),
+            off: 0,
+            addr: if self.registered {
+                self.iovecs[buffer].base as u64
+            } else {
+                &self.iovecs[buffer] as *const IoVec as u64
+            },
+            len: if self.registered { BUFFER_SIZE as u32 } else { 1 },
+            rw_flags: 0,
+            user_data: buffer as u64,
+            buf_index: buffer as u16,
+            personality: 0,
+            splice_fd_in: 0,
+            addr3: 0,
+            pad: 0,
+        };
+        unsafe {
+            ptr::write(self.sqes.at::<Sqe>(0).add(buffer), sqe);
+            let mask = *self.sq_ring.at::<u32>(self.sq_off.ring_mask);
+            let tail = &*self.sq_ring.at::<AtomicU32>(self.sq_off.tail);
+            let position = tail.load(Ordering::Relaxed);
+            *self.sq_ring.at::<u32>(self.sq_off.array).add((position & mask) as usize) = buffer as u32;
+            tail.store(position.wrapping_add(1), Ordering::Release);
+        }
+        self.in_flight[buffer] = Some((file, key));
+        self.queued += 1;
+
+        if self.queued >= SUBMIT_BATCH {
+            self.enter(0, done);
+        }
+        self.reap(done);
+    }
+
+    /// Wait for every read in flight, appending them to `done`
+    pub fn finish(&mut self, done: &mut Vec<(T, io::Result<Vec<u8>>)>) {
+        while !self.broken && self.free.len() < POOL_BUFFERS {
+            self.enter(1, done);
+            self.reap(done);
+        }
+    }
+
+    /// Hand the queued reads to the kernel and wait for `min_complete` completions.
+    /// If the kernel refuses, the reads in flight are redone with blocking reads
+    /// and appended to `done`.
+    fn enter(&mut self, min_complete: u32, done: &mut Vec<(T, io::Result<Vec<u8>>)>) {
+        let flags = if min_complete > 0 { IORING_ENTER_GETEVENTS } else { 0 };
+        loop {
+            let submitted = unsafe {
+                syscall(SYS_IO_URING_ENTER, self.ring_fd, self.queued, min_complete, flags, ptr::null::<c_void>(), 0usize)
+            };
+            if submitted >= 0 {
+                self.queued -= submitted as u32;
+                return;
+            }
+            let error = io::Error::last_os_error();
+            match error.raw_os_error() {
+                Some(EINTR) => continue,
+                // The completion ring is full or the kernel is short of memory:
+                // completions will come out on the next reap
+                Some(EAGAIN) | Some(EBUSY) => return,
+                _ => {
+                    self.broken = true;
+                    // Their buffers stay out of the pool: the kernel may still
+                    // complete some of them (see Drop)
+                    for slot in &mut self.in_flight {
+                        if let Some((file, key)) = slot.take() {
+                            done.push((key, Self::read_rest_of(self.max_len, file, Vec::new())));
+                        }
+                    }
+                    return;
+                }
+            }
+        }
+    }
+
+    /// Collect the completed reads
+    fn reap(&mut self, done: &mut Vec<(T, io::Result<Vec<u8>>)>) {
+        if self.broken {
+            return;
+        }
+        let mask = unsafe { *self.cq_ring.at::<u32>(self.cq_off.ring_mask) };
+        let head = unsafe { &*self.cq_ring.at::<AtomicU32>(self.cq_off.head) };
+        let tail = unsafe { &*self.cq_ring.at::<AtomicU32>(self.cq_off.tail) };
+        let mut position = head.load(Ordering::Relaxed);
+        while position != tail.load(Ordering::Acquire) {
+            let cqe = unsafe { ptr::read(self.cq_ring.at::<Cqe>(self.cq_off.cqes).add((position & mask) as usize)) };
+            position = position.wrapping_add(1);
+            head.store(position, Ordering::Release);
+
+            let buffer = cqe.user_data as usize;
+            let (file, key) = self.in_flight[buffer].take().expect("completion of a read in flight");
+            let content = match cqe.res {
+                res if res < 0 => Err(io::Error::from_raw_os_error(-res)),
+                // A read that returns 0 is at end of file
+                0 => Ok(Vec::new()),
+                res => {
+                    let start = buffer * BUFFER_SIZE;
+                    Self::read_rest_of(self.max_len, file, self.pool[start..start + res as usize].to_vec())
+                }
+            };
+            self.free.push(buffer);
+            done.push((key, content));
+        }
+    }
+}
+
+impl<T> BatchReader<T> {
+    /// `content` (the start of `file`) followed by the rest of the file, or
+    /// ErrorKind::FileTooLarge when the file is longer than `max_len`
+    fn read_rest_of(max_len: Option<u64>, mut file: File, mut content: Vec<u8>) -> io::Result<Vec<u8>> {
+        if let Some(max_len) = max_len {
+            if file.metadata()?.len() > max_len {
+                return Err(io::ErrorKind::FileTooLarge.into());
+            }
+        }
+        file.seek(SeekFrom::Start(content.len() as u64))?;
+        file.read_to_end(&mut content)?;
+        Ok(content)
+    }
+
+    fn read_rest(&self, file: File, content: Vec<u8>) -> io::Result<Vec<u8>> {
+        Self::read_rest_of(self.max_len, file, content)
+    }
+}
+
+impl<T> Drop for BatchReader<T> {
+    fn drop(&mut self) {
+        // The kernel may still write into the pool: wait for the reads in flight
+        // before it is freed, or leak it when unwinding or when the ring failed
+        if self.free.len() < POOL_BUFFERS {
+            if std::thread::panicking() || self.broken {
+                std::mem::forget(std::mem::take(&mut self.pool));
+            } else {
+                self.finish(&mut Vec::new());
+            }
+        }
+        unsafe { close(self.ring_fd) };
+    }
+}
@@ -0,0 +1,520 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Watch mode (--watch, Linux only).
+//!
+//! The validator stays running and keeps the per-file results of its last run in
+//! memory: the records --cache stores on disk, from which the walker also rebuilds
+//! the SRS index. inotify reports changes below the repository root; once the tree
+//! has been quiet for a moment the checks run again, as an incremental run over the
+//! files inotify listed: only those are re-checked, while cross-file checks replay
+//! the results of the others and still see the whole repository. After dropped
+//! events, or when a directory came or went, every file is checked (files whose
+//! size, mtime or content did not change still replay their results). Each run
+//! prints the findings that appeared or went away since the previous one,
+//! comparing the findings the checks returned rather than the printed report.
+//!
+//! The findings of the latest results are served on a Unix socket, so editors and git hooks
+//! can ask for it without starting a validator: a client sends one line, "status"
+//! or "report" (the default), and reads the reply until the server closes it.
+
+use std::collections::{BTreeMap, BTreeSet, HashMap};
+use std::ffi::CString;
+use std::fs::{self, File};
+use std::io::{self, BufRead, BufReader, Read, Write};
+use std::os::raw::{c_char, c_int, c_ulong};
+use std::os::unix::io::{AsRawFd, FromRawFd};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use crate::api::{CheckSummary, Finding, Severity};
+use crate::cache::ResultCache;
+use crate::checks::Check;
+use crate::config::ValidatorConfig;
+use crate::exclusions::{DirScope, WalkFilter};
+use crate::file_walker::classify_file_type;
+
+const IN_CLOEXEC: c_int = 0o2000000;
+const IN_MODIFY: u32 = 0x0000_0002;
+const IN_ATTRIB: u32 = 0x0000_0004;
+const IN_CLOSE_WRITE: u32 = 0x0000_0008;
+const IN_MOVED_FROM: u32 = 0x0000_0040;
+const IN_MOVED_TO: u32 = 0x0000_0080;
+const IN_CREATE: u32 = 0x0000_0100;
+const IN_DELETE: u32 = 0x0000_0200;
+const IN_Q_OVERFLOW: u32 = 0x0000_4000;
+const IN_IGNORED: u32 = 0x0000_8000;
+const IN_ONLYDIR: u32 = 0x0100_0000;
+const IN_ISDIR: u32 = 0x4000_0000;
+
+const WATCH_MASK: u32 = IN_MODIFY
+    | IN_ATTRIB
+    | IN_CLOSE_WRITE
+    | IN_MOVED_FROM
+    | IN_MOVED_TO
+    | IN_CREATE
+    | IN_DELETE
+    | IN_ONLYDIR;
+
+/// Size of the fixed part of struct inotify_event (wd, mask, cookie, len)
+const EVENT_HEADER_LEN: usize = 16;
+
+const POLLIN: i16 = 0x1;
+const EINTR: i32 = 4;
+
+/// How long the tree must stay quiet before a run starts, so that a save touching
+/// several files (or a checkout) is validated once
+const QUIET_MS: c_int = 100;
+
+/// Changed paths listed in the header of a run
+const MAX_LISTED_CHANGES: usize = 5;
+
+#[repr(C)]
+struct PollFd {
+    fd: c_int,
+    events: i16,
+    revents: i16,
+}
+
+extern "C" {
+    fn inotify_init1(flags: c_int) -> c_int;
+    fn inotify_add_watch(fd: c_int, pathname: *const c_char, mask: u32) -> c_int;
+    fn poll(fds: *mut PollFd, nfds: c_ulong, timeout: c_int) -> c_int;
+}
+
+/// Paths reported by inotify since the last run
+#[derive(Default)]
+struct Changes {
+    /// Relative paths of changed files and directories
+    paths: BTreeSet<String>,
+    /// The kernel dropped events
+    overflow: bool,
+    /// A directory was created, moved or deleted: the files in it are not listed
+    directories: bool,
+}
+
+impl Changes {
+    fn is_empty(&self) -> bool {
+        self.paths.is_empty() && !self.overflow
+    }
+}
+
+/// Recursive inotify watch over the directories the walker visits
+struct Watcher {
+    file: File,
+    /// Watch descriptor -> relative path of the directory ("" for the root)
+    dirs: HashMap<i32, String>,
+}
+
+impl Watcher {
+    fn new() -> io::Result<Self> {
+        let fd = unsafe { inotify_init1(IN_CLOEXEC) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Self {
+            file: unsafe { File::from_raw_fd(fd) },
+            dirs: HashMap::new(),
+        })
+    }
+
+    /// Watch `relative_dir` and every directory below it that the walker would
+    /// enter. Returns the number of directories added.
+    fn watch_tree(&mut self, config: &ValidatorConfig, relative_dir: &str) -> usize {
+        let filter = WalkFilter::new(&config.exclusions, &config.repo_root);
+        match filter.descend_to(&config.repo_root, relative_dir) {
+            Some(scope) => self.watch_dir(config, &filter, &scope, relative_dir),
+            None => 0,
+        }
+    }
+
+    fn watch_dir(&mut self, config: &ValidatorConfig, filter: &WalkFilter, scope: &DirScope, relative_dir: &str) -> usize {
+        let full_path = if relative_dir.is_empty() {
+            config.repo_root.clone()
+        } else {
+            format!("{}/{}", config.repo_root, relative_dir)
+        };
+        let c_path = match CString::new(full_path.as_str()) {
+            Ok(p) => p,
+            Err(_) => return 0,
+        };
+        let wd = unsafe { inotify_add_watch(self.file.as_raw_fd(), c_path.as_ptr(), WATCH_MASK) };
+        if wd < 0 {
+            // Typically the directory vanished again, or fs.inotify.max_user_watches was reached
+            eprintln!("  [WARN] Could not watch {}: {}", full_path, io::Error::last_os_error());
+            return 0;
+        }
+        self.dirs.insert(wd, relative_dir.to_string());
+
+        let mut added = 1;
+        let entries = match fs::read_dir(&full_path) {
+            Ok(e) => e,
+            Err(_) => return added,
+        };
+        for entry in entries.flatten() {
+            let is_dir = entry.file_type().map(|t| t.is_dir()).unwrap_or(false);
+            if !is_dir {
+                continue;
+            }
+            let name = entry.file_name().to_string_lossy().to_string();
+            let relative = join(relative_dir, &name);
+            if let Some(child) = filter.enter_dir(scope, &name, &relative, &entry.path()) {
+                added += self.watch_dir(config, filter, &child, &relative);
+            }
+        }
+        added
+    }
+
+    /// Wait up to `timeout_ms` (-1: forever) for events; true when some are ready
+    fn poll(&self, timeout_ms: c_int) -> io::Result<bool> {
+        let mut fds = PollFd {
+            fd: self.file.as_raw_fd(),
+            events: POLLIN,
+            revents: 0,
+        };
+        loop {
+            let ready = unsafe { poll(&mut fds, 1, timeout_ms) };
+            if ready >= 0 {
+                return Ok(ready > 0);
+            }
+            let err = io::Error::last_os_error();
+            if err.raw_os_error() != Some(EINTR) {
+                return Err(err);
+            }
+        }
+    }
+
+    /// Block until a relevant change happens, then collect changes until the tree
+    /// has been quiet for QUIET_MS
+    fn wait_for_changes(&mut self, config: &ValidatorConfig) -> io::Result<Changes> {
+        let mut changes = Changes::default();
+        while changes.is_empty() {
+            self.poll(-1)?;
+            self.read_events(config, &mut changes)?;
+        }
+        while self.poll(QUIET_MS)? {
+            self.read_events(config, &mut changes)?;
+        }
+        Ok(changes)
+    }
+
+    fn read_events(&mut self, config: &ValidatorConfig, changes: &mut Changes) -> io::Result<()> {
+        let mut buffer = vec![0u8; 64 * 1024];
+        let len = self.file.read(&mut buffer)?;
+
+        let mut offset = 0;
+        while offset + EVENT_HEADER_LEN <= len {
+            let field = |at: usize| {
+                let bytes: [u8; 4] = buffer[offset + at..offset + at + 4].try_into().unwrap();
+                u32::from_ne_bytes(bytes)
+            };
+            let wd = field(0) as i32;
+            let mask = field(4);
+            let name_len = field(12) as usize;
+            let name_bytes = &buffer[offset + EVENT_HEADER_LEN..(offset + EVENT_HEADER_LEN + name_len).min(len)];
+            let name = String::from_utf8_lossy(name_bytes).trim_end_matches('\0').to_string();
+            offset += EVENT_HEADER_LEN + name_len;
+
+            if mask & IN_Q_OVERFLOW != 0 {
+                changes.overflow = true;
+                continue;
+            }
+            if mask & IN_IGNORED != 0 {
+                self.dirs.remove(&wd);
+                continue;
+            }
+            let dir = match self.dirs.get(&wd) {
+                Some(dir) => dir.clone(),
+                None => continue,
+            };
+            if name.is_empty() {
+                continue;
+            }
+            let relative = join(&dir, &name);
+
+            if mask & IN_ISDIR != 0 {
+                if name.starts_with('.') || config.exclusions.is_excluded(&relative) {
+                    continue;
+                }
+                // A directory created or moved into the tree brings its own subtree
+                // (nothing when it is ignored)
+                if mask & (IN_CREATE | IN_MOVED_TO) != 0 {
+                    self.watch_tree(config, &relative);
+                }
+                if mask & (IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) != 0 {
+                    changes.paths.insert(relative);
+                    changes.directories = true;
+                }
+            } else if is_relevant_file(&name) {
+                changes.paths.insert(relative);
+            }
+        }
+        Ok(())
+    }
+}
+
+fn join(dir: &str, name: &str) -> String {
+    if dir.is_empty() {
+        name.to_string()
+    } else {
+        format!("{}/{}", dir, name)
+    }
+}
+
+/// Files the checks read: the walker's file types, plus the .gitmodules that
+/// c_build_tools_ref reads on its own
+fn is_relevant_file(name: &str) -> bool {
+    name == ".gitmodules" || (!name.starts_with('.') && classify_file_type(name) != 0)
+}
+
+/// Findings and verdicts of the latest run
+struct Results {
+    violations: i32,
+    /// Findings of each file that has any, as of the run that last checked it
+    files: BTreeMap<String, Vec<Finding>>,
+    /// Findings of the checks' init() and finalize(), in check order
+    check_findings: Vec<Finding>,
+    checks: Vec<CheckSummary>,
+}
+
+impl Results {
+    fn findings(&self) -> Vec<&Finding> {
+        self.files.values().flatten().chain(&self.check_findings).collect()
+    }
+
+    /// The report served on the socket: the findings of every file, then the
+    /// findings and verdict of each check
+    fn report(&self) -> String {
+        let mut report = String::new();
+        for finding in self.files.values().flatten() {
+            report.push_str(&format!("  {}\n", finding));
+        }
+        report.push_str("\n========================================\n");
+        report.push_str("Validation Summary\n");
+        report.push_str("========================================\n");
+        for check in &self.checks {
+            for finding in self.check_findings.iter().filter(|finding| finding.check == check.name) {
+                report.push_str(&format!("  {}\n", finding));
+            }
+            let status = if check.violations == 0 { "PASSED" } else { "FAILED" };
+            report.push_str(&format!("  {:<25} [{}]\n", check.name, status));
+        }
+        report.push_str(if self.violations > 0 {
+            "\n[VALIDATION FAILED]\n"
+        } else {
+            "\n[VALIDATION PASSED]\n"
+        });
+        report
+    }
+}
+
+/// Run the checks, writing the report to `out`. With `previous`, only the files
+/// in config.changed_paths are checked again (cross-file checks still see every
+/// file) and the other files keep the findings they had.
+fn run_checks(
+    config: &ValidatorConfig,
+    checks: &mut Vec<Box<dyn Check>>,
+    cache: Option<ResultCache>,
+    previous: Option<&Results>,
+    out: &mut dyn Write,
+) -> io::Result<(Results, Option<ResultCache>)> {
+    let mut files = BTreeMap::new();
+    if let (Some(previous), Some(changed)) = (previous, &config.changed_paths) {
+        files = previous.files.clone();
+        files.retain(|path, _| !changed.contains(path));
+    }
+
+    // An incremental run only counts the violations of the files it checked.
+    // Without --fix every violation a check finds in a file is one error finding,
+    // so the files carried over add their errors to the checks that skipped them.
+    let per_file: Vec<String> = checks
+        .iter()
+        .filter(|check| !check.cross_file())
+        .map(|check| check.name().to_string())
+        .collect();
+    let mut carried: HashMap<String, i32> = HashMap::new();
+    for finding in files.values().flatten() {
+        if finding.severity == Severity::Error && per_file.contains(&finding.check) {
+            *carried.entry(finding.check.clone()).or_insert(0) += 1;
+        }
+    }
+
+    let outcome = crate::validate_into(config, checks, cache, out, &mut |task, findings| {
+        if task.changed && !findings.is_empty() {
+            files.insert(task.relative_path.clone(), findings);
+        }
+    })?;
+    let mut results = Results {
+        violations: outcome.violations,
+        files,
+        check_findings: outcome.check_findings,
+        checks: outcome.checks,
+    };
+    for check in &mut results.checks {
+        let errors = carried.get(&check.name).copied().unwrap_or(0);
+        check.violations += errors;
+        results.violations += errors;
+    }
+    Ok((results, outcome.cache))
+}
+
+/// Entries of `a` not in `b`, counting duplicates, in the order of `a`
+fn missing_from<'a>(a: &[&'a Finding], b: &[&Finding]) -> Vec<&'a Finding> {
+    let mut remaining: HashMap<&Finding, usize> = HashMap::new();
+    for entry in b {
+        *remaining.entry(entry).or_insert(0) += 1;
+    }
+    a.iter()
+        .copied()
+        .filter(|entry| match remaining.get_mut(entry) {
+            Some(count) if *count > 0 => {
+                *count -= 1;
+                false
+            }
+            _ => true,
+        })
+        .collect()
+}
+
+fn print_delta(previous: &Results, current: &Results) {
+    let (before, after) = (previous.findings(), current.findings());
+    let (removed, added) = (missing_from(&before, &after), missing_from(&after, &before));
+    for (sign, entries) in [('-', &removed), ('+', &added)] {
+        for entry in entries {
+            for line in entry.to_string().lines() {
+                println!("{}   {}", sign, line);
+            }
+        }
+    }
+
+    for check in &current.checks {
+        let old = previous.checks.iter().find(|old| old.name == check.name);
+        match old {
+            Some(old) if (old.violations == 0) != (check.violations == 0) => {
+                let status = |summary: &CheckSummary| if summary.violations == 0 { "PASSED" } else { "FAILED" };
+                println!("  {:<25} [{}] -> [{}]", check.name, status(old), status(check));
+            }
+            _ => {}
+        }
+    }
+    if removed.is_empty() && added.is_empty() {
+        println!("  (no change in findings)");
+    }
+}
+
+/// Latest results, shared with the socket server
+struct Latest {
+    generation: u64,
+    violations: i32,
+    report: String,
+}
+
+fn bind_socket(path: &str) -> io::Result<UnixListener> {
+    if fs::symlink_metadata(path).is_ok() {
+        if UnixStream::connect(path).is_ok() {
+            return Err(io::Error::new(
+                io::ErrorKind::AddrInUse,
+                format!("{} is in use by another watcher", path),
+            ));
+        }
+        // Left behind by a watcher that was killed
+        fs::remove_file(path)?;
+    }
+    UnixListener::bind(path)
+}
+
+fn serve(listener: UnixListener, latest: Arc<Mutex<Latest>>) {
+    for stream in listener.incoming() {
+        if let Ok(mut stream) = stream {
+            // A client that went away is not an error worth reporting
+            let _ = answer(&mut stream, &latest);
+        }
+    }
+}
+
+fn answer(stream: &mut UnixStream, latest: &Mutex<Latest>) -> io::Result<()> {
+    // A client that sends nothing gets the report once the timeout expires
+    stream.set_read_timeout(Some(Duration::from_millis(500)))?;
+    let mut request = String::new();
+    let _ = BufReader::new(&*stream).read_line(&mut request);
+
+    let reply = {
+        let latest = latest.lock().unwrap();
+        match request.trim() {
+            "status" => format!(
+                "{} violations={} generation={}\n",
+                if latest.violations > 0 { "FAILED" } else { "PASSED" },
+                latest.violations,
+                latest.generation
+            ),
+            "" | "report" => latest.report.clone(),
+            other => format!("unknown request '{}' (expected status or report)\n", other),
+        }
+    };
+    stream.write_all(reply.as_bytes())
+}
+
+/// Validate the repository, then keep re-validating it as files change. Only
+/// returns on error.
+pub fn run(mut config: ValidatorConfig, checks: &mut Vec<Box<dyn Check>>, socket_path: &str) -> io::Result<()> {
+    let mut watcher = Watcher::new()?;
+    let watched = watcher.watch_tree(&config, "");
+    let listener = bind_socket(socket_path)?;
+
+    let cache = match &config.cache_path {
+        Some(path) => ResultCache::load(path, &config.repo_root),
+        None => ResultCache::empty(),
+    };
+    let (mut results, mut cache) = run_checks(&config, checks, Some(cache), None, &mut io::stdout())?;
+    println!();
+    println!("Watching {} directories; results are served on {}", watched, socket_path);
+
+    let latest = Arc::new(Mutex::new(Latest {
+        generation: 1,
+        violations: results.violations,
+        report: results.report(),
+    }));
+    let server_latest = Arc::clone(&latest);
+    std::thread::spawn(move || serve(listener, server_latest));
+
+    loop {
+        let changes = watcher.wait_for_changes(&config)?;
+        let started = Instant::now();
+        // Only the files inotify listed are checked again, unless it dropped events
+        // or a directory came or went with files it did not list
+        config.changed_paths = if changes.overflow || changes.directories {
+            None
+        } else {
+            Some(changes.paths.iter().cloned().collect())
+        };
+        let (next, next_cache) = run_checks(&config, checks, cache, Some(&results), &mut io::sink())?;
+        cache = next_cache;
+
+        println!();
+        let mut listed: Vec<&str> = changes.paths.iter().map(|p| p.as_str()).take(MAX_LISTED_CHANGES).collect();
+        let unlisted = changes.paths.len() - listed.len();
+        let more = format!("and {} more", unlisted);
+        if unlisted > 0 {
+            listed.push(&more);
+        }
+        if changes.overflow {
+            listed.push("(event queue overflowed)");
+        }
+        println!("Changed: {}", listed.join(", "));
+
+        print_delta(&results, &next);
+        println!(
+            "{} violation(s) (was {}), validated in {} ms",
+            next.violations,
+            results.violations,
+            started.elapsed().as_millis()
+        );
+        results = next;
+
+        let mut latest = latest.lock().unwrap();
+        latest.generation += 1;
+        latest.violations = results.violations;
+        latest.report = results.report();
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Work-stealing queue used to hand files from the walker to the check workers.
+//!
+//! Every worker owns a deque. The producer spreads items round-robin across the
+//! deques; a worker pops from the front of its own deque and, when that is empty,
+//! steals from the back of the others. A shared counter of queued items lets idle
+//! workers sleep instead of spinning while the walker is still enumerating.
+
+use std::collections::VecDeque;
+use std::sync::{Condvar, Mutex};
+
+struct Signal {
+    /// Items pushed but not yet claimed by a worker
+    pending: usize,
+    /// Set once the producer has pushed its last item
+    closed: bool,
+}
+
+pub struct WorkQueue<T> {
+    deques: Vec<Mutex<VecDeque<T>>>,
+    signal: Mutex<Signal>,
+    available: Condvar,
+    /// Signalled when a worker claims an item
+    claimed: Condvar,
+}
+
+impl<T> WorkQueue<T> {
+    pub fn new(workers: usize) -> Self {
+        let workers = workers.max(1);
+        Self {
+            deques: (0..workers).map(|_| Mutex::new(VecDeque::new())).collect(),
+            signal: Mutex::new(Signal {
+                pending: 0,
+                closed: false,
+            }),
+            available: Condvar::new(),
+            claimed: Condvar::new(),
+        }
+    }
+
+    /// Queue an item on the deque of the given worker (taken modulo the worker count)
+    pub fn push(&self, worker: usize, item: T) {
+        let index = worker % self.deques.len();
+        self.deques[index].lock().unwrap().push_back(item);
+
+        let mut signal = self.signal.lock().unwrap();
+        signal.pending += 1;
+        drop(signal);
+        self.available.notify_one();
+    }
+
+    /// Block the producer until fewer than `limit` pushed items wait for a worker,
+    /// so that items carrying file contents do not pile up ahead of the checks
+    pub fn wait_below(&self, limit: usize) {
+        let mut signal = self.signal.lock().unwrap();
+        while signal.pending >= limit {
+            signal = self.claimed.wait(signal).unwrap();
+        }
+    }
+
+    /// Signal that no more items will be pushed; idle workers drain and exit
+    pub fn close(&self) {
+        let mut signal = self.signal.lock().unwrap();
+        signal.closed = true;
+        drop(signal);
+        self.available.notify_all();
+    }
+
+    /// Take the next item for the given worker, blocking until one is available.
+    /// Returns None once the queue is closed and fully drained.
+    pub fn pop(&self, worker: usize) -> Option<T> {
+        // Claim an item first: once pending has been decremented on our behalf,
+        // at least one unclaimed item is guaranteed to sit in some deque.
+        {
+            let mut signal = self.signal.lock().unwrap();
+            loop {
+                if signal.pending > 0 {
+                    signal.pending -= 1;
+                    self.claimed.notify_one();
+                    break;
+                }
+                if signal.closed {
+                    return None;
+                }
+                signal = self.available.wait(signal).unwrap();
+            }
+        }
+
+        let count = self.deques.len();
+        let own = worker % count;
+        loop {
+            if let Some(item) = self.deques[own].lock().unwrap().pop_front() {
+                return Some(item);
+            }
+            for offset in 1..count {
+                let victim = (own + offset) % count;
+                if let Some(item) = self.deques[victim].lock().unwrap().pop_back() {
+                    return Some(item);
+                }
+            }
+            // Another worker raced us to the deque holding an item; rescan
+            std::thread::yield_now();
+        }
+    }
+}
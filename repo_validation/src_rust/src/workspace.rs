@@ -0,0 +1,144 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//! Workspace mode (--workspace <manifest>).
+//!
+//! Validates several repositories in one process, one after the other, with the
+//! same options. The manifest lists one repository root per line; blank lines and
+//! lines starting with '#' are ignored, and relative roots are resolved against the
+//! manifest's folder.
+//!
+//! Each repository is followed by the submodules vendored in its deps folder,
+//! and theirs, each validated as a repository of its own: the deps folder stays
+//! excluded from the walk of the repository that vendors it.
+//!
+//! The repositories share one in-memory result cache. Cached results are keyed by
+//! path relative to the repository (or submodule) root and content hash, so a
+//! submodule vendored at the same commit by several repositories - deps/c-pal of
+//! one and deps/c-util/deps/c-pal of another - replays the results of its first
+//! copy instead of being checked again.
+
+use std::collections::HashSet;
+use std::fs;
+use std::io;
+use std::path::{Path, PathBuf};
+
+use crate::cache::ResultCache;
+use crate::checks::Check;
+use crate::config::ValidatorConfig;
+use crate::exclusions::Exclusions;
+
+/// Folder of a repository holding its vendored submodules
+const DEPS_FOLDER: &str = "deps";
+
+/// Read the repository roots listed in the manifest
+pub fn read_manifest(manifest_path: &str) -> Result<Vec<String>, String> {
+    let content = fs::read_to_string(manifest_path).map_err(|e| format!("{}: {}", manifest_path, e))?;
+    let base = Path::new(manifest_path).parent().unwrap_or(Path::new(""));
+
+    let mut roots = Vec::new();
+    for line in content.lines() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let root = if Path::new(line).is_absolute() || base.as_os_str().is_empty() {
+            line.to_string()
+        } else {
+            base.join(line).to_string_lossy().into_owned()
+        };
+        let root = root.trim_end_matches(['/', '\\']).to_string();
+        if !Path::new(&root).is_dir() {
+            return Err(format!("{}: '{}' is not a directory", manifest_path, root));
+        }
+        roots.push(root);
+    }
+    if roots.is_empty() {
+        return Err(format!("{}: no repository roots listed", manifest_path));
+    }
+    Ok(roots)
+}
+
+/// `roots`, each followed depth-first by the submodules checked out in its deps
+/// folder (the folders there with a .git entry), in name order. A folder listed
+/// twice is only kept the first time.
+fn with_submodules(roots: &[String]) -> Vec<String> {
+    let mut all: Vec<String> = Vec::with_capacity(roots.len());
+    let mut seen: HashSet<PathBuf> = HashSet::new();
+    for root in roots {
+        add_with_submodules(&mut all, &mut seen, root.clone());
+    }
+    all
+}
+
+fn add_with_submodules(all: &mut Vec<String>, seen: &mut HashSet<PathBuf>, root: String) {
+    if !seen.insert(fs::canonicalize(&root).unwrap_or_else(|_| PathBuf::from(&root))) {
+        return;
+    }
+    let deps = Path::new(&root).join(DEPS_FOLDER);
+    all.push(root);
+
+    let mut submodules: Vec<String> = match fs::read_dir(&deps) {
+        Ok(entries) => entries
+            .flatten()
+            .filter(|entry| entry.file_type().is_ok_and(|file_type| file_type.is_dir()))
+            .filter(|entry| entry.path().join(".git").exists())
+            .map(|entry| entry.path().to_string_lossy().into_owned())
+            .collect(),
+        Err(_) => Vec::new(),
+    };
+    submodules.sort();
+    for submodule in submodules {
+        add_with_submodules(all, seen, submodule);
+    }
+}
+
+/// Validate every repository of the workspace with the options of `template`
+/// (whose repo_root is ignored). Returns the number of repositories that failed, or
+/// the error that stopped the run (see crate::validate).
+pub fn run(template: &ValidatorConfig, active_checks: &mut Vec<Box<dyn Check>>, roots: &[String]) -> io::Result<usize> {
+    // Fix mode never uses the cache
+    let mut shared = if template.fix_mode { None } else { Some(ResultCache::empty()) };
+    let roots = with_submodules(roots);
+    let mut verdicts: Vec<(&str, bool)> = Vec::with_capacity(roots.len());
+
+    for root in &roots {
+        let config = ValidatorConfig {
+            repo_root: root.clone(),
+            exclusions: Exclusions::new(template.exclusions.folders().to_vec(), template.exclusions.gitignore()),
+            fix_mode: template.fix_mode,
+            submodule_sha: template.submodule_sha.clone(),
+            jobs: template.jobs,
+            cache_path: None,
+            changed_paths: None,
+            srs_index_out: None,
+            timings: template.timings,
+            trace_out: None,
+            workspace: true,
+            staged: None,
+            batched_reads: template.batched_reads,
+            max_memory: template.max_memory,
+            map_files: template.map_files,
+        };
+        crate::print_header(&config, active_checks);
+        let (violations, cache) = crate::validate(&config, active_checks, shared.take())?;
+        shared = cache;
+        verdicts.push((root, violations == 0));
+        println!();
+    }
+
+    println!("========================================");
+    println!("Workspace Summary");
+    println!("========================================");
+    for (root, passed) in &verdicts {
+        println!("  {:<40} [{}]", root, if *passed { "PASSED" } else { "FAILED" });
+    }
+    let failed = verdicts.iter().filter(|(_, passed)| !passed).count();
+    println!();
+    if failed > 0 {
+        println!("[WORKSPACE FAILED]");
+    } else {
+        println!("[WORKSPACE PASSED]");
+    }
+    Ok(failed)
+}
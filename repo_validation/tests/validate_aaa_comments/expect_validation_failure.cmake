@@ -26,4 +26,17 @@ if(NOT VALIDATION_RESULT EQUAL 1)
     message(FATAL_ERROR "aaa_comments validation should exit with code 1 for invalid fixture ${REPO_ROOT}, but exited with ${VALIDATION_RESULT}")
 endif()
 
+# EXPECTED_FINDINGS_FILE optionally sets EXPECTED_FINDINGS, text the output must
+# contain, for fixtures where failing for the wrong test or with the wrong markers
+# must be caught too
+if(DEFINED EXPECTED_FINDINGS_FILE)
+    include("${EXPECTED_FINDINGS_FILE}")
+endif()
+foreach(EXPECTED_FINDING IN LISTS EXPECTED_FINDINGS)
+    string(FIND "${VALIDATION_OUTPUT}" "${EXPECTED_FINDING}" FINDING_POSITION)
+    if(FINDING_POSITION EQUAL -1)
+        message(FATAL_ERROR "aaa_comments validation output for ${REPO_ROOT} should contain: ${EXPECTED_FINDING}")
+    endif()
+endforeach()
+
 message(STATUS "aaa_comments validation failed as expected for invalid fixture: ${REPO_ROOT}")
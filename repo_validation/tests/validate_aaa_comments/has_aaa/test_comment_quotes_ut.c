@@ -0,0 +1,77 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Test file with apostrophes and braces inside comments and literals
+// This tests that comments, strings and char literals are skipped as a whole when
+// the test bodies and their AAA comments are found
+
+#include "testrunnerswitcher.h"
+
+BEGIN_TEST_SUITE(test_comment_quotes_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+}
+
+// A commented out test is not a test: TEST_FUNCTION(test_commented_out) {
+/* TEST_FUNCTION(test_in_block_comment)
+{
+    int not_a_test = 0;
+} */
+
+// Test with apostrophes in its comments
+TEST_FUNCTION(test_with_apostrophe_in_comments)
+{
+    // arrange
+    // the handle isn't created yet, so there's nothing to clean up
+    int value = 1;
+
+    // act
+    value++; // don't wrap around
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 2, value);
+}
+
+// Test with braces in its comments
+TEST_FUNCTION(test_with_braces_in_comments)
+{
+    // arrange
+    // a stray { in a comment does not open a block
+    int value = 1; /* nor does this one: { { */
+
+    // act
+    value += 2; // } and this one does not close it
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 3, value);
+}
+
+// Test with quotes, comment markers and braces inside literals
+TEST_FUNCTION(test_with_quotes_in_literals)
+{
+    // arrange
+    char apostrophe = '\'';
+    char quote = '"';
+    char open_brace = '{';
+    const char* text = "it's a /* not a comment */ string with a } and // no comment";
+
+    // act
+    size_t len = strlen(text) + apostrophe + quote + open_brace;
+
+    // assert
+    ASSERT_IS_TRUE(len > 0);
+}
+
+// Test whose body ends right after a literal with an unmatched brace and apostrophe
+TEST_FUNCTION(test_with_literal_before_closing_brace)
+{
+    // arrange
+    const char* message = "can't close }";
+
+    // act
+    size_t len = strlen(message);
+
+    // assert
+    ASSERT_IS_TRUE(len > 0); /* } */
+}
+
+END_TEST_SUITE(test_comment_quotes_ut)
@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Test file with AAA comments in helpers called by other helpers
+
+#include "testrunnerswitcher.h"
+
+BEGIN_TEST_SUITE(test_nested_helper_aaa_ut)
+
+// Helper function containing arrange comment
+static void create_input(int* value)
+{
+    // arrange
+    *value = 7;
+}
+
+// Helper function containing act comment
+static int run_operation(int input)
+{
+    // act
+    return input + 1;
+}
+
+// Helper function containing assert comment
+static void check_output(int expected, int actual)
+{
+    // assert
+    ASSERT_ARE_EQUAL(int, expected, actual);
+}
+
+// Helper that only calls other helpers
+static int prepare_and_run(void)
+{
+    int value;
+    create_input(&value);
+    return run_operation(value);
+}
+
+// Two levels of helpers below the test
+static void run_scenario(void)
+{
+    int result = prepare_and_run();
+    check_output(8, result);
+}
+
+// Helpers calling each other; together they contain all three comments
+static int countdown_even(int n);
+
+static int countdown_odd(int n)
+{
+    // arrange
+    // act
+    return (n == 0) ? 0 : countdown_even(n - 1);
+}
+
+static int countdown_even(int n)
+{
+    // assert
+    ASSERT_IS_TRUE(n >= 0);
+    return (n == 0) ? 0 : countdown_odd(n - 1);
+}
+
+// Test whose AAA comments are two helper levels deep
+TEST_FUNCTION(test_with_nested_helpers)
+{
+    run_scenario();
+}
+
+// Test whose AAA comments are split across mutually recursive helpers
+TEST_FUNCTION(test_with_recursive_helpers)
+{
+    (void)countdown_even(4);
+}
+
+END_TEST_SUITE(test_nested_helper_aaa_ut)
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Test file with apostrophes and braces inside comments and literals but missing AAA
+// This should FAIL validation for every test - neither may hide a test or its body
+
+#include "testrunnerswitcher.h"
+
+BEGIN_TEST_SUITE(test_comment_quotes_missing_aaa_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+}
+
+// Test with an apostrophe in a comment and NO AAA comments - should FAIL
+TEST_FUNCTION(test_apostrophe_in_comment_no_aaa)
+{
+    // it's this apostrophe that must not hide the test
+    int value = 1;
+    (void)value;
+}
+
+// Test with braces in comments and NO AAA comments - should FAIL
+TEST_FUNCTION(test_braces_in_comments_no_aaa)
+{
+    // a stray { in a comment
+    int value = 1; /* } } */
+    (void)value;
+}
+
+// Test with AAA comments only inside string literals - should FAIL
+TEST_FUNCTION(test_aaa_in_strings_only)
+{
+    const char* arrange = "// arrange";
+    const char* act = "/* act */";
+    const char* assert_text = "// assert";
+    (void)arrange;
+    (void)act;
+    (void)assert_text;
+}
+
+// Test with quotes in char literals and NO assert comment - should FAIL
+TEST_FUNCTION(test_char_literals_missing_assert)
+{
+    // arrange
+    char apostrophe = '\'';
+    char quote = '"';
+
+    // act
+    int sum = apostrophe + quote + '{';
+    (void)sum;
+}
+
+// A commented out declaration must not swallow the next test: TEST_FUNCTION(test_commented_out) {
+
+// Test after a commented out test and NO AAA comments - should FAIL
+TEST_FUNCTION(test_after_commented_out_test_no_aaa)
+{
+    int value = '}';
+    (void)value;
+}
+
+END_TEST_SUITE(test_comment_quotes_missing_aaa_ut)
@@ -0,0 +1,13 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+# Findings expected for missing_aaa_comments_quotes: every test is reported with
+# exactly its own missing markers
+set(EXPECTED_FINDINGS
+    "TEST_FUNCTION(test_apostrophe_in_comment_no_aaa) - missing AAA: arrange, act, assert"
+    "TEST_FUNCTION(test_braces_in_comments_no_aaa) - missing AAA: arrange, act, assert"
+    "TEST_FUNCTION(test_aaa_in_strings_only) - missing AAA: arrange, act, assert"
+    "TEST_FUNCTION(test_char_literals_missing_assert) - missing AAA: assert"
+    "TEST_FUNCTION(test_after_commented_out_test_no_aaa) - missing AAA: arrange, act, assert"
+    "Test functions: 5, exempted: 0, violations: 5"
+)
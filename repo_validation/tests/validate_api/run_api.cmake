@@ -0,0 +1,102 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED VALIDATE_BUFFERS_EXE)
+    message(FATAL_ERROR "VALIDATE_BUFFERS_EXE must be specified")
+endif()
+
+if(NOT DEFINED WORK_DIR)
+    message(FATAL_ERROR "WORK_DIR must be specified")
+endif()
+
+if(NOT DEFINED CASE)
+    message(FATAL_ERROR "CASE must be specified")
+endif()
+
+string(ASCII 9 TAB)
+string(ASCII 13 CR)
+
+# The contents are stored under names that have nothing to do with the paths they
+# are checked as: the paths passed to validate_files do not exist anywhere
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/repo")
+file(WRITE "${WORK_DIR}/tabs_and_lf.bin" "int tabbed;${CR}\nint other;${TAB}// tab${CR}\nint last;\n")
+file(WRITE "${WORK_DIR}/clean.bin" "int clean;${CR}\n")
+
+function(run_validate_buffers EXPECTED_RESULT)
+    execute_process(
+        COMMAND "${VALIDATE_BUFFERS_EXE}" --repo-root "${WORK_DIR}/repo" ${ARGN}
+        RESULT_VARIABLE RESULT
+        OUTPUT_VARIABLE OUTPUT
+        ERROR_VARIABLE ERROR
+    )
+    message(STATUS "${OUTPUT}")
+    if(ERROR)
+        message(STATUS "${ERROR}")
+    endif()
+    if(NOT RESULT EQUAL EXPECTED_RESULT)
+        message(FATAL_ERROR "validate_buffers should exit with code ${EXPECTED_RESULT}, but exited with ${RESULT}")
+    endif()
+    set(OUTPUT "${OUTPUT}" PARENT_SCOPE)
+    set(ERROR "${ERROR}" PARENT_SCOPE)
+endfunction()
+
+function(expect_line LINE)
+    string(FIND "${OUTPUT}" "${LINE}\n" FOUND)
+    if(FOUND EQUAL -1)
+        message(FATAL_ERROR "expected the line '${LINE}'")
+    endif()
+endfunction()
+
+function(expect_no_match PATTERN)
+    if(OUTPUT MATCHES "${PATTERN}")
+        message(FATAL_ERROR "did not expect output matching '${PATTERN}'")
+    endif()
+endfunction()
+
+if(CASE STREQUAL "findings")
+    run_validate_buffers(1
+        "src/module.c=${WORK_DIR}/tabs_and_lf.bin"
+        "src/clean.c=${WORK_DIR}/clean.bin"
+    )
+    # One finding per check and file, with the path and line it was given
+    expect_line("finding no_tabs src/module.c:2 ERROR src/module.c - contains 1 tab(s), first at line 2")
+    expect_line("finding file_endings src/module.c ERROR src/module.c - ends with LF only (expected CRLF)")
+    expect_no_match("finding [a-z_]+ src/clean.c")
+    expect_line("check no_tabs 1")
+    expect_line("check file_endings 1")
+    expect_line("check no_vld_include 0")
+    expect_line("files_checked 2")
+elseif(CASE STREQUAL "with_checks")
+    run_validate_buffers(1
+        --check no_tabs --check no_vld_include
+        "src/module.c=${WORK_DIR}/tabs_and_lf.bin"
+    )
+    # Only the named checks run, in check order: file_endings reports nothing
+    expect_line("finding no_tabs src/module.c:2 ERROR src/module.c - contains 1 tab(s), first at line 2")
+    expect_no_match("file_endings")
+    string(REGEX MATCHALL "check [a-z_]+ [0-9]+" CHECKS "${OUTPUT}")
+    if(NOT CHECKS STREQUAL "check no_tabs 1;check no_vld_include 0")
+        message(FATAL_ERROR "expected only no_tabs and no_vld_include to run, got '${CHECKS}'")
+    endif()
+
+    # The same selection passes on a clean buffer
+    run_validate_buffers(0
+        --check no_tabs --check no_vld_include
+        "src/clean.c=${WORK_DIR}/clean.bin"
+    )
+    expect_no_match("finding ")
+elseif(CASE STREQUAL "unknown_check")
+    run_validate_buffers(2
+        --check no_tabs --check no_such_check
+        "src/module.c=${WORK_DIR}/tabs_and_lf.bin"
+    )
+    if(NOT ERROR MATCHES "no check named 'no_such_check'")
+        message(FATAL_ERROR "expected with_checks to reject 'no_such_check', got '${ERROR}'")
+    endif()
+    expect_no_match("finding ")
+else()
+    message(FATAL_ERROR "unknown CASE '${CASE}'")
+endif()
+
+message(STATUS "Library API case '${CASE}' passed")
@@ -0,0 +1,82 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED TEST_SHA)
+    message(FATAL_ERROR "TEST_SHA must be specified")
+endif()
+
+if(NOT DEFINED WORK_DIR)
+    message(FATAL_ERROR "WORK_DIR must be specified")
+endif()
+
+# The pipeline file is written here rather than checked in, so that git's line
+# ending conversion cannot change the bytes under test
+string(ASCII 13 CR)
+set(CRLF "${CR}\n")
+
+# Written with the wrong ref and with the ref the fix should leave; only the
+# value after "ref:" differs, the indentation and every CRLF stay
+foreach(REF_VALUE IN ITEMS "deadbeefdeadbeefdeadbeefdeadbeefdeadbeef" "${TEST_SHA}")
+    set(CONTENT "name: $(BuildID)_$(BuildDefinitionName)_$(SourceBranchName)${CRLF}")
+    string(APPEND CONTENT "${CRLF}")
+    string(APPEND CONTENT "resources:${CRLF}")
+    string(APPEND CONTENT "    repositories:${CRLF}")
+    string(APPEND CONTENT "      - repository: self${CRLF}")
+    string(APPEND CONTENT "        clean: true${CRLF}")
+    string(APPEND CONTENT "      - repository: c_build_tools${CRLF}")
+    string(APPEND CONTENT "        type: github${CRLF}")
+    string(APPEND CONTENT "        name: azure/c-build-tools${CRLF}")
+    string(APPEND CONTENT "        endpoint: github.com_azure${CRLF}")
+    string(APPEND CONTENT "        ref: ${REF_VALUE}${CRLF}")
+    string(APPEND CONTENT "${CRLF}")
+    string(APPEND CONTENT "jobs:${CRLF}")
+    string(APPEND CONTENT "- template: /pipeline_templates/build_all_flavors.yml@c_build_tools${CRLF}")
+    list(APPEND CONTENTS "${CONTENT}")
+endforeach()
+list(GET CONTENTS 0 INPUT)
+list(GET CONTENTS 1 EXPECTED)
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+# The check only applies to a repository with the c-build-tools submodule
+file(WRITE "${WORK_DIR}/repo/.gitmodules"
+    "[submodule \"deps/c-build-tools\"]\n"
+    "\tpath = deps/c-build-tools\n"
+    "\turl = https://github.com/Azure/c-build-tools\n"
+)
+file(WRITE "${WORK_DIR}/repo/build/devops_gated.yml" "${INPUT}")
+file(WRITE "${WORK_DIR}/expected.yml" "${EXPECTED}")
+
+execute_process(
+    COMMAND "${REPO_VALIDATOR_RS_EXE}" --repo-root "${WORK_DIR}/repo" --check c_build_tools_ref --submodule-sha "${TEST_SHA}" --fix
+    RESULT_VARIABLE FIX_RESULT
+    OUTPUT_VARIABLE FIX_OUTPUT
+    ERROR_VARIABLE FIX_ERROR
+)
+
+message(STATUS "${FIX_OUTPUT}")
+if(FIX_ERROR)
+    message(STATUS "${FIX_ERROR}")
+endif()
+
+if(NOT FIX_RESULT EQUAL 0)
+    message(FATAL_ERROR "c_build_tools_ref --fix should exit with code 0, but exited with ${FIX_RESULT}")
+endif()
+
+string(FIND "${FIX_OUTPUT}" "[FIXED] Updated ref to" FIXED_POSITION)
+if(FIXED_POSITION EQUAL -1)
+    message(FATAL_ERROR "c_build_tools_ref --fix should report the updated ref")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files "${WORK_DIR}/repo/build/devops_gated.yml" "${WORK_DIR}/expected.yml"
+    RESULT_VARIABLE COMPARE_RESULT
+)
+if(NOT COMPARE_RESULT EQUAL 0)
+    message(FATAL_ERROR "The fixed pipeline file differs from ${WORK_DIR}/expected.yml: the ref line should keep its indentation and every line its CRLF")
+endif()
+
+message(STATUS "c_build_tools_ref --fix kept the indentation and the CRLF line endings")
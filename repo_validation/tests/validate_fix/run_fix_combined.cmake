@@ -0,0 +1,87 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED WORK_DIR)
+    message(FATAL_ERROR "WORK_DIR must be specified")
+endif()
+
+# The file is written here rather than checked in, so that git's line ending
+# conversion cannot change the bytes under test
+string(ASCII 9 TAB)
+string(ASCII 13 CR)
+set(LF "\n")
+
+set(INPUT "// Copyright (c) Microsoft. All rights reserved.${LF}")
+string(APPEND INPUT "${LF}")
+string(APPEND INPUT "#include <stdlib.h>${LF}")
+string(APPEND INPUT "#include \"vld.h\"${LF}")
+string(APPEND INPUT "#include \"combined.h\"${LF}")
+string(APPEND INPUT "${LF}")
+string(APPEND INPUT "int combined_scale(int a)${LF}")
+string(APPEND INPUT "{${LF}")
+string(APPEND INPUT "${TAB}if (a > 0)${LF}")
+string(APPEND INPUT "${TAB}{${LF}")
+string(APPEND INPUT "${TAB}${TAB}return a *${TAB}2;${LF}")
+string(APPEND INPUT "${TAB}}${LF}")
+string(APPEND INPUT "${TAB}return 0;${LF}")
+string(APPEND INPUT "}${LF}")
+
+# no_tabs replaces each tab with four spaces, no_vld_include drops the include line
+# and file_endings ends the last line with CRLF; every other byte is kept
+set(EXPECTED "// Copyright (c) Microsoft. All rights reserved.${LF}")
+string(APPEND EXPECTED "${LF}")
+string(APPEND EXPECTED "#include <stdlib.h>${LF}")
+string(APPEND EXPECTED "#include \"combined.h\"${LF}")
+string(APPEND EXPECTED "${LF}")
+string(APPEND EXPECTED "int combined_scale(int a)${LF}")
+string(APPEND EXPECTED "{${LF}")
+string(APPEND EXPECTED "    if (a > 0)${LF}")
+string(APPEND EXPECTED "    {${LF}")
+string(APPEND EXPECTED "        return a *    2;${LF}")
+string(APPEND EXPECTED "    }${LF}")
+string(APPEND EXPECTED "    return 0;${LF}")
+string(APPEND EXPECTED "}${CR}${LF}")
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/repo")
+file(WRITE "${WORK_DIR}/repo/combined.c" "${INPUT}")
+file(WRITE "${WORK_DIR}/expected.c" "${EXPECTED}")
+
+execute_process(
+    COMMAND "${REPO_VALIDATOR_RS_EXE}" --repo-root "${WORK_DIR}/repo" --check no_tabs --check file_endings --check no_vld_include --fix
+    RESULT_VARIABLE FIX_RESULT
+    OUTPUT_VARIABLE FIX_OUTPUT
+    ERROR_VARIABLE FIX_ERROR
+)
+
+message(STATUS "${FIX_OUTPUT}")
+
+if(FIX_ERROR)
+    message(STATUS "${FIX_ERROR}")
+endif()
+
+if(NOT FIX_RESULT EQUAL 0)
+    message(FATAL_ERROR "--fix should exit with code 0 once every fix is written, but exited with ${FIX_RESULT}")
+endif()
+
+foreach(FIXED "replaced 7 tab\\(s\\)" "converted LF to CRLF" "removed 1 vld.h include\\(s\\)")
+    if(NOT FIX_OUTPUT MATCHES "\\[FIXED\\] combined.c - ${FIXED}")
+        message(FATAL_ERROR "--fix did not report the fix matching '${FIXED}'")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files "${WORK_DIR}/repo/combined.c" "${WORK_DIR}/expected.c"
+    RESULT_VARIABLE COMPARE_RESULT
+)
+
+if(NOT COMPARE_RESULT EQUAL 0)
+    file(READ "${WORK_DIR}/repo/combined.c" ACTUAL HEX)
+    message(FATAL_ERROR "combined.c after --fix differs from the expected bytes; got ${ACTUAL}")
+endif()
+
+message(STATUS "All three fixes landed in combined.c in one write")
@@ -0,0 +1,119 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED REPO_DIR)
+    message(FATAL_ERROR "REPO_DIR must be specified")
+endif()
+
+# The repository is written here rather than checked in: a checked in .git folder
+# is not possible, and the ignored files must not be ignored by this repository's
+# own walk or .gitignore
+string(ASCII 9 TAB)
+set(TABBED_CONTENT "int tabbed(void)\r\n{\r\n${TAB}return 0;\r\n}\r\n")
+
+# Every file below contains a tab; the ignore files decide which ones are checked.
+# Files that stay checked (each rule leaves one behind):
+set(CHECKED_FILES
+    # !keep.gen.c re-includes it after *.gen.c ignored it
+    "keep.gen.c"
+    # build_*/ only matches directories
+    "build_notes.c"
+    # /top_only.c is anchored to the root
+    "src/top_only.c"
+    # docs/scratch.c contains a slash, so it is anchored to the root as well
+    "src/docs/scratch.c"
+    # src/.gitignore re-includes it below the root .gitignore's *.gen.c
+    "src/local.gen.c"
+)
+# Files that are ignored:
+set(IGNORED_FILES
+    # *.gen.c has no slash, so it matches the name at any depth
+    "output.gen.c"
+    "src/nested/other.gen.c"
+    # build_*/ prunes the directory
+    "build_x64/main.c"
+    "top_only.c"
+    "docs/scratch.c"
+    # listed in .git/info/exclude
+    "private_notes.c"
+    # src/.gitignore matches paths relative to src
+    "src/scratch/main.c"
+)
+
+file(REMOVE_RECURSE "${REPO_DIR}")
+foreach(FILE_PATH IN LISTS CHECKED_FILES IGNORED_FILES)
+    file(WRITE "${REPO_DIR}/${FILE_PATH}" "${TABBED_CONTENT}")
+endforeach()
+
+file(WRITE "${REPO_DIR}/.gitignore"
+    "# Generated sources\n"
+    "*.gen.c\n"
+    "!keep.gen.c\n"
+    "build_*/\n"
+    "/top_only.c\n"
+    "docs/scratch.c\n"
+)
+file(WRITE "${REPO_DIR}/src/.gitignore"
+    "!local.gen.c\n"
+    "/scratch/\n"
+)
+file(WRITE "${REPO_DIR}/.git/info/exclude" "private_notes.c\n")
+
+# Run no_tabs on the repository; EXPECTED_RESULT is the exit code
+function(run_no_tabs EXPECTED_RESULT DESCRIPTION)
+    execute_process(
+        COMMAND "${REPO_VALIDATOR_RS_EXE}" --repo-root "${REPO_DIR}" --check no_tabs ${ARGN}
+        RESULT_VARIABLE VALIDATION_RESULT
+        OUTPUT_VARIABLE VALIDATION_OUTPUT
+        ERROR_VARIABLE VALIDATION_ERROR
+    )
+    message(STATUS "${VALIDATION_OUTPUT}")
+    if(VALIDATION_ERROR)
+        message(STATUS "${VALIDATION_ERROR}")
+    endif()
+    if(NOT VALIDATION_RESULT EQUAL EXPECTED_RESULT)
+        message(FATAL_ERROR "${DESCRIPTION}: expected exit code ${EXPECTED_RESULT}, got ${VALIDATION_RESULT}")
+    endif()
+    set(VALIDATION_OUTPUT "${VALIDATION_OUTPUT}" PARENT_SCOPE)
+endfunction()
+
+# A file is reported under its relative path, with either separator
+function(is_reported OUTPUT_VAR FILE_PATH)
+    string(REGEX REPLACE "([.])" "[.]" PATTERN "${FILE_PATH}")
+    string(REPLACE "/" "[/\\\\]" PATTERN "${PATTERN}")
+    if("${VALIDATION_OUTPUT}" MATCHES "(^|[ \t\n])${PATTERN} - contains 1 tab")
+        set(${OUTPUT_VAR} TRUE PARENT_SCOPE)
+    else()
+        set(${OUTPUT_VAR} FALSE PARENT_SCOPE)
+    endif()
+endfunction()
+
+# Test 1: Without --gitignore every file is checked, ignored or not
+run_no_tabs(1 "without --gitignore the tabs should be reported")
+foreach(FILE_PATH IN LISTS CHECKED_FILES IGNORED_FILES)
+    is_reported(REPORTED "${FILE_PATH}")
+    if(NOT REPORTED)
+        message(FATAL_ERROR "without --gitignore ${FILE_PATH} should be reported")
+    endif()
+endforeach()
+
+# Test 2: With --gitignore only the files that no rule ignores are checked
+run_no_tabs(1 "with --gitignore the tabs of checked files should be reported" --gitignore)
+foreach(FILE_PATH IN LISTS CHECKED_FILES)
+    is_reported(REPORTED "${FILE_PATH}")
+    if(NOT REPORTED)
+        message(FATAL_ERROR "with --gitignore ${FILE_PATH} should still be reported")
+    endif()
+endforeach()
+foreach(FILE_PATH IN LISTS IGNORED_FILES)
+    is_reported(REPORTED "${FILE_PATH}")
+    if(REPORTED)
+        message(FATAL_ERROR "with --gitignore ${FILE_PATH} should be ignored")
+    endif()
+endforeach()
+
+message(STATUS "--gitignore honored negation, directory-only and anchored patterns and .git/info/exclude")
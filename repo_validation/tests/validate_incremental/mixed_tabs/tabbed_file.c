@@ -0,0 +1,6 @@
+// Copyright (c) Microsoft. All rights reserved.
+
+int tabbed_function(void)
+{
+	return 0;
+}
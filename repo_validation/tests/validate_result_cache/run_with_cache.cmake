@@ -0,0 +1,46 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED REPO_ROOT)
+    message(FATAL_ERROR "REPO_ROOT must be specified")
+endif()
+
+if(NOT DEFINED CACHE_FILE)
+    message(FATAL_ERROR "CACHE_FILE must be specified")
+endif()
+
+if(NOT DEFINED EXPECTED_RESULT)
+    message(FATAL_ERROR "EXPECTED_RESULT must be specified")
+endif()
+
+file(REMOVE "${CACHE_FILE}")
+
+foreach(RUN cold warm)
+    execute_process(
+        COMMAND "${REPO_VALIDATOR_RS_EXE}" --repo-root "${REPO_ROOT}" --check srs_uniqueness --cache "${CACHE_FILE}"
+        RESULT_VARIABLE VALIDATION_RESULT
+        OUTPUT_VARIABLE VALIDATION_OUTPUT
+        ERROR_VARIABLE VALIDATION_ERROR
+    )
+
+    message(STATUS "${VALIDATION_OUTPUT}")
+
+    if(VALIDATION_ERROR)
+        message(STATUS "${VALIDATION_ERROR}")
+    endif()
+
+    if(NOT VALIDATION_RESULT EQUAL EXPECTED_RESULT)
+        message(FATAL_ERROR "${RUN} run should exit with code ${EXPECTED_RESULT} for fixture ${REPO_ROOT}, but exited with ${VALIDATION_RESULT}")
+    endif()
+endforeach()
+
+# Every file is unchanged on the warm run, so nothing may be re-checked
+if(NOT VALIDATION_OUTPUT MATCHES "Result cache: reused results for [1-9][0-9]* file\\(s\\), checked 0 file\\(s\\)")
+    message(FATAL_ERROR "warm run did not reuse the cached results for fixture ${REPO_ROOT}")
+endif()
+
+message(STATUS "Result cache produced the same verdict on the cold and warm runs for fixture: ${REPO_ROOT}")
@@ -0,0 +1,18 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED SRS_INDEX_FILE)
+    message(FATAL_ERROR "SRS_INDEX_FILE must be specified")
+endif()
+
+if(NOT EXISTS "${SRS_INDEX_FILE}")
+    message(FATAL_ERROR "SRS index was not written: ${SRS_INDEX_FILE}")
+endif()
+
+# Header: "SRSINDEX" magic followed by format version 2 (little-endian u32)
+file(READ "${SRS_INDEX_FILE}" SRS_INDEX_HEADER LIMIT 12 HEX)
+if(NOT SRS_INDEX_HEADER STREQUAL "535253494e44455802000000")
+    message(FATAL_ERROR "Unexpected SRS index header: ${SRS_INDEX_HEADER}")
+endif()
+
+message(STATUS "SRS index header is valid: ${SRS_INDEX_FILE}")
@@ -0,0 +1,77 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT GIT_EXECUTABLE)
+    message(FATAL_ERROR "GIT_EXECUTABLE must be specified")
+endif()
+
+if(NOT DEFINED FIXTURE_FILE)
+    message(FATAL_ERROR "FIXTURE_FILE must be specified")
+endif()
+
+if(NOT DEFINED REPO_DIR)
+    message(FATAL_ERROR "REPO_DIR must be specified")
+endif()
+
+function(run_git)
+    execute_process(
+        COMMAND "${GIT_EXECUTABLE}" -c user.name=validator -c user.email=validator@localhost -c core.autocrlf=false ${ARGN}
+        WORKING_DIRECTORY "${REPO_DIR}"
+        RESULT_VARIABLE GIT_RESULT
+        OUTPUT_QUIET
+        ERROR_VARIABLE GIT_ERROR
+    )
+    if(NOT GIT_RESULT EQUAL 0)
+        message(FATAL_ERROR "git ${ARGN} failed: ${GIT_ERROR}")
+    endif()
+endfunction()
+
+# Run the validator on the staged content; EXPECTED_RESULT is its exit code
+function(run_staged EXPECTED_RESULT DESCRIPTION)
+    execute_process(
+        COMMAND "${REPO_VALIDATOR_RS_EXE}" --repo-root "${REPO_DIR}" --check no_tabs --staged
+        RESULT_VARIABLE VALIDATION_RESULT
+        OUTPUT_VARIABLE VALIDATION_OUTPUT
+        ERROR_VARIABLE VALIDATION_ERROR
+    )
+    message(STATUS "${VALIDATION_OUTPUT}")
+    if(VALIDATION_ERROR)
+        message(STATUS "${VALIDATION_ERROR}")
+    endif()
+    if(NOT VALIDATION_RESULT EQUAL EXPECTED_RESULT)
+        message(FATAL_ERROR "${DESCRIPTION}: expected exit code ${EXPECTED_RESULT}, got ${VALIDATION_RESULT}")
+    endif()
+endfunction()
+
+file(REMOVE_RECURSE "${REPO_DIR}")
+file(MAKE_DIRECTORY "${REPO_DIR}")
+file(COPY "${FIXTURE_FILE}" DESTINATION "${REPO_DIR}")
+get_filename_component(FILE_NAME "${FIXTURE_FILE}" NAME)
+file(READ "${FIXTURE_FILE}" CLEAN_CONTENT)
+
+run_git(init -q)
+run_git(add "${FILE_NAME}")
+run_git(commit -q -m "clean file")
+
+# Test 1: A tab added to the working tree but not staged is not part of the commit
+file(APPEND "${REPO_DIR}/${FILE_NAME}" "\tint unstaged_tab;\r\n")
+run_staged(0 "an unstaged tab should not be reported")
+
+# Test 2: A staged tab is reported even after the working tree copy was cleaned up
+run_git(add "${FILE_NAME}")
+file(WRITE "${REPO_DIR}/${FILE_NAME}" "${CLEAN_CONTENT}")
+run_staged(1 "a staged tab should be reported")
+
+# Test 3: A staged file is reported even after it was deleted from the working tree
+run_git(add "${FILE_NAME}")
+run_staged(0 "a clean staged file should pass")
+file(WRITE "${REPO_DIR}/staged_only.c" "\tint staged_only_tab;\r\n")
+run_git(add staged_only.c)
+file(REMOVE "${REPO_DIR}/staged_only.c")
+run_staged(1 "a staged file missing from the working tree should be checked")
+
+message(STATUS "Staged mode checked the staged content only")
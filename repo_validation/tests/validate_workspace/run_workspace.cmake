@@ -0,0 +1,60 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED FIXTURE)
+    message(FATAL_ERROR "FIXTURE must be specified")
+endif()
+
+if(NOT DEFINED WORKSPACE_DIR)
+    message(FATAL_ERROR "WORKSPACE_DIR must be specified")
+endif()
+
+if(NOT DEFINED EXPECTED_RESULT)
+    message(FATAL_ERROR "EXPECTED_RESULT must be specified")
+endif()
+
+# Two identical repositories; the manifest lists them relative to its own folder
+file(REMOVE_RECURSE "${WORKSPACE_DIR}")
+foreach(REPO first second)
+    file(MAKE_DIRECTORY "${WORKSPACE_DIR}/${REPO}")
+    file(COPY "${FIXTURE}/" DESTINATION "${WORKSPACE_DIR}/${REPO}")
+endforeach()
+file(WRITE "${WORKSPACE_DIR}/workspace.txt" "# Workspace test repositories\nfirst\nsecond\n")
+
+execute_process(
+    COMMAND "${REPO_VALIDATOR_RS_EXE}" --workspace "${WORKSPACE_DIR}/workspace.txt" --check srs_uniqueness
+    RESULT_VARIABLE VALIDATION_RESULT
+    OUTPUT_VARIABLE VALIDATION_OUTPUT
+    ERROR_VARIABLE VALIDATION_ERROR
+)
+
+message(STATUS "${VALIDATION_OUTPUT}")
+
+if(VALIDATION_ERROR)
+    message(STATUS "${VALIDATION_ERROR}")
+endif()
+
+if(NOT VALIDATION_RESULT EQUAL EXPECTED_RESULT)
+    message(FATAL_ERROR "workspace run should exit with code ${EXPECTED_RESULT} for fixture ${FIXTURE}, but exited with ${VALIDATION_RESULT}")
+endif()
+
+if(EXPECTED_RESULT EQUAL 0)
+    set(EXPECTED_VERDICT "[WORKSPACE PASSED]")
+else()
+    set(EXPECTED_VERDICT "[WORKSPACE FAILED]")
+endif()
+string(FIND "${VALIDATION_OUTPUT}" "${EXPECTED_VERDICT}" VERDICT_POSITION)
+if(VERDICT_POSITION EQUAL -1)
+    message(FATAL_ERROR "workspace run did not print ${EXPECTED_VERDICT} for fixture ${FIXTURE}")
+endif()
+
+# The second repository is a copy of the first, so nothing in it may be re-checked
+if(NOT VALIDATION_OUTPUT MATCHES "Repository Root: [^\n]*second\n.*Result cache: reused results for [1-9][0-9]* file\\(s\\), checked 0 file\\(s\\)")
+    message(FATAL_ERROR "second repository did not reuse the results of the first for fixture ${FIXTURE}")
+endif()
+
+message(STATUS "Workspace produced the expected verdict for both copies of fixture: ${FIXTURE}")
@@ -0,0 +1,64 @@
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+if(NOT DEFINED REPO_VALIDATOR_RS_EXE)
+    message(FATAL_ERROR "REPO_VALIDATOR_RS_EXE must be specified")
+endif()
+
+if(NOT DEFINED FIXTURE)
+    message(FATAL_ERROR "FIXTURE must be specified")
+endif()
+
+if(NOT DEFINED WORKSPACE_DIR)
+    message(FATAL_ERROR "WORKSPACE_DIR must be specified")
+endif()
+
+# A checked out submodule: the fixture's copy of the repository and a .git file
+# pointing into the superproject (git does not let the fixture hold the .git file)
+function(add_submodule SOURCE DESTINATION)
+    file(MAKE_DIRECTORY "${DESTINATION}")
+    file(COPY "${FIXTURE}/${SOURCE}/" DESTINATION "${DESTINATION}")
+    file(WRITE "${DESTINATION}/.git" "gitdir: ../../.git/modules/${SOURCE}\n")
+endfunction()
+
+# c-util style: the app vendors c-pal and c-util, and c-util vendors the same c-pal
+set(APP_DIR "${WORKSPACE_DIR}/app")
+file(REMOVE_RECURSE "${WORKSPACE_DIR}")
+file(MAKE_DIRECTORY "${APP_DIR}")
+file(COPY "${FIXTURE}/app/" DESTINATION "${APP_DIR}")
+add_submodule(c_pal "${APP_DIR}/deps/c-pal")
+add_submodule(c_util "${APP_DIR}/deps/c-util")
+add_submodule(c_pal "${APP_DIR}/deps/c-util/deps/c-pal")
+file(WRITE "${WORKSPACE_DIR}/workspace.txt" "app\n")
+
+execute_process(
+    COMMAND "${REPO_VALIDATOR_RS_EXE}" --workspace "${WORKSPACE_DIR}/workspace.txt" --check srs_uniqueness
+    RESULT_VARIABLE VALIDATION_RESULT
+    OUTPUT_VARIABLE VALIDATION_OUTPUT
+    ERROR_VARIABLE VALIDATION_ERROR
+)
+
+message(STATUS "${VALIDATION_OUTPUT}")
+
+if(VALIDATION_ERROR)
+    message(STATUS "${VALIDATION_ERROR}")
+endif()
+
+if(NOT VALIDATION_RESULT EQUAL 0)
+    message(FATAL_ERROR "workspace run should pass on the nested deps fixture, but exited with ${VALIDATION_RESULT}")
+endif()
+
+# Every submodule is validated as a repository of its own
+foreach(SUBMODULE deps/c-pal deps/c-util deps/c-util/deps/c-pal)
+    string(FIND "${VALIDATION_OUTPUT}" "Repository Root: ${APP_DIR}/${SUBMODULE}\n" ROOT_POSITION)
+    if(ROOT_POSITION EQUAL -1)
+        message(FATAL_ERROR "workspace run did not validate submodule ${SUBMODULE}")
+    endif()
+endforeach()
+
+# The copy of c-pal under c-util is the last one validated and replays the first copy
+if(NOT VALIDATION_OUTPUT MATCHES "Repository Root: [^\n]*/deps/c-util/deps/c-pal\n.*Result cache: reused results for [1-9][0-9]* file\\(s\\), checked 0 file\\(s\\)")
+    message(FATAL_ERROR "the second copy of c-pal did not reuse the results of the first")
+endif()
+
+message(STATUS "Workspace validated each vendored submodule and reused the results of the repeated one")